@@ -14,6 +14,8 @@ namespace FamiStudio
         private int sizeY;
         private byte[] imageData;
         private byte[][] decodeBuffer = new byte[2][];
+        private int[][] decodeRect = new int[2][] { new int[4], new int[4] };
+        private int[] dirtyRect = new int[4];
         private GCHandle gcHandle;
 
         private Task decodeTask;
@@ -31,8 +33,35 @@ namespace FamiStudio
         private unsafe void DecodeFrame()
         {
             Gif.AdvanceFrame(gif);
-            fixed (byte* p = decodeBuffer[decodeFrameIndex & 1])
-                Gif.RenderFrame(gif, new IntPtr(p), sizeX * 3, 3);
+            Gif.GetDirtyRect(gif, dirtyRect);
+
+            // Only the area that changed is decoded and uploaded. Keep the width a multiple
+            // of 4 pixels so that RGB rows stay 4-byte aligned for the texture upload.
+            var x0 = dirtyRect[0] & ~3;
+            var x1 = Math.Min(sizeX, (dirtyRect[0] + dirtyRect[2] + 3) & ~3);
+            if (((x1 - x0) & 3) != 0)
+            {
+                x0 = 0;
+                x1 = sizeX;
+            }
+
+            var idx = decodeFrameIndex & 1;
+            var rect = decodeRect[idx];
+            rect[0] = x0;
+            rect[1] = dirtyRect[1];
+            rect[2] = x1 - x0;
+            rect[3] = dirtyRect[3];
+
+            var size = rect[2] * rect[3] * 3;
+            if (decodeBuffer[idx] == null || decodeBuffer[idx].Length != size)
+                decodeBuffer[idx] = new byte[size];
+
+            if (size > 0)
+            {
+                fixed (byte* p = decodeBuffer[idx])
+                    Gif.RenderRect(gif, new IntPtr(p), rect[2] * 3, 3, rect[0], rect[1], rect[2], rect[3]);
+            }
+
             decodeFrameIndex++;
             frameReady = true;
         }
@@ -54,8 +83,7 @@ namespace FamiStudio
             gif = Gif.Open(gcHandle.AddrOfPinnedObject(), Platform.IsDesktop ? 1 : 0);
             sizeX = Gif.GetWidth(gif);
             sizeY = Gif.GetHeight(gif);
-            decodeBuffer[0] = new byte[sizeX * sizeY * 3];
-            decodeBuffer[1] = new byte[sizeX * sizeY * 3];
+            Gif.CacheFrames(gif);
             decodeFrameIndex = 0;
             renderFrameIndex = 0;
             DecodeFrame();
@@ -159,7 +187,9 @@ namespace FamiStudio
                 if (frameReady)
                 {
                     var updateStart = Platform.TimeSeconds();
-                    g.UpdateTexture(bmp, 0, 0, sizeX, sizeY, decodeBuffer[renderFrameIndex & 1], TextureFormat.Rgb);
+                    var rect = decodeRect[renderFrameIndex & 1];
+                    if (rect[2] > 0 && rect[3] > 0)
+                        g.UpdateTexture(bmp, rect[0], rect[1], rect[2], rect[3], decodeBuffer[renderFrameIndex & 1], TextureFormat.Rgb);
                     var updateTime = (float)(Platform.TimeSeconds() - updateStart);
                     frameReady = false;
                     renderFrameIndex++;
@@ -815,6 +815,7 @@ namespace FamiStudio
 
         private void UndoRedoManager_Updated()
         {
+            songPlayer?.InvalidateSeekKeyframes();
             ToolBar.MarkDirty();
             ValidateIntegrity();
         }
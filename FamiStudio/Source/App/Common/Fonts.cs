@@ -57,6 +57,17 @@ namespace FamiStudio
             "NotoSansKR-ExtraBold"
         };
 
+        // Printable ASCII, always used by the UI, rasterized in one go on startup.
+        private static readonly string PrecachedCharacters = GetPrecachedCharacters();
+
+        private static string GetPrecachedCharacters()
+        {
+            var chars = new char[127 - 32];
+            for (var i = 0; i < chars.Length; i++)
+                chars[i] = (char)(32 + i);
+            return new string(chars);
+        }
+
         protected FontCollection[] fontCollections = new FontCollection[2];
         protected Font[] fonts = new Font[(int)RenderFontStyle.Max];
 
@@ -81,6 +92,14 @@ namespace FamiStudio
                 var bold = FontDefinitions[i].Bold;
                 fonts[i] = g.CreateFont(fontCollections[bold ? 1 : 0], (int)DpiScaling.ScaleForFontFloat(FontDefinitions[i].Size));
             }
+
+            PrecacheCharacters();
+        }
+
+        private void PrecacheCharacters()
+        {
+            foreach (var font in fonts)
+                font.PrecacheCharacters(PrecachedCharacters);
         }
 
         public void ClearGlyphCache(Graphics g)
@@ -94,6 +113,8 @@ namespace FamiStudio
                 coll.ReleaseFontData(1);
 
             g.ClearGlyphCache();
+
+            PrecacheCharacters();
         }
 
         public void Dispose()
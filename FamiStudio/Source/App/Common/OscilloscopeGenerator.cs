@@ -164,25 +164,13 @@ namespace FamiStudio
 
                         if (lastTrigger >= 0)
                         {
-                            var newHasNonZeroData = false;
                             var vertices = new float[lastSampleCount * 2];
 
-                            var j = lastTrigger - lastSampleCount / 2; 
-                            if (j < 0) j += sampleBuffer.Length;
-
-                            for (int i = 0; i < lastSampleCount; i++, j = (j + 1) % sampleBuffer.Length)
-                            {
-                                var samp = (int)sampleBuffer[j];
-
-                                vertices[i * 2 + 0] = i / (float)(lastSampleCount - 1);
-                                vertices[i * 2 + 1] = Utils.Clamp(samp / 32768.0f * SampleScale, -1.0f, 1.0f);
-
-                                newHasNonZeroData |= Math.Abs(samp) > 1024;
-                            }
+                            NesApu.OscilloscopeVertices(sampleBuffer, sampleBuffer.Length, 1, lastTrigger - lastSampleCount / 2, lastSampleCount, 0, SampleScale, vertices, out var peak);
 
                             // Not exactly atomic... But OK.
                             geometry = vertices;
-                            hasNonZeroData = newHasNonZeroData;
+                            hasNonZeroData = peak > 1024;
                         }
 
                         lastTrigger = newTrigger;
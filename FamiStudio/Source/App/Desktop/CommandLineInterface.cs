@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.IO;
 using System.Linq;
 using System.Runtime.InteropServices;
@@ -146,9 +147,10 @@ namespace FamiStudio
             Console.WriteLine($"  -nsf-import-preserve-padding : Preserve 1-byte of padding after DPCM samples (default:disabled).");
             Console.WriteLine($"  -nsf-import-dmc-values : Import the initial DMC values for samples used in the song (default:enabled).");
             Console.WriteLine($"  -nsf-import-tuning:<tuning> : Tuning frequency in Hz for the original song (default:440).");
+            Console.WriteLine($"  -nsf-import-trace:<file> : Save the last 64K instructions executed by the NSF to a text file (default:disabled).");
             Console.WriteLine($"");
             Console.WriteLine($"WAV export specific options");
-            Console.WriteLine($"  -wav-export-rate:<rate> : Sample rate of the exported wave : 11025, 22050, 44100 or 48000 (default:44100).");
+            Console.WriteLine($"  -wav-export-rate:<rates> : Comma-separated sample rates of the exported wave : 11025, 22050, 44100, 48000 or 96000, one file per rate when more than one (default:44100).");
             Console.WriteLine($"  -wav-export-duration:<duration> : Duration in second, 0 plays song once and stop (default:0).");
             Console.WriteLine($"  -wav-export-loop:<count> : Number of times to play the song (default:1).");
             Console.WriteLine($"  -wav-export-channels:<mask> : Channel mask in hexadecimal, bit zero in channel 0 and so on (default:ff).");
@@ -156,7 +158,7 @@ namespace FamiStudio
             Console.WriteLine($"  -wav-export-separate-intro : Export the intro of the song seperately from the looping section (default:off).");
             Console.WriteLine($"");
             Console.WriteLine($"MP3 export specific options");
-            Console.WriteLine($"  -mp3-export-rate:<rate> : Sample rate of the exported mp3 : 44100 or 48000 (default:44100).");
+            Console.WriteLine($"  -mp3-export-rate:<rates> : Comma-separated sample rates of the exported mp3 : 44100 or 48000, one file per rate when more than one (default:44100).");
             Console.WriteLine($"  -mp3-export-bitrate:<rate> : Bitrate of the exported mp3 : 96, 112, 128, 160, 192, 224 or 256 (default:192).");
             Console.WriteLine($"  -mp3-export-duration:<duration> : Duration in second, 0 plays song once and stop (default:0).");
             Console.WriteLine($"  -mp3-export-loop:<count> : Number of times to play the song (default:1).");
@@ -165,7 +167,7 @@ namespace FamiStudio
             Console.WriteLine($"  -mp3-export-separate-intro : Export the intro of the song seperately from the looping section (default:off).");
             Console.WriteLine($"");
             Console.WriteLine($"OGG export specific options");
-            Console.WriteLine($"  -ogg-export-rate:<rate> : Sample rate of the exported mp3 : 44100 or 48000 (default:44100).");
+            Console.WriteLine($"  -ogg-export-rate:<rates> : Comma-separated sample rates of the exported mp3 : 44100 or 48000, one file per rate when more than one (default:44100).");
             Console.WriteLine($"  -ogg-export-bitrate:<rate> : Bitrate of the exported mp3 : 96, 112, 128, 160, 192, 224 or 256 (default:192).");
             Console.WriteLine($"  -ogg-export-duration:<duration> : Duration in second, 0 plays song once and stop (default:0).");
             Console.WriteLine($"  -ogg-export-loop:<count> : Number of times to play the song (default:1).");
@@ -176,6 +178,9 @@ namespace FamiStudio
             Console.WriteLine($"NSF export specific options");
             Console.WriteLine($"  -nsf-export-mode:<mode> : Target machine: ntsc or pal (default:project mode).");
             Console.WriteLine($"  -nsf-nsfe : Use NSFe format (default:off).");
+            Console.WriteLine($"  -nsf-export-profile : Play the exported songs and print the CPU cost of the sound engine (default:off).");
+            Console.WriteLine($"  -nsf-export-profile-frames:<frames> : Number of frames to profile for each song (default:3600).");
+            Console.WriteLine($"  -nsf-export-profile-labels:<file> : ca65 debug file (.dbg) or VICE label file to group the cost by label (default:none).");
             Console.WriteLine($"");
             Console.WriteLine($"ROM export specific options");
             Console.WriteLine($"  -rom-export-mode:<mode> : Target machine: ntsc, pal or dual (default:project mode).");
@@ -238,8 +243,9 @@ namespace FamiStudio
                 var preservePad  = HasOption("nsf-import-preserve-padding");
                 var importDmcVal = HasOption("nsf-import-dmc-values");
                 var tuning       = ParseOption("nsf-import-tuning", 440);
+                var traceFile    = ParseOption("nsf-import-trace", (string)null);
                 
-                project = new NsfFile().Load(filename, songIndex, duration, patternLen, startFrame, true, reverseDpcm, preservePad, importDmcVal, tuning);
+                project = new NsfFile().Load(filename, songIndex, duration, patternLen, startFrame, true, reverseDpcm, preservePad, importDmcVal, tuning, traceFile);
             }
 
             if (project == null)
@@ -312,8 +318,10 @@ namespace FamiStudio
             if (!ValidateExtension(filename, "." + extension))
                 return;
 
-            var songIndex  = ParseOption("export-song", 0);
-            var sampleRate = ParseOption($"{extension}-export-rate", 44100);
+            var songIdxs   = ParseOption("export-song", new[] { 0 });
+            var songIndex  = songIdxs[0];
+            var sampleRates = ParseOption($"{extension}-export-rate", new[] { 44100 });
+            var sampleRate = sampleRates[0];
             var loopCount  = ParseOption($"{extension}-export-loop", 1);
             var duration   = ParseOption($"{extension}-export-duration", 0);
             var mask       = ParseOption($"{extension}-export-channels", 0xffffff, true);
@@ -339,22 +347,61 @@ namespace FamiStudio
                     pan[i] = 0.5f;
             }
 
+            // Multiple songs are rendered and encoded concurrently, one job per song.
+            if (songIdxs.Length > 1 && !separate && !intro && sampleRates.Length == 1)
+            {
+                var jobs = new List<AudioEncodeJob>();
+
+                foreach (var idx in songIdxs)
+                {
+                    var batchSong = GetProjectSong(idx);
+                    if (batchSong == null)
+                        return;
+
+                    jobs.Add(new AudioEncodeJob()
+                    {
+                        Filename = Utils.AddFileSuffix(filename, "_" + batchSong.Name),
+                        Format = format,
+                        SampleRate = sampleRate,
+                        BitRate = bitrate,
+                        NumChannels = project.OutputsStereoAudio ? 2 : 1,
+                        Producer = (threadIndex, sink) =>
+                        {
+                            var player = AudioExportUtils.CreateNativePlayer(project, sampleRate, loopCount, mask, threadIndex);
+                            return player.StreamSongSamples(batchSong, duration, sink);
+                        }
+                    });
+                }
+
+                AudioEncodeQueue.Run(jobs, true);
+                return;
+            }
+
+            // Multiple rates are rendered once at the emulation rate and converted for each file.
+            var renderRate = sampleRates.Length > 1 ? NesApu.EmulationSampleRate : sampleRate;
+
             if (song != null)
             {
-                AudioExportUtils.Save(song, filename, sampleRate, loopCount, duration, mask, separate, intro, stereo, pan, 0, true, false,
+                AudioExportUtils.Save(song, filename, renderRate, loopCount, duration, mask, separate, intro, stereo, pan, 0, true, false,
                      (samples, samplesChannels, fn) =>
                      {
-                         switch (format)
+                         foreach (var rate in sampleRates)
                          {
-                             case AudioFormatType.Mp3:
-                                 Mp3File.Save(samples, fn, sampleRate, bitrate, samplesChannels);
-                                 break;
-                             case AudioFormatType.Wav:
-                                 WaveFile.Save(samples, fn, sampleRate, samplesChannels);
-                                 break;
-                             case AudioFormatType.Vorbis:
-                                 VorbisFile.Save(samples, fn, sampleRate, bitrate, samplesChannels);
-                                 break;
+                             var rateSamples = rate != renderRate ? WaveUtils.ResampleBuffer(samples, renderRate, rate, samplesChannels == 2) : samples;
+                             var rateFilename = sampleRates.Length > 1 ? Utils.AddFileSuffix(fn, "_" + rate) : fn;
+
+                             switch (format)
+                             {
+                                 case AudioFormatType.Mp3:
+                                     Mp3File.Save(rateSamples, rateFilename, rate, bitrate, samplesChannels);
+                                     break;
+                                 case AudioFormatType.Wav:
+                                     WaveFile.Save(rateSamples, rateFilename, rate, samplesChannels);
+                                     break;
+                                 case AudioFormatType.Vorbis:
+                                     VorbisFile.Save(rateSamples, rateFilename, rate, bitrate, samplesChannels);
+                                     break;
+                             }
                          }
                      });
             }
@@ -379,7 +426,7 @@ namespace FamiStudio
             var exportSongIds = GetExportSongIds();
             if (exportSongIds != null)
             {
-                new NsfFile().Save(
+                var success = new NsfFile().Save(
                     project,
                     FamiToneKernel.FamiStudio,
                     filename,
@@ -389,9 +436,53 @@ namespace FamiStudio
                     project.Copyright,
                     machine,
                     nsfe);
+
+                if (success && HasOption("nsf-export-profile"))
+                {
+                    NsfProfile(filename, exportSongIds, ParseOption("nsf-export-profile-frames", 3600), ParseOption("nsf-export-profile-labels", ""));
+                }
             }
         }
 
+        private void NsfProfile(string filename, int[] songIds, int numFrames, string labels)
+        {
+            var nsf = NotSoFatso.NsfOpen(filename);
+
+            if (nsf == IntPtr.Zero)
+            {
+                Log.LogMessage(LogSeverity.Error, "Error opening the exported NSF file for profiling.");
+                return;
+            }
+
+            var frameCycles = NotSoFatso.NsfIsPal(nsf) != 0 ? 33247 : 29780;
+
+            if (!string.IsNullOrEmpty(labels) && NotSoFatso.NsfLoadProfileLabels(nsf, labels) == 0)
+                Log.LogMessage(LogSeverity.Warning, $"No labels found in '{labels}'.");
+
+            for (int i = 0; i < songIds.Length; i++)
+            {
+                NotSoFatso.NsfSetProfiling(nsf, 1);
+                NotSoFatso.NsfSetTrack(nsf, i);
+                for (int f = 0; f < numFrames; f++)
+                    NotSoFatso.NsfRunFrame(nsf);
+
+                NotSoFatso.NsfGetProfileSummary(nsf, out var summary);
+
+                Log.LogMessage(LogSeverity.Info, $"Song '{project.GetSong(songIds[i]).Name}' : average {summary.AverageCycles:F0} cycles ({summary.AverageCycles * 100.0 / frameCycles:F1}% of a frame), peak {summary.PeakCycles} cycles ({summary.PeakCycles * 100.0 / frameCycles:F1}%) at frame {summary.PeakFrame}, init {summary.InitCycles} cycles.");
+
+                var numBuckets = Math.Min(NotSoFatso.NsfGetProfileBucketCount(nsf), 10);
+                for (int j = 0; j < numBuckets; j++)
+                {
+                    var cycles = NotSoFatso.NsfGetProfileBucketCycles(nsf, j);
+                    var name = Utils.PtrToStringAnsi(NotSoFatso.NsfGetProfileBucketName(nsf, j));
+                    Log.LogMessage(LogSeverity.Info, $"    {name} (${NotSoFatso.NsfGetProfileBucketAddress(nsf, j):X4}) : {cycles * 100.0 / Math.Max(1, summary.TotalCycles + summary.InitCycles):F1}%");
+                }
+            }
+
+            NotSoFatso.NsfSetProfiling(nsf, 0);
+            NotSoFatso.NsfClose(nsf);
+        }
+
         private void RomExport(string filename)
         {
             if (!ValidateExtension(filename, ".nes"))
@@ -72,7 +72,7 @@ namespace FamiStudio
             return stream;
         }
 
-        public void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback)
+        public void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback, ReadBufferDataCallback bufferReadCallback = null)
         {
             bufferFill = bufferFillCallback;
             lastSamples = null;
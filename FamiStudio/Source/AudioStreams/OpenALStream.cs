@@ -8,10 +8,14 @@ namespace FamiStudio
 {
     public unsafe class OpenALStream : IAudioStream
     {
+        // How long the task may block waiting on the emulation before checking for quit.
+        private const int ReadTimeoutMs = 5;
+
         private static IntPtr device;
         private static IntPtr context;
 
         private GetBufferDataCallback bufferFill;
+        private ReadBufferDataCallback bufferRead;
         private StreamStartingCallback streamStarting;
         private int freq;
         private bool quit;
@@ -88,10 +92,11 @@ namespace FamiStudio
         public bool IsPlaying => playingTask != null;
         public bool RecreateOnDeviceChanged => false;
 
-        public void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback)
+        public void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback, ReadBufferDataCallback bufferReadCallback = null)
         {
             quit = false;
             bufferFill = bufferFillCallback;
+            bufferRead = bufferReadCallback;
             streamStarting = streamStartCallback;
             samples = null;
             samplesOffset = 0;
@@ -136,6 +141,7 @@ namespace FamiStudio
 
                     playingTask = null;
                     bufferFill = null;
+                    bufferRead = null;
                     streamStarting = null;
                     samples = null;
                     samplesOffset = 0;
@@ -189,7 +195,30 @@ namespace FamiStudio
                         var bufferId = streamStarted ? AL.SourceUnqueueBuffer(source) : buffers[i];
                         var bufferSamplesOffset = 0;
 
-                        do
+                        // Pull directly from the emulation, no intermediate arrays.
+                        if (bufferRead != null && samplesOffset == 0)
+                        {
+                            fixed (short* p = &bufferSamples[0])
+                            {
+                                while (bufferSamplesOffset < bufferSampleCount && !quit)
+                                {
+                                    bufferSamplesOffset += bufferRead(new IntPtr(p + bufferSamplesOffset), bufferSampleCount - bufferSamplesOffset, ReadTimeoutMs, out streamDone);
+
+                                    // If we are done, pad the last buffer with zeroes so the stream can start
+                                    // for super-short (ex: 1-frame) non-looping songs.
+                                    if (streamDone)
+                                    {
+                                        Array.Clear(bufferSamples, bufferSamplesOffset, bufferSampleCount - bufferSamplesOffset);
+                                        bufferSamplesOffset = bufferSampleCount;
+                                    }
+                                }
+                            }
+
+                            if (quit)
+                                return;
+                        }
+
+                        while (bufferSamplesOffset < bufferSampleCount)
                         {
                             if (samplesOffset == 0)
                             {
@@ -229,7 +258,6 @@ namespace FamiStudio
 
                             bufferSamplesOffset += numSamplesToCopy;
                         }
-                        while (bufferSamplesOffset < bufferSampleCount);
 
                         fixed (short* p = &bufferSamples[0])
                             AL.BufferData(bufferId, stereo ? AL.Stereo16 : AL.Mono16, new IntPtr(p), bufferSamples.Length * sizeof(short), freq);
@@ -267,9 +267,13 @@ namespace FamiStudio
             public short[] samples = null;
         }
 
+        // How long the callback may block waiting on the emulation before checking back.
+        private const int ReadTimeoutMs = 5;
+
         private IntPtr stream = new IntPtr();
         private volatile bool play;
         private GetBufferDataCallback bufferFill;
+        private ReadBufferDataCallback bufferRead;
         private bool stereo;
         private int outputSampleRate;
         private int inputSampleRate;
@@ -416,11 +420,12 @@ namespace FamiStudio
             return portAudioStream;
         }
 
-        public void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback)
+        public void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback, ReadBufferDataCallback bufferReadCallback = null)
         {
             Debug.Assert(!play);
 
             bufferFill = bufferFillCallback;
+            bufferRead = bufferReadCallback;
             resampleIndex = 0.0;
             samples = null;
             samplesOffset = 0;
@@ -469,7 +474,12 @@ namespace FamiStudio
 
             lock (this)
             {
-                if (play)
+                // Read straight into the output buffer when there is nothing to resample/mix and nothing left over.
+                if (play && bufferRead != null && samplesOffset == 0 && inputSampleRate == outputSampleRate && immediateData == null)
+                {
+                    ReadDirect(outPtr, (int)sampleCount);
+                }
+                else if (play)
                 {
                     do
                     {
@@ -518,6 +528,25 @@ namespace FamiStudio
             return PaStreamCallbackResult.Continue;
         }
 
+        void ReadDirect(IntPtr outPtr, int sampleCount)
+        {
+            while (sampleCount != 0)
+            {
+                var numSamplesRead = bufferRead(outPtr, sampleCount, ReadTimeoutMs, out var done);
+
+                outPtr = IntPtr.Add(outPtr, numSamplesRead * sizeof(short));
+                sampleCount -= numSamplesRead;
+
+                // If we are done, pad the last buffer with zeros.
+                if (done)
+                {
+                    Platform.ZeroMemory(outPtr, sampleCount * sizeof(short));
+                    play = false;
+                    break;
+                }
+            }
+        }
+
         short[] MixImmediateData(short[] samples)
         {
             // Mix in immediate data if any, storing in variable since main thread can change it anytime.
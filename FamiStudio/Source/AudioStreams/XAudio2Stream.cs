@@ -75,7 +75,7 @@ namespace FamiStudio
         public bool RecreateOnDeviceChanged => false;
         public bool Stereo => waveFormat.Channels == 2;
 
-        public void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback)
+        public void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback, ReadBufferDataCallback bufferReadCallback = null)
         {
             Debug.Assert(sourceVoice == null);
             Debug.Assert(bufferSemaphore == null);
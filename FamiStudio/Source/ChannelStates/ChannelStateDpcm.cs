@@ -53,7 +53,7 @@ namespace FamiStudio
 
                             lock (DPCMSample.ProcessedDataLock)
                             {
-                                NesApu.CurrentSample[apuIdx] = sample.ProcessedData;
+                                NesApu.SetCurrentSample(apuIdx, sample.ProcessedData);
 
                                 WriteRegister(NesApu.APU_DMC_START, 0, 4, sample.Id);
                                 WriteRegister(NesApu.APU_DMC_LEN, sample.ProcessedData.Length >> 4);
@@ -46,6 +46,7 @@ namespace FamiStudio
         public bool IsOffscreen => offscreen;
         public int ScreenWidth => screenRect.Width;
         public int ScreenHeight => screenRect.Height;
+        public int MaxTextureSize => maxTextureSize;
 
         public const int MaxAtlasResolution = 1024;
         public const int MaxVertexCount = 64 * 1024;
@@ -68,6 +69,7 @@ namespace FamiStudio
         protected List<short[]> freeIndexArrays    = new List<short[]>();
 
         protected List<GlyphCache> glyphCaches = new List<GlyphCache>();
+        protected List<int> glyphAtlases = new List<int>();
 
         public abstract int CreateTexture(int width, int height, TextureFormat format, bool filter);
         public abstract void DeleteTexture(int id);
@@ -484,11 +486,26 @@ namespace FamiStudio
             return newCache.TextureId;
         }
 
+        public int CreateGlyphAtlas(byte[] data, int size)
+        {
+            Debug.Assert(data.Length == (size * size));
+
+            var texture = CreateTexture(size, size, TextureFormat.R, false);
+            UpdateTexture(texture, 0, 0, size, size, data);
+            glyphAtlases.Add(texture);
+
+            return texture;
+        }
+
         public void ClearGlyphCache()
         {
             foreach (var cache in glyphCaches)
                 cache.Dispose();
             glyphCaches.Clear();
+
+            foreach (var texture in glyphAtlases)
+                DeleteTexture(texture);
+            glyphAtlases.Clear();
         }
 
         private void ClearAtlases()
@@ -749,6 +766,22 @@ namespace FamiStudio
         [DllImport(StbDll, CallingConvention = CallingConvention.StdCall)]
         extern static int StbFindGlyphIndex(IntPtr info, int codepoint);
 
+        [DllImport(StbDll, CallingConvention = CallingConvention.StdCall)]
+        extern static unsafe int StbBuildAtlas(IntPtr info, int* codepoints, int num, float scale, int padding, int atlasWidth, int atlasHeight, byte* atlas, GlyphMetrics* metrics, int* kerning, int numThreads);
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct GlyphMetrics
+        {
+            public int x;
+            public int y;
+            public int width;
+            public int height;
+            public int xoffset;
+            public int yoffset;
+            public int advance;
+            public int glyph;
+        }
+
         class FontData
         {
             public string name;
@@ -929,18 +962,69 @@ namespace FamiStudio
             }
             else
             {
-                GetGlyphIndex(c0, out var f0);
-                GetGlyphIndex(c1, out var f1);
+                var g0 = GetGlyphIndex(c0, out var f0);
+                var g1 = GetGlyphIndex(c1, out var f1);
 
-                // Get the max of f0/f1. The logic here is that a Chinese font includes
-                // the latin characters, but not the other way around. 
-                var kern = StbGetGlyphKernAdvance(GetFontData(Math.Max(f0, f1)), c0, c1);
+                // Kerning only makes sense between 2 glyphs of the same font.
+                var kern = f0 == f1 ? StbGetGlyphKernAdvance(GetFontData(f0), g0, g1) : 0;
 
                 kerningPairs.Add(key, kern);
                 return kern * scale;
             }
         }
 
+        // Packs and rasterizes all the characters (which must all come from the same font) in a
+        // single native call. Returns null if they dont fit in a texture of "maxSize".
+        public unsafe byte[] BuildAtlas(char[] chars, float scale, int padding, int minSize, int maxSize, out int size, out GlyphMetrics[] metrics)
+        {
+            GetGlyphIndex(chars[0], out var fontIndex);
+
+            var fontData = GetFontData(fontIndex);
+            var codepoints = new int[chars.Length];
+            var kerning = new int[chars.Length * chars.Length];
+            var numThreads = Math.Min(Environment.ProcessorCount, 8);
+
+            for (var i = 0; i < chars.Length; i++)
+            {
+                Debug.Assert(GetGlyphIndex(chars[i], out var f) >= 0 && f == fontIndex);
+                codepoints[i] = chars[i];
+            }
+
+            metrics = new GlyphMetrics[chars.Length];
+
+            for (size = minSize; size <= maxSize; size *= 2)
+            {
+                var atlas = new byte[size * size];
+                var success = 0;
+
+                fixed (int* pc = codepoints, pk = kerning)
+                fixed (byte* pa = atlas)
+                fixed (GlyphMetrics* pm = metrics)
+                {
+                    success = StbBuildAtlas(fontData, pc, chars.Length, scale, padding, size, size, pa, pm, pk, numThreads);
+                }
+
+                if (success != 0)
+                {
+                    for (var i = 0; i < chars.Length; i++)
+                    {
+                        for (var j = 0; j < chars.Length; j++)
+                            kerningPairs.TryAdd(chars[i] | (chars[j] << 16), kerning[i * chars.Length + j]);
+                    }
+
+                    return atlas;
+                }
+            }
+
+            return null;
+        }
+
+        public int GetCharacterFontIndex(char c)
+        {
+            GetGlyphIndex(c, out var fontIndex);
+            return fontIndex;
+        }
+
         public void Dispose()
         {
             ReleaseFontData(0);
@@ -1061,6 +1145,66 @@ namespace FamiStudio
             glyphInfos.Clear();
         }
 
+        // Rasterizes a whole set of characters at once into dedicated atlas textures (one per
+        // font of the collection). Much faster than caching them one by one on first use.
+        public void PrecacheCharacters(string chars)
+        {
+            Debug.Assert(graphics.OwnedByCurrentThread());
+
+            var charsPerFont = new Dictionary<int, List<char>>();
+
+            foreach (var c in chars)
+            {
+                var validChar = c;
+                if (!fontCollection.EnsureCharValid(ref validChar) || glyphInfos.ContainsKey(c))
+                    continue;
+
+                var fontIndex = fontCollection.GetCharacterFontIndex(c);
+                if (!charsPerFont.TryGetValue(fontIndex, out var list))
+                {
+                    list = new List<char>();
+                    charsPerFont.Add(fontIndex, list);
+                }
+                list.Add(c);
+            }
+
+            foreach (var list in charsPerFont.Values)
+            {
+                var fontChars = list.ToArray();
+                var atlas = fontCollection.BuildAtlas(fontChars, scale, 1, 64, Math.Min(graphics.MaxTextureSize, 2048), out var atlasSize, out var metrics);
+
+                // Didnt fit, the characters will simply be cached on first use.
+                if (atlas == null)
+                    continue;
+
+                var texture = graphics.CreateGlyphAtlas(atlas, atlasSize);
+
+                for (var i = 0; i < fontChars.Length; i++)
+                {
+                    var m = metrics[i];
+                    var glyphInfo = new CharInfo();
+
+                    glyphInfo.width    = m.width;
+                    glyphInfo.height   = m.height;
+                    glyphInfo.xoffset  = m.xoffset;
+                    glyphInfo.yoffset  = baseValue + m.yoffset + globalOffsetY;
+                    glyphInfo.xadvance = m.advance * scale;
+                    glyphInfo.rasterized = true;
+
+                    if (m.width > 0 && m.height > 0)
+                    {
+                        glyphInfo.texture = texture;
+                        glyphInfo.u0 = ((m.x + 0) / (float)atlasSize);
+                        glyphInfo.v0 = ((m.y + 0) / (float)atlasSize);
+                        glyphInfo.u1 = ((m.x + m.width)  / (float)atlasSize);
+                        glyphInfo.v1 = ((m.y + m.height) / (float)atlasSize);
+                    }
+
+                    glyphInfos.Add(fontChars[i], glyphInfo);
+                }
+            }
+        }
+
         public float GetKerning(char c0, char c1)
         {
             return fontCollection.GetKerning(c0, c1, scale);
@@ -0,0 +1,128 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Threading;
+
+namespace FamiStudio
+{
+    // A single render + encode job. The producer is called on a worker thread with the
+    // index of that thread so it can use its own WAV export APU (see WavPlayer), and
+    // streams its samples to the sink, which feeds them straight to the encoder.
+    public class AudioEncodeJob
+    {
+        public string Filename;
+        public int Format;
+        public int SampleRate = 44100;
+        public int BitRate = 192;
+        public int NumChannels = 1;
+        public Func<int, AudioSampleSink, bool> Producer;
+
+        // Filled by the queue once the job has run.
+        public bool   Success;
+        public int    NumSamples;
+        public double RenderTime;
+        public double EncodeTime;
+
+        public double AudioDuration => NumSamples / (double)(SampleRate * NumChannels);
+        public double TotalTime => RenderTime + EncodeTime;
+        public double Speed => TotalTime > 0.0 ? AudioDuration / TotalTime : 0.0;
+    }
+
+    public static class AudioEncodeQueue
+    {
+        public static bool Run(List<AudioEncodeJob> jobs, bool log)
+        {
+            var counter = new ThreadSafeCounter();
+            var t0 = TimeSeconds();
+
+            Log.ReportProgress(0.0f);
+            Log.LogMessageConditional(log, LogSeverity.Info, $"Rendering and encoding {jobs.Count} file(s)...");
+
+            // Each worker thread owns its APU and creates its own encoder per job, nothing is shared.
+            Utils.NonBlockingParallelFor(jobs.Count, NesApu.NUM_WAV_EXPORT_APU, counter, (jobIdx, threadIndex) =>
+            {
+                var job = jobs[jobIdx];
+
+                using (var writer = OpenWriter(job))
+                {
+                    if (writer != null)
+                    {
+                        var encodeTime = 0.0;
+                        var tr = TimeSeconds();
+
+                        // Time spent in the sink is encoding, the rest is rendering.
+                        var rendered = job.Producer(threadIndex, (samples, offset, count) =>
+                        {
+                            var ts = TimeSeconds();
+                            var success = writer.Write(samples, offset, count);
+                            encodeTime += TimeSeconds() - ts;
+                            job.NumSamples += count;
+                            return success;
+                        });
+
+                        if (rendered && job.NumSamples > 0 && !Log.ShouldAbortOperation)
+                        {
+                            var tf = TimeSeconds();
+                            job.Success = writer.Finish();
+                            encodeTime += TimeSeconds() - tf;
+                        }
+
+                        job.EncodeTime = encodeTime;
+                        job.RenderTime = TimeSeconds() - tr - encodeTime;
+                    }
+                }
+
+                System.GC.Collect();
+
+                return !Log.ShouldAbortOperation;
+            });
+
+            while (counter.Value != jobs.Count)
+            {
+                Log.ReportProgress(counter.Value / (float)jobs.Count);
+                Thread.Sleep(10);
+            }
+
+            var success = true;
+
+            // Workers cannot log, report the statistics once everything is done.
+            foreach (var job in jobs)
+            {
+                if (job.Success)
+                {
+                    Log.LogMessageConditional(log, LogSeverity.Info,
+                        $"{job.Filename} : {job.AudioDuration:0.0} sec of audio, render {job.RenderTime * 1000:0} ms, encode {job.EncodeTime * 1000:0} ms ({job.Speed:0.0}x realtime).");
+                }
+                else
+                {
+                    Log.LogMessageConditional(log, LogSeverity.Error, $"{job.Filename} : Export failed.");
+                    success = false;
+                }
+            }
+
+            Log.LogMessageConditional(log, LogSeverity.Info, $"Exported {jobs.Count} file(s) in {TimeSeconds() - t0:0.00} sec.");
+
+            return success;
+        }
+
+        // GLFW is not initialized when running from the command line, so the platform timer
+        // cannot be used here.
+        private static double TimeSeconds()
+        {
+            return Stopwatch.GetTimestamp() / (double)Stopwatch.Frequency;
+        }
+
+        private static AudioFileWriter OpenWriter(AudioEncodeJob job)
+        {
+            switch (job.Format)
+            {
+                case AudioFormatType.Mp3:
+                    return Mp3File.Open(job.Filename, job.SampleRate, job.BitRate, job.NumChannels);
+                case AudioFormatType.Vorbis:
+                    return VorbisFile.Open(job.Filename, job.SampleRate, job.BitRate, job.NumChannels);
+                default:
+                    return WaveFile.Open(job.Filename, job.SampleRate, job.NumChannels);
+            }
+        }
+    }
+}
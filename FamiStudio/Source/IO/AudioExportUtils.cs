@@ -96,10 +96,40 @@ namespace FamiStudio
                     // the raw result of the emulation.
                     if (delay == 0 && centerPan && outputsStereo)
                     {
-                        var player = new WavPlayer(sampleRate, project.PalMode, outputsStereo, loopCount, channelMask, 0, NesApu.TND_MODE_SEPARATE);
+                        var player = CreateNativePlayer(project, sampleRate, loopCount, channelMask);
                         samples = player.GetSongSamples(song, duration, log, allowAbort);
                         numChannels = 2;
                     }
+                    else if (!outputsStereo)
+                    {
+                        // The APU pans the channels itself, only the delay is left to apply,
+                        // with the opposite panning.
+                        var channelPans = pan;
+                        if (channelPans == null)
+                        {
+                            channelPans = new float[song.Channels.Length];
+                            Array.Fill(channelPans, 0.5f);
+                        }
+
+                        var player = new WavPlayer(sampleRate, project.PalMode, true, loopCount, channelMask, 0, NesApu.TND_MODE_SEPARATE, channelPans);
+                        var stereoSamples = player.GetSongSamples(song, duration, log, allowAbort);
+
+                        samples = stereoSamples;
+
+                        if (delayInSamples > 0)
+                        {
+                            samples = stereoSamples.Clone() as short[];
+
+                            for (int i = delayInSamples * 2; i < samples.Length; i += 2)
+                            {
+                                samples[i + 0] = (short)Utils.Clamp(stereoSamples[i + 0] + stereoSamples[i + 1 - delayInSamples * 2], short.MinValue, short.MaxValue);
+                                samples[i + 1] = (short)Utils.Clamp(stereoSamples[i + 1] + stereoSamples[i + 0 - delayInSamples * 2], short.MinValue, short.MaxValue);
+                            }
+                        }
+
+                        numChannels = 2;
+                        introDuration *= 2;
+                    }
                     else
                     {
                         Log.LogMessageConditional(log, LogSeverity.Info, $"Exporting channels individually due to custom panning or delay, this will take longer...");
@@ -218,6 +248,16 @@ namespace FamiStudio
             System.GC.Collect();
         }
 
+        // Player producing the project's own output format (stereo only for stereo expansions),
+        // set up the same way Save does when no panning or delay needs to be applied.
+        public static WavPlayer CreateNativePlayer(Project project, int sampleRate, int loopCount, long channelMask, int threadIndex = 0)
+        {
+            if (project.OutputsStereoAudio)
+                return new WavPlayer(sampleRate, project.PalMode, true, loopCount, channelMask, threadIndex, NesApu.TND_MODE_SEPARATE);
+            else
+                return new WavPlayer(sampleRate, project.PalMode, false, loopCount, channelMask, threadIndex);
+        }
+
         private static short[][] GetIndividualChannelSamples(Song song, bool outputsStereo, long channelMask, int sampleRate, int loopCount, bool pal, int duration, bool log, bool allowAbort)
         {
             // Get all the samples for all channels.
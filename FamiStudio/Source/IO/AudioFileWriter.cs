@@ -0,0 +1,107 @@
+﻿using System;
+using System.IO;
+
+namespace FamiStudio
+{
+    // Writes interleaved 16-bit samples to an audio file as they come. Everything goes to a
+    // temporary file, which only replaces the destination once Finish() succeeded, so that a
+    // failed save never leaves a truncated file behind.
+    public abstract class AudioFileWriter : IDisposable
+    {
+        protected FileStream file;
+        private string filename;
+        private string tempFilename;
+        private bool failed;
+
+        protected AudioFileWriter(string filename)
+        {
+            this.filename = filename;
+            tempFilename = filename + ".tmp";
+            file = new FileStream(tempFilename, FileMode.Create);
+        }
+
+        public bool Write(short[] samples, int offset, int count)
+        {
+            if (!failed && count > 0)
+                failed = !WriteSamples(samples, offset, count);
+            return !failed;
+        }
+
+        public bool Finish()
+        {
+            if (!failed)
+                failed = !FinishSamples();
+
+            file.Dispose();
+
+            if (!failed)
+                File.Move(tempFilename, filename, true);
+
+            return !failed;
+        }
+
+        public virtual void Dispose()
+        {
+            file.Dispose();
+
+            if (File.Exists(tempFilename))
+            {
+                try { File.Delete(tempFilename); } catch { }
+            }
+        }
+
+        protected abstract bool WriteSamples(short[] samples, int offset, int count);
+        protected abstract bool FinishSamples();
+    }
+
+    // Native encoders (the Shine and Vorbis DLLs) are fed in chunks, what they produce is
+    // drained to the file after each one.
+    public abstract class NativeAudioFileWriter : AudioFileWriter
+    {
+        // Number of interleaved samples fed to the encoder at once.
+        const int ChunkSize = 65536;
+
+        private byte[] encodedData = new byte[ChunkSize];
+
+        protected NativeAudioFileWriter(string filename) : base(filename)
+        {
+        }
+
+        protected abstract int EncoderFeed(int numSamples, IntPtr wavData);
+        protected abstract int EncoderFinish();
+        protected abstract int EncoderRead(int size, IntPtr data);
+
+        protected unsafe override bool WriteSamples(short[] samples, int offset, int count)
+        {
+            fixed (short* wavPtr = &samples[offset])
+            {
+                for (var i = 0; i < count; i += ChunkSize)
+                {
+                    if (EncoderFeed(Math.Min(ChunkSize, count - i), new IntPtr(wavPtr + i)) != 0)
+                        return false;
+
+                    DrainEncoder();
+                }
+            }
+
+            return true;
+        }
+
+        protected override bool FinishSamples()
+        {
+            var success = EncoderFinish() == 0;
+            DrainEncoder();
+            return success;
+        }
+
+        private unsafe void DrainEncoder()
+        {
+            fixed (byte* dataPtr = &encodedData[0])
+            {
+                int size;
+                while ((size = EncoderRead(encodedData.Length, new IntPtr(dataPtr))) > 0)
+                    file.Write(encodedData, 0, size);
+            }
+        }
+    }
+}
@@ -12,10 +12,44 @@ namespace FamiStudio
     {
         private const string ShineMp3Dll = Platform.DllStaticLib ? "__Internal" : Platform.DllPrefix + "ShineMp3" + Platform.DllExtension;
 
-        [DllImport(ShineMp3Dll, CallingConvention = CallingConvention.StdCall, EntryPoint = "ShineMp3Encode")]
-        extern static int ShineMp3Encode(int wav_rate, int wav_channels, int wav_num_samples, IntPtr wavData, int mp3_bitrate, int mp3_data_size, IntPtr mp3_data);
+        [DllImport(ShineMp3Dll, CallingConvention = CallingConvention.StdCall, EntryPoint = "ShineMp3EncoderCreate")]
+        extern static IntPtr ShineMp3EncoderCreate(int wav_rate, int wav_channels, int mp3_bitrate);
 
-        public unsafe static bool Save(short[] wavData, string filename, int sampleRate, int bitRate, int numChannels)
+        [DllImport(ShineMp3Dll, CallingConvention = CallingConvention.StdCall, EntryPoint = "ShineMp3EncoderFeed")]
+        extern static int ShineMp3EncoderFeed(IntPtr enc, int num_samples, IntPtr wav_data);
+
+        [DllImport(ShineMp3Dll, CallingConvention = CallingConvention.StdCall, EntryPoint = "ShineMp3EncoderFinish")]
+        extern static int ShineMp3EncoderFinish(IntPtr enc);
+
+        [DllImport(ShineMp3Dll, CallingConvention = CallingConvention.StdCall, EntryPoint = "ShineMp3EncoderRead")]
+        extern static int ShineMp3EncoderRead(IntPtr enc, int mp3_data_size, IntPtr mp3_data);
+
+        [DllImport(ShineMp3Dll, CallingConvention = CallingConvention.StdCall, EntryPoint = "ShineMp3EncoderDestroy")]
+        extern static void ShineMp3EncoderDestroy(IntPtr enc);
+
+        class Writer : NativeAudioFileWriter
+        {
+            private IntPtr enc;
+
+            public Writer(string filename, IntPtr enc) : base(filename)
+            {
+                this.enc = enc;
+            }
+
+            protected override int EncoderFeed(int numSamples, IntPtr wavData) => ShineMp3EncoderFeed(enc, numSamples, wavData);
+            protected override int EncoderFinish() => ShineMp3EncoderFinish(enc);
+            protected override int EncoderRead(int size, IntPtr data) => ShineMp3EncoderRead(enc, size, data);
+
+            public override void Dispose()
+            {
+                base.Dispose();
+                ShineMp3EncoderDestroy(enc);
+                enc = IntPtr.Zero;
+            }
+        }
+
+        // Returns null if the encoder cannot be created.
+        public static AudioFileWriter Open(string filename, int sampleRate, int bitRate, int numChannels)
         {
             if (sampleRate < 44100)
             {
@@ -23,24 +57,26 @@ namespace FamiStudio
                 sampleRate = 44100;
             }
 
-            var mp3Data = new byte[wavData.Length * sizeof(short) * 4];
-            var mp3Size = 0;
+            var enc = ShineMp3EncoderCreate(sampleRate, numChannels, bitRate);
 
-            fixed (short* wavPtr = &wavData[0])
+            if (enc == IntPtr.Zero)
+                return null;
+
+            try
             {
-                fixed (byte* mp3Ptr = &mp3Data[0])
-                {
-                    mp3Size = ShineMp3Encode(sampleRate, numChannels, wavData.Length, new IntPtr(wavPtr), bitRate, mp3Data.Length, new IntPtr(mp3Ptr));
-                }
+                return new Writer(filename, enc);
             }
+            catch
+            {
+                ShineMp3EncoderDestroy(enc);
+                throw;
+            }
+        }
 
-            if (mp3Size <= 0)
-                return false;
-
-            Array.Resize(ref mp3Data, mp3Size);
-            File.WriteAllBytes(filename, mp3Data);
-
-            return true;
+        public static bool Save(short[] wavData, string filename, int sampleRate, int bitRate, int numChannels)
+        {
+            using (var writer = Open(filename, sampleRate, bitRate, numChannels))
+                return writer != null && writer.Write(wavData, 0, wavData.Length) && writer.Finish();
         }
     }
 }
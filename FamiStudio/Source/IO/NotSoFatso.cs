@@ -18,6 +18,10 @@ namespace FamiStudio
         [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
         public extern static IntPtr NsfOpen(string file);
 
+        // The data is only read during the call, no need to keep it around.
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static IntPtr NsfOpenMemory(byte[] data, int size);
+
         [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
         public extern static int NsfGetTrackCount(IntPtr nsf);
 
@@ -60,6 +64,73 @@ namespace FamiStudio
         [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
         public extern static int NsfSetApuWriteCallback(IntPtr nsf, [MarshalAs(UnmanagedType.FunctionPtr)] WriteRegisterDelegate cb);
 
+        // Play routine profiler. Counts the CPU cycles of every frame and of every PC, buckets
+        // are grouped by label when a ca65 debug file (.dbg) or a VICE label file is loaded.
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static int NsfSetProfiling(IntPtr nsf, int enable);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static int NsfLoadProfileLabels(IntPtr nsf, [MarshalAs(UnmanagedType.LPStr)] string path);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static void NsfGetProfileSummary(IntPtr nsf, out NsfProfileSummary summary);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static int NsfGetProfileFrames(IntPtr nsf, [Out] uint[] frames, int count);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static int NsfGetProfileBucketCount(IntPtr nsf);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static IntPtr NsfGetProfileBucketName(IntPtr nsf, int idx);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static int NsfGetProfileBucketAddress(IntPtr nsf, int idx);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static long NsfGetProfileBucketCycles(IntPtr nsf, int idx);
+
+        // Instruction trace. A ring of the last instructions whose PC is in [minAddr, maxAddr],
+        // capacity is rounded up to a power of 2 and 0 disables it.
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static int NsfSetTrace(IntPtr nsf, int capacity, int minAddr, int maxAddr);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static int NsfReadTrace(IntPtr nsf, [Out] NsfTraceEntry[] entries, int count);
+
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern static int NsfGetTraceDropped(IntPtr nsf);
+
+        // A null entry gives the column header.
+        [DllImport(NotSoFatsoDll, CallingConvention = CallingConvention.StdCall)]
+        public extern unsafe static int NsfDisassembleTrace(NsfTraceEntry* entry, byte* text, int size);
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct NsfProfileSummary
+        {
+            public int Frames;
+            public int PeakFrame;
+            public uint PeakCycles;
+            public uint InitCycles;
+            public long TotalCycles;
+            public double AverageCycles;
+        }
+
+        [StructLayout(LayoutKind.Sequential)]
+        public unsafe struct NsfTraceEntry
+        {
+            public ushort PC;
+            public byte Opcode;
+            public fixed byte Operand[2];
+            public byte A;
+            public byte X;
+            public byte Y;
+            public byte SP;
+            public byte P;
+            public ushort Frame;
+            public uint Cycle;
+        }
+
         public const int EXTSOUND_VRC6  = 0x01;
         public const int EXTSOUND_VRC7  = 0x02;
         public const int EXTSOUND_FDS   = 0x04;
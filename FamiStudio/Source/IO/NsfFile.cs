@@ -1383,9 +1383,9 @@ namespace FamiStudio
             return trackNames;
         }
 
-        private int GetNumNamcoChannels(string filename, int songIndex, int numFrames)
+        private int GetNumNamcoChannels(byte[] data, int songIndex, int numFrames)
         {
-            var tmpNsf = NotSoFatso.NsfOpen(filename);
+            var tmpNsf = NotSoFatso.NsfOpenMemory(data, data.Length);
 
             NotSoFatso.NsfSetTrack(tmpNsf, songIndex);
 
@@ -1417,9 +1417,57 @@ namespace FamiStudio
             return mask;
         }
 
-        public Project Load(string filename, int songIndex, int duration, int patternLength, int startFrame, bool removeIntroSilence, bool reverseDpcm, bool preserveDpcmPad, bool importDmcVal, int tuning = 440)
+        const int TraceCapacity = 65536;
+
+        // Writes the instructions left in the trace ring, oldest first.
+        private unsafe void SaveTrace(string traceFile)
         {
-            nsf = NotSoFatso.NsfOpen(filename);
+            var entries = new NotSoFatso.NsfTraceEntry[4096];
+            var text = stackalloc byte[256];
+            var dropped = NotSoFatso.NsfGetTraceDropped(nsf);
+
+            using (var writer = new StreamWriter(traceFile))
+            {
+                if (dropped > 0)
+                    writer.WriteLine($"({dropped} older instructions were overwritten)");
+
+                writer.WriteLine(Marshal.PtrToStringAnsi((IntPtr)text, NotSoFatso.NsfDisassembleTrace(null, text, 256)));
+
+                int count;
+                while ((count = NotSoFatso.NsfReadTrace(nsf, entries, entries.Length)) > 0)
+                {
+                    fixed (NotSoFatso.NsfTraceEntry* p = entries)
+                    {
+                        for (int i = 0; i < count; i++)
+                            writer.WriteLine(Marshal.PtrToStringAnsi((IntPtr)text, NotSoFatso.NsfDisassembleTrace(p + i, text, 256)));
+                    }
+                }
+            }
+
+            Log.LogMessage(LogSeverity.Info, $"CPU trace saved to '{traceFile}'.");
+        }
+
+        public Project Load(string filename, int songIndex, int duration, int patternLength, int startFrame, bool removeIntroSilence, bool reverseDpcm, bool preserveDpcmPad, bool importDmcVal, int tuning = 440, string traceFile = null)
+        {
+            byte[] data = null;
+
+            try
+            {
+                data = File.ReadAllBytes(filename);
+            }
+            catch (Exception e)
+            {
+                Log.LogMessage(LogSeverity.Error, e.Message);
+                return null;
+            }
+
+            return Load(data, songIndex, duration, patternLength, startFrame, removeIntroSilence, reverseDpcm, preserveDpcmPad, importDmcVal, tuning, traceFile);
+        }
+
+        // Same as above, for a NSF/NSFE that is already in memory (from an archive, etc.)
+        public Project Load(byte[] data, int songIndex, int duration, int patternLength, int startFrame, bool removeIntroSilence, bool reverseDpcm, bool preserveDpcmPad, bool importDmcVal, int tuning = 440, string traceFile = null)
+        {
+            nsf = NotSoFatso.NsfOpenMemory(data, data.Length);
 
             if (nsf == IntPtr.Zero)
             {
@@ -1427,6 +1475,10 @@ namespace FamiStudio
                 return null;
             }
 
+            // The trace is cheap enough to keep the last frames of a misbehaving NSF.
+            if (traceFile != null)
+                NotSoFatso.NsfSetTrace(nsf, TraceCapacity, 0x0000, 0xffff);
+
             var trackCount = NotSoFatso.NsfGetTrackCount(nsf);
 
             if (songIndex < 0 || songIndex > trackCount)
@@ -1465,7 +1517,7 @@ namespace FamiStudio
                 return null;
             }
 
-            var numN163Channels = (expansionMask & ExpansionType.N163Mask) != 0 ? GetNumNamcoChannels(filename, songIndex, numFrames) : 1;
+            var numN163Channels = (expansionMask & ExpansionType.N163Mask) != 0 ? GetNumNamcoChannels(data, songIndex, numFrames) : 1;
             project.SetExpansionAudioMask(expansionMask, numN163Channels);
 
             var songName = Utils.PtrToStringAnsi(NotSoFatso.NsfGetTrackName(nsf, songIndex));
@@ -1504,6 +1556,8 @@ namespace FamiStudio
                     if (++waitFrameCount == 1000)
                     {
                         Log.LogMessage(LogSeverity.Error, "NSF did not call PLAY after 1000 frames, aborting.");
+                        if (traceFile != null)
+                            SaveTrace(traceFile);
                         NotSoFatso.NsfClose(nsf);
                         return null;
                     }
@@ -1529,6 +1583,9 @@ namespace FamiStudio
 
             song.SetLength(p + 1);
 
+            if (traceFile != null)
+                SaveTrace(traceFile);
+
             NotSoFatso.NsfClose(nsf);
 
             var factors = Utils.GetFactors(song.PatternLength, FamiStudioTempoUtils.MaxNoteLength);
@@ -1,9 +1,11 @@
 ﻿using System;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
 using System.Linq;
 using System.Threading;
+using System.Threading.Tasks;
 
 namespace FamiStudio
 {
@@ -12,6 +14,7 @@ namespace FamiStudio
         protected const int TextMargin = 4;
         protected const int SampleRate = 44100;
         protected const int ChannelIconTextSpacing = 8;
+        protected const int OscilloscopeQueueSize = 8;
 
         protected int videoResX = 1920;
         protected int videoResY = 1080;
@@ -23,6 +26,7 @@ namespace FamiStudio
         protected int registerPosY = 4;
         protected int oscFrameWindowSize;
         protected int oscRenderWindowSize;
+        protected int oscMaxPoints; // 0 = one vertex per sample.
 
         protected Project project;
         protected Song song;
@@ -38,9 +42,16 @@ namespace FamiStudio
         protected List<Texture> registerViewerIcons;
         protected Color[] registerColors = new Color[11];
         protected List<string> authorText = new List<string>();
+        protected float[][] frameOscilloscopes;
+
+        // Oscilloscopes of the frame being rendered, prepared ahead by PrepareOscilloscopes().
+        protected float[] GetOscilloscope(VideoChannelState state)
+        {
+            return frameOscilloscopes[state.videoChannelIndex];
+        }
 
         // TODO : This is is very similar to Oscilloscope.cs, unify eventually...
-        protected float[] UpdateOscilloscope(VideoChannelState state, int frameIndex)
+        private float[] UpdateOscilloscope(VideoChannelState state, int frameIndex)
         {
             var meta = metadata[frameIndex];
             var newTrigger = meta.channelData[state.songChannelIndex].trigger;
@@ -78,9 +89,11 @@ namespace FamiStudio
             // have at the moment are very low EPSM notes with periods about 8 frames.
             Debug.Assert(state.holdFrameCount < 10);
 
-            var vertices = new float[oscRenderWindowSize * 2];
+            float[] vertices;
 
             #if false
+                vertices = new float[oscRenderWindowSize * 2];
+
                 // For debugging oscilloscope placement
                 for (int i = 0; i < vertices.Length / 2; i++)
                 {
@@ -89,14 +102,10 @@ namespace FamiStudio
                 }
             #else
                 var startIdx = newTrigger >= 0 ? newTrigger : state.lastTrigger;
+                var maxPoints = oscMaxPoints >= 4 && oscMaxPoints < oscRenderWindowSize ? oscMaxPoints & ~1 : 0;
 
-                for (int i = 0, j = startIdx - oscRenderWindowSize / 2; i < oscRenderWindowSize; i++, j++)
-                {
-                    var samp = j < 0 || j >= state.wav.Length ? 0 : state.wav[j];
-
-                    vertices[i * 2 + 0] = i / (float)(oscRenderWindowSize - 1);
-                    vertices[i * 2 + 1] = Utils.Clamp(samp / 32768.0f * state.oscScale, -1.0f, 1.0f);
-                }
+                vertices = new float[(maxPoints > 0 ? maxPoints : oscRenderWindowSize) * 2];
+                NesApu.OscilloscopeVertices(state.wav, state.wav.Length, 0, startIdx - oscRenderWindowSize / 2, oscRenderWindowSize, maxPoints, state.oscScale, vertices, out _);
             #endif
 
             if (newTrigger >= 0)
@@ -487,11 +496,41 @@ namespace FamiStudio
             }
         }
 
+        private void PrepareOscilloscopes(BlockingCollection<float[][]> queue, CancellationToken token)
+        {
+            try
+            {
+                for (int f = 0; f < metadata.Length; f++)
+                {
+                    if (halfFrameRate && (f & 1) != 0)
+                        continue;
+
+                    // Each channel keeps its own trigger state, so they can all run in parallel.
+                    var oscilloscopes = new float[channelStates.Length][];
+                    Parallel.For(0, channelStates.Length, i => oscilloscopes[i] = UpdateOscilloscope(channelStates[i], f));
+                    queue.Add(oscilloscopes, token);
+                }
+            }
+            catch (OperationCanceledException)
+            {
+            }
+            finally
+            {
+                queue.CompleteAdding();
+            }
+        }
+
         protected bool LaunchEncoderLoop(Action<int> body, Action cleanup = null)
         {
             var success = true;
             var lastTime = DateTime.Now;
 
+            // The oscilloscopes are prepared on worker threads while the previous frames are 
+            // rendered, the queue keeps them from running too far ahead.
+            var oscilloscopeQueue = new BlockingCollection<float[][]>(OscilloscopeQueueSize);
+            var oscilloscopeCancel = new CancellationTokenSource();
+            var oscilloscopeTask = Task.Factory.StartNew(() => PrepareOscilloscopes(oscilloscopeQueue, oscilloscopeCancel.Token), TaskCreationOptions.LongRunning);
+
             DpiScaling.ForceUnitScaling = false;
 
 #if !DEBUG
@@ -516,6 +555,7 @@ namespace FamiStudio
                         continue;
 
                     var frame = metadata[f];
+                    frameOscilloscopes = oscilloscopeQueue.Take();
 
                     // HACK : It was a terrible idea to make the DPI scaling a global thing. It should have remained on the 
                     // Graphics object like before. Need to keep switching to unit scaling back/forth.
@@ -566,6 +606,12 @@ namespace FamiStudio
             finally
 #endif
             {
+                oscilloscopeCancel.Cancel();
+                oscilloscopeTask.Wait();
+                oscilloscopeCancel.Dispose();
+                oscilloscopeQueue.Dispose();
+                frameOscilloscopes = null;
+
                 Utils.DisposeAndNullify(ref fonts);
                 Utils.DisposeAndNullify(ref watermark);
                 Utils.DisposeAndNullify(ref videoGraphics);
@@ -657,17 +703,28 @@ namespace FamiStudio
 
     class VideoMetadataPlayer : BasePlayer
     {
+        // Triggers and registers are captured natively for every frame and read back in batches.
+        const int TelemetryBatchSize = 64;
+
         int numSamples = 0;
         int prevNumSamples = 0;
+        int triggerLogFrame = 0;
+        int triggerLogSampleOffset = 0;
         bool readRegisters;
         List<VideoFrameMetadata> metadata;
+        NesApu.FrameTelemetry[] telemetry = new NesApu.FrameTelemetry[TelemetryBatchSize];
+        int[] triggerLog;
 
         public VideoMetadataPlayer(int sampleRate, bool pal, bool stereo, bool registers, int maxLoop) : base(NesApu.APU_WAV_EXPORT, pal, stereo, sampleRate)
         {
+            // Large enough to hold every trigger of a batch (plus a frame of margin), even at
+            // one trigger per sample. Sized from the sample rate since exports can go to 96kHz.
+            triggerLog = new int[(sampleRate / (pal ? 50 : 60) + 1) * (TelemetryBatchSize + 1)];
             maxLoopCount = maxLoop;
             metadata = new List<VideoFrameMetadata>();
             readRegisters = registers;
             forceReadRegisterValues = true;
+            captureTelemetry = true;
         }
 
         private void WriteMetadata(List<VideoFrameMetadata> metadata)
@@ -684,7 +741,6 @@ namespace FamiStudio
                 meta.channelData[i] = new VideoFrameMetadata.ChannelMetadata();
                 meta.channelData[i].note    = channelStates[i].CurrentNote;
                 meta.channelData[i].volume  = channelStates[i].CurrentVolume;
-                meta.channelData[i].trigger = GetOscilloscopeTrigger(channelStates[i].InnerChannelType);
             }
 
             if (readRegisters)
@@ -698,6 +754,72 @@ namespace FamiStudio
             prevNumSamples = numSamples;
         }
 
+        private unsafe void ReadTelemetry()
+        {
+            fixed (NesApu.FrameTelemetry* p = &telemetry[0])
+            {
+                int count;
+                while ((count = NesApu.ReadTelemetry(apuIndex, p, telemetry.Length)) > 0)
+                {
+                    for (int i = 0; i < count; i++)
+                    {
+                        // The last frame may have been emulated, but not kept.
+                        var frame = p[i].Frame;
+                        if (frame >= metadata.Count)
+                            continue;
+
+                        var meta = metadata[frame];
+
+                        for (int j = 0; j < channelStates.Length; j++)
+                        {
+                            var channelType = channelStates[j].InnerChannelType;
+                            var expType = ChannelType.GetExpansionTypeForChannelType(channelType);
+                            var chanIdx = ChannelType.GetExpansionChannelIndexForChannelType(channelType);
+
+                            meta.channelData[j].trigger = p[i].GetTrigger(expType, chanIdx);
+                        }
+
+                        meta.registerValues?.SetRegisterValues(ref p[i]);
+                    }
+                }
+            }
+        }
+
+        private void ReadTriggerLogs()
+        {
+            // The emulation only keeps the trigger closest to what it thinks is the middle of
+            // the frame. With the full log, we can pick the one closest to the actual middle.
+            for (int j = 0; j < channelStates.Length; j++)
+            {
+                var channelType = channelStates[j].InnerChannelType;
+                var expType = ChannelType.GetExpansionTypeForChannelType(channelType);
+                var chanIdx = ChannelType.GetExpansionChannelIndexForChannelType(channelType);
+                var count = NesApu.ReadTriggerLog(apuIndex, expType, chanIdx, triggerLog, triggerLog.Length);
+                var k = 0;
+
+                for (int f = triggerLogFrame; f < metadata.Count && k < count; f++)
+                {
+                    var meta = metadata[f];
+                    var frameStart = meta.wavOffset;
+                    var frameEnd = f + 1 < metadata.Count ? metadata[f + 1].wavOffset : prevNumSamples;
+                    var frameMid = (frameStart + frameEnd) / 2;
+                    var best = -1;
+
+                    for (; k < count && triggerLog[k] + triggerLogSampleOffset < frameEnd; k++)
+                    {
+                        var sample = triggerLog[k] + triggerLogSampleOffset;
+                        if (sample >= frameStart && (best < 0 || Math.Abs(sample - frameMid) < Math.Abs(best - frameMid)))
+                            best = sample;
+                    }
+
+                    if (best >= 0 && meta.channelData[j].trigger != NesApu.TRIGGER_NONE)
+                        meta.channelData[j].trigger = best - frameStart;
+                }
+            }
+
+            triggerLogFrame = metadata.Count;
+        }
+
         public VideoFrameMetadata[] GetVideoMetadata(Song song, int duration)
         {
             int maxSample = int.MaxValue;
@@ -706,13 +828,28 @@ namespace FamiStudio
                 maxSample = duration * sampleRate;
 
             BeginPlaySong(song);
+            NesApu.SetTelemetryCapture(apuIndex, TelemetryBatchSize * 2);
+            NesApu.SetTriggerLogs(apuIndex, triggerLog.Length);
+            triggerLogSampleOffset = numSamples;
 
             while (PlaySongFrame() && numSamples < maxSample)
             {
                 WriteMetadata(metadata);
+
+                if ((metadata.Count % TelemetryBatchSize) == 0)
+                {
+                    ReadTelemetry();
+                    ReadTriggerLogs();
+                }
+
                 Log.ReportProgress(0.0f);
             }
 
+            ReadTelemetry();
+            ReadTriggerLogs();
+            NesApu.SetTelemetryCapture(apuIndex, 0);
+            NesApu.SetTriggerLogs(apuIndex, 0);
+
             return metadata.ToArray();
         }
 
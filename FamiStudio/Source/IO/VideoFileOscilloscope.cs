@@ -19,6 +19,9 @@ namespace FamiStudio
             var channelResX = (int)channelResXFloat;
             var channelResY = (int)channelResYFloat;
 
+            // A min/max pair per pixel column, anything more would not be visible.
+            oscMaxPoints = channelResX * 2;
+
             // Tweak some cosmetic stuff that depends on resolution.
             var smallChannelText = channelResY < 128;
             var font = settings.OscLineThickness > 1 ?
@@ -58,7 +61,7 @@ namespace FamiStudio
                     c.FillRectangleGradient(0, 0, channelResX, channelResY, Color.Black, Color.Invisible, true, channelResY / 2);
 
                     // Oscilloscope
-                    var oscilloscope = UpdateOscilloscope(s, f);
+                    var oscilloscope = GetOscilloscope(s);
 
                     c.PushTransform(0, channelResY / 2, channelPosX1 - channelPosX0, (channelPosY0 - channelPosY1) / 2);
                     c.DrawNiceSmoothLine(oscilloscope, frame.channelData[i].color, settings.OscLineThickness);
@@ -444,6 +444,9 @@ namespace FamiStudio
             var oscScaleY = (oscMaxY - oscMinY) / 2;
             var oscChannelPadX = separateChannels ? 0 : 5;
 
+            // A min/max pair per pixel column, anything more would not be visible.
+            oscMaxPoints = (int)(channelHeaderSizeXFloat - oscChannelPadX * 2) * 2;
+
             registerPosY += oscMaxY;
 
             var highlightedKeys = new ValueTuple<int, Color>[channelStates.Length];
@@ -600,7 +603,7 @@ namespace FamiStudio
                     var channelPosY = separateChannels ? (int)MathF.Round((i / numCols) * channelSizeYFloat) : 0;
                     var channelNameSizeX = (int)videoGraphics.MeasureString(s.channelText, font);
                     var channelIconPosX = (int)channelHeaderSizeXFloat / 2 - (channelNameSizeX + s.icon.Size.Width + ChannelIconTextSpacing) / 2;
-                    var oscilloscope = UpdateOscilloscope(s, f);
+                    var oscilloscope = GetOscilloscope(s);
 
                     o.PushTranslation(channelPosX, channelPosY + ChannelIconPosY);
                     o.FillAndDrawRectangle(channelIconPosX, 0, channelIconPosX + s.icon.Size.Width - 1, s.icon.Size.Height - 1, Theme.DarkGreyColor2, Theme.LightGreyColor1);
@@ -12,29 +12,65 @@ namespace FamiStudio
     {
         private const string VorbisDll = Platform.DllPrefix + "Vorbis" + Platform.DllExtension;
 
-        [DllImport(VorbisDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "VorbisOggEncode")]
-        extern static int VorbisOggEncode(int wav_rate, int wav_channels, int wav_num_samples, IntPtr wav_data, int ogg_bitrate, int ogg_data_size, IntPtr ogg_data);
+        [DllImport(VorbisDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "VorbisOggEncoderCreate")]
+        extern static IntPtr VorbisOggEncoderCreate(int wav_rate, int wav_channels, int ogg_bitrate, IntPtr write_func, IntPtr write_user);
 
-        public unsafe static bool Save(short[] wavData, string filename, int sampleRate, int bitRate, int numChannels)
+        [DllImport(VorbisDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "VorbisOggEncoderFeed")]
+        extern static int VorbisOggEncoderFeed(IntPtr enc, int num_samples, IntPtr wav_data);
+
+        [DllImport(VorbisDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "VorbisOggEncoderFinish")]
+        extern static int VorbisOggEncoderFinish(IntPtr enc);
+
+        [DllImport(VorbisDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "VorbisOggEncoderRead")]
+        extern static int VorbisOggEncoderRead(IntPtr enc, int ogg_data_size, IntPtr ogg_data);
+
+        [DllImport(VorbisDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "VorbisOggEncoderDestroy")]
+        extern static void VorbisOggEncoderDestroy(IntPtr enc);
+
+        class Writer : NativeAudioFileWriter
         {
-            var oggData = new byte[wavData.Length * sizeof(short) * 4];
-            var oggSize = 0;
+            private IntPtr enc;
 
-            fixed (short* wavPtr = &wavData[0])
+            public Writer(string filename, IntPtr enc) : base(filename)
             {
-                fixed (byte* mp3Ptr = &oggData[0])
-                {
-                    oggSize = VorbisOggEncode(sampleRate, numChannels, wavData.Length, new IntPtr(wavPtr), bitRate, oggData.Length, new IntPtr(mp3Ptr));
-                }
+                this.enc = enc;
             }
 
-            if (oggSize <= 0)
-                return false;
+            protected override int EncoderFeed(int numSamples, IntPtr wavData) => VorbisOggEncoderFeed(enc, numSamples, wavData);
+            protected override int EncoderFinish() => VorbisOggEncoderFinish(enc);
+            protected override int EncoderRead(int size, IntPtr data) => VorbisOggEncoderRead(enc, size, data);
 
-            Array.Resize(ref oggData, oggSize);
-            File.WriteAllBytes(filename, oggData);
+            public override void Dispose()
+            {
+                base.Dispose();
+                VorbisOggEncoderDestroy(enc);
+                enc = IntPtr.Zero;
+            }
+        }
+
+        // Returns null if the encoder cannot be created.
+        public static AudioFileWriter Open(string filename, int sampleRate, int bitRate, int numChannels)
+        {
+            var enc = VorbisOggEncoderCreate(sampleRate, numChannels, bitRate, IntPtr.Zero, IntPtr.Zero);
 
-            return true;
+            if (enc == IntPtr.Zero)
+                return null;
+
+            try
+            {
+                return new Writer(filename, enc);
+            }
+            catch
+            {
+                VorbisOggEncoderDestroy(enc);
+                throw;
+            }
+        }
+
+        public static bool Save(short[] wavData, string filename, int sampleRate, int bitRate, int numChannels)
+        {
+            using (var writer = Open(filename, sampleRate, bitRate, numChannels))
+                return writer != null && writer.Write(wavData, 0, wavData.Length) && writer.Finish();
         }
     }
 }
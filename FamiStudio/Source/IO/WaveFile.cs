@@ -77,60 +77,104 @@ namespace FamiStudio
             { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
         const int FormatSubChunkSize = 18;
 
-        public unsafe static void Save(short[] samples, string filename, int sampleRate, int numChannels)
+        private unsafe static byte[] GetHeaderBytes(int sampleRate, int numChannels, int numSamples)
+        {
+            var header = new PCMWaveHeader();
+
+            // RIFF WAVE Header
+            header.chunkId[0] = (byte)'R';
+            header.chunkId[1] = (byte)'I';
+            header.chunkId[2] = (byte)'F';
+            header.chunkId[3] = (byte)'F';
+            header.format[0] = (byte)'W';
+            header.format[1] = (byte)'A';
+            header.format[2] = (byte)'V';
+            header.format[3] = (byte)'E';
+
+            // Format subchunk
+            header.subChunk1Id[0] = (byte)'f';
+            header.subChunk1Id[1] = (byte)'m';
+            header.subChunk1Id[2] = (byte)'t';
+            header.subChunk1Id[3] = (byte)' ';
+            header.audioFormat = WAVE_FORMAT_PCM; // FOR PCM
+            header.numChannels = (ushort)numChannels; // 1 for MONO, 2 for stereo
+            header.sampleRate = (uint)sampleRate; // ie 44100 hertz, cd quality audio
+            header.bitsPerSample = 16; // 
+            header.byteRate = header.sampleRate * header.numChannels * header.bitsPerSample / 8;
+            header.blockAlign = (ushort)(header.numChannels * header.bitsPerSample / 8);
+
+            // Data subchunk
+            header.subChunk2Id[0] = (byte)'d';
+            header.subChunk2Id[1] = (byte)'a';
+            header.subChunk2Id[2] = (byte)'t';
+            header.subChunk2Id[3] = (byte)'a';
+
+            // All sizes for later:
+            // chuckSize = 4 + (8 + subChunk1Size) + (8 + subChubk2Size)
+            // subChunk1Size is constanst, i'm using 16 and staying with PCM
+            // subChunk2Size = nSamples * nChannels * bitsPerSample/8
+            // Whenever a sample is added:
+            //    chunkSize += (nChannels * bitsPerSample/8)
+            //    subChunk2Size += (nChannels * bitsPerSample/8)
+            header.subChunk1Size = 16;
+            header.subChunk2Size = (uint)(numSamples * sizeof(short));
+            header.chunkSize = 4 + (8 + header.subChunk1Size) + (8 + header.subChunk2Size);
+
+            var headerBytes = new byte[sizeof(PCMWaveHeader)];
+            Marshal.Copy(new IntPtr(&header), headerBytes, 0, headerBytes.Length);
+            return headerBytes;
+        }
+
+        public static void Save(short[] samples, string filename, int sampleRate, int numChannels)
         {
             using (var file = new FileStream(filename, FileMode.Create))
             {
-                var header = new PCMWaveHeader();
-
-                // RIFF WAVE Header
-                header.chunkId[0] = (byte)'R';
-                header.chunkId[1] = (byte)'I';
-                header.chunkId[2] = (byte)'F';
-                header.chunkId[3] = (byte)'F';
-                header.format[0] = (byte)'W';
-                header.format[1] = (byte)'A';
-                header.format[2] = (byte)'V';
-                header.format[3] = (byte)'E';
-
-                // Format subchunk
-                header.subChunk1Id[0] = (byte)'f';
-                header.subChunk1Id[1] = (byte)'m';
-                header.subChunk1Id[2] = (byte)'t';
-                header.subChunk1Id[3] = (byte)' ';
-                header.audioFormat = WAVE_FORMAT_PCM; // FOR PCM
-                header.numChannels = (ushort)numChannels; // 1 for MONO, 2 for stereo
-                header.sampleRate = (uint)sampleRate; // ie 44100 hertz, cd quality audio
-                header.bitsPerSample = 16; // 
-                header.byteRate = header.sampleRate * header.numChannels * header.bitsPerSample / 8;
-                header.blockAlign = (ushort)(header.numChannels * header.bitsPerSample / 8);
-
-                // Data subchunk
-                header.subChunk2Id[0] = (byte)'d';
-                header.subChunk2Id[1] = (byte)'a';
-                header.subChunk2Id[2] = (byte)'t';
-                header.subChunk2Id[3] = (byte)'a';
-
-                // All sizes for later:
-                // chuckSize = 4 + (8 + subChunk1Size) + (8 + subChubk2Size)
-                // subChunk1Size is constanst, i'm using 16 and staying with PCM
-                // subChunk2Size = nSamples * nChannels * bitsPerSample/8
-                // Whenever a sample is added:
-                //    chunkSize += (nChannels * bitsPerSample/8)
-                //    subChunk2Size += (nChannels * bitsPerSample/8)
-                header.subChunk1Size = 16;
-                header.subChunk2Size = (uint)(samples.Length * sizeof(short));
-                header.chunkSize = 4 + (8 + header.subChunk1Size) + (8 + header.subChunk2Size);
-
-                var headerBytes = new byte[sizeof(PCMWaveHeader)];
-                Marshal.Copy(new IntPtr(&header), headerBytes, 0, headerBytes.Length);
-                file.Write(headerBytes);
+                file.Write(GetHeaderBytes(sampleRate, numChannels, samples.Length));
 
                 var sampleBytes = new byte[samples.Length*2];
                 Buffer.BlockCopy(samples, 0, sampleBytes, 0, sampleBytes.Length);
                 file.Write(sampleBytes);
+            }
+        }
+
+        // The header is written with an empty data chunk first, and patched with the final
+        // sizes once all the samples are in.
+        class Writer : AudioFileWriter
+        {
+            private int sampleRate;
+            private int numChannels;
+            private int numSamples;
+            private byte[] sampleBytes = new byte[0];
 
+            public Writer(string filename, int sampleRate, int numChannels) : base(filename)
+            {
+                this.sampleRate = sampleRate;
+                this.numChannels = numChannels;
+                file.Write(GetHeaderBytes(sampleRate, numChannels, 0));
+            }
+
+            protected override bool WriteSamples(short[] samples, int offset, int count)
+            {
+                if (sampleBytes.Length < count * 2)
+                    sampleBytes = new byte[count * 2];
+
+                Buffer.BlockCopy(samples, offset * 2, sampleBytes, 0, count * 2);
+                file.Write(sampleBytes, 0, count * 2);
+                numSamples += count;
+                return true;
             }
+
+            protected override bool FinishSamples()
+            {
+                file.Seek(0, SeekOrigin.Begin);
+                file.Write(GetHeaderBytes(sampleRate, numChannels, numSamples));
+                return true;
+            }
+        }
+
+        public static AudioFileWriter Open(string filename, int sampleRate, int numChannels)
+        {
+            return new Writer(filename, sampleRate, numChannels);
         }
 
         private unsafe static short[] LoadInternal(byte[] bytes, out int sampleRate)
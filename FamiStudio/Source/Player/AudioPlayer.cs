@@ -1,5 +1,5 @@
 ﻿using System;
-using System.Collections.Concurrent;
+using System.Collections.Generic;
 using System.Diagnostics;
 using System.Threading;
 using System.Threading.Tasks;
@@ -11,14 +11,31 @@ namespace FamiStudio
         protected const float MetronomeFirstBeatPitch  = 1.375f;
         protected const float MetronomeFirstBeatVolume = 1.5f;
 
+        // Enough for the number of frames the ring can hold, plus the partially consumed one and the end marker.
+        private const int FrameQueueSize = 64;
+
         public class FrameAudioData
         {
             public short[] samples;
+            public int   numSamples;
+            public long  endSample;
+            public bool  endOfSong;
             public int   playPosition;
             public int   triggerSample = NesApu.TRIGGER_NONE;
             public int   metronomePosition;
             public float metronomePitch  = 1.0f;
             public float metronomeVolume = 1.0f;
+
+            public void Reset()
+            {
+                samples = null;
+                numSamples = 0;
+                endSample = 0;
+                endOfSong = false;
+                triggerSample = NesApu.TRIGGER_NONE;
+                metronomePitch = 1.0f;
+                metronomeVolume = 1.0f;
+            }
         };
 
         protected IAudioStream audioStream;
@@ -28,11 +45,24 @@ namespace FamiStudio
         protected int numBufferedFrames = 3;
         protected IOscilloscope oscilloscope;
 
-        // These are only used when the number of buffered emulation frame > 0
+        // These are only used when the number of buffered emulation frame > 0. The samples go through
+        // a native ring, the frames' metadata through a single-producer/single-consumer queue here.
         protected Thread emulationThread;
-        protected Semaphore emulationSemaphore;
-        protected ManualResetEvent stopEvent;
-        protected ConcurrentQueue<FrameAudioData> emulationQueue;
+        protected int ringCapacity;
+        protected FrameAudioData[] frameQueue;
+        protected volatile int frameQueueHead; // Only written by the emulation thread.
+        protected volatile int frameQueueTail; // Only written by the audio stream.
+        protected volatile bool frameQueueEnded;
+        protected long ringSamplesWritten;
+        protected long ringSamplesRead;
+        protected short[] ringScratchSamples;
+        protected short[] ringMixedSamples;
+        protected short[] ringFillSamples;
+
+        // The oscilloscope holds on to the samples of a frame for a little while, they go in arrays of
+        // the exact size, one per queue slot. A slot is only reused a full queue of frames later, long
+        // after the oscilloscope has drawn it.
+        protected Dictionary<int, short[][]> oscilloscopeSamples = new Dictionary<int, short[][]>();
 
         // Only used when number of buffered emulation frame == 0
         protected FrameAudioData lastFrameAudioData;
@@ -44,96 +74,91 @@ namespace FamiStudio
         protected abstract bool EmulateFrame();
 
         public bool IsOscilloscopeConnected => oscilloscope != null;
-        public bool IsPlaying => (UsesEmulationThread ? (emulationThread != null || emulationQueue.Count > 0) : (audioStream != null && audioStream.IsPlaying)) || IsSeeking;
+        public bool IsPlaying => (UsesEmulationThread ? (emulationThread != null || FrameQueueCount > 0) : (audioStream != null && audioStream.IsPlaying)) || IsSeeking;
         public bool IsSeeking => seekTask != null;
 
         protected bool UsesEmulationThread => numBufferedFrames > 0;
+        protected int FrameQueueCount => frameQueueHead - frameQueueTail;
 
         public override int PlayPosition
         {
-            get 
+            get
             {
-                // Take the oldest frame in the queue as our play position when using emulation thread.
-                if (UsesEmulationThread && emulationQueue.TryPeek(out var data) && data != null)
-                    return Math.Max(0, data.playPosition);
-                else
-                    return base.PlayPosition;
+                // Take the oldest frame still being played as our play position when using emulation thread.
+                if (UsesEmulationThread)
+                {
+                    var tail = frameQueueTail;
+                    if (tail != frameQueueHead)
+                        return Math.Max(0, frameQueue[tail % FrameQueueSize].playPosition);
+                }
+
+                return base.PlayPosition;
             }
         }
 
-        protected AudioPlayer(IAudioStream stream, int apuIndex, bool pal, int sampleRate, bool stereo, int numFrames) : base(apuIndex, pal, stereo, sampleRate) 
+        protected AudioPlayer(IAudioStream stream, int apuIndex, bool pal, int sampleRate, bool stereo, int numFrames) : base(apuIndex, pal, stereo, sampleRate)
         {
             numBufferedFrames = numFrames;
             audioStream = stream;
-            
+
             if (UsesEmulationThread)
             {
-                stopEvent = new ManualResetEvent(false);
-                emulationSemaphore = new Semaphore(numBufferedFrames, numBufferedFrames);
-                emulationQueue = new ConcurrentQueue<FrameAudioData>();
+                // Size for the longest (PAL) frames, the instrument player can switch at any time.
+                ringCapacity = NesApu.RingInit(apuIndex, (numBufferedFrames + 1) * GetMaxFrameSamples(true));
+                frameQueue = new FrameAudioData[FrameQueueSize];
+                for (int i = 0; i < FrameQueueSize; i++)
+                    frameQueue[i] = new FrameAudioData();
             }
         }
 
-        protected short[] MixSamples(short[] emulation, short[] metronome, int metronomeIndex, float pitch, float volume)
+        private int GetMaxFrameSamples(bool pal)
         {
-            if (metronome != null)
-            {
-                var newSamples = new short[emulation.Length];
+            return ((int)Math.Ceiling(sampleRate / (pal ? NesApu.FpsPAL : NesApu.FpsNTSC)) + 1) * (stereo ? 2 : 1);
+        }
 
-                var i = 0;
-                var j = (float)metronomeIndex;
+        // Every frame (NTSC being the shortest) produces at least that many samples.
+        private int GetMinFrameSamples()
+        {
+            return ((int)(sampleRate / NesApu.FpsNTSC) - 1) * (stereo ? 2 : 1);
+        }
 
-                if (stereo)
-                {
-                    Debug.Assert((newSamples.Length & 1) == 0);
-                    for (; i < newSamples.Length && (int)j < metronome.Length; i += 2, j += pitch)
-                    {
-                        newSamples[i + 0] = (short)Utils.Clamp((int)(emulation[i + 0] + metronome[(int)j] * (volume / 2)), short.MinValue, short.MaxValue);
-                        newSamples[i + 1] = (short)Utils.Clamp((int)(emulation[i + 1] + metronome[(int)j] * (volume / 2)), short.MinValue, short.MaxValue);
-                    }
-                }
-                else
+        protected void MixSamples(short[] emulation, short[] output, int count, short[] metronome, int metronomeIndex, float pitch, float volume)
+        {
+            var i = 0;
+            var j = (float)metronomeIndex;
+
+            if (stereo)
+            {
+                Debug.Assert((count & 1) == 0);
+                for (; i < count && (int)j < metronome.Length; i += 2, j += pitch)
                 {
-                    for (; i < newSamples.Length && (int)j < metronome.Length; i++, j += pitch)
-                        newSamples[i] = (short)Utils.Clamp((int)(emulation[i] + metronome[(int)j] * volume), short.MinValue, short.MaxValue);
+                    output[i + 0] = (short)Utils.Clamp((int)(emulation[i + 0] + metronome[(int)j] * (volume / 2)), short.MinValue, short.MaxValue);
+                    output[i + 1] = (short)Utils.Clamp((int)(emulation[i + 1] + metronome[(int)j] * (volume / 2)), short.MinValue, short.MaxValue);
                 }
-
-                if (i != newSamples.Length)
-                    Array.Copy(emulation, i, newSamples, i, newSamples.Length - i);
-
-                return newSamples;
             }
             else
             {
-                return emulation;
+                for (; i < count && (int)j < metronome.Length; i++, j += pitch)
+                    output[i] = (short)Utils.Clamp((int)(emulation[i] + metronome[(int)j] * volume), short.MinValue, short.MaxValue);
             }
+
+            if (i != count && output != emulation)
+                Array.Copy(emulation, i, output, i, count - i);
         }
 
         protected short[] AudioBufferFillCallback(out bool done)
         {
-            FrameAudioData data;
+            if (UsesEmulationThread)
+                return AudioBufferFillFromRing(out done);
 
             done = false;
 
-            if (UsesEmulationThread)
-            {
-                if (!emulationQueue.TryDequeue(out data))
-                {
-                    // Trace.WriteLine("Audio is starving!");
-                    return null;
-                }
+            // First time it wont be null since we call BeginPlaySong.
+            if (lastFrameAudioData == null)
+                EmulateFrame();
 
-                // Tell emulation thread it should start rendering one more frame.
-                emulationSemaphore.Release();
-            }
-            else
-            {
-                // First time it wont be null since we call BeginPlaySong.
-                if (lastFrameAudioData == null)
-                    EmulateFrame();
-                data = lastFrameAudioData;
-                lastFrameAudioData = null;
-            }
+            var data = lastFrameAudioData;
+            lastFrameAudioData = null;
 
             // This means we've reached the end of a non-looping song.
             if (data == null)
@@ -147,33 +172,172 @@ namespace FamiStudio
                 oscilloscope.AddSamples(data.samples, data.triggerSample);
 
             // Mix in metronome if needed.
-            if (data.metronomePosition >= 0)
-                data.samples = MixSamples(data.samples, metronomeSound, data.metronomePosition, data.metronomePitch, data.metronomeVolume);
+            var metronome = metronomeSound;
+            if (data.metronomePosition >= 0 && metronome != null)
+            {
+                var mixed = new short[data.samples.Length];
+                MixSamples(data.samples, mixed, mixed.Length, metronome, data.metronomePosition, data.metronomePitch, data.metronomeVolume);
+                data.samples = mixed;
+            }
 
             return data.samples;
         }
 
+        // Used by streams that need managed arrays. Hands out fixed size chunks from the ring, the
+        // array is reused, streams are done with it by the time they ask for more.
+        private unsafe short[] AudioBufferFillFromRing(out bool done)
+        {
+            done = false;
+
+            var chunkSize = GetMinFrameSamples();
+            var available = NesApu.RingSamplesAvailable(apuIndex);
+            var samples = ringFillSamples;
+
+            if (available < chunkSize)
+            {
+                if (!frameQueueEnded)
+                    return null;
+
+                // Last few samples of a non-looping song.
+                if (available == 0)
+                {
+                    ConsumeRingSamples(0, out done);
+                    return null;
+                }
+
+                chunkSize = available;
+                samples = new short[chunkSize];
+            }
+            else if (samples == null || samples.Length != chunkSize)
+            {
+                samples = ringFillSamples = new short[chunkSize];
+            }
+
+            fixed (short* p = &samples[0])
+                NesApu.RingRead(apuIndex, new IntPtr(p), chunkSize, 0);
+
+            ConsumeRingSamples(chunkSize, out _);
+
+            return samples;
+        }
+
+        // Used by streams that can take samples directly, no managed arrays involved.
+        protected int AudioBufferReadCallback(IntPtr data, int numSamples, int timeoutMs, out bool done)
+        {
+            Debug.Assert(UsesEmulationThread);
+
+            var numRead = NesApu.RingRead(apuIndex, data, numSamples, frameQueueEnded ? 0 : timeoutMs);
+
+            // Ring was closed, we are stopping.
+            if (numRead < 0)
+            {
+                done = true;
+                return 0;
+            }
+
+            ConsumeRingSamples(numRead, out done);
+
+            return numRead;
+        }
+
+        // Retires the frames that have been fully played, feeds the oscilloscope along the way.
+        private void ConsumeRingSamples(int numSamples, out bool done)
+        {
+            done = false;
+            ringSamplesRead += numSamples;
+
+            while (frameQueueTail != frameQueueHead)
+            {
+                var data = frameQueue[frameQueueTail % FrameQueueSize];
+
+                if (data.endOfSong)
+                {
+                    done = ringSamplesRead >= data.endSample;
+                    if (!done)
+                        break;
+                }
+                else
+                {
+                    if (data.endSample > ringSamplesRead)
+                        break;
+
+                    if (oscilloscope != null && data.samples != null)
+                        oscilloscope.AddSamples(data.samples, data.triggerSample);
+                }
+
+                frameQueueTail++;
+            }
+        }
+
+        // Blocks until there is room for one more frame in the ring. Returns false when asked to stop.
+        protected bool WaitForEmulationSpace()
+        {
+            // Keep at most "numBufferedFrames" frames ahead of the stream, a partially played one counts as one.
+            var threshold = ringCapacity - numBufferedFrames * GetMinFrameSamples() + 1;
+
+            while (true)
+            {
+                var result = NesApu.RingWaitSpace(apuIndex, threshold, 100);
+
+                if (result > 0)
+                    return true;
+                if (result < 0)
+                    return false;
+            }
+        }
+
         protected void AudioStreamStartingCallback()
         {
             if (UsesEmulationThread)
             {
                 // Stream is about to start, wait for emulation to pre-fill its buffers.
-                while (emulationQueue.Count < numBufferedFrames && !reachedEnd)
-                    Thread.Sleep(1);
+                var prefillSamples = numBufferedFrames * GetMinFrameSamples();
+
+                while (!reachedEnd && NesApu.RingWaitSamples(apuIndex, prefillSamples, 10) == 0);
             }
         }
 
         protected void ResetThreadingObjects()
         {
-            stopEvent.Reset();
-            emulationSemaphore = new Semaphore(numBufferedFrames, numBufferedFrames);
+            NesApu.RingReset(apuIndex);
+            ClearFrameQueue();
+        }
+
+        // Wakes up the emulation thread and the stream, both must then be joined/stopped.
+        protected void CloseEmulationRing()
+        {
+            NesApu.RingClose(apuIndex);
+
+            var dropped = NesApu.RingDroppedSamples(apuIndex);
+            if (dropped > 0)
+                Log.LogMessage(LogSeverity.Debug, $"Audio ring was full, {dropped} samples were dropped.");
+        }
+
+        protected void ClearFrameQueue()
+        {
+            frameQueueHead = 0;
+            frameQueueTail = 0;
+            frameQueueEnded = false;
+            ringSamplesWritten = 0;
+            ringSamplesRead = 0;
+        }
+
+        protected void QueueEndOfSong()
+        {
+            var data = frameQueue[frameQueueHead % FrameQueueSize];
+            data.Reset();
+            data.endOfSong = true;
+            data.endSample = ringSamplesWritten;
+            data.playPosition = playPosition;
+            frameQueueEnded = true;
+            frameQueueHead++;
         }
 
         public override void Shutdown()
         {
             if (UsesEmulationThread)
             {
-                stopEvent.Set();
+                CloseEmulationRing();
                 if (emulationThread != null)
                     emulationThread.Join();
             }
@@ -193,16 +357,26 @@ namespace FamiStudio
         }
 
         protected virtual FrameAudioData GetFrameAudioData()
-        {  
+        {
             // Update metronome if there is a beat.
             var metronome = metronomeSound;
 
             if (beat && beatIndex >= 0 && metronome != null)
                 metronomePlayPosition = 0;
 
-            FrameAudioData data = new FrameAudioData();
+            FrameAudioData data;
+
+            if (UsesEmulationThread)
+            {
+                Debug.Assert(FrameQueueCount < FrameQueueSize);
+                data = frameQueue[frameQueueHead % FrameQueueSize];
+                data.Reset();
+            }
+            else
+            {
+                data = new FrameAudioData();
+            }
 
-            data.samples = base.EndFrame();
             data.metronomePosition = metronomePlayPosition;
             data.playPosition = playPosition;
 
@@ -212,9 +386,19 @@ namespace FamiStudio
                 data.metronomeVolume = MetronomeFirstBeatVolume;
             }
 
+            if (UsesEmulationThread)
+            {
+                EndFrameToRing(data, metronome);
+            }
+            else
+            {
+                data.samples = base.EndFrame();
+                data.numSamples = data.samples.Length;
+            }
+
             if (metronomePlayPosition >= 0)
             {
-                metronomePlayPosition += (int)(data.samples.Length / (stereo ? 2 : 1) * data.metronomePitch);
+                metronomePlayPosition += (int)(data.numSamples / (stereo ? 2 : 1) * data.metronomePitch);
                 if (metronome == null || metronomePlayPosition >= metronome.Length)
                     metronomePlayPosition = -1;
             }
@@ -222,13 +406,74 @@ namespace FamiStudio
             return data;
         }
 
+        private unsafe void EndFrameToRing(FrameAudioData data, short[] metronome)
+        {
+            NesApu.EndFrame(apuIndex);
+
+            var mixMetronome = data.metronomePosition >= 0 && metronome != null;
+
+            if (oscilloscope == null && !mixMetronome)
+            {
+                // Common case, the APU renders straight into the ring.
+                data.numSamples = NesApu.RingWriteSamples(apuIndex);
+            }
+            else
+            {
+                var numSamples = NesApu.SamplesAvailable(apuIndex);
+                var numTotalSamples = numSamples * (stereo ? 2 : 1);
+
+                var samples = oscilloscope != null ? GetOscilloscopeBuffer(numTotalSamples) : GetRingBuffer(ref ringScratchSamples, numTotalSamples);
+                var output = samples;
+
+                fixed (short* p = &samples[0])
+                    NesApu.ReadSamples(apuIndex, new IntPtr(p), numSamples);
+
+                if (mixMetronome)
+                {
+                    output = GetRingBuffer(ref ringMixedSamples, numTotalSamples);
+                    MixSamples(samples, output, numTotalSamples, metronome, data.metronomePosition, data.metronomePitch, data.metronomeVolume);
+                }
+
+                fixed (short* p = &output[0])
+                    data.numSamples = NesApu.RingWrite(apuIndex, new IntPtr(p), numTotalSamples);
+
+                data.samples = oscilloscope != null ? samples : null;
+            }
+
+            ringSamplesWritten += data.numSamples;
+            data.endSample = ringSamplesWritten;
+
+            ReadBackRegisterValues();
+        }
+
+        private short[] GetRingBuffer(ref short[] buffer, int size)
+        {
+            if (buffer == null || buffer.Length < size)
+                buffer = new short[Math.Max(size, GetMaxFrameSamples(true))];
+            return buffer;
+        }
+
+        private short[] GetOscilloscopeBuffer(int size)
+        {
+            if (!oscilloscopeSamples.TryGetValue(size, out var slots))
+            {
+                slots = new short[FrameQueueSize][];
+                oscilloscopeSamples.Add(size, slots);
+            }
+
+            var slot = frameQueueHead % FrameQueueSize;
+            if (slots[slot] == null)
+                slots[slot] = new short[size];
+            return slots[slot];
+        }
+
         protected override unsafe short[] EndFrame()
         {
             var data = GetFrameAudioData();
 
             if (UsesEmulationThread)
             {
-                emulationQueue.Enqueue(data);
+                frameQueueHead++;
             }
             else
             {
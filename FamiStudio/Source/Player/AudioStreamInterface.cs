@@ -9,6 +9,9 @@ namespace FamiStudio
     public delegate short[] GetBufferDataCallback(out bool done);
     public delegate void StreamStartingCallback();
 
+    // Optional, lets the stream pull samples straight into its own buffer. Returns the number of samples written.
+    public delegate int ReadBufferDataCallback(IntPtr data, int numSamples, int timeoutMs, out bool done);
+
     public interface IAudioStream : IDisposable
     {
         bool IsPlaying { get; }
@@ -16,7 +19,7 @@ namespace FamiStudio
         bool RecreateOnDeviceChanged { get; }
         int ImmediatePlayPosition { get; }
 
-        void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback);
+        void Start(GetBufferDataCallback bufferFillCallback, StreamStartingCallback streamStartCallback, ReadBufferDataCallback bufferReadCallback = null);
         void Stop();
         void PlayImmediate(short[] data, int sampleRate, float volume, int channel = 0);
     }
@@ -43,6 +43,7 @@ namespace FamiStudio
         protected bool stereo = false;
         protected bool accurateSeek = false;
         protected bool forceReadRegisterValues = false;
+        protected bool captureTelemetry = false;
         protected volatile bool reachedEnd = false;
         protected int  tndMode = NesApu.TND_MODE_SINGLE;
         protected int  beatIndex = -1;
@@ -51,6 +52,7 @@ namespace FamiStudio
         protected ChannelState[] channelStates;
         protected LoopMode loopMode = LoopMode.Song;
         protected long channelMask = -1;
+        protected float[] channelPans; // 0 = left, 1 = right, mixed in stereo by the APU when not null.
         protected volatile int playPosition = 0;
         protected NoteLocation playLocation = new NoteLocation(0, 0);
         protected NesApu.NesRegisterValues registerValues = new NesApu.NesRegisterValues();
@@ -67,6 +69,21 @@ namespace FamiStudio
         protected int tempoEnvelopeIndex;
         protected int tempoEnvelopeCounter;
 
+        // Only used by accurate seek. The APU state is saved every few frames while the song
+        // plays linearly from the start, seeking restores the closest one and only emulates
+        // the frames after it.
+        protected const int SeekKeyframeInterval = 120;
+        protected struct SeekKeyframe
+        {
+            public int Frame;
+            public int Note;
+        }
+        protected List<SeekKeyframe> seekKeyframes = new List<SeekKeyframe>();
+        protected Song seekKeyframesSong;
+        protected bool recordSeekKeyframes;
+        protected int lastSeekKeyframeNote;
+        protected volatile bool seekKeyframesDirty;
+
         protected BasePlayer(int apu, bool pal, bool inStereo, int rate = 44100)
         {
             apuIndex = apu;
@@ -282,9 +299,29 @@ namespace FamiStudio
             }
         }
 
+        protected void UpdateChannelsPanning()
+        {
+            NesApu.SetStereo(apuIndex, channelPans != null ? 1 : 0);
+
+            if (channelPans == null)
+                return;
+
+            for (int i = 0; i < channelStates.Length; i++)
+            {
+                if (channelPans[i] != 0.5f)
+                {
+                    var channelType = channelStates[i].InnerChannelType;
+                    var exp = ChannelType.GetExpansionTypeForChannelType(channelType);
+                    var idx = ChannelType.GetExpansionChannelIndexForChannelType(channelType);
+
+                    NesApu.SetChannelMix(apuIndex, exp, idx, 1.0, channelPans[i] * 2.0 - 1.0);
+                }
+            }
+        }
+
         public void BeginPlaySong(Song s)
         {
-            Debug.Assert(s.Project.OutputsStereoAudio == stereo);
+            Debug.Assert(s.Project.OutputsStereoAudio == stereo || channelPans != null && stereo);
 
             song = s;
             song.Project.AutoAssignN163WavePositions(out n163AutoWavPosMap);
@@ -300,6 +337,82 @@ namespace FamiStudio
 
             InitAndResetApu(song.Project);
             UpdateChannelsMuting();
+            UpdateChannelsPanning();
+
+            if (seekKeyframesDirty || seekKeyframesSong != song)
+            {
+                seekKeyframes.Clear();
+                seekKeyframesSong = song;
+                seekKeyframesDirty = false;
+                NesApu.ClearKeyframes(apuIndex);
+            }
+
+            recordSeekKeyframes = accurateSeek;
+            lastSeekKeyframeNote = -1;
+        }
+
+        // Must be called whenever the song changes, the keyframes no longer match it.
+        public void InvalidateSeekKeyframes()
+        {
+            seekKeyframesDirty = true;
+        }
+
+        private void UpdateSeekKeyframes()
+        {
+            if (!recordSeekKeyframes)
+                return;
+
+            var note = playLocation.ToAbsoluteNoteIndex(song);
+
+            // Looping, editing or skipping frames breaks the link between frames and notes.
+            if (seekKeyframesDirty || note < lastSeekKeyframeNote || (!seeking && playbackRate != 1))
+            {
+                recordSeekKeyframes = false;
+                return;
+            }
+
+            lastSeekKeyframeNote = note;
+
+            if ((frameNumber % SeekKeyframeInterval) == 0 &&
+                (seekKeyframes.Count == 0 || seekKeyframes[seekKeyframes.Count - 1].Frame < frameNumber) &&
+                NesApu.AddKeyframe(apuIndex, frameNumber) == 0)
+            {
+                seekKeyframes.Add(new SeekKeyframe() { Frame = frameNumber, Note = note });
+            }
+        }
+
+        // Jumps to the last keyframe before the target note. The song is replayed without
+        // emulation, like a regular seek, and the APU state is then restored from the keyframe.
+        protected void SeekToKeyframe(int startNote)
+        {
+            Debug.Assert(accurateSeek);
+
+            var idx = seekKeyframes.FindLastIndex(k => k.Note < startNote - 1);
+            if (idx < 0 || seekKeyframesDirty)
+                return;
+
+            var keyframe = seekKeyframes[idx];
+
+            seeking = true;
+            NesApu.StartSeeking(apuIndex);
+
+            while (frameNumber < keyframe.Frame && PlaySongFrameInternal(true));
+
+            NesApu.StopSeeking(apuIndex);
+            seeking = false;
+
+            // If this ever fails, we simply resume the accurate seek from here.
+            Debug.Assert(frameNumber == keyframe.Frame);
+
+            if (frameNumber == keyframe.Frame && NesApu.LoadKeyframe(apuIndex, keyframe.Frame) == 0)
+            {
+                lastSeekKeyframeNote = keyframe.Note;
+                UpdateChannelsMuting();
+            }
+            else
+            {
+                recordSeekKeyframes = false;
+            }
         }
 
         public bool SeekTo(int startNote)
@@ -324,6 +437,7 @@ namespace FamiStudio
                 if (accurateSeek)
                 {
                     EndSeekFrame();
+                    UpdateSeekKeyframes();
                     break;
                 }
             }
@@ -403,6 +517,7 @@ namespace FamiStudio
 
             UpdateChannelsMuting();
             EndFrame();
+            UpdateSeekKeyframes();
 
             return true;
         }
@@ -692,7 +807,9 @@ namespace FamiStudio
             {
                 lock (registerValues)
                 {
-                    registerValues.ReadRegisterValues(apuIndex);
+                    // When capturing, the chip registers are read back later, in batches.
+                    if (!captureTelemetry)
+                        registerValues.ReadRegisterValues(apuIndex);
 
                     // Read some additionnal information that we may need for the
                     // register viewer, such as instrument colors, etc.
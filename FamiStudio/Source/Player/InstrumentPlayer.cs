@@ -71,7 +71,7 @@ namespace FamiStudio
             if (UsesEmulationThread)
             {
                 Debug.Assert(emulationThread == null);
-                Debug.Assert(emulationQueue.Count == 0);
+                Debug.Assert(FrameQueueCount == 0);
 
                 ResetThreadingObjects();
 
@@ -80,7 +80,7 @@ namespace FamiStudio
             }
 
             audioStream.Stop(); // Extra safety
-            audioStream.Start(AudioBufferFillCallback, AudioStreamStartingCallback);
+            audioStream.Start(AudioBufferFillCallback, AudioStreamStartingCallback, UsesEmulationThread ? AudioBufferReadCallback : null);
         }
 
         public void Stop(bool stopNotes = true)
@@ -92,14 +92,17 @@ namespace FamiStudio
 
                 if (UsesEmulationThread)
                 {
-                    stopEvent.Set();
+                    CloseEmulationRing();
                     emulationThread.Join();
                     emulationThread = null;
                 }
             }
 
             audioStream?.Stop();
-            emulationQueue?.Clear();
+
+            if (UsesEmulationThread)
+                ClearFrameQueue();
+
             channelStates = null;
         }
 
@@ -203,13 +206,8 @@ namespace FamiStudio
 
         void EmulationThread(object o)
         {
-            var waitEvents = new WaitHandle[] { stopEvent, emulationSemaphore };
-
-            while (true)
+            while (WaitForEmulationSpace())
             {
-                if (WaitHandle.WaitAny(waitEvents) == 0)
-                    break;
-
                 EmulateFrame();
             }
         }
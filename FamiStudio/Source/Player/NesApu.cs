@@ -47,6 +47,18 @@ namespace FamiStudio
         public extern static int GetAudioExpansions(int apuIdx);
         [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetExpansionVolume")]
         public extern static int SetExpansionVolume(int apuIdx, int expansion, double volume);
+
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetBusPan")]
+        public extern static void SetBusPan(int apuIdx, int expansion, double pan);
+
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetStereo")]
+        public extern static void SetStereo(int apuIdx, int stereo);
+
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetChannelMix")]
+        public extern static void SetChannelMix(int apuIdx, int expansion, int index, double volume, double pan);
+
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuReadBusSamples")]
+        public extern static int ReadBusSamples(int apuIdx, int expansion, IntPtr buffer, int bufferSize);
         [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuGetRegisterValues")]
         public extern unsafe static void GetRegisterValues(int apuIdx, int exp, void* regs);
         [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuGetN163WavePos")]
@@ -59,6 +71,93 @@ namespace FamiStudio
         public extern static int GetChannelTrigger(int apuIdx, int exp, int idx);
         [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetN163Mix")]
         public extern static void SetN163Mix(int apuIdx, int mix);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetDmcMemory")]
+        public extern static void SetDmcMemory(int apuIdx, int bank, int addr, byte[] data, int size);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSelectDmcBank")]
+        public extern static void SelectDmcBank(int apuIdx, int bank);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetDmcBankRegister")]
+        public extern static void SetDmcBankRegister(int apuIdx, int addr);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuAddKeyframe")]
+        public extern static int AddKeyframe(int apuIdx, int frame);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuFindKeyframe")]
+        public extern static int FindKeyframe(int apuIdx, int frame);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuLoadKeyframe")]
+        public extern static int LoadKeyframe(int apuIdx, int frame);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuClearKeyframes")]
+        public extern static void ClearKeyframes(int apuIdx);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingInit")]
+        public extern static int RingInit(int apuIdx, int capacity);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingReset")]
+        public extern static void RingReset(int apuIdx);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingClose")]
+        public extern static void RingClose(int apuIdx);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingSamplesAvailable")]
+        public extern static int RingSamplesAvailable(int apuIdx);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingWaitSpace")]
+        public extern static int RingWaitSpace(int apuIdx, int count, int timeoutMs);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingWaitSamples")]
+        public extern static int RingWaitSamples(int apuIdx, int count, int timeoutMs);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingWriteSamples")]
+        public extern static int RingWriteSamples(int apuIdx);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingDroppedSamples")]
+        public extern static int RingDroppedSamples(int apuIdx);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingWrite")]
+        public extern static int RingWrite(int apuIdx, IntPtr data, int count);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuRingRead")]
+        public extern static int RingRead(int apuIdx, IntPtr data, int count, int timeoutMs);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuGetFrameTelemetry")]
+        public extern unsafe static void GetFrameTelemetry(int apuIdx, FrameTelemetry* telemetry);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetTelemetryCapture")]
+        public extern static int SetTelemetryCapture(int apuIdx, int count);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuReadTelemetry")]
+        public extern unsafe static int ReadTelemetry(int apuIdx, FrameTelemetry* telemetry, int count);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuSetTriggerLogs")]
+        public extern static int SetTriggerLogs(int apuIdx, int count);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuReadTriggerLog")]
+        public extern static int ReadTriggerLog(int apuIdx, int exp, int idx, int[] samples, int count);
+
+        // Vertices (x in [0, 1], y in [-1, 1]) of "count" samples starting at "start", reduced to min/max pairs
+        // if there are more than "maxPoints" of them (0 = no limit). Returns the number of vertices.
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuOscilloscopeVertices")]
+        public extern static int OscilloscopeVertices([In] short[] wav, int size, int circular, int start, int count, int maxPoints, float scale, [Out] float[] vertices, out int peak);
+
+        // Converts interleaved samples from one rate to another with a polyphase filter. Returns the number of frames written.
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuResample")]
+        public extern static int Resample([In] short[] input, int inputCount, int inputRate, [Out] short[] output, int outputCount, int outputRate, int channels);
+
+        // Register log capture (every call that changes the state of the APU) and replay, for reproducible traces and offline rendering.
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuStartCapture")]
+        public extern static int StartCapture(int apuIdx, [MarshalAs(UnmanagedType.LPStr)] string path);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuStopCapture")]
+        public extern static int StopCapture(int apuIdx);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuReplayOpen")]
+        public extern static int ReplayOpen(int apuIdx, [MarshalAs(UnmanagedType.LPStr)] string path);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuReplayFrame")]
+        public extern static int ReplayFrame(int apuIdx);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuReplayClose")]
+        public extern static void ReplayClose(int apuIdx);
+
+        // Batch replay of register logs on a pool of worker threads, each job on an APU of its own. The buffers (and the
+        // handle) must stay alive until BatchWait returns. Sample rate 0 and expansions -1 keep the values of the log,
+        // BatchSubmit returns -1 for a sample rate outside of 8000-192000.
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuBatchCreate")]
+        public extern static IntPtr BatchCreate(int threadCount);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuBatchSubmit")]
+        public extern static int BatchSubmit(IntPtr batch, [MarshalAs(UnmanagedType.LPStr)] string logPath, int sampleRate, int expansions, IntPtr buffer, int bufferSize, [MarshalAs(UnmanagedType.LPStr)] string wavPath);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuBatchWait")]
+        public extern static int BatchWait(IntPtr batch);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuBatchGetResult")]
+        public extern static int BatchGetResult(IntPtr batch, int job, out int samples, out int channels, out int sampleRate);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuBatchDestroy")]
+        public extern static void BatchDestroy(IntPtr batch);
+
+        // Profiling counters, for a per-chip cost breakdown of exports. Cheap when disabled, not cleared by Init.
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuEnableStats")]
+        public extern static void EnableStats(int apuIdx, int enable);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuGetStats")]
+        public extern unsafe static void GetStats(int apuIdx, Stats* stats);
+        [DllImport(NesSndEmuDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "NesApuResetStats")]
+        public extern static void ResetStats(int apuIdx);
 
         [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
         public delegate int DmcReadDelegate(IntPtr data, int addr);
@@ -548,6 +647,77 @@ namespace FamiStudio
             public fixed byte Ages_A1[184];
         }
 
+        // Must match Simple_Apu::frame_telemetry_t.
+        [StructLayout(LayoutKind.Sequential, Pack = 4)]
+        public unsafe struct FrameTelemetry
+        {
+            public const int MaxChannels = 16;
+
+            public int Frame;
+            public int ExpansionMask;
+            public int FdsWavePos;
+            public fixed int N163WavePos[8];
+            public fixed int Triggers[ExpansionType.Count * MaxChannels];
+
+            public ApuRegisterValues  Apu;
+            public Vrc6RegisterValues Vrc6;
+            public Vrc7RegisterValues Vrc7;
+            public FdsRegisterValues  Fds;
+            public Mmc5RegisterValues Mmc5;
+            public N163RegisterValues N163;
+            public S5bRegisterValues  S5B;
+            public EpsmRegisterValues Epsm;
+
+            public int GetTrigger(int exp, int idx)
+            {
+                return Triggers[exp * MaxChannels + idx];
+            }
+        }
+
+        // Must match Simple_Apu::stats_t. Per-chip arrays are indexed by expansion type, 0 being the 2A03.
+        [StructLayout(LayoutKind.Sequential)]
+        public unsafe struct Stats
+        {
+            public int Frames;
+            public int Enabled;
+            public long Samples;
+            public double MixSeconds;
+            public long OpllCalc;
+            public long Opn2Clock;
+            public fixed long PsgCalc[2]; // S5B, EPSM.
+            public fixed long Cycles[ExpansionType.Count];
+            public fixed long Deltas[ExpansionType.Count];
+            public fixed double Seconds[ExpansionType.Count];
+        }
+
+        public unsafe static void LogStats(int apuIdx)
+        {
+            var stats = new Stats();
+            GetStats(apuIdx, &stats);
+
+            if (stats.Frames == 0)
+                return;
+
+            var totalSeconds = stats.MixSeconds;
+            for (int i = 0; i < ExpansionType.Count; i++)
+                totalSeconds += stats.Seconds[i];
+
+            for (int i = 0; i < ExpansionType.Count; i++)
+            {
+                if (stats.Cycles[i] == 0)
+                    continue;
+
+                var calls = 
+                    i == ExpansionType.Vrc7 ? stats.OpllCalc :
+                    i == ExpansionType.S5B  ? stats.PsgCalc[0] :
+                    i == ExpansionType.EPSM ? stats.Opn2Clock + stats.PsgCalc[1] : 0;
+
+                Log.LogMessage(LogSeverity.Debug, $"{(i == 0 ? "2A03" : ExpansionType.InternalNames[i])}: {stats.Seconds[i] * 1000000.0 / stats.Frames:F1} us/frame ({stats.Seconds[i] * 100.0 / totalSeconds:F1}%), {stats.Cycles[i]} cycles, {stats.Deltas[i]} deltas, {calls} core calls.");
+            }
+
+            Log.LogMessage(LogSeverity.Debug, $"Mixing: {stats.MixSeconds * 1000000.0 / stats.Frames:F1} us/frame ({stats.MixSeconds * 100.0 / totalSeconds:F1}%), {stats.Samples} samples.");
+        }
+
         public struct N163InstrumentRange
         {
             public byte Pos;
@@ -597,52 +767,24 @@ namespace FamiStudio
 
             public void ReadRegisterValues(int apuIdx)
             {
-                var expansionMask = NesApu.GetAudioExpansions(apuIdx);
-
-                fixed (void* p = &Apu)
-                    NesApu.GetRegisterValues(apuIdx, ExpansionType.None, p);
-
-                if ((expansionMask & ExpansionType.Vrc6Mask) != 0)
-                {
-                    fixed (void* p = &Vrc6)
-                        NesApu.GetRegisterValues(apuIdx, ExpansionType.Vrc6, p);
-                }
-
-                if ((expansionMask & ExpansionType.Vrc7Mask) != 0)
-                {
-                    fixed (void* p = &Vrc7)
-                        NesApu.GetRegisterValues(apuIdx, ExpansionType.Vrc7, p);
-                }
-
-                if ((expansionMask & ExpansionType.FdsMask) != 0)
-                {
-                    fixed (void* p = &Fds)
-                        NesApu.GetRegisterValues(apuIdx, ExpansionType.Fds, p);
-                }
-
-                if ((expansionMask & ExpansionType.Mmc5Mask) != 0)
-                {
-                    fixed (void* p = &Mmc5)
-                        NesApu.GetRegisterValues(apuIdx, ExpansionType.Mmc5, p);
-                }
+                var telemetry = new FrameTelemetry();
+                NesApu.GetFrameTelemetry(apuIdx, &telemetry);
+                SetRegisterValues(ref telemetry);
+            }
 
-                if ((expansionMask & ExpansionType.N163Mask) != 0)
-                {
-                    fixed (void* p = &N163)
-                        NesApu.GetRegisterValues(apuIdx, ExpansionType.N163, p);
-                }
+            public void SetRegisterValues(ref FrameTelemetry telemetry)
+            {
+                var expansionMask = telemetry.ExpansionMask;
 
-                if ((expansionMask & ExpansionType.S5BMask) != 0)
-                {
-                    fixed (void* p = &S5B)
-                        NesApu.GetRegisterValues(apuIdx, ExpansionType.S5B, p);
-                }
+                Apu = telemetry.Apu;
 
-                if ((expansionMask & ExpansionType.EPSMMask) != 0)
-                {
-                    fixed (void* p = &Epsm)
-                        NesApu.GetRegisterValues(apuIdx, ExpansionType.EPSM, p);
-                }
+                if ((expansionMask & ExpansionType.Vrc6Mask) != 0) Vrc6 = telemetry.Vrc6;
+                if ((expansionMask & ExpansionType.Vrc7Mask) != 0) Vrc7 = telemetry.Vrc7;
+                if ((expansionMask & ExpansionType.FdsMask)  != 0) Fds  = telemetry.Fds;
+                if ((expansionMask & ExpansionType.Mmc5Mask) != 0) Mmc5 = telemetry.Mmc5;
+                if ((expansionMask & ExpansionType.N163Mask) != 0) N163 = telemetry.N163;
+                if ((expansionMask & ExpansionType.S5BMask)  != 0) S5B  = telemetry.S5B;
+                if ((expansionMask & ExpansionType.EPSMMask) != 0) Epsm = telemetry.Epsm;
             }
 
             public void SetPalMode(bool p)
@@ -881,6 +1023,17 @@ namespace FamiStudio
 
         public static byte[][] CurrentSample = new byte[2 + NUM_WAV_EXPORT_APU][];
 
+        // Copies the sample in the APU memory so the DMC can fetch bytes natively. The callback
+        // below is only hit for reads outside of the sample. Only uploads when the sample changes.
+        public static void SetCurrentSample(int apuIdx, byte[] sample)
+        {
+            if (CurrentSample[apuIdx] != sample)
+            {
+                CurrentSample[apuIdx] = sample;
+                SetDmcMemory(apuIdx, 0, DPCMSampleAddr, sample, sample != null ? sample.Length : 0);
+            }
+        }
+
         public static int DmcReadCallback(IntPtr data, int addr)
         {
             var apuIdx = data.ToInt32();
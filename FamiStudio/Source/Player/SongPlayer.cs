@@ -32,7 +32,7 @@ namespace FamiStudio
                 if (accurateSeek)
                 {
                     abortSeek = false;
-                    seekTask = Task.Factory.StartNew(() => { while (SeekTo(startNote) && !abortSeek); });
+                    seekTask = Task.Factory.StartNew(() => { SeekToKeyframe(startNote); while (SeekTo(startNote) && !abortSeek); });
                     return;
                 }
                 else
@@ -58,7 +58,7 @@ namespace FamiStudio
             if (UsesEmulationThread)
             {
                 Debug.Assert(emulationThread == null);
-                Debug.Assert(emulationQueue.Count == 0);
+                Debug.Assert(FrameQueueCount == 0);
 
                 ResetThreadingObjects();
 
@@ -67,7 +67,7 @@ namespace FamiStudio
             }
 
             audioStream.Stop(); // Extra safety
-            audioStream.Start(AudioBufferFillCallback, AudioStreamStartingCallback);
+            audioStream.Start(AudioBufferFillCallback, AudioStreamStartingCallback, UsesEmulationThread ? AudioBufferReadCallback : null);
         }
 
         public void Stop()
@@ -82,12 +82,12 @@ namespace FamiStudio
             if (UsesEmulationThread)
             {
                 // Keeping a local variable of the thread since the song may
-                // end naturally and may set playerThread = null after we have set
-                // the stop event.
+                // end naturally and may set playerThread = null after we have
+                // closed the ring.
                 var thread = emulationThread;
                 if (thread != null)
                 {
-                    stopEvent.Set();
+                    CloseEmulationRing();
                     thread.Join();
                     Debug.Assert(emulationThread == null);
                 }
@@ -104,7 +104,7 @@ namespace FamiStudio
                 // When stopping, reset the play position to the first frame in the queue,
                 // this prevent the cursor from jumping ahead when playing/stopping quickly
                 playPosition = PlayPosition;
-                emulationQueue.Clear();
+                ClearFrameQueue();
             }
         }
 
@@ -121,22 +121,17 @@ namespace FamiStudio
         {
             var advanced = PlaySongFrame();
 
-            // When reaching the end of a non looping song, push a null to signal to stop the stream.
+            // When reaching the end of a non looping song, push a marker to signal to stop the stream.
             if (!advanced && UsesEmulationThread)
-                emulationQueue.Enqueue(null);
+                QueueEndOfSong();
 
             return advanced;
         }
         
         private void EmulationThread(object o)
         {
-            var waitEvents = new WaitHandle[] { stopEvent, emulationSemaphore };
-
-            while (true)
+            while (WaitForEmulationSpace())
             {
-                if (WaitHandle.WaitAny(waitEvents) == 0)
-                    break;
-
                 if (!EmulateFrame())
                     break;
             }
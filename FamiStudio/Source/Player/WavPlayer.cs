@@ -4,58 +4,125 @@ using System.Diagnostics;
 
 namespace FamiStudio
 {
+    // Receives rendered samples as they are produced, returns false to stop the render.
+    public delegate bool AudioSampleSink(short[] samples, int offset, int count);
+
     class WavPlayer : BasePlayer
     {
-        List<short> samples;
+        // Number of interleaved samples accumulated before they are handed to the sink.
+        const int ChunkSize = 65536;
+
+        AudioSampleSink sink;
+        short[] chunk;
+        int chunkCount;
+        int numSamples;
+        int maxSample;
+        bool sinkFailed;
 
-        public WavPlayer(int sampleRate, bool pal, bool stereo, int maxLoop, long mask, int threadIndex = 0, int tnd = NesApu.TND_MODE_SINGLE) : base(NesApu.APU_WAV_EXPORT + threadIndex, pal, stereo, sampleRate)
+        public WavPlayer(int sampleRate, bool pal, bool stereo, int maxLoop, long mask, int threadIndex = 0, int tnd = NesApu.TND_MODE_SINGLE, float[] pan = null) : base(NesApu.APU_WAV_EXPORT + threadIndex, pal, stereo, sampleRate)
         {
             Debug.Assert(threadIndex < NesApu.NUM_WAV_EXPORT_APU);
 
             maxLoopCount = maxLoop;
             channelMask = mask;
             tndMode = tnd;
+            channelPans = pan;
         }
 
         public short[] GetSongSamples(Song song, int duration, bool log = false, bool allowAbort = false)
         {
-            int maxSample = int.MaxValue;
+            var samples = new List<short>();
+
+            if (!StreamSongSamples(song, duration, (s, o, c) => { samples.AddRange(new ArraySegment<short>(s, o, c)); return true; }, log, allowAbort))
+                return new short[0];
+
+            return samples.ToArray();
+        }
+
+        // Renders the song and hands the samples to the sink in chunks, the whole song is never
+        // held in memory. Returns false if the sink failed or the operation was aborted.
+        public bool StreamSongSamples(Song song, int duration, AudioSampleSink output, bool log = false, bool allowAbort = false)
+        {
+            maxSample = int.MaxValue;
 
             if (duration > 0)
                 maxSample = duration * sampleRate * (stereo ? 2 : 1);
 
             var loopPoint = Math.Max(0, song.LoopPoint);
             var totalNumPatterns = loopPoint + (song.Length - loopPoint) * maxLoopCount;
-                
-            samples = new List<short>();
+
+            sink = output;
+            chunk = new short[ChunkSize];
+            chunkCount = 0;
+            numSamples = 0;
+            sinkFailed = false;
 
             BeginPlaySong(song);
 
-            while (PlaySongFrame() && samples.Count < maxSample)
+            if (log)
+            {
+                NesApu.ResetStats(apuIndex);
+                NesApu.EnableStats(apuIndex, 1);
+            }
+
+            while (PlaySongFrame() && numSamples < maxSample && !sinkFailed)
             {
                 if (log)
                 {
                     if (duration > 0)
-                        Log.ReportProgress(samples.Count / (float)maxSample);
+                        Log.ReportProgress(numSamples / (float)maxSample);
                     else
                         Log.ReportProgress(numPlayedPatterns / (float)totalNumPatterns);
                 }
 
                 if (allowAbort && Log.ShouldAbortOperation)
                 { 
-                    return new short[0];
+                    NesApu.EnableStats(apuIndex, 0);
+                    sink = null;
+                    return false;
                 }
             }
 
-            if (samples.Count > maxSample)
-                samples.RemoveRange(maxSample, samples.Count - maxSample);
+            if (log)
+            {
+                NesApu.EnableStats(apuIndex, 0);
+                NesApu.LogStats(apuIndex);
+            }
 
-            return samples.ToArray();
+            FlushChunk();
+            sink = null;
+
+            return !sinkFailed;
+        }
+
+        private void FlushChunk()
+        {
+            if (chunkCount > 0 && !sinkFailed)
+                sinkFailed = !sink(chunk, 0, chunkCount);
+
+            chunkCount = 0;
         }
 
         protected override short[] EndFrame()
         {
-            samples.AddRange(base.EndFrame());
+            var frame = base.EndFrame();
+
+            // Anything past the requested duration is dropped.
+            var count = Math.Min(frame.Length, maxSample - numSamples);
+
+            for (var i = 0; i < count; )
+            {
+                var n = Math.Min(count - i, ChunkSize - chunkCount);
+                Array.Copy(frame, i, chunk, chunkCount, n);
+                chunkCount += n;
+                i += n;
+
+                if (chunkCount == ChunkSize)
+                    FlushChunk();
+            }
+
+            numSamples += count;
+
             return null;
         }
     }
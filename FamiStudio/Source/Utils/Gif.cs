@@ -22,6 +22,15 @@ namespace FamiStudio
         [DllImport(GifDecDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "GifRenderFrame")]
         public static extern void RenderFrame(IntPtr gif, IntPtr buffer, int stride, int channels);
         
+        [DllImport(GifDecDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "GifRenderRect")]
+        public static extern void RenderRect(IntPtr gif, IntPtr buffer, int stride, int channels, int x, int y, int width, int height);
+
+        [DllImport(GifDecDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "GifGetDirtyRect")]
+        public static extern void GetDirtyRect(IntPtr gif, int[] rect);
+
+        [DllImport(GifDecDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "GifCacheFrames")]
+        public static extern int CacheFrames(IntPtr gif);
+
         [DllImport(GifDecDll, CallingConvention = CallingConvention.StdCall, EntryPoint = "GifGetFrameDelay")]
         public static extern int GetFrameDelay(IntPtr gif);
 
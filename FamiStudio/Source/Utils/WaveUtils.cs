@@ -102,39 +102,23 @@ namespace FamiStudio
             return output;
         }
 
+        // Unlike ResampleStream, which is linear to keep the latency low, whole buffers go
+        // through the polyphase filter of the emulation DLL.
         static public short[] ResampleBuffer(short[] source, int inputRate, int outputRate, bool stereo)
         {
+            if (inputRate == outputRate)
+            {
+                return source;
+            }
+
             var ratio = inputRate / (double)outputRate;
-            var sampleIndex = 0.0;
             var channelCount = stereo ? 2 : 1;
             var inputFrameCount = source.Length / channelCount;
             var outputFrameCount = (int)(inputFrameCount / ratio);
             var output = new short[outputFrameCount * channelCount];
 
-            for (var i = 0; i < outputFrameCount * channelCount; i += channelCount)
-            {
-                var alpha = Math.Abs(Utils.Frac(sampleIndex));
-
-                var idx0 = Math.Min((int)Math.Floor  (sampleIndex), inputFrameCount - 1) * channelCount;
-                var idx1 = Math.Min((int)Math.Ceiling(sampleIndex), inputFrameCount - 1) * channelCount;
-
-                {
-                    var s0 = source[idx0];
-                    var s1 = source[idx1];
-
-                    output[i] = (short)Utils.Lerp(s0, s1, alpha);
-                }
-
-                if (stereo)
-                {
-                    var s0 = source[idx0 + 1];
-                    var s1 = source[idx1 + 1];
-
-                    output[i + 1] = (short)Utils.Lerp(s0, s1, alpha);
-                }
-
-                sampleIndex += ratio;
-            }
+            if (outputFrameCount > 0)
+                NesApu.Resample(source, inputFrameCount, inputRate, output, outputFrameCount, outputRate, channelCount);
 
             return output;
         }
@@ -1,17 +1,26 @@
 ﻿using System;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
 using System.Linq;
 using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
 
 namespace FamiStudio
 {
     class VideoEncoderFFmpeg : IVideoEncoder
     {
+        // Frames are written to ffmpeg on a separate thread, while the next ones are rendered.
+        private const int NumFramesInFlight = 3;
+
         private Process process;
         private BinaryWriter stream;
-        private byte[] videoImage;
+        private BlockingCollection<byte[]> freeImages;
+        private BlockingCollection<byte[]> pendingImages;
+        private Task writeTask;
+        private volatile bool writeFailed;
 
         public VideoEncoderFFmpeg()
         {
@@ -21,7 +30,14 @@ namespace FamiStudio
         {
             process = LaunchFFmpeg(Settings.FFmpegExecutablePath, $"-y -f rawvideo -pix_fmt argb -s {resX}x{resY} -r {frameRateNumer}/{frameRateDenom} -i - -i \"{audioFile}\" -c:v h264 -pix_fmt yuv420p -b:v {videoBitRate}K -c:a aac -aac_is disable -b:a {audioBitRate}k \"{outputFile}\"", true, false, true);
             stream = new BinaryWriter(process.StandardInput.BaseStream);
-            videoImage = new byte[resX * resY * 4];
+            freeImages = new BlockingCollection<byte[]>();
+            pendingImages = new BlockingCollection<byte[]>(NumFramesInFlight);
+            writeFailed = false;
+
+            for (int i = 0; i < NumFramesInFlight; i++)
+                freeImages.Add(new byte[resX * resY * 4]);
+
+            writeTask = Task.Factory.StartNew(WriteThread, TaskCreationOptions.LongRunning);
 
             if (Platform.IsWindows)
             {
@@ -32,15 +48,62 @@ namespace FamiStudio
             return true;
         }
 
+        private void WriteThread()
+        {
+            try
+            {
+                foreach (var image in pendingImages.GetConsumingEnumerable())
+                {
+                    if (!writeFailed)
+                    {
+                        try
+                        {
+                            stream.Write(image);
+                        }
+                        catch (Exception)
+                        {
+                            writeFailed = true;
+                        }
+                    }
+
+                    freeImages.Add(image);
+                }
+            }
+            catch (Exception)
+            {
+                writeFailed = true;
+            }
+            finally
+            {
+                // Nothing will be returned anymore, release the producer if it is waiting on an image.
+                freeImages.CompleteAdding();
+            }
+        }
+
         public bool AddFrame(OffscreenGraphics graphics)
         {
-            graphics.GetBitmap(videoImage);
-            stream.Write(videoImage);
+            if (writeFailed || !freeImages.TryTake(out var image, Timeout.Infinite))
+            {
+                Log.LogMessage(LogSeverity.Error, "Error sending frames to ffmpeg, aborting.");
+                return false;
+            }
+
+            graphics.GetBitmap(image);
+            pendingImages.Add(image);
             return true;
         }
 
         public void EndEncoding(bool abort)
         {
+            pendingImages.CompleteAdding();
+            writeTask.Wait();
+            writeTask = null;
+
+            pendingImages.Dispose();
+            freeImages.Dispose();
+            pendingImages = null;
+            freeImages = null;
+
             stream.Dispose();
             stream = null;
 
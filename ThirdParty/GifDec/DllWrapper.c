@@ -31,52 +31,32 @@ int __stdcall GifAdvanceFrame(gd_GIF* gif)
         ret = gd_get_frame(gif);
     }
 
-    if (ret == -1)
-        return -1;
+    return ret;
 }
 
 void __stdcall GifRenderFrame(gd_GIF* gif, unsigned char* buffer, int stride, int channels)
 {
-    unsigned char* color = buffer;
-
-    // Create temp buffer if stride isnt a perfect match or if we need to add alpha.
-    if (channels != 3 || stride != gif->width * 3)
-    {
-        color = malloc(stride * gif->height);
-    }
-
-    gd_render_frame(gif, color);
-
-    if (color != buffer)
-    {
-        unsigned char* src = color;
-
-        if (channels == 3)
-        {
-            for (int y = 0; y < gif->height; y++)
-            {
-                memcpy(&buffer[stride * y], src, gif->width * 3);
-                src += gif->width * 3;
-            }
-        }
-        else
-        {
-            unsigned char* dst = buffer;
+    gd_render_frame_stride(gif, buffer, stride, channels);
+}
 
-            for (int y = 0; y < gif->height * gif->width; y++)
-            {
-                dst[0] = src[2];
-                dst[1] = src[1];
-                dst[2] = src[0];
-                dst[3] = 255;
+// Decodes all frames once, later calls to GifAdvanceFrame replay them. Returns the frame count or -1.
+int __stdcall GifCacheFrames(gd_GIF* gif)
+{
+    return gd_cache_frames(gif);
+}
 
-                src += 3;
-                dst += 4;
-            }
-        }
+// Area (x, y, width, height) that changed during the last GifAdvanceFrame.
+void __stdcall GifGetDirtyRect(gd_GIF* gif, int* rect)
+{
+    rect[0] = gif->dx;
+    rect[1] = gif->dy;
+    rect[2] = gif->dw;
+    rect[3] = gif->dh;
+}
 
-        free(color);
-    }
+void __stdcall GifRenderRect(gd_GIF* gif, unsigned char* buffer, int stride, int channels, int x, int y, int width, int height)
+{
+    gd_render_rect(gif, buffer, stride, channels, x, y, width, height);
 }
 
 int __stdcall GifGetFrameDelay(gd_GIF* gif)
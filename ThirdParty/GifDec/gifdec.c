@@ -122,6 +122,8 @@ gd_open_gif(const uint8_t* buffer, int swap)
             memcpy(&gif->canvas[i*3], bgcolor, 3);
     gif->data = data;
     gif->anim_start = data;
+    gif->cur_frame = -1;
+    gif->dirty_full = 1;
     goto ok;
 fail:
     return 0;
@@ -248,19 +250,25 @@ read_ext(gd_GIF *gif)
     }
 }
 
+/* FamiStudio : The LZW table is allocated once per GIF with room for the maximum
+ * number of codes (4096), so decoding a frame never touches the heap. */
+#define MAX_TABLE_ENTRIES 0x1000
+
 static Table *
-new_table(int key_size)
+reset_table(gd_GIF *gif, int key_size)
 {
     int key;
-    int init_bulk = MAX(1 << (key_size + 1), 0x100);
-    Table *table = malloc(sizeof(*table) + sizeof(Entry) * init_bulk);
-    if (table) {
-        table->bulk = init_bulk;
-        table->nentries = (1 << key_size) + 2;
+    Table *table = gif->table;
+    if (!table) {
+        table = malloc(sizeof(*table) + sizeof(Entry) * MAX_TABLE_ENTRIES);
+        if (!table) return NULL;
+        table->bulk = MAX_TABLE_ENTRIES;
         table->entries = (Entry *) &table[1];
-        for (key = 0; key < (1 << key_size); key++)
-            table->entries[key] = (Entry) {1, 0xFFF, key};
+        gif->table = table;
     }
+    table->nentries = (1 << key_size) + 2;
+    for (key = 0; key < (1 << key_size); key++)
+        table->entries[key] = (Entry) {1, 0xFFF, key};
     return table;
 }
 
@@ -363,7 +371,9 @@ read_image_data(gd_GIF *gif, int interlace)
     gif->data = start;
     clear = 1 << key_size;
     stop = clear + 1;
-    table = new_table(key_size);
+    table = reset_table(gif, key_size);
+    if (!table)
+        return -1;
     key_size++;
     init_key_size = key_size;
     sub_len = shift = 0;
@@ -378,10 +388,9 @@ read_image_data(gd_GIF *gif, int interlace)
             table_is_full = 0;
         } else if (!table_is_full) {
             ret = add_entry(&table, str_len + 1, key, entry.suffix);
-            if (ret == -1) {
-                free(table);
+            if (ret == -1)
                 return -1;
-            }
+            gif->table = table;
             if (table->nentries == 0x1000) {
                 ret = 0;
                 table_is_full = 1;
@@ -409,7 +418,6 @@ read_image_data(gd_GIF *gif, int interlace)
         if (key < table->nentries - 1 && !table_is_full)
             table->entries[table->nentries - 1].suffix = entry.suffix;
     }
-    free(table);
     if (key == stop)
         read_data(&gif->data, &sub_len, 1); /* Must be zero! */
     gif->data = end;
@@ -474,6 +482,18 @@ render_frame_rect(gd_GIF *gif, uint8_t *buffer)
     }
 }
 
+static void
+free_cache(gd_GIF *gif)
+{
+    int i;
+    for (i = 0; i < gif->nframes; i++)
+        free(gif->cache[i].indices);
+    free(gif->cache);
+    gif->cache = NULL;
+    gif->frames = NULL;
+    gif->nframes = 0;
+}
+
 static void
 dispose(gd_GIF *gif)
 {
@@ -497,13 +517,74 @@ dispose(gd_GIF *gif)
     }
 }
 
+/* FamiStudio : Dirty rectangle is the union of the previous and current frame
+ * rectangles, since those are the only pixels that can change between the two. */
+static void
+update_dirty_rect(gd_GIF *gif, int px, int py, int pw, int ph)
+{
+    int x0, y0, x1, y1;
+    if (gif->dirty_full) {
+        px = py = 0;
+        pw = gif->width;
+        ph = gif->height;
+        gif->dirty_full = 0;
+    } else if (pw == 0 || ph == 0) {
+        px = gif->fx;
+        py = gif->fy;
+        pw = gif->fw;
+        ph = gif->fh;
+    }
+    x0 = MIN(px, gif->fx);
+    y0 = MIN(py, gif->fy);
+    x1 = MAX(px + pw, gif->fx + gif->fw);
+    y1 = MAX(py + ph, gif->fy + gif->fh);
+    gif->dx = x0;
+    gif->dy = y0;
+    gif->dw = x1 - x0;
+    gif->dh = y1 - y0;
+}
+
+static int
+get_cached_frame(gd_GIF *gif)
+{
+    gd_Frame *frm;
+    int j;
+
+    if (++gif->cur_frame >= gif->nframes) {
+        gif->cur_frame = gif->nframes;
+        return 0;
+    }
+    frm = &gif->frames[gif->cur_frame];
+    gif->fx = frm->fx;
+    gif->fy = frm->fy;
+    gif->fw = frm->fw;
+    gif->fh = frm->fh;
+    gif->gce = frm->gce;
+    gif->lct = frm->palette;
+    gif->palette = &gif->lct;
+    for (j = 0; j < frm->fh; j++)
+        memcpy(&gif->frame[(frm->fy + j) * gif->width + frm->fx], &frm->indices[j * frm->fw], frm->fw);
+    return 1;
+}
+
 /* Return 1 if got a frame; 0 if got GIF trailer; -1 if error. */
 int
 gd_get_frame(gd_GIF *gif)
 {
     char sep;
+    int px, py, pw, ph, ret;
 
     dispose(gif);
+    px = gif->fx;
+    py = gif->fy;
+    pw = gif->fw;
+    ph = gif->fh;
+    if (gif->frames) {
+        ret = get_cached_frame(gif);
+        if (ret == 1)
+            update_dirty_rect(gif, px, py, pw, ph);
+        return ret;
+    }
     read_data(&gif->data, &sep, 1);
     while (sep != ',') {
         if (sep == ';')
@@ -515,9 +596,77 @@ gd_get_frame(gd_GIF *gif)
     }
     if (read_image(gif) == -1)
         return -1;
+    update_dirty_rect(gif, px, py, pw, ph);
     return 1;
 }
 
+/* FamiStudio : Decodes every frame once and keeps the indexed sub-rectangles, further
+ * calls to gd_get_frame() simply replay them. Restarts the animation. Returns the
+ * number of frames, or -1 on error. */
+int
+gd_cache_frames(gd_GIF *gif)
+{
+    uint8_t *canvas;
+    gd_Frame *frm;
+    int capacity, ret, j, size;
+
+    if (gif->frames)
+        return gif->nframes;
+
+    size = gif->width * gif->height * 3;
+    canvas = malloc(size);
+    if (!canvas)
+        return -1;
+    memcpy(canvas, gif->canvas, size);
+
+    gd_rewind(gif);
+    capacity = 0;
+    while ((ret = gd_get_frame(gif)) == 1) {
+        if (gif->nframes == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            frm = realloc(gif->cache, sizeof(gd_Frame) * capacity);
+            if (!frm) {
+                ret = -1;
+                break;
+            }
+            gif->cache = frm;
+        }
+        frm = &gif->cache[gif->nframes];
+        frm->fx = gif->fx;
+        frm->fy = gif->fy;
+        frm->fw = gif->fw;
+        frm->fh = gif->fh;
+        frm->gce = gif->gce;
+        frm->palette = *gif->palette;
+        frm->indices = malloc(gif->fw * gif->fh + 1);
+        if (!frm->indices) {
+            ret = -1;
+            break;
+        }
+        for (j = 0; j < gif->fh; j++)
+            memcpy(&frm->indices[j * gif->fw], &gif->frame[(gif->fy + j) * gif->width + gif->fx], gif->fw);
+        gif->nframes++;
+    }
+
+    /* Back to the state we were in before the first frame. */
+    memcpy(gif->canvas, canvas, size);
+    free(canvas);
+    gif->fx = gif->fy = gif->fw = gif->fh = 0;
+    memset(&gif->gce, 0, sizeof(gif->gce));
+    gif->palette = &gif->gct;
+    gif->dirty_full = 1;
+
+    if (ret == -1 || gif->nframes == 0) {
+        free_cache(gif);
+        gd_rewind(gif);
+        return -1;
+    }
+
+    gif->frames = gif->cache;
+    gd_rewind(gif);
+    return gif->nframes;
+}
+
 void
 gd_render_frame(gd_GIF *gif, uint8_t *buffer)
 {
@@ -525,6 +674,76 @@ gd_render_frame(gd_GIF *gif, uint8_t *buffer)
     render_frame_rect(gif, buffer);
 }
 
+/* FamiStudio : Renders the current frame directly into a buffer with an arbitrary
+ * row stride. With 4 channels, colors are swizzled and alpha is forced to 255.
+ * Palette indices are expanded through a 32-bit lookup table, one store per pixel. */
+void
+gd_render_frame_stride(gd_GIF *gif, uint8_t *buffer, int stride, int channels)
+{
+    gd_render_rect(gif, buffer, stride, channels, 0, 0, gif->width, gif->height);
+}
+
+/* FamiStudio : Same, but only renders the (rx, ry, rw, rh) rectangle, "buffer" points
+ * to where its top-left pixel goes. Typically used with the dirty rectangle. */
+void
+gd_render_rect(gd_GIF *gif, uint8_t *buffer, int stride, int channels, int rx, int ry, int rw, int rh)
+{
+    uint32_t lut[0x100];
+    int i, x, y, x0, x1, transparent;
+    uint8_t tindex;
+
+    transparent = gif->gce.transparency;
+    tindex = gif->gce.tindex;
+
+    if (channels == 4) {
+        for (i = 0; i < 0x100; i++) {
+            uint8_t *color = &gif->palette->colors[i*3];
+            uint8_t rgba[4] = { color[2], color[1], color[0], 255 };
+            memcpy(&lut[i], rgba, 4);
+        }
+    }
+
+    /* Horizontal overlap of the frame with the requested rectangle. */
+    x0 = MAX(rx, gif->fx);
+    x1 = MIN(rx + rw, gif->fx + gif->fw);
+
+    for (y = ry; y < ry + rh; y++) {
+        uint8_t *dst = &buffer[(y - ry) * stride];
+        uint8_t *src = &gif->canvas[(y * gif->width + rx) * 3];
+        uint8_t *idx;
+
+        if (channels == 4) {
+            for (x = 0; x < rw; x++, src += 3) {
+                uint8_t rgba[4] = { src[2], src[1], src[0], 255 };
+                memcpy(&dst[x*4], rgba, 4);
+            }
+        } else {
+            memcpy(dst, src, rw * 3);
+        }
+
+        if (y < gif->fy || y >= gif->fy + gif->fh || x0 >= x1)
+            continue;
+
+        idx = &gif->frame[y * gif->width];
+        dst -= rx * channels;
+
+        if (channels == 4) {
+            if (transparent) {
+                for (x = x0; x < x1; x++)
+                    if (idx[x] != tindex)
+                        memcpy(&dst[x*4], &lut[idx[x]], 4);
+            } else {
+                for (x = x0; x < x1; x++)
+                    memcpy(&dst[x*4], &lut[idx[x]], 4);
+            }
+        } else {
+            for (x = x0; x < x1; x++)
+                if (!transparent || idx[x] != tindex)
+                    memcpy(&dst[x*3], &gif->palette->colors[idx[x]*3], 3);
+        }
+    }
+}
+
 int
 gd_is_bgcolor(gd_GIF *gif, uint8_t color[3])
 {
@@ -535,6 +754,7 @@ void
 gd_rewind(gd_GIF *gif)
 {
     gif->data = gif->anim_start;
+    gif->cur_frame = -1;
 }
 
 void
@@ -543,5 +763,7 @@ gd_close_gif(gd_GIF *gif)
     gif->data = NULL;
     gif->anim_start = NULL;
     free(gif->frame);    
+    free(gif->table);
+    free_cache(gif);
     free(gif);
 }
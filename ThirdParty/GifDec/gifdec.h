@@ -21,6 +21,14 @@ typedef struct gd_GCE {
     int transparency;
 } gd_GCE;
 
+// FamiStudio : Pre-decoded frame, see gd_cache_frames().
+typedef struct gd_Frame {
+    uint16_t fx, fy, fw, fh;
+    gd_GCE gce;
+    gd_Palette palette;
+    uint8_t *indices;
+} gd_Frame;
+
 // FamiStudio : Changed file descriptor to memory buffer.
 typedef struct gd_GIF {
     const uint8_t* data;
@@ -42,11 +50,19 @@ typedef struct gd_GIF {
     uint8_t bgindex;
     uint8_t swap; // FamiStudio: flag to swap Red/Blue channels.
     uint8_t *canvas, *frame;
+    struct Table *table; // FamiStudio: persistent LZW table.
+    uint16_t dx, dy, dw, dh; // FamiStudio: area that changed during the last gd_get_frame().
+    uint8_t dirty_full;
+    gd_Frame *frames, *cache; // FamiStudio: frame cache, "frames" is only set once fully decoded.
+    int nframes, cur_frame;
 } gd_GIF;
 
 gd_GIF *gd_open_gif(const uint8_t* data, int swap);
 int gd_get_frame(gd_GIF *gif);
 void gd_render_frame(gd_GIF *gif, uint8_t *buffer);
+void gd_render_frame_stride(gd_GIF *gif, uint8_t *buffer, int stride, int channels);
+void gd_render_rect(gd_GIF *gif, uint8_t *buffer, int stride, int channels, int rx, int ry, int rw, int rh);
+int gd_cache_frames(gd_GIF *gif);
 int gd_is_bgcolor(gd_GIF *gif, uint8_t color[3]);
 void gd_rewind(gd_GIF *gif);
 void gd_close_gif(gd_GIF *gif);
@@ -0,0 +1,408 @@
+
+// Batch rendering of register logs, for the regression renders of whole projects. Each
+// job replays a log on a Simple_Apu of its own, the jobs are spread over a pool of worker
+// threads that steal from each other when they run out of work.
+
+#ifndef BATCH_RENDER_H
+#define BATCH_RENDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "Register_Log.h"
+
+class Batch_Render {
+public:
+	typedef blip_sample_t sample_t;
+
+	enum {
+		status_pending   = 1,  // Not rendered yet.
+		status_ok        = 0,
+		status_truncated = -1, // The output buffer was full, what fits was written.
+		status_bad_log   = -2, // The log could not be loaded or is corrupt.
+		status_bad_file  = -3, // The wave file could not be written.
+		status_no_memory = -4,
+		status_bad_rate  = -5  // The sample rate override is out of range.
+	};
+
+	// Range accepted for the sample rate override.
+	enum { min_sample_rate = 8000, max_sample_rate = 192000 };
+	static bool valid_sample_rate( long rate ) { return rate == 0 || (rate >= min_sample_rate && rate <= max_sample_rate); }
+
+	struct job_t
+	{
+		// Input, the job only reads them.
+		const char* log_path;
+		long sample_rate;     // 0 keeps the rate of the log.
+		int expansions;       // -1 keeps the expansions of the log.
+		sample_t* out;        // Interleaved samples when stereo, can be NULL.
+		long out_size;        // Size of 'out', in samples.
+		const char* wav_path; // Wave file to write, can be NULL.
+
+		// Results, valid once wait() returns.
+		int status;
+		int channels;
+		long sample_rate_out;
+		long samples;         // Rendered, in samples (frames * channels).
+	};
+
+	Batch_Render();
+	~Batch_Render();
+
+	// Starts the workers, 0 meaning one per hardware thread. Returns false if none could
+	// be started. Stops the previous ones first.
+	bool start( int thread_count = 0 );
+
+	// Queues a job, it must stay valid until wait() returns. Only one thread submits.
+	void submit( job_t* job );
+
+	// Waits for every job submitted so far, returns the number of them that failed.
+	int wait();
+
+	// Waits for the current jobs and joins the workers.
+	void stop();
+
+	int thread_count() const { return (int) workers.size(); }
+
+	// Renders a job on the calling thread, this is what the workers run.
+	static void render( job_t& job );
+
+private:
+	struct worker_t
+	{
+		std::mutex lock;
+		std::deque<job_t*> jobs; // The owner takes from the back, thieves from the front.
+		std::thread thread;
+	};
+
+	std::vector<worker_t*> workers;
+	std::mutex idle_lock;
+	std::condition_variable idle_cond; // Workers wait for jobs.
+	std::condition_variable done_cond; // wait() waits for the workers.
+	std::atomic<long> queued;
+	std::atomic<long> pending;
+	std::atomic<int> failures;
+	bool stopping;
+	size_t next_worker;
+
+	job_t* take( size_t self );
+	void run( size_t self );
+	static bool write_wav_header( FILE* file, long sample_rate, int channels, long samples );
+
+	// noncopyable
+	Batch_Render( const Batch_Render& );
+	Batch_Render& operator = ( const Batch_Render& );
+};
+
+inline Batch_Render::Batch_Render() : queued( 0 ), pending( 0 ), failures( 0 )
+{
+	stopping = false;
+	next_worker = 0;
+}
+
+inline Batch_Render::~Batch_Render()
+{
+	stop();
+}
+
+inline bool Batch_Render::start( int thread_count )
+{
+	stop();
+
+	if ( thread_count <= 0 )
+		thread_count = (int) std::thread::hardware_concurrency();
+	if ( thread_count <= 0 )
+		thread_count = 1;
+
+	stopping = false;
+	failures = 0;
+
+	// The first chips to be created build tables shared by all of them (emu2413), this
+	// must not happen on several workers at once.
+	Simple_Apu* first = new (std::nothrow) Simple_Apu;
+	if ( !first )
+		return false;
+	delete first;
+
+	// Every worker must exist before any of them looks for jobs to steal. The ones whose
+	// thread cannot be started still get jobs, the others steal them.
+	for ( int i = 0; i < thread_count; i++ )
+	{
+		worker_t* w = new (std::nothrow) worker_t;
+		if ( !w )
+			break;
+		workers.push_back( w );
+	}
+
+	int started = 0;
+	for ( size_t i = 0; i < workers.size(); i++ )
+	{
+		try
+		{
+			workers [i]->thread = std::thread( &Batch_Render::run, this, i );
+			started++;
+		}
+		catch ( ... )
+		{
+		}
+	}
+
+	if ( !started )
+	{
+		for ( size_t i = 0; i < workers.size(); i++ )
+			delete workers [i];
+		workers.clear();
+	}
+
+	return started != 0;
+}
+
+inline void Batch_Render::submit( job_t* job )
+{
+	job->status = status_pending;
+	job->channels = 0;
+	job->sample_rate_out = 0;
+	job->samples = 0;
+
+	if ( workers.empty() )
+	{
+		render( *job );
+		if ( job->status != status_ok )
+			failures++;
+		return;
+	}
+
+	// Round robin, stealing evens out the jobs of different lengths.
+	worker_t* w = workers [next_worker++ % workers.size()];
+	{
+		std::lock_guard<std::mutex> guard( w->lock );
+		w->jobs.push_back( job );
+	}
+
+	pending++;
+	queued++;
+
+	std::lock_guard<std::mutex> guard( idle_lock );
+	idle_cond.notify_one();
+}
+
+inline int Batch_Render::wait()
+{
+	std::unique_lock<std::mutex> guard( idle_lock );
+	done_cond.wait( guard, [this] { return pending.load() == 0; } );
+	return failures.exchange( 0 );
+}
+
+inline void Batch_Render::stop()
+{
+	if ( workers.empty() )
+		return;
+
+	wait();
+
+	{
+		std::lock_guard<std::mutex> guard( idle_lock );
+		stopping = true;
+		idle_cond.notify_all();
+	}
+
+	// All of them first, a worker can look into the others until it exits.
+	for ( size_t i = 0; i < workers.size(); i++ )
+	{
+		if ( workers [i]->thread.joinable() )
+			workers [i]->thread.join();
+	}
+
+	for ( size_t i = 0; i < workers.size(); i++ )
+		delete workers [i];
+
+	workers.clear();
+}
+
+inline Batch_Render::job_t* Batch_Render::take( size_t self )
+{
+	job_t* job = NULL;
+
+	{
+		worker_t* w = workers [self];
+		std::lock_guard<std::mutex> guard( w->lock );
+		if ( !w->jobs.empty() )
+		{
+			job = w->jobs.back();
+			w->jobs.pop_back();
+		}
+	}
+
+	for ( size_t i = 1; !job && i < workers.size(); i++ )
+	{
+		worker_t* w = workers [(self + i) % workers.size()];
+		std::unique_lock<std::mutex> guard( w->lock, std::try_to_lock );
+		if ( guard.owns_lock() && !w->jobs.empty() )
+		{
+			job = w->jobs.front();
+			w->jobs.pop_front();
+		}
+	}
+
+	if ( job )
+		queued--;
+
+	return job;
+}
+
+inline void Batch_Render::run( size_t self )
+{
+	while ( true )
+	{
+		job_t* job = take( self );
+
+		if ( !job )
+		{
+			std::unique_lock<std::mutex> guard( idle_lock );
+			if ( stopping )
+				return;
+
+			// A try_lock may have skipped a victim, look again as long as jobs are queued.
+			if ( queued.load() == 0 )
+				idle_cond.wait( guard, [this] { return stopping || queued.load() != 0; } );
+			continue;
+		}
+
+		render( *job );
+
+		if ( job->status != status_ok )
+			failures++;
+
+		if ( --pending == 0 )
+		{
+			std::lock_guard<std::mutex> guard( idle_lock );
+			done_cond.notify_all();
+		}
+	}
+}
+
+inline void Batch_Render::render( job_t& job )
+{
+	if ( !valid_sample_rate( job.sample_rate ) )
+	{
+		job.status = status_bad_rate;
+		return;
+	}
+
+	Register_Log log;
+	if ( !job.log_path || !log.load( job.log_path ) )
+	{
+		job.status = status_bad_log;
+		return;
+	}
+
+	log.replay_overrides( job.sample_rate, job.expansions );
+	job.sample_rate_out = job.sample_rate ? job.sample_rate : log.sample_rate();
+
+	Simple_Apu* apu = new (std::nothrow) Simple_Apu;
+	if ( !apu )
+	{
+		job.status = status_no_memory;
+		return;
+	}
+
+	FILE* file = NULL;
+	if ( job.wav_path )
+	{
+		file = fopen( job.wav_path, "wb" );
+		if ( !file || !write_wav_header( file, 0, 1, 0 ) ) // Rewritten at the end.
+			job.status = status_bad_file;
+	}
+
+	// Grown to the largest frame, read_samples() has to take a whole frame at once.
+	std::vector<sample_t> frame;
+	bool full = false;
+	int status = 1;
+
+	while ( job.status == status_pending && (status = log.replay_frame( *apu )) > 0 )
+	{
+		long count = apu->samples_avail();
+		int channels = apu->is_stereo() ? 2 : 1;
+		long values = count * channels;
+		job.channels = channels;
+
+		if ( frame.size() < (size_t) values + 1 )
+		{
+			try { frame.resize( values + 1 ); }
+			catch ( ... ) { job.status = status_no_memory; break; }
+		}
+
+		sample_t* buf = &frame [0];
+		apu->read_samples( buf, count );
+
+		if ( file && values && fwrite( buf, sizeof( sample_t ), values, file ) != (size_t) values )
+			job.status = status_bad_file;
+
+		if ( job.out && !full )
+		{
+			long n = job.out_size - job.samples;
+			if ( n > values )
+				n = values;
+			memcpy( job.out + job.samples, buf, n * sizeof( sample_t ) );
+			full = n < values;
+			job.samples += n;
+		}
+		else if ( !job.out )
+		{
+			job.samples += values;
+		}
+	}
+
+	if ( status < 0 && job.status == status_pending )
+		job.status = status_bad_log;
+
+	if ( file )
+	{
+		if ( job.status == status_pending )
+		{
+			long written = ftell( file ) / (long) sizeof( sample_t ) - 22; // Minus the 44 bytes of header.
+			if ( fseek( file, 0, SEEK_SET ) || !write_wav_header( file, job.sample_rate_out, job.channels ? job.channels : 1, written ) )
+				job.status = status_bad_file;
+		}
+
+		if ( fclose( file ) && job.status == status_pending )
+			job.status = status_bad_file;
+	}
+
+	if ( job.status == status_pending )
+		job.status = full ? status_truncated : status_ok;
+
+	delete apu;
+}
+
+inline bool Batch_Render::write_wav_header( FILE* file, long sample_rate, int channels, long samples )
+{
+	long data_size = samples * 2;
+	long byte_rate = sample_rate * channels * 2;
+	unsigned char h [44] =
+	{
+		'R','I','F','F', 0,0,0,0, 'W','A','V','E',
+		'f','m','t',' ', 16,0,0,0, 1,0, 0,0, 0,0,0,0, 0,0,0,0, 0,0, 16,0,
+		'd','a','t','a', 0,0,0,0
+	};
+
+	unsigned long riff_size = (unsigned long) data_size + 36;
+	for ( int i = 0; i < 4; i++ )
+	{
+		h [ 4 + i] = (unsigned char) (riff_size >> (i * 8));
+		h [24 + i] = (unsigned char) ((unsigned long) sample_rate >> (i * 8));
+		h [28 + i] = (unsigned char) ((unsigned long) byte_rate >> (i * 8));
+		h [40 + i] = (unsigned char) ((unsigned long) data_size >> (i * 8));
+	}
+	h [22] = (unsigned char) channels;
+	h [32] = (unsigned char) (channels * 2);
+
+	return fwrite( h, sizeof h, 1, file ) == 1;
+}
+
+#endif
@@ -1,3 +1,12 @@
+// Standard headers first, blargg_common.h defines min/max/abs macros.
+#include <deque>
+#include <string>
+#include <vector>
+#include "Batch_Render.h"
+#include "Oscilloscope.h"
+#include "Resampler.h"
+#include "Sample_Ring.h"
+#include "Register_Log.h" // Includes Simple_Apu.h.
 #include "Simple_Apu.h"
 
 #if defined(LINUX) || defined(__clang__)
@@ -13,11 +22,25 @@
 // 2+ = WAV/Video export, one for each potential thread.
 static Simple_Apu apu[2 + NUM_WAV_EXPORT_APU];
 
+// Output rings for the song/instrument players when they use an emulation thread.
+static Sample_Ring ring[2];
+
+// Frames too large for a single ring block are rendered here first.
+static std::vector<blip_sample_t> ring_scratch[2];
+
+// Register log capture and replay, see NesApuStartCapture/NesApuReplayOpen. Everything 
+// that changes the state of an APU is recorded while capturing.
+static Register_Log* capture[2 + NUM_WAV_EXPORT_APU];
+static Register_Log* replay[2 + NUM_WAV_EXPORT_APU];
+
 extern "C" int __stdcall NesApuInit(int apuIdx, int sampleRate, int bass_freq, int pal, int seperate_tnd, int expansions, int (__cdecl *dmcReadFunc)(void* user_data, cpu_addr_t))
 {
 	if (apu[apuIdx].sample_rate(sampleRate, pal, seperate_tnd))
 		return -1;
 
+	if (capture[apuIdx])
+		capture[apuIdx]->init(sampleRate, bass_freq, pal != 0, seperate_tnd, expansions);
+
 	apu[apuIdx].set_audio_expansions(expansions);
 	apu[apuIdx].dmc_reader(dmcReadFunc, (void*)apuIdx);
 	apu[apuIdx].bass_freq(0, bass_freq); // Any non FDS value will do for initialisation.
@@ -28,6 +51,9 @@ extern "C" int __stdcall NesApuInit(int apuIdx, int sampleRate, int bass_freq, i
 extern "C" void __stdcall NesApuWriteRegister(int apuIdx, unsigned int addr, int data)
 {
 	apu[apuIdx].write_register(addr, data);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->write(addr, data);
 }
 
 extern "C" int __stdcall NesApuSamplesAvailable(int apuIdx)
@@ -53,26 +79,41 @@ extern "C" int __stdcall NesApuReadStatus(int apuIdx)
 extern "C" void __stdcall NesApuEndFrame(int apuIdx)
 {
 	apu[apuIdx].end_frame();
+
+	if (capture[apuIdx])
+		capture[apuIdx]->end_frame();
 }
 
 extern "C" void __stdcall NesApuReset(int apuIdx)
 {
 	apu[apuIdx].reset();
+
+	if (capture[apuIdx])
+		capture[apuIdx]->reset();
 }
 
 extern "C" void __stdcall NesApuEnableChannel(int apuIdx, int exp, int idx, int enable)
 {
 	apu[apuIdx].enable_channel(exp, idx, enable != 0);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->enable_channel(exp, idx, enable != 0);
 }
 
 extern "C" void __stdcall NesApuStartSeeking(int apuIdx)
 {
 	apu[apuIdx].start_seeking();
+
+	if (capture[apuIdx])
+		capture[apuIdx]->start_seeking();
 }
 
 extern "C" void __stdcall NesApuStopSeeking(int apuIdx)
 {
 	apu[apuIdx].stop_seeking();
+
+	if (capture[apuIdx])
+		capture[apuIdx]->stop_seeking();
 }
 
 extern "C" int __stdcall NesApuIsSeeking(int apuIdx)
@@ -83,11 +124,17 @@ extern "C" int __stdcall NesApuIsSeeking(int apuIdx)
 extern "C" void __stdcall NesApuTrebleEq(int apuIdx, int expansion, double treble_amount, int treble_freq, int sample_rate)
 {
 	apu[apuIdx].treble_eq(expansion, treble_amount, treble_freq, sample_rate);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->treble_eq(expansion, treble_amount, treble_freq, sample_rate);
 }
 
 extern "C" void __stdcall NesApuBassFilter(int apuIdx, int expansion, int bass_freq)
 {
 	apu[apuIdx].bass_freq(expansion, bass_freq);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->bass_freq(expansion, bass_freq);
 }
 
 extern "C" int __stdcall NesApuGetAudioExpansions(int apuIdx)
@@ -98,10 +145,46 @@ extern "C" int __stdcall NesApuGetAudioExpansions(int apuIdx)
 extern "C" void __stdcall NesApuSetExpansionVolume(int apuIdx, int expansion, double volume)
 {
 	apu[apuIdx].set_expansion_volume(expansion, volume);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->expansion_volume(expansion, volume);
+}
+
+extern "C" void __stdcall NesApuSetBusPan(int apuIdx, int expansion, double pan)
+{
+	apu[apuIdx].set_bus_pan(expansion, pan);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->bus_pan(expansion, pan);
+}
+
+extern "C" void __stdcall NesApuSetStereo(int apuIdx, int stereo)
+{
+	apu[apuIdx].set_stereo(stereo != 0);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->stereo(stereo != 0);
+}
+
+extern "C" void __stdcall NesApuSetChannelMix(int apuIdx, int expansion, int index, double volume, double pan)
+{
+	apu[apuIdx].set_channel_mix(expansion, index, volume, pan);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->channel_mix(expansion, index, volume, pan);
+}
+
+// Stem of one expansion bus for the last NesApuReadSamples call, in the same format (see Simple_Apu::read_bus_samples).
+extern "C" int __stdcall NesApuReadBusSamples(int apuIdx, int expansion, blip_sample_t* buffer, int size)
+{
+	return apu[apuIdx].read_bus_samples(expansion, buffer, size);
 }
 
 extern "C" int __stdcall NesApuSkipCycles(int apuIdx, int cycles)
 {
+	if (capture[apuIdx])
+		capture[apuIdx]->skip_cycles(cycles);
+
 	return apu[apuIdx].skip_cycles(cycles);
 }
 
@@ -132,5 +215,360 @@ extern "C" int __stdcall NesApuGetChannelTrigger(int apuIdx, int exp, int idx)
 
 extern "C" void __stdcall NesApuSetN163Mix(int apuIdx, int mix)
 {
+	if (capture[apuIdx])
+		capture[apuIdx]->namco_mix(mix != 0);
+
 	return apu[apuIdx].set_namco_mix(mix);
 }
+
+extern "C" void __stdcall NesApuSetDmcMemory(int apuIdx, int bank, unsigned int addr, const unsigned char* data, int size)
+{
+	apu[apuIdx].set_dmc_memory(bank, addr, data, size);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->dmc_memory(bank, addr, data, size);
+}
+
+extern "C" void __stdcall NesApuSelectDmcBank(int apuIdx, int bank)
+{
+	apu[apuIdx].select_dmc_bank(bank);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->select_dmc_bank(bank);
+}
+
+extern "C" void __stdcall NesApuSetDmcBankRegister(int apuIdx, unsigned int addr)
+{
+	apu[apuIdx].set_dmc_bank_register(addr);
+
+	if (capture[apuIdx])
+		capture[apuIdx]->dmc_bank_register(addr);
+}
+
+extern "C" int __stdcall NesApuAddKeyframe(int apuIdx, int frame)
+{
+	return apu[apuIdx].add_keyframe(frame);
+}
+
+extern "C" int __stdcall NesApuFindKeyframe(int apuIdx, int frame)
+{
+	return apu[apuIdx].find_keyframe(frame);
+}
+
+extern "C" int __stdcall NesApuLoadKeyframe(int apuIdx, int frame)
+{
+	return apu[apuIdx].load_keyframe(frame);
+}
+
+extern "C" void __stdcall NesApuClearKeyframes(int apuIdx)
+{
+	apu[apuIdx].clear_keyframes();
+}
+
+extern "C" int __stdcall NesApuRingInit(int apuIdx, int capacity)
+{
+	return ring[apuIdx].init(capacity);
+}
+
+extern "C" void __stdcall NesApuRingReset(int apuIdx)
+{
+	ring[apuIdx].reset();
+}
+
+extern "C" void __stdcall NesApuRingClose(int apuIdx)
+{
+	ring[apuIdx].close();
+}
+
+extern "C" int __stdcall NesApuRingSamplesAvailable(int apuIdx)
+{
+	return ring[apuIdx].samples_avail();
+}
+
+extern "C" int __stdcall NesApuRingWaitSpace(int apuIdx, int count, int timeoutMs)
+{
+	return ring[apuIdx].wait_space(count, timeoutMs);
+}
+
+extern "C" int __stdcall NesApuRingWaitSamples(int apuIdx, int count, int timeoutMs)
+{
+	return ring[apuIdx].wait_samples(count, timeoutMs);
+}
+
+// Renders all available APU samples straight into the ring, returns the number of values written.
+extern "C" int __stdcall NesApuRingWriteSamples(int apuIdx)
+{
+	long count = apu[apuIdx].samples_avail();
+	long total = count * (apu[apuIdx].is_stereo() ? 2 : 1);
+
+	// Simple_Apu::read_samples() has to take the whole frame at once. Frames at high sample
+	// rates do not fit in a single block, they are rendered aside and copied in.
+	if (total > Sample_Ring::max_write && ring[apuIdx].space_avail() >= total)
+	{
+		std::vector<blip_sample_t>& scratch = ring_scratch[apuIdx];
+		if (scratch.size() < (size_t)total)
+			scratch.resize(total);
+
+		apu[apuIdx].read_samples(&scratch[0], count);
+		return ring[apuIdx].write(&scratch[0], total);
+	}
+
+	blip_sample_t* p = ring[apuIdx].begin_write(total);
+
+	// Ring is full, this should not happen since the player waits for space, drop the frame.
+	if (!p)
+	{
+		apu[apuIdx].read_samples(NULL, count);
+		ring[apuIdx].drop(total);
+		return 0;
+	}
+
+	apu[apuIdx].read_samples(p, count);
+	ring[apuIdx].end_write(total);
+
+	return total;
+}
+
+extern "C" int __stdcall NesApuRingDroppedSamples(int apuIdx)
+{
+	return ring[apuIdx].dropped_samples();
+}
+
+extern "C" int __stdcall NesApuRingWrite(int apuIdx, const blip_sample_t* data, int count)
+{
+	return ring[apuIdx].write(data, count);
+}
+
+// Waits up to "timeoutMs" for any data, then reads at most "count" values. Returns -1 once the ring is closed and empty.
+extern "C" int __stdcall NesApuRingRead(int apuIdx, blip_sample_t* data, int count, int timeoutMs)
+{
+	if (ring[apuIdx].wait_samples(1, timeoutMs) < 0 && ring[apuIdx].samples_avail() == 0)
+		return -1;
+
+	return ring[apuIdx].read(data, count);
+}
+
+extern "C" void __stdcall NesApuGetFrameTelemetry(int apuIdx, Simple_Apu::frame_telemetry_t* out)
+{
+	apu[apuIdx].get_frame_telemetry(out);
+}
+
+extern "C" int __stdcall NesApuSetTelemetryCapture(int apuIdx, int count)
+{
+	return apu[apuIdx].set_telemetry_capture(count);
+}
+
+extern "C" int __stdcall NesApuReadTelemetry(int apuIdx, Simple_Apu::frame_telemetry_t* out, int count)
+{
+	return apu[apuIdx].read_telemetry(out, count);
+}
+
+extern "C" int __stdcall NesApuSetTriggerLogs(int apuIdx, int count)
+{
+	return apu[apuIdx].set_trigger_logs(count);
+}
+
+extern "C" int __stdcall NesApuReadTriggerLog(int apuIdx, int exp, int idx, int* out, int count)
+{
+	return apu[apuIdx].read_trigger_log(exp, idx, out, count);
+}
+
+// Not tied to any APU, builds the oscilloscope geometry for the live view and video export.
+extern "C" int __stdcall NesApuOscilloscopeVertices(const short* wav, int size, int circular, int start, int count, int maxPoints, float scale, float* vertices, int* peak)
+{
+	return osc_build_vertices(wav, size, circular != 0, start, count, maxPoints, scale, vertices, peak);
+}
+
+// Not tied to any APU either, converts interleaved samples from one rate to another.
+// Returns the number of frames written, at most 'outCount'.
+extern "C" int __stdcall NesApuResample(const short* in, int inCount, int inRate, short* out, int outCount, int outRate, int channels)
+{
+	Polyphase_Resampler resampler;
+	if (channels <= 0 || !resampler.setup(inRate, outRate))
+		return 0;
+
+	long count = resampler.out_count(inCount);
+	if (count > outCount)
+		count = outCount;
+
+	resampler.resample(in, inCount, channels, out, count);
+	return (int)count;
+}
+
+// Starts recording every call that changes the state of the APU to a file, until
+// NesApuStopCapture. Must be called between songs, before NesApuInit, for the log
+// to replay correctly. The DPCM memory already loaded is recorded first, since the
+// app only uploads a sample when it changes. Loading keyframes cannot be recorded,
+// seek with the APU instead while capturing. Returns 0 on success.
+extern "C" int __stdcall NesApuStartCapture(int apuIdx, const char* path)
+{
+	if (!capture[apuIdx])
+	{
+		capture[apuIdx] = new Register_Log;
+		if (!capture[apuIdx])
+			return -1;
+	}
+
+	if (!capture[apuIdx]->open(path))
+	{
+		delete capture[apuIdx];
+		capture[apuIdx] = NULL;
+		return -1;
+	}
+
+	const Simple_Apu& a = apu[apuIdx];
+	for (int i = 0; i < Simple_Apu::max_dmc_banks; i++)
+	{
+		cpu_addr_t addr;
+		int size;
+		const unsigned char* data = a.dmc_memory(i, &addr, &size);
+		if (size)
+			capture[apuIdx]->dmc_memory(i, addr, data, size);
+	}
+
+	if (a.dmc_bank_register())
+		capture[apuIdx]->dmc_bank_register(a.dmc_bank_register());
+	if (a.dmc_bank())
+		capture[apuIdx]->select_dmc_bank(a.dmc_bank());
+
+	return 0;
+}
+
+// Returns 0 if the whole capture was written successfully.
+extern "C" int __stdcall NesApuStopCapture(int apuIdx)
+{
+	if (!capture[apuIdx])
+		return -1;
+
+	bool success = capture[apuIdx]->close();
+	delete capture[apuIdx];
+	capture[apuIdx] = NULL;
+
+	return success ? 0 : -1;
+}
+
+// Opens a register log to drive the APU with. Returns the number of frames in the log, or -1 on error.
+extern "C" int __stdcall NesApuReplayOpen(int apuIdx, const char* path)
+{
+	if (!replay[apuIdx])
+	{
+		replay[apuIdx] = new Register_Log;
+		if (!replay[apuIdx])
+			return -1;
+	}
+
+	if (!replay[apuIdx]->load(path))
+	{
+		delete replay[apuIdx];
+		replay[apuIdx] = NULL;
+		return -1;
+	}
+
+	return replay[apuIdx]->frame_count();
+}
+
+// Replays the log up to the end of the next frame, the samples can then be read as usual.
+// Returns 1 if a frame was ended, 0 at the end of the log and -1 on error.
+extern "C" int __stdcall NesApuReplayFrame(int apuIdx)
+{
+	if (!replay[apuIdx])
+		return -1;
+
+	return replay[apuIdx]->replay_frame(apu[apuIdx]);
+}
+
+extern "C" void __stdcall NesApuReplayClose(int apuIdx)
+{
+	delete replay[apuIdx];
+	replay[apuIdx] = NULL;
+}
+
+// Profiling counters (see Simple_Apu::stats_t), for a per-chip cost breakdown of exports.
+extern "C" void __stdcall NesApuEnableStats(int apuIdx, int enable)
+{
+	apu[apuIdx].enable_stats(enable != 0);
+}
+
+extern "C" void __stdcall NesApuGetStats(int apuIdx, Simple_Apu::stats_t* stats)
+{
+	apu[apuIdx].get_stats(stats);
+}
+
+extern "C" void __stdcall NesApuResetStats(int apuIdx)
+{
+	apu[apuIdx].reset_stats();
+}
+
+// Batch rendering of register logs (see Batch_Render.h), independent of the APUs above.
+// Each batch has its own pool of threads and keeps its jobs until it is destroyed, the
+// output buffers must stay valid (pinned) until NesApuBatchWait returns.
+struct Batch
+{
+	Batch_Render render;
+	std::deque<Batch_Render::job_t> jobs;
+	std::deque<std::string> paths;
+};
+
+extern "C" void* __stdcall NesApuBatchCreate(int threadCount)
+{
+	Batch* batch = new (std::nothrow) Batch;
+	if (batch && !batch->render.start(threadCount))
+	{
+		delete batch;
+		batch = NULL;
+	}
+
+	return batch;
+}
+
+// Returns the index of the job, or -1 if the sample rate is out of range. A NULL buffer or
+// wave path skips that output.
+extern "C" int __stdcall NesApuBatchSubmit(void* handle, const char* logPath, int sampleRate, int expansions, blip_sample_t* buffer, int bufferSize, const char* wavPath)
+{
+	Batch* batch = (Batch*)handle;
+
+	if (!Batch_Render::valid_sample_rate(sampleRate))
+		return -1;
+
+	batch->paths.push_back(logPath ? logPath : "");
+	const char* log = batch->paths.back().c_str();
+	batch->paths.push_back(wavPath ? wavPath : "");
+	const char* wav = wavPath ? batch->paths.back().c_str() : NULL;
+
+	Batch_Render::job_t job;
+	memset(&job, 0, sizeof(job));
+	job.log_path = log;
+	job.sample_rate = sampleRate;
+	job.expansions = expansions;
+	job.out = buffer;
+	job.out_size = buffer ? bufferSize : 0;
+	job.wav_path = wav;
+
+	batch->jobs.push_back(job);
+	batch->render.submit(&batch->jobs.back());
+
+	return (int)batch->jobs.size() - 1;
+}
+
+// Waits for all the jobs submitted so far, returns how many of them failed.
+extern "C" int __stdcall NesApuBatchWait(void* handle)
+{
+	return ((Batch*)handle)->render.wait();
+}
+
+// Status of a job once waited for, see Batch_Render::status_ok and the others.
+extern "C" int __stdcall NesApuBatchGetResult(void* handle, int job, int* samples, int* channels, int* sampleRate)
+{
+	Batch_Render::job_t& j = ((Batch*)handle)->jobs[job];
+
+	*samples = (int)j.samples;
+	*channels = j.channels;
+	*sampleRate = (int)j.sample_rate_out;
+
+	return j.status;
+}
+
+extern "C" void __stdcall NesApuBatchDestroy(void* handle)
+{
+	delete (Batch*)handle;
+}
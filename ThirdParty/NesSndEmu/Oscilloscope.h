@@ -0,0 +1,229 @@
+
+// Oscilloscope geometry, shared by the live oscilloscope and the video export.
+
+#ifndef OSCILLOSCOPE_H
+#define OSCILLOSCOPE_H
+
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define OSCILLOSCOPE_SSE2 1
+#endif
+
+// Calls f(ptr, len, pos) for each contiguous piece of samples [start, start + count),
+// 'pos' being relative to 'start'. A circular buffer wraps around, otherwise the pieces
+// that fall outside of the buffer are passed as NULL and are meant to be read as zeros.
+template <class F>
+inline void osc_for_each_span(const short* wav, int size, bool circular, int start, int count, F f)
+{
+	int pos = 0;
+
+	if (circular)
+	{
+		int idx = start % size;
+		if (idx < 0)
+			idx += size;
+
+		while (pos < count)
+		{
+			int n = count - pos < size - idx ? count - pos : size - idx;
+			f(wav + idx, n, pos);
+			pos += n;
+			idx = 0;
+		}
+	}
+	else
+	{
+		while (pos < count)
+		{
+			int idx = start + pos;
+			int n = count - pos;
+
+			if (idx < 0)
+			{
+				if (n > -idx) n = -idx;
+				f((const short*)NULL, n, pos);
+			}
+			else if (idx >= size)
+			{
+				f((const short*)NULL, n, pos);
+			}
+			else
+			{
+				if (n > size - idx) n = size - idx;
+				f(wav + idx, n, pos);
+			}
+
+			pos += n;
+		}
+	}
+}
+
+inline void osc_min_max(const short* p, int n, int& lo, int& hi)
+{
+	int i = 0;
+
+	if (!p)
+	{
+		if (lo > 0) lo = 0;
+		if (hi < 0) hi = 0;
+		return;
+	}
+
+#if OSCILLOSCOPE_SSE2
+	if (n >= 8)
+	{
+		__m128i vlo = _mm_set1_epi16((short)lo);
+		__m128i vhi = _mm_set1_epi16((short)hi);
+
+		for (; i + 8 <= n; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+			vlo = _mm_min_epi16(vlo, v);
+			vhi = _mm_max_epi16(vhi, v);
+		}
+
+		short los[8];
+		short his[8];
+		_mm_storeu_si128((__m128i*)los, vlo);
+		_mm_storeu_si128((__m128i*)his, vhi);
+
+		for (int j = 0; j < 8; j++)
+		{
+			if (los[j] < lo) lo = los[j];
+			if (his[j] > hi) hi = his[j];
+		}
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		if (p[i] < lo) lo = p[i];
+		if (p[i] > hi) hi = p[i];
+	}
+}
+
+inline float osc_clamp(float y)
+{
+	return y < -1.0f ? -1.0f : (y > 1.0f ? 1.0f : y);
+}
+
+// Writes the vertices of samples 'pos' to 'pos + n'.
+inline void osc_convert(const short* p, int n, int pos, float x_scale, float y_scale, float* out)
+{
+	int i = 0;
+	out += pos * 2;
+
+#if OSCILLOSCOPE_SSE2
+	const __m128 ramp  = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	const __m128 xs    = _mm_set1_ps(x_scale);
+	const __m128 ys    = _mm_set1_ps(y_scale);
+	const __m128 one   = _mm_set1_ps(1.0f);
+	const __m128 m_one = _mm_set1_ps(-1.0f);
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 x = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)(pos + i)), ramp), xs);
+		__m128 y = _mm_setzero_ps();
+
+		if (p)
+		{
+			__m128i v = _mm_loadl_epi64((const __m128i*)(p + i));
+			v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			y = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), ys), one), m_one);
+		}
+
+		_mm_storeu_ps(out + i * 2 + 0, _mm_unpacklo_ps(x, y));
+		_mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(x, y));
+	}
+#endif
+
+	for (; i < n; i++)
+	{
+		out[i * 2 + 0] = (pos + i) * x_scale;
+		out[i * 2 + 1] = p ? osc_clamp(p[i] * y_scale) : 0.0f;
+	}
+}
+
+// Builds ready-to-draw (x, y) vertices, x in [0, 1] and y in [-1, 1], from 'count' samples
+// of 'wav' starting at 'start'. When there are more samples than 'max_points' (0 = no limit),
+// the samples are split in max_points / 2 groups, each reduced to its min and max in the
+// order they happened. Returns the number of vertices, 'peak' gets the largest magnitude.
+inline int osc_build_vertices(const short* wav, int size, bool circular, int start, int count, int max_points, float scale, float* out, int* peak)
+{
+	int lo = 32767;
+	int hi = -32768;
+	int num_vertices;
+	float y_scale = scale / 32768.0f;
+
+	if (count <= 0 || size <= 0)
+	{
+		*peak = 0;
+		return 0;
+	}
+
+	if (max_points < 4 || count <= max_points)
+	{
+		float x_scale = count > 1 ? 1.0f / (count - 1) : 0.0f;
+
+		osc_for_each_span(wav, size, circular, start, count, [&](const short* p, int n, int pos)
+		{
+			osc_min_max(p, n, lo, hi);
+			osc_convert(p, n, pos, x_scale, y_scale, out);
+		});
+
+		num_vertices = count;
+	}
+	else
+	{
+		int groups = max_points / 2;
+		float x_scale = 1.0f / (groups - 1);
+
+		for (int g = 0; g < groups; g++)
+		{
+			int g0 = (int)((long long)count * g / groups);
+			int g1 = (int)((long long)count * (g + 1) / groups);
+			int glo = 32767;
+			int ghi = -32768;
+
+			osc_for_each_span(wav, size, circular, start + g0, g1 - g0, [&](const short* p, int n, int pos)
+			{
+				osc_min_max(p, n, glo, ghi);
+			});
+
+			// Keep the extremes in the order they happened, so the shape of the wave is preserved.
+			bool found = false;
+			bool hi_first = false;
+
+			osc_for_each_span(wav, size, circular, start + g0, g1 - g0, [&](const short* p, int n, int pos)
+			{
+				for (int i = 0; i < n && !found; i++)
+				{
+					int v = p ? p[i] : 0;
+					if (v == ghi) { found = true; hi_first = true; }
+					else if (v == glo) { found = true; }
+				}
+			});
+
+			int first  = hi_first ? ghi : glo;
+			int second = hi_first ? glo : ghi;
+
+			out[g * 4 + 0] = g * x_scale;
+			out[g * 4 + 1] = osc_clamp(first * y_scale);
+			out[g * 4 + 2] = g * x_scale;
+			out[g * 4 + 3] = osc_clamp(second * y_scale);
+
+			if (glo < lo) lo = glo;
+			if (ghi > hi) hi = ghi;
+		}
+
+		num_vertices = groups * 2;
+	}
+
+	*peak = hi > -lo ? hi : -lo;
+
+	return num_vertices;
+}
+
+#endif
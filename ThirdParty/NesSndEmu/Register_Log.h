@@ -0,0 +1,790 @@
+
+// Register log, a recording of every call made to a Simple_Apu (initialization, mixer
+// settings, register writes, frame ends, etc.) that can be replayed bit-exactly later.
+
+#ifndef REGISTER_LOG_H
+#define REGISTER_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include "Simple_Apu.h"
+
+// File layout : "NSRL" tag, 32-bit version, then one record per call. Each record is
+// an opcode byte followed by its arguments, all little-endian.
+class Register_Log {
+public:
+	enum { version = 1 };
+
+	enum {
+		op_init              = 1,  // u32 sample rate, u16 bass freq, u8 pal, u8 tnd mode, u8 expansions
+		op_reset             = 2,
+		op_write             = 3,  // u16 addr, u8 data
+		op_end_frame         = 4,
+		op_skip_cycles       = 5,  // u32 cycles
+		op_treble_eq         = 6,  // u8 expansion, f64 amount, u32 freq, u32 sample rate
+		op_bass_freq         = 7,  // u8 expansion, u32 freq
+		op_expansion_volume  = 8,  // u8 expansion, f64 volume
+		op_namco_mix         = 9,  // u8 mix
+		op_enable_channel    = 10, // u8 expansion, u8 index, u8 enable
+		op_dmc_memory        = 11, // u8 bank, u16 addr, u32 size, data
+		op_dmc_bank_register = 12, // u16 addr
+		op_select_dmc_bank   = 13, // u8 bank
+		op_start_seeking     = 14,
+		op_stop_seeking      = 15,
+		op_bus_pan           = 16, // u8 expansion, f64 pan
+		op_stereo            = 17, // u8 stereo
+		op_channel_mix       = 18, // u8 expansion, u8 index, f64 volume, f64 pan
+	};
+
+	enum { header_size = 8 };
+
+	Register_Log();
+	~Register_Log();
+
+	// Recording. Every call appends a record, mirroring the Simple_Apu function of the same name.
+	void init( long sample_rate, int bass_freq, bool pal, int tnd_mode, int expansions );
+	void reset();
+	void write( cpu_addr_t addr, int data );
+	void end_frame();
+	void skip_cycles( long cycles );
+	void treble_eq( int exp, double amount, int freq, int sample_rate );
+	void bass_freq( int exp, int freq );
+	void expansion_volume( int exp, double volume );
+	void namco_mix( bool mix );
+	void enable_channel( int exp, int idx, bool enable );
+	void dmc_memory( int bank, cpu_addr_t addr, const unsigned char* data, int size );
+	void dmc_bank_register( cpu_addr_t addr );
+	void select_dmc_bank( int bank );
+	void start_seeking();
+	void stop_seeking();
+	void bus_pan( int exp, double pan );
+	void stereo( bool stereo );
+	void channel_mix( int exp, int idx, double volume, double pan );
+
+	// Empties the log, keeps the memory.
+	void clear();
+
+	// False if a record could not be added because of an allocation failure, or if
+	// writing to the capture file failed.
+	bool is_ok() const { return ok; }
+	long size() const { return buf_size; }
+	const unsigned char* data() const { return buf; }
+
+	// Returns false on error, a loaded log that is not valid is left empty. The file is
+	// memory-mapped when possible, it must not be modified while it is loaded.
+	bool save( const char* path ) const;
+	bool load( const char* path );
+
+	// Capture to a file, for long sessions. The records are written to the file every
+	// time 'flush_size' bytes have accumulated, at the end of a frame, so the log itself
+	// never grows past that. close() writes what is left and returns false on error.
+	enum { flush_size = 1024 * 1024 };
+	bool open( const char* path );
+	bool close();
+	bool is_open() const { return file != NULL; }
+
+	// Playback. Applies the records up to and including the next end of frame. Returns 1
+	// if a frame was ended, 0 at the end of the log and -1 if the log is corrupt (a
+	// record out of range for the APU included) or the APU could not be initialized.
+	void rewind() { play_pos = 0; }
+	enum { max_frame_cycles = 33248 }; // Longest frame (PAL), a played frame cannot go past it.
+	int replay_frame( Simple_Apu& apu );
+
+	// Replays the init records with another sample rate (0 keeps the one of the log) or
+	// other expansions (-1 keeps the ones of the log).
+	void replay_overrides( long sample_rate, int expansions ) { replay_rate = sample_rate; replay_expansions = expansions; }
+
+	// Information gathered while recording or by load(), the last init record wins.
+	int frame_count() const { return frames; }
+	long sample_rate() const { return init_rate; }
+	int expansions() const { return init_expansions; }
+	bool is_stereo() const { return init_stereo || (init_expansions & Simple_Apu::expansion_mask_epsm) != 0; }
+
+private:
+	unsigned char* buf;
+	long buf_size;
+	long buf_capacity;
+	long play_pos;
+	bool ok;
+	int frames;
+	long init_rate;
+	int init_expansions;
+	bool init_stereo;
+	long replay_rate;
+	int replay_expansions;
+	FILE* file;
+
+	// Mapped file, 'buf' then points right after the header.
+	void* map_view;
+	long map_size;
+#if defined(_WIN32)
+	HANDLE map_handle;
+#endif
+
+	unsigned char* grow( long count );
+	void flush();
+	bool map( const char* path );
+	void unmap();
+	void put8 ( unsigned char* p, int v ) { p [0] = (unsigned char) v; }
+	void put16( unsigned char* p, int v ) { p [0] = (unsigned char) v; p [1] = (unsigned char) (v >> 8); }
+	void put32( unsigned char* p, unsigned long v ) { put16( p, (int) (v & 0xffff) ); put16( p + 2, (int) (v >> 16) ); }
+	void put64( unsigned char* p, double v );
+	int get16( const unsigned char* p ) const { return p [0] | (p [1] << 8); }
+	unsigned long get32( const unsigned char* p ) const { return (unsigned long) get16( p ) | ((unsigned long) get16( p + 2 ) << 16); }
+	double get64( const unsigned char* p ) const;
+	long record_size( long pos ) const;
+	bool scan();
+	static bool valid_channel( int exp, int idx ) { return idx < Simple_Apu::channel_count( exp ); }
+
+	// noncopyable
+	Register_Log( const Register_Log& );
+	Register_Log& operator = ( const Register_Log& );
+};
+
+inline Register_Log::Register_Log()
+{
+	buf = NULL;
+	buf_size = 0;
+	buf_capacity = 0;
+	play_pos = 0;
+	ok = true;
+	frames = 0;
+	init_rate = 0;
+	init_expansions = 0;
+	init_stereo = false;
+	replay_rate = 0;
+	replay_expansions = -1;
+	file = NULL;
+	map_view = NULL;
+	map_size = 0;
+}
+
+inline Register_Log::~Register_Log()
+{
+	close();
+
+	if ( map_view )
+		unmap();
+	else
+		free( buf );
+}
+
+inline void Register_Log::clear()
+{
+	if ( map_view )
+		unmap();
+
+	buf_size = 0;
+	play_pos = 0;
+	ok = true;
+	frames = 0;
+	init_rate = 0;
+	init_expansions = 0;
+	init_stereo = false;
+}
+
+inline unsigned char* Register_Log::grow( long count )
+{
+	// Recording after loading a mapped log, bring it back into our own memory first.
+	if ( map_view )
+	{
+		unsigned char* copy = (unsigned char*) malloc( buf_size + count );
+		if ( !copy )
+		{
+			ok = false;
+			return NULL;
+		}
+
+		long size = buf_size;
+		memcpy( copy, buf, size );
+		unmap();
+		buf = copy;
+		buf_size = size;
+		buf_capacity = size + count;
+	}
+
+	if ( buf_size + count > buf_capacity )
+	{
+		long new_capacity = buf_capacity ? buf_capacity * 2 : 65536;
+		while ( new_capacity < buf_size + count )
+			new_capacity *= 2;
+
+		unsigned char* new_buf = (unsigned char*) realloc( buf, new_capacity );
+		if ( !new_buf )
+		{
+			ok = false;
+			return NULL;
+		}
+
+		buf = new_buf;
+		buf_capacity = new_capacity;
+	}
+
+	unsigned char* p = buf + buf_size;
+	buf_size += count;
+	return p;
+}
+
+// Doubles are stored as-is, this assumes a little-endian host.
+inline void Register_Log::put64( unsigned char* p, double v )
+{
+	memcpy( p, &v, 8 );
+}
+
+inline double Register_Log::get64( const unsigned char* p ) const
+{
+	double v;
+	memcpy( &v, p, 8 );
+	return v;
+}
+
+inline void Register_Log::init( long sample_rate, int bass_freq, bool pal, int tnd_mode, int expansions )
+{
+	unsigned char* p = grow( 10 );
+	if ( !p ) return;
+	put8 ( p + 0, op_init );
+	put32( p + 1, (unsigned long) sample_rate );
+	put16( p + 5, bass_freq );
+	put8 ( p + 7, pal );
+	put8 ( p + 8, tnd_mode );
+	put8 ( p + 9, expansions );
+	init_rate = sample_rate;
+	init_expansions = expansions;
+}
+
+inline void Register_Log::reset()
+{
+	unsigned char* p = grow( 1 );
+	if ( !p ) return;
+	put8( p, op_reset );
+}
+
+inline void Register_Log::write( cpu_addr_t addr, int data )
+{
+	unsigned char* p = grow( 4 );
+	if ( !p ) return;
+	put8 ( p + 0, op_write );
+	put16( p + 1, addr );
+	put8 ( p + 3, data );
+}
+
+inline void Register_Log::end_frame()
+{
+	unsigned char* p = grow( 1 );
+	if ( !p ) return;
+	put8( p, op_end_frame );
+	frames++;
+
+	if ( file && buf_size >= flush_size )
+		flush();
+}
+
+inline void Register_Log::skip_cycles( long cycles )
+{
+	unsigned char* p = grow( 5 );
+	if ( !p ) return;
+	put8 ( p + 0, op_skip_cycles );
+	put32( p + 1, (unsigned long) cycles );
+}
+
+inline void Register_Log::treble_eq( int exp, double amount, int freq, int sample_rate )
+{
+	unsigned char* p = grow( 18 );
+	if ( !p ) return;
+	put8 ( p + 0, op_treble_eq );
+	put8 ( p + 1, exp );
+	put64( p + 2, amount );
+	put32( p + 10, (unsigned long) freq );
+	put32( p + 14, (unsigned long) sample_rate );
+}
+
+inline void Register_Log::bass_freq( int exp, int freq )
+{
+	unsigned char* p = grow( 6 );
+	if ( !p ) return;
+	put8 ( p + 0, op_bass_freq );
+	put8 ( p + 1, exp );
+	put32( p + 2, (unsigned long) freq );
+}
+
+inline void Register_Log::expansion_volume( int exp, double volume )
+{
+	unsigned char* p = grow( 10 );
+	if ( !p ) return;
+	put8 ( p + 0, op_expansion_volume );
+	put8 ( p + 1, exp );
+	put64( p + 2, volume );
+}
+
+inline void Register_Log::namco_mix( bool mix )
+{
+	unsigned char* p = grow( 2 );
+	if ( !p ) return;
+	put8( p + 0, op_namco_mix );
+	put8( p + 1, mix );
+}
+
+inline void Register_Log::enable_channel( int exp, int idx, bool enable )
+{
+	unsigned char* p = grow( 4 );
+	if ( !p ) return;
+	put8( p + 0, op_enable_channel );
+	put8( p + 1, exp );
+	put8( p + 2, idx );
+	put8( p + 3, enable );
+}
+
+inline void Register_Log::dmc_memory( int bank, cpu_addr_t addr, const unsigned char* data, int size )
+{
+	unsigned char* p = grow( 8 + size );
+	if ( !p ) return;
+	put8 ( p + 0, op_dmc_memory );
+	put8 ( p + 1, bank );
+	put16( p + 2, addr );
+	put32( p + 4, (unsigned long) size );
+	if ( size )
+		memcpy( p + 8, data, size );
+}
+
+inline void Register_Log::dmc_bank_register( cpu_addr_t addr )
+{
+	unsigned char* p = grow( 3 );
+	if ( !p ) return;
+	put8 ( p + 0, op_dmc_bank_register );
+	put16( p + 1, addr );
+}
+
+inline void Register_Log::select_dmc_bank( int bank )
+{
+	unsigned char* p = grow( 2 );
+	if ( !p ) return;
+	put8( p + 0, op_select_dmc_bank );
+	put8( p + 1, bank );
+}
+
+inline void Register_Log::start_seeking()
+{
+	unsigned char* p = grow( 1 );
+	if ( !p ) return;
+	put8( p, op_start_seeking );
+}
+
+inline void Register_Log::stop_seeking()
+{
+	unsigned char* p = grow( 1 );
+	if ( !p ) return;
+	put8( p, op_stop_seeking );
+}
+
+inline void Register_Log::bus_pan( int exp, double pan )
+{
+	unsigned char* p = grow( 10 );
+	if ( !p ) return;
+	put8 ( p + 0, op_bus_pan );
+	put8 ( p + 1, exp );
+	put64( p + 2, pan );
+}
+
+inline void Register_Log::stereo( bool stereo )
+{
+	unsigned char* p = grow( 2 );
+	if ( !p ) return;
+	put8( p + 0, op_stereo );
+	put8( p + 1, stereo );
+	init_stereo = stereo;
+}
+
+inline void Register_Log::channel_mix( int exp, int idx, double volume, double pan )
+{
+	unsigned char* p = grow( 19 );
+	if ( !p ) return;
+	put8 ( p + 0, op_channel_mix );
+	put8 ( p + 1, exp );
+	put8 ( p + 2, idx );
+	put64( p + 3, volume );
+	put64( p + 11, pan );
+}
+
+// Size of the record at 'pos', or -1 if it is unknown or truncated.
+inline long Register_Log::record_size( long pos ) const
+{
+	long size;
+
+	switch ( buf [pos] )
+	{
+		case op_init:              size = 10; break;
+		case op_reset:             size = 1;  break;
+		case op_write:             size = 4;  break;
+		case op_end_frame:         size = 1;  break;
+		case op_skip_cycles:       size = 5;  break;
+		case op_treble_eq:         size = 18; break;
+		case op_bass_freq:         size = 6;  break;
+		case op_expansion_volume:  size = 10; break;
+		case op_namco_mix:         size = 2;  break;
+		case op_enable_channel:    size = 4;  break;
+		case op_dmc_bank_register: size = 3;  break;
+		case op_select_dmc_bank:   size = 2;  break;
+		case op_start_seeking:     size = 1;  break;
+		case op_stop_seeking:      size = 1;  break;
+		case op_bus_pan:           size = 10; break;
+		case op_stereo:            size = 2;  break;
+		case op_channel_mix:       size = 19; break;
+		case op_dmc_memory:
+			if ( pos + 8 > buf_size || get32( buf + pos + 4 ) > 0x8000 )
+				return -1;
+			size = 8 + (long) get32( buf + pos + 4 );
+			break;
+		default:
+			return -1;
+	}
+
+	return pos + size <= buf_size ? size : -1;
+}
+
+inline bool Register_Log::scan()
+{
+	frames = 0;
+	init_rate = 0;
+	init_expansions = 0;
+	init_stereo = false;
+
+	for ( long pos = 0; pos < buf_size; )
+	{
+		long size = record_size( pos );
+		if ( size < 0 )
+			return false;
+
+		if ( buf [pos] == op_end_frame )
+		{
+			frames++;
+		}
+		else if ( buf [pos] == op_init )
+		{
+			init_rate = (long) get32( buf + pos + 1 );
+			init_expansions = buf [pos + 9];
+		}
+		else if ( buf [pos] == op_stereo )
+		{
+			init_stereo = buf [pos + 1] != 0;
+		}
+
+		pos += size;
+	}
+
+	return true;
+}
+
+inline bool Register_Log::save( const char* path ) const
+{
+	FILE* f = fopen( path, "wb" );
+	if ( !f )
+		return false;
+
+	unsigned char header [header_size] = { 'N', 'S', 'R', 'L', version, 0, 0, 0 };
+	bool success =
+		fwrite( header, sizeof header, 1, f ) == 1 &&
+		(buf_size == 0 || fwrite( buf, buf_size, 1, f ) == 1);
+
+	return fclose( f ) == 0 && success;
+}
+
+inline bool Register_Log::open( const char* path )
+{
+	close();
+	clear();
+
+	file = fopen( path, "wb" );
+	if ( !file )
+		return false;
+
+	unsigned char header [header_size] = { 'N', 'S', 'R', 'L', version, 0, 0, 0 };
+	if ( fwrite( header, sizeof header, 1, file ) != 1 )
+		ok = false;
+
+	return true;
+}
+
+inline void Register_Log::flush()
+{
+	if ( buf_size && fwrite( buf, buf_size, 1, file ) != 1 )
+		ok = false;
+
+	buf_size = 0;
+	play_pos = 0;
+}
+
+inline bool Register_Log::close()
+{
+	if ( !file )
+		return false;
+
+	flush();
+	if ( fclose( file ) != 0 )
+		ok = false;
+	file = NULL;
+
+	return ok;
+}
+
+#if defined(_WIN32)
+
+inline bool Register_Log::map( const char* path )
+{
+	HANDLE f = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( f == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx( f, &size ) || size.QuadPart <= header_size || size.QuadPart > 0x7fffffff )
+	{
+		CloseHandle( f );
+		return false;
+	}
+
+	// The mapping keeps the file open.
+	map_handle = CreateFileMappingA( f, NULL, PAGE_READONLY, 0, 0, NULL );
+	CloseHandle( f );
+	if ( !map_handle )
+		return false;
+
+	map_view = MapViewOfFile( map_handle, FILE_MAP_READ, 0, 0, 0 );
+	if ( !map_view )
+	{
+		CloseHandle( map_handle );
+		return false;
+	}
+
+	map_size = (long) size.QuadPart;
+	return true;
+}
+
+inline void Register_Log::unmap()
+{
+	UnmapViewOfFile( map_view );
+	CloseHandle( map_handle );
+	map_view = NULL;
+	map_size = 0;
+	buf = NULL;
+	buf_size = 0;
+	buf_capacity = 0;
+}
+
+#else
+
+inline bool Register_Log::map( const char* path )
+{
+	int fd = ::open( path, O_RDONLY );
+	if ( fd < 0 )
+		return false;
+
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || st.st_size <= header_size || st.st_size > 0x7fffffff )
+	{
+		::close( fd );
+		return false;
+	}
+
+	// The mapping keeps the file open.
+	void* view = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	::close( fd );
+	if ( view == MAP_FAILED )
+		return false;
+
+	map_view = view;
+	map_size = (long) st.st_size;
+	return true;
+}
+
+inline void Register_Log::unmap()
+{
+	munmap( map_view, map_size );
+	map_view = NULL;
+	map_size = 0;
+	buf = NULL;
+	buf_size = 0;
+	buf_capacity = 0;
+}
+
+#endif
+
+inline bool Register_Log::load( const char* path )
+{
+	clear();
+
+	// Playback reads straight from the mapped file, no copy needed.
+	if ( map( path ) )
+	{
+		const unsigned char* header = (const unsigned char*) map_view;
+		if ( memcmp( header, "NSRL", 4 ) || get32( header + 4 ) != version )
+		{
+			unmap();
+			return false;
+		}
+
+		free( buf );
+		buf = (unsigned char*) map_view + header_size;
+		buf_size = map_size - header_size;
+		buf_capacity = 0;
+
+		if ( !scan() )
+		{
+			clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	FILE* f = fopen( path, "rb" );
+	if ( !f )
+		return false;
+
+	unsigned char header [header_size];
+	bool success = fread( header, sizeof header, 1, f ) == 1 &&
+		!memcmp( header, "NSRL", 4 ) && get32( header + 4 ) == version;
+
+	if ( success )
+	{
+		unsigned char chunk [4096];
+		long count;
+		while ( (count = (long) fread( chunk, 1, sizeof chunk, f )) > 0 )
+		{
+			unsigned char* p = grow( count );
+			if ( !p )
+			{
+				success = false;
+				break;
+			}
+			memcpy( p, chunk, count );
+		}
+	}
+
+	fclose( f );
+
+	if ( !success || !scan() )
+	{
+		clear();
+		return false;
+	}
+
+	return true;
+}
+
+inline int Register_Log::replay_frame( Simple_Apu& apu )
+{
+	unsigned long frame_cycles = 0;
+
+	while ( play_pos < buf_size )
+	{
+		long size = record_size( play_pos );
+		if ( size < 0 )
+			return -1;
+
+		const unsigned char* p = buf + play_pos;
+		play_pos += size;
+
+		switch ( p [0] )
+		{
+			case op_init:
+				if ( p [8] > Simple_Apu::tnd_mode_separate_tn_only || p [9] >= 1 << (Simple_Apu::expansion_count - 1) )
+					return -1;
+				if ( apu.sample_rate( replay_rate ? replay_rate : (long) get32( p + 1 ), p [7] != 0, p [8] ) )
+					return -1;
+				apu.set_audio_expansions( replay_expansions >= 0 ? replay_expansions : p [9] );
+				apu.bass_freq( 0, get16( p + 5 ) ); // Any non FDS value will do for initialisation, like NesApuInit.
+				break;
+			case op_reset:
+				apu.reset();
+				break;
+			case op_write:
+				if ( !apu.is_seeking() && (frame_cycles += 4) > max_frame_cycles ) // See Simple_Apu::clock().
+					return -1;
+				apu.write_register( (cpu_addr_t) get16( p + 1 ), p [3] );
+				break;
+			case op_end_frame:
+				apu.end_frame();
+				return 1;
+			case op_skip_cycles:
+				if ( !apu.is_seeking() && (get32( p + 1 ) > max_frame_cycles || (frame_cycles += get32( p + 1 )) > max_frame_cycles) )
+					return -1;
+				apu.skip_cycles( (long) get32( p + 1 ) );
+				break;
+			case op_treble_eq:
+				if ( p [1] >= Simple_Apu::expansion_count )
+					return -1;
+				apu.treble_eq( p [1], get64( p + 2 ), (int) get32( p + 10 ), (int) get32( p + 14 ) );
+				break;
+			case op_bass_freq:
+				if ( p [1] >= Simple_Apu::expansion_count )
+					return -1;
+				apu.bass_freq( p [1], (int) get32( p + 2 ) );
+				break;
+			case op_expansion_volume:
+				if ( p [1] >= Simple_Apu::expansion_count )
+					return -1;
+				apu.set_expansion_volume( p [1], get64( p + 2 ) );
+				break;
+			case op_namco_mix:
+				apu.set_namco_mix( p [1] != 0 );
+				break;
+			case op_enable_channel:
+				if ( !valid_channel( p [1], p [2] ) )
+					return -1;
+				apu.enable_channel( p [1], p [2], p [3] != 0 );
+				break;
+			case op_dmc_memory:
+				if ( p [1] >= Simple_Apu::max_dmc_banks || get16( p + 2 ) < 0x8000 || get16( p + 2 ) + (long) get32( p + 4 ) > 0x10000 )
+					return -1;
+				apu.set_dmc_memory( p [1], (cpu_addr_t) get16( p + 2 ), p + 8, (int) get32( p + 4 ) );
+				break;
+			case op_dmc_bank_register:
+				apu.set_dmc_bank_register( (cpu_addr_t) get16( p + 1 ) );
+				break;
+			case op_select_dmc_bank:
+				if ( p [1] >= Simple_Apu::max_dmc_banks )
+					return -1;
+				apu.select_dmc_bank( p [1] );
+				break;
+			case op_start_seeking:
+				apu.start_seeking();
+				break;
+			case op_stop_seeking:
+				apu.stop_seeking();
+				break;
+			case op_bus_pan:
+				if ( p [1] >= Simple_Apu::expansion_count )
+					return -1;
+				apu.set_bus_pan( p [1], get64( p + 2 ) );
+				break;
+			case op_stereo:
+				apu.set_stereo( p [1] != 0 );
+				break;
+			case op_channel_mix:
+				if ( !valid_channel( p [1], p [2] ) )
+					return -1;
+				apu.set_channel_mix( p [1], p [2], get64( p + 3 ), get64( p + 11 ) );
+				break;
+		}
+	}
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,180 @@
+
+// Polyphase windowed-sinc resampler, converts a render made at one rate to any other
+// rate. Used for the exports and the sample previews, the emulation itself always runs
+// at the rate it was given.
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define RESAMPLER_SSE2 1
+#endif
+
+class Polyphase_Resampler
+{
+public:
+	// Number of zero crossings on each side of the filter when upsampling, downsampling
+	// widens the filter by the same ratio as it lowers the cutoff.
+	enum { half_taps = 16 };
+	// Fractional positions in the table, the ones in between are interpolated.
+	enum { phase_count = 256 };
+	// Frames converted at once, per channel.
+	enum { block_size = 4096 };
+
+	Polyphase_Resampler() : half(0), taps(0), step(1.0) { }
+
+	// Builds the filter for a conversion, returns false if the rates are invalid.
+	bool setup(long in_rate, long out_rate)
+	{
+		if (in_rate <= 0 || out_rate <= 0)
+			return false;
+
+		step = (double)in_rate / out_rate;
+
+		// Cutoff slightly below the lowest Nyquist frequency, leaves room for the transition band.
+		double cutoff = (step > 1.0 ? 1.0 / step : 1.0) * 0.92;
+		half = (int)ceil(half_taps / cutoff);
+
+		taps = (half * 2 + 3) & ~3; // Multiple of 4 for the SIMD loop, the extra taps are zeros.
+		filter.assign((size_t)(phase_count + 1) * taps, 0.0f);
+
+		for (int p = 0; p <= phase_count; p++)
+		{
+			double frac = (double)p / phase_count;
+			float* row = &filter[(size_t)p * taps];
+
+			// Tap 't' weighs the input frame at 't - half + 1' relative to the integer position.
+			for (int t = 0; t < half * 2; t++)
+			{
+				double x = t - half + 1 - frac;
+				row[t] = (float)(cutoff * sinc(cutoff * x) * kaiser(x / half));
+			}
+		}
+
+		return true;
+	}
+
+	// Number of output frames for 'in_count' input frames.
+	long out_count(long in_count) const
+	{
+		return (long)(in_count / step);
+	}
+
+	// Converts 'in_count' frames of 'channels' interleaved channels to 'out_count' frames,
+	// the input being zeros outside of its range.
+	void resample(const short* in, long in_count, int channels, short* out, long out_count) const
+	{
+		std::vector<float> window;
+
+		for (int c = 0; c < channels; c++)
+		{
+			for (long j0 = 0; j0 < out_count; j0 += block_size)
+			{
+				long j1 = j0 + block_size < out_count ? j0 + block_size : out_count;
+
+				// Input frames read by this block, as floats with zeros outside of the input.
+				long first = (long)floor(j0 * step) - half + 1;
+				long last  = (long)floor((j1 - 1) * step) - half + taps;
+
+				window.resize(last - first + 1);
+				for (long i = first; i <= last; i++)
+					window[i - first] = i >= 0 && i < in_count ? in[i * channels + c] : 0.0f;
+
+				for (long j = j0; j < j1; j++)
+				{
+					double x = j * step;
+					long   i = (long)floor(x);
+					double f = (x - i) * phase_count;
+					int    p = (int)f;
+					float  a = (float)(f - p);
+
+					const float* src = &window[i - (half - 1) - first];
+					const float* c0  = &filter[(size_t)p * taps];
+					const float* c1  = c0 + taps;
+
+					float s0, s1;
+					dot2(src, c0, c1, s0, s1);
+
+					float y = s0 + (s1 - s0) * a;
+					int v = (int)(y < 0.0f ? y - 0.5f : y + 0.5f);
+					out[j * channels + c] = (short)(v < -32768 ? -32768 : (v > 32767 ? 32767 : v));
+				}
+			}
+		}
+	}
+
+private:
+	std::vector<float> filter;
+	int half;
+	int taps;
+	double step;
+
+	static double sinc(double x)
+	{
+		if (fabs(x) < 1e-9)
+			return 1.0;
+		x *= 3.14159265358979323846;
+		return sin(x) / x;
+	}
+
+	// Kaiser window (beta = 8) over [-1, 1].
+	static double kaiser(double x)
+	{
+		if (x <= -1.0 || x >= 1.0)
+			return 0.0;
+		return bessel_i0(8.0 * sqrt(1.0 - x * x)) / bessel_i0(8.0);
+	}
+
+	static double bessel_i0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 32; k++)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	// Both dot products of 'src' with two adjacent phases at once.
+	void dot2(const float* src, const float* c0, const float* c1, float& s0, float& s1) const
+	{
+		int t = 0;
+
+#if RESAMPLER_SSE2
+		__m128 a0 = _mm_setzero_ps();
+		__m128 a1 = _mm_setzero_ps();
+
+		for (; t + 4 <= taps; t += 4)
+		{
+			__m128 v = _mm_loadu_ps(src + t);
+			a0 = _mm_add_ps(a0, _mm_mul_ps(v, _mm_loadu_ps(c0 + t)));
+			a1 = _mm_add_ps(a1, _mm_mul_ps(v, _mm_loadu_ps(c1 + t)));
+		}
+
+		float r0[4];
+		float r1[4];
+		_mm_storeu_ps(r0, a0);
+		_mm_storeu_ps(r1, a1);
+		s0 = (r0[0] + r0[1]) + (r0[2] + r0[3]);
+		s1 = (r1[0] + r1[1]) + (r1[2] + r1[3]);
+#else
+		s0 = 0.0f;
+		s1 = 0.0f;
+#endif
+
+		for (; t < taps; t++)
+		{
+			s0 += src[t] * c0[t];
+			s1 += src[t] * c1[t];
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,342 @@
+
+// Single-producer/single-consumer ring of PCM samples between the emulation
+// thread (producer) and the audio stream callback (consumer).
+
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <time.h>
+	#include <unistd.h>
+#else
+	#include <condition_variable>
+	#include <mutex>
+#endif
+
+class Sample_Ring {
+public:
+	typedef short sample_t;
+
+	// Largest block that begin_write() can hand out contiguously. Larger frames
+	// have to go through write().
+	enum { max_write = 2048 };
+
+	Sample_Ring();
+	~Sample_Ring();
+
+	// Allocates room for at least "count" samples, rounded up to a power of two.
+	// Both sides must be idle. Returns the actual capacity, or -1 if out of memory.
+	long init( long count );
+
+	// Empties the ring and re-opens it after close(). Both sides must be idle.
+	void reset();
+
+	// Wakes up both sides, waits will fail until the next reset().
+	void close();
+
+	bool is_closed() const { return closed.load() != 0; }
+	long capacity() const { return (long) mask + 1; }
+	long samples_avail() const { return (long) (writer.pos.load( std::memory_order_acquire ) - reader.pos.load( std::memory_order_relaxed )); }
+	long space_avail() const { return capacity() - (long) (writer.pos.load( std::memory_order_relaxed ) - reader.pos.load( std::memory_order_acquire )); }
+
+	// Waits until at least "count" samples can be written (producer) or read (consumer).
+	// Returns 1 on success, 0 on timeout and -1 if the ring has been closed.
+	int wait_space( long count, int timeout_ms );
+	int wait_samples( long count, int timeout_ms );
+
+	// Producer. Returns a contiguous block of "count" (<= max_write) samples which
+	// must then be committed with end_write(). Caller is responsible for checking space.
+	sample_t* begin_write( long count );
+	void end_write( long count );
+
+	// Producer. Copies as much of "in" as fits, returns the number of samples written.
+	long write( const sample_t* in, long count );
+
+	// Producer. Records samples thrown away because the ring was full, and the total
+	// since the last reset().
+	void drop( long count ) { dropped.fetch_add( count, std::memory_order_relaxed ); }
+	long dropped_samples() const { return dropped.load( std::memory_order_relaxed ); }
+
+	// Consumer. Copies at most "count" samples, returns the number of samples read.
+	long read( sample_t* out, long count );
+
+private:
+	// Each side gets its own cache line for its position and event. The "waiting" flag
+	// is the exception, it is set by the other side while it sleeps on this side's event,
+	// which is rare enough that the shared line does not matter.
+	struct alignas(64) side_t {
+		std::atomic<uint32_t> pos;
+		std::atomic<uint32_t> event;   // Bumped on every commit, this is what the other side sleeps on.
+		std::atomic<int>      waiting; // Set while the other side sleeps, avoids the wake syscall otherwise.
+	};
+
+	side_t writer;
+	side_t reader;
+	alignas(64) std::atomic<int> closed;
+	std::atomic<long> dropped;
+
+	sample_t* buf;
+	uint32_t  mask;
+
+#if !defined(_WIN32) && !defined(__linux__)
+	std::mutex              wait_mutex;
+	std::condition_variable wait_cond;
+#endif
+
+	int  wait( side_t& other, long count, bool for_space, int timeout_ms );
+	void signal( side_t& self );
+	void wait_event( std::atomic<uint32_t>& event, uint32_t value, int timeout_ms );
+	void wake_event( std::atomic<uint32_t>& event );
+
+	// noncopyable
+	Sample_Ring( const Sample_Ring& );
+	Sample_Ring& operator = ( const Sample_Ring& );
+};
+
+inline Sample_Ring::Sample_Ring()
+{
+	buf = NULL;
+	mask = 0;
+	closed = 0;
+	dropped = 0;
+	writer.pos = 0;
+	writer.event = 0;
+	writer.waiting = 0;
+	reader.pos = 0;
+	reader.event = 0;
+	reader.waiting = 0;
+}
+
+inline Sample_Ring::~Sample_Ring()
+{
+	free( buf );
+}
+
+inline long Sample_Ring::init( long count )
+{
+	uint32_t size = 1024;
+	while ( size < (uint32_t) count )
+		size <<= 1;
+
+	if ( size != mask + 1 || !buf )
+	{
+		// Extra room past the end so begin_write() never has to split a block.
+		sample_t* new_buf = (sample_t*) realloc( buf, (size + max_write) * sizeof (sample_t) );
+		if ( !new_buf )
+			return -1;
+
+		buf = new_buf;
+		mask = size - 1;
+	}
+
+	reset();
+
+	return (long) size;
+}
+
+inline void Sample_Ring::reset()
+{
+	writer.pos = 0;
+	reader.pos = 0;
+	closed = 0;
+	dropped = 0;
+}
+
+inline void Sample_Ring::close()
+{
+	closed = 1;
+	writer.event++;
+	reader.event++;
+	wake_event( writer.event );
+	wake_event( reader.event );
+}
+
+inline int Sample_Ring::wait_space( long count, int timeout_ms )
+{
+	return wait( reader, count, true, timeout_ms );
+}
+
+inline int Sample_Ring::wait_samples( long count, int timeout_ms )
+{
+	return wait( writer, count, false, timeout_ms );
+}
+
+inline Sample_Ring::sample_t* Sample_Ring::begin_write( long count )
+{
+	if ( count > max_write || count > space_avail() )
+		return NULL;
+
+	return buf + (writer.pos.load( std::memory_order_relaxed ) & mask);
+}
+
+inline void Sample_Ring::end_write( long count )
+{
+	uint32_t pos = writer.pos.load( std::memory_order_relaxed );
+	uint32_t offset = pos & mask;
+
+	// Anything that went into the slack wraps around to the start.
+	if ( offset + count > mask + 1 )
+		memcpy( buf, buf + mask + 1, (offset + count - (mask + 1)) * sizeof (sample_t) );
+
+	writer.pos.store( pos + (uint32_t) count );
+	signal( writer );
+}
+
+inline long Sample_Ring::write( const sample_t* in, long count )
+{
+	long space = space_avail();
+	if ( count > space )
+	{
+		drop( count - space );
+		count = space;
+	}
+
+	uint32_t pos = writer.pos.load( std::memory_order_relaxed );
+	uint32_t offset = pos & mask;
+	long first = (long) (mask + 1 - offset);
+	if ( first > count )
+		first = count;
+
+	memcpy( buf + offset, in, first * sizeof (sample_t) );
+	memcpy( buf, in + first, (count - first) * sizeof (sample_t) );
+
+	writer.pos.store( pos + (uint32_t) count );
+	signal( writer );
+
+	return count;
+}
+
+inline long Sample_Ring::read( sample_t* out, long count )
+{
+	long avail = samples_avail();
+	if ( count > avail )
+		count = avail;
+
+	uint32_t pos = reader.pos.load( std::memory_order_relaxed );
+	uint32_t offset = pos & mask;
+	long first = (long) (mask + 1 - offset);
+	if ( first > count )
+		first = count;
+
+	if ( out )
+	{
+		memcpy( out, buf + offset, first * sizeof (sample_t) );
+		memcpy( out + first, buf, (count - first) * sizeof (sample_t) );
+	}
+
+	reader.pos.store( pos + (uint32_t) count );
+	signal( reader );
+
+	return count;
+}
+
+inline void Sample_Ring::signal( side_t& self )
+{
+	// Only pay for the syscall if the other side is actually sleeping.
+	self.event.fetch_add( 1 );
+	if ( self.waiting.load() )
+		wake_event( self.event );
+}
+
+inline int Sample_Ring::wait( side_t& other, long count, bool for_space, int timeout_ms )
+{
+	typedef std::chrono::steady_clock clock;
+	clock::time_point deadline = clock::now() + std::chrono::milliseconds( timeout_ms );
+
+	other.waiting.store( 1 );
+
+	int result;
+	while ( true )
+	{
+		uint32_t event = other.event.load();
+
+		if ( closed.load() )
+		{
+			result = -1;
+			break;
+		}
+
+		if ( (for_space ? space_avail() : samples_avail()) >= count )
+		{
+			result = 1;
+			break;
+		}
+
+		long remaining = (long) std::chrono::duration_cast<std::chrono::milliseconds>( deadline - clock::now() ).count();
+		if ( remaining <= 0 )
+		{
+			result = 0;
+			break;
+		}
+
+		wait_event( other.event, event, (int) remaining );
+	}
+
+	other.waiting.store( 0 );
+
+	return result;
+}
+
+#if defined(_WIN32)
+
+inline void Sample_Ring::wait_event( std::atomic<uint32_t>& event, uint32_t value, int timeout_ms )
+{
+	WaitOnAddress( &event, &value, sizeof (uint32_t), (DWORD) timeout_ms );
+}
+
+inline void Sample_Ring::wake_event( std::atomic<uint32_t>& event )
+{
+	WakeByAddressAll( &event );
+}
+
+#elif defined(__linux__)
+
+inline void Sample_Ring::wait_event( std::atomic<uint32_t>& event, uint32_t value, int timeout_ms )
+{
+	struct timespec ts;
+	ts.tv_sec  = timeout_ms / 1000;
+	ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+	syscall( SYS_futex, (uint32_t*) &event, FUTEX_WAIT_PRIVATE, value, &ts, NULL, 0 );
+}
+
+inline void Sample_Ring::wake_event( std::atomic<uint32_t>& event )
+{
+	syscall( SYS_futex, (uint32_t*) &event, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0 );
+}
+
+#else
+
+inline void Sample_Ring::wait_event( std::atomic<uint32_t>& event, uint32_t value, int timeout_ms )
+{
+	std::unique_lock<std::mutex> lock( wait_mutex );
+	if ( event.load() == value )
+		wait_cond.wait_for( lock, std::chrono::milliseconds( timeout_ms ) );
+}
+
+inline void Sample_Ring::wake_event( std::atomic<uint32_t>& event )
+{
+	// Taking the lock closes the gap between the waiter checking the value and sleeping.
+	std::lock_guard<std::mutex> lock( wait_mutex );
+	wait_cond.notify_all();
+}
+
+#endif
+
+#endif
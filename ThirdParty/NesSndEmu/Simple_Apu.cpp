@@ -1,7 +1,18 @@
 
 // Nes_Snd_Emu 0.1.7. http://www.slack.net/~ant/libs/
 
+#include <chrono> // Before blargg_common.h, which defines min() and max().
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define SIMPLE_APU_SSE2 1
+#endif
+
 #include "Simple_Apu.h"
+#include "nes_apu/Nes_State.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 /* Copyright (C) 2003-2005 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -19,10 +30,53 @@ static int null_dmc_reader( void*, cpu_addr_t )
 	return 0x55; // causes dmc sample to be flat
 }
 
+// Runs a call into a chip, charging its time and deltas to 'exp' when profiling.
+#define PROFILE_CHIP( exp, call ) \
+	{ if ( stats_enabled ) { stats_probe_t probe = stats_begin(); call; stats_end( exp, probe ); } else { call; } }
+
+static double stats_clock()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Number of channels of each chip, in expansion order.
+static const int expansion_channel_counts[Simple_Apu::expansion_count] = { 5, 3, 6, 1, 2, 8, 3, 15 };
+
+// First channel buffer of each chip, -1 for the ones whose channels do not get one.
+static const int channel_bus_base[Simple_Apu::expansion_count] = { 0, 5, 8, -1, 14, 16, 24, -1 };
+
+// Registers decoded by each chip (see their write_register()). Some ranges overlap,
+// the S5B sees the VRC7 silence register and the N163 address register, for example.
+struct register_range_t
+{
+	int exp;
+	cpu_addr_t first;
+	cpu_addr_t last;
+};
+
+static const register_range_t register_ranges[] =
+{
+	{ Simple_Apu::expansion_none,    Nes_Apu::start_addr, Nes_Apu::end_addr },
+	{ Simple_Apu::expansion_vrc6,    Nes_Vrc6::base_addr + Nes_Vrc6::addr_step * 0, Nes_Vrc6::base_addr + Nes_Vrc6::addr_step * 0 + Nes_Vrc6::reg_count - 1 },
+	{ Simple_Apu::expansion_vrc6,    Nes_Vrc6::base_addr + Nes_Vrc6::addr_step * 1, Nes_Vrc6::base_addr + Nes_Vrc6::addr_step * 1 + Nes_Vrc6::reg_count - 1 },
+	{ Simple_Apu::expansion_vrc6,    Nes_Vrc6::base_addr + Nes_Vrc6::addr_step * 2, Nes_Vrc6::base_addr + Nes_Vrc6::addr_step * 2 + Nes_Vrc6::reg_count - 1 },
+	{ Simple_Apu::expansion_vrc7,    Nes_Vrc7::reg_select, Nes_Vrc7::reg_select },
+	{ Simple_Apu::expansion_vrc7,    Nes_Vrc7::reg_write, Nes_Vrc7::reg_write },
+	{ Simple_Apu::expansion_vrc7,    Nes_Vrc7::reg_silence, Nes_Vrc7::reg_silence },
+	{ Simple_Apu::expansion_fds,     Nes_Fds::start_addr, Nes_Fds::end_addr },
+	{ Simple_Apu::expansion_mmc5,    Nes_Mmc5::start_addr, Nes_Mmc5::end_addr },
+	{ Simple_Apu::expansion_namco,   Nes_Namco::data_reg_addr, Nes_Namco::data_reg_addr + Nes_Namco::reg_range - 1 },
+	{ Simple_Apu::expansion_namco,   Nes_Namco::addr_reg_addr, Nes_Namco::addr_reg_addr + Nes_Namco::reg_range - 1 },
+	{ Simple_Apu::expansion_sunsoft, Nes_Sunsoft::reg_select, Nes_Sunsoft::reg_select + Nes_Sunsoft::reg_range - 1 },
+	{ Simple_Apu::expansion_sunsoft, Nes_Sunsoft::reg_write, Nes_Sunsoft::reg_write + Nes_Sunsoft::reg_range - 1 },
+	{ Simple_Apu::expansion_epsm,    Nes_EPSM::reg_select, Nes_EPSM::reg_write2 },
+};
+
 Simple_Apu::Simple_Apu()
 {
 	pal_mode = false;
 	seeking = false; 
+	stereo = false;
 	separate_tnd_mode = tnd_mode_single;
 	time = 0;
 	frame_length = 29780;
@@ -31,10 +85,47 @@ Simple_Apu::Simple_Apu()
 	apu.dmc_reader( null_dmc_reader, NULL );
 	fds_filter_accum = 0;
 	fds_filter_alpha = 1 << fds_filter_bits;
+	dmc_bank_idx = 0;
+	dmc_bank_reg = 0;
+	memset(dmc_banks, 0, sizeof(dmc_banks));
+	keyframes = NULL;
+	keyframes_count = 0;
+	keyframes_capacity = 0;
+	telemetry = NULL;
+	telemetry_capacity = 0;
+	telemetry_read = 0;
+	telemetry_count = 0;
+	telemetry_frame = 0;
+	memset(trigger_logs, 0, sizeof(trigger_logs));
+	memset(bus_samples, 0, sizeof(bus_samples));
+	memset(chan_samples, 0, sizeof(chan_samples));
+	bus_samples_data = NULL;
+	bus_size = 0;
+	bus_samples_count = 0;
+	for (int i = 0; i < expansion_count; i++)
+		bus_pan[i] = 0.0;
+	memset(channel_mix, 0, sizeof(channel_mix));
+	memset(sq_part_accum, 0, sizeof(sq_part_accum));
+	memset(sq_part_prev, 0, sizeof(sq_part_prev));
+	memset(tnd_part_prev, 0, sizeof(tnd_part_prev));
+	reset_channel_mix();
+	stats_enabled = false;
+	reset_stats();
+	build_write_ranges();
 }
 
 Simple_Apu::~Simple_Apu()
 {
+	clear_keyframes();
+	free(keyframes);
+	free(telemetry);
+	free(bus_samples_data);
+	for (int i = 0; i < channel_bus_count; i++)
+		free(chan_samples[i]);
+	set_trigger_logs(0);
+
+	for (int i = 0; i < max_dmc_banks; i++)
+		delete[] dmc_banks[i].data;
 }
 
 void Simple_Apu::dmc_reader( int (*f)( void* user_data, cpu_addr_t ), void* p )
@@ -43,8 +134,56 @@ void Simple_Apu::dmc_reader( int (*f)( void* user_data, cpu_addr_t ), void* p )
 	apu.dmc_reader( f, p );
 }
 
+void Simple_Apu::set_dmc_memory(int bank, cpu_addr_t addr, const unsigned char* data, int size)
+{
+	assert(bank >= 0 && bank < max_dmc_banks);
+	assert(addr >= 0x8000 && addr + size <= 0x10000);
+
+	dmc_bank_t& b = dmc_banks[bank];
+
+	if (size > b.capacity)
+	{
+		delete[] b.data;
+		b.data = new unsigned char[size];
+		b.capacity = size;
+	}
+
+	if (size > 0)
+		memcpy(b.data, data, size);
+
+	b.addr = addr;
+	b.size = size;
+
+	if (bank == dmc_bank_idx)
+		select_dmc_bank(bank);
+}
+
+void Simple_Apu::select_dmc_bank(int bank)
+{
+	dmc_bank_idx = bank % max_dmc_banks;
+
+	const dmc_bank_t& b = dmc_banks[dmc_bank_idx];
+	apu.dmc_memory(b.size ? b.data : NULL, b.addr, b.size);
+}
+
+const unsigned char* Simple_Apu::dmc_memory(int bank, cpu_addr_t* addr, int* size) const
+{
+	const dmc_bank_t& b = dmc_banks[bank];
+	*addr = b.addr;
+	*size = b.size;
+	return b.data;
+}
+
+void Simple_Apu::set_dmc_bank_register(cpu_addr_t addr)
+{
+	dmc_bank_reg = addr;
+}
+
 blargg_err_t Simple_Apu::sample_rate( long sample_rate, bool pal, int tnd_mode )
 {
+	// Keyframes hold buffers of the old size and layout.
+	clear_keyframes();
+
 	pal_mode = pal;
 	separate_tnd_mode = tnd_mode;
 	separate_tnd_channel_enabled[0] = true;
@@ -52,8 +191,12 @@ blargg_err_t Simple_Apu::sample_rate( long sample_rate, bool pal, int tnd_mode )
 	separate_tnd_channel_enabled[2] = true;
 	frame_length = pal ? 33247 : 29780;
 
+	reset_channel_mix();
+
 	if (separate_tnd_mode)
 	{
+		apu.osc_output(0, &buf);
+		apu.osc_output(1, &buf);
 		apu.osc_output(2, &buf_tnd[0]);
 		apu.osc_output(3, &buf_tnd[1]);
 		apu.osc_output(4, &buf_tnd[2]);
@@ -63,13 +206,13 @@ blargg_err_t Simple_Apu::sample_rate( long sample_rate, bool pal, int tnd_mode )
 		apu.output(&buf, &buf_tnd[0]);
 	}
 
-	vrc6.output(&buf_exp);
-	vrc7.output(&buf_exp);
+	vrc6.output(&buf_exp[expansion_vrc6]);
+	vrc7.output(&buf_exp[expansion_vrc7]);
 	fds.output(&buf_fds);
 	fds.treble_eq(blip_eq_t(0));
-	mmc5.output(&buf_exp);
-	namco.output(&buf_exp);
-	sunsoft.output(&buf_exp);
+	mmc5.output(&buf_exp[expansion_mmc5]);
+	namco.output(&buf_exp[expansion_namco]);
+	sunsoft.output(&buf_exp[expansion_sunsoft]);
 	epsm.output(&buf_epsm_left, &buf_epsm_right);
 
 	long clock_rate = pal ? 1662607 : 1789773;
@@ -82,8 +225,14 @@ blargg_err_t Simple_Apu::sample_rate( long sample_rate, bool pal, int tnd_mode )
 	buf_fds.sample_rate(sample_rate);
 	buf_fds.clock_rate(clock_rate);
 
-	buf_exp.sample_rate(sample_rate);
-	buf_exp.clock_rate(clock_rate);
+	for (int i = 1; i < expansion_count; i++)
+	{
+		if (exp_bus_mask & (1 << (i - 1)))
+		{
+			buf_exp[i].sample_rate(sample_rate);
+			buf_exp[i].clock_rate(clock_rate);
+		}
+	}
 
 	buf_tnd[0].clock_rate(clock_rate);
 	buf_tnd[1].clock_rate(clock_rate);
@@ -93,16 +242,62 @@ blargg_err_t Simple_Apu::sample_rate( long sample_rate, bool pal, int tnd_mode )
 	buf_tnd[0].sample_rate(sample_rate);
 	buf_tnd[1].sample_rate(sample_rate);
 	buf_tnd[2].sample_rate(sample_rate);
-	return buf.sample_rate(sample_rate);
+
+	blargg_err_t err = buf.sample_rate(sample_rate);
+	if (err)
+		return err;
+
+	if (!resize_buses(buf.buffer_size_))
+		return "Out of memory";
+
+	return 0;
+}
+
+bool Simple_Apu::resize_buses(long size)
+{
+	if (size != bus_size || !bus_samples_data)
+	{
+		sample_t* data = (sample_t*)realloc(bus_samples_data, size * (expansion_count + 1) * sizeof(sample_t));
+		if (!data)
+			return false;
+
+		bus_samples_data = data;
+		bus_size = size;
+
+		for (int i = 0; i <= expansion_count; i++)
+			bus_samples[i] = bus_samples_data + i * size;
+	}
+
+	bus_samples_count = 0;
+
+	return true;
+}
+
+int Simple_Apu::channel_count(int exp)
+{
+	return (unsigned)exp < expansion_count ? expansion_channel_counts[exp] : 0;
 }
 
 void Simple_Apu::enable_channel(int expansion, int idx, bool enable)
 {
+	if (enable)
+		channels_disabled[expansion] &= ~(1 << idx);
+	else
+		channels_disabled[expansion] |= 1 << idx;
+
+	update_channel_output(expansion, idx);
+}
+
+void Simple_Apu::update_channel_output(int expansion, int idx)
+{
+	bool enable = (channels_disabled[expansion] & (1 << idx)) == 0;
+	Blip_Buffer* chan = channel_mix[expansion][idx].routed && channel_bus_base[expansion] >= 0 ? &buf_chan[channel_bus_base[expansion] + idx] : NULL;
+
 	if (expansion == 0)
 	{
 		if (idx < 2)
 		{
-			apu.osc_output(idx, enable ? &buf : NULL);
+			apu.osc_output(idx, enable ? (chan ? chan : &buf) : NULL);
 		}
 		else
 		{
@@ -120,17 +315,103 @@ void Simple_Apu::enable_channel(int expansion, int idx, bool enable)
 	{
 		switch (expansion)
 		{
-			case expansion_vrc6: vrc6.osc_output(idx, enable ? &buf_exp : NULL); break;
-			case expansion_vrc7: vrc7.enable_channel(idx, enable); break;
+			case expansion_vrc6: vrc6.osc_output(idx, enable ? (chan ? chan : &buf_exp[expansion_vrc6]) : NULL); break;
+			case expansion_vrc7: vrc7.enable_channel(idx, enable); vrc7.osc_output(idx, chan); break;
 			case expansion_fds: fds.output(enable ? &buf_fds : NULL); break;
-			case expansion_mmc5: mmc5.osc_output(idx, enable ? &buf_exp : NULL); break;
-			case expansion_namco: namco.osc_output(idx, enable ? &buf_exp : NULL); break;
-			case expansion_sunsoft: sunsoft.enable_channel(idx, enable ? &buf_exp : NULL); break;
+			case expansion_mmc5: mmc5.osc_output(idx, enable ? (chan ? chan : &buf_exp[expansion_mmc5]) : NULL); break;
+			case expansion_namco: namco.osc_output(idx, enable ? (chan ? chan : &buf_exp[expansion_namco]) : NULL); break;
+			case expansion_sunsoft: sunsoft.enable_channel(idx, enable); sunsoft.osc_output(idx, chan); break;
 			case expansion_epsm: epsm.enable_channel(idx, enable); break;
 		}
 	}
 }
 
+void Simple_Apu::reset_channel_mix()
+{
+	// The other chips are reconnected to their bus by sample_rate().
+	for (int i = 0; i < expansion_channel_counts[expansion_vrc7]; i++)
+		vrc7.osc_output(i, NULL);
+	for (int i = 0; i < expansion_channel_counts[expansion_sunsoft]; i++)
+		sunsoft.osc_output(i, NULL);
+
+	for (int i = 0; i < expansion_count; i++)
+	{
+		channels_disabled[i] = 0;
+
+		for (int j = 0; j < telemetry_max_channels; j++)
+		{
+			channel_mix[i][j].routed = false;
+			channel_mix[i][j].volume = 1.0f;
+			channel_mix[i][j].pan = 0.0f;
+		}
+	}
+
+	chan_bus_mask = 0;
+}
+
+void Simple_Apu::set_channel_mix(int exp, int idx, double volume, double pan)
+{
+	if ((unsigned)exp >= expansion_count || (unsigned)idx >= (unsigned)expansion_channel_counts[exp])
+		return;
+
+	channel_mix_t& m = channel_mix[exp][idx];
+	m.volume = (float)volume;
+	m.pan = (float)(pan < -1.0 ? -1.0 : (pan > 1.0 ? 1.0 : pan));
+
+	if (m.routed || (volume == 1.0 && pan == 0.0) || exp == expansion_epsm)
+		return;
+
+	// FDS has a single channel, it simply takes over its bus.
+	if (exp == expansion_fds)
+	{
+		m.routed = true;
+		return;
+	}
+
+	// Without separate TND buffers there is nothing to split.
+	if (exp == expansion_none && idx >= 2 && !separate_tnd_mode)
+		return;
+
+	// Start in sync with the bus, so that both have the same samples available.
+	int bus = channel_bus_base[exp] + idx;
+	Blip_Buffer& b = buf_chan[bus];
+	const Blip_Buffer& src = exp == expansion_none ? buf : buf_exp[exp];
+
+	if (b.set_sample_rate(src.sample_rate(), src.length()))
+		return;
+
+	// Same size as the other buses, sample_rate() un-routes everything when it changes.
+	sample_t* samples = (sample_t*)realloc(chan_samples[bus], bus_size * sizeof(sample_t));
+	if (!samples)
+		return;
+
+	chan_samples[bus] = samples;
+
+	b.clock_rate(src.clock_rate());
+	b.bass_freq(src.bass_freq());
+	b.offset_ = src.offset_;
+
+	if (exp == expansion_none)
+	{
+		if (idx < 2)
+		{
+			sq_part_accum[idx] = 0;
+			sq_part_prev[idx] = 0;
+		}
+		else
+		{
+			tnd_part_prev[idx - 2] = 0;
+		}
+	}
+
+	// A new bus changes the keyframe layout.
+	clear_keyframes();
+
+	m.routed = true;
+	chan_bus_mask |= 1L << bus;
+	update_channel_output(exp, idx);
+}
+
 void Simple_Apu::reset_triggers()
 {
 	apu.reset_triggers();
@@ -186,21 +467,55 @@ void Simple_Apu::treble_eq(int expansion, double treble_amount, int treble_freq,
 void Simple_Apu::bass_freq(int expansion, int bass_freq)
 {
 	// FDS is a special case and has its own bass filter.
-	// Not sure yet for other expansions, but they share
-	// the same blip buffer anyway.
-	if (expansion == expansion_fds)
+	switch (expansion)
 	{
-		buf_fds.bass_freq(bass_freq);
-		return;
+		case expansion_fds:
+			buf_fds.bass_freq(bass_freq);
+			break;
+		case expansion_epsm:
+			buf_epsm_left.bass_freq(bass_freq);
+			buf_epsm_right.bass_freq(bass_freq);
+			break;
+		case expansion_none:
+			buf.bass_freq(bass_freq);
+			buf_tnd[0].bass_freq(bass_freq);
+			buf_tnd[1].bass_freq(bass_freq);
+			buf_tnd[2].bass_freq(bass_freq);
+			buf_epsm_left.bass_freq(bass_freq);
+			buf_epsm_right.bass_freq(bass_freq);
+			for (int i = 1; i < expansion_count; i++)
+			{
+				if (exp_bus_mask & (1 << (i - 1)))
+					buf_exp[i].bass_freq(bass_freq);
+			}
+			break;
+		default:
+			buf_exp[expansion].bass_freq(bass_freq);
+			break;
 	}
 
-	buf.bass_freq(bass_freq);
-	buf_exp.bass_freq(bass_freq);
-	buf_tnd[0].bass_freq(bass_freq);
-	buf_tnd[1].bass_freq(bass_freq);
-	buf_tnd[2].bass_freq(bass_freq);
-	buf_epsm_left.bass_freq(bass_freq);
-	buf_epsm_right.bass_freq(bass_freq);
+	// Routed channels follow the bus of their chip.
+	for (int i = 0; i < expansion_count; i++)
+	{
+		if (channel_bus_base[i] < 0 || (expansion != i && expansion != expansion_none))
+			continue;
+
+		for (int j = 0; j < expansion_channel_counts[i]; j++)
+		{
+			if (chan_bus_mask & (1L << (channel_bus_base[i] + j)))
+				buf_chan[channel_bus_base[i] + j].bass_freq(bass_freq);
+		}
+	}
+}
+
+void Simple_Apu::set_bus_pan(int exp, double pan)
+{
+	bus_pan[exp] = pan < -1.0 ? -1.0 : (pan > 1.0 ? 1.0 : pan);
+}
+
+void Simple_Apu::set_stereo(bool s)
+{
+	stereo = s;
 }
 
 void Simple_Apu::set_expansion_volume(int exp, double volume)
@@ -220,44 +535,66 @@ void Simple_Apu::set_expansion_volume(int exp, double volume)
 
 void Simple_Apu::write_register(cpu_addr_t addr, int data)
 {
+	// Bank switches need to happen even when seeking.
+	if (dmc_bank_reg && addr == dmc_bank_reg)
+	{
+		select_dmc_bank(data);
+		return;
+	}
+
 	if (seeking)
 	{
-		if (addr >= Nes_Apu::start_addr && addr <= Nes_Apu::end_addr)
+		for (int i = 0; i < write_range_count; i++)
 		{
-			apu.write_shadow_register(addr, data);
-		}
-		else
-		{
-			if (expansions & expansion_mask_vrc6) vrc6.write_shadow_register(addr, data);
-			if (expansions & expansion_mask_vrc7) vrc7.write_shadow_register(addr, data);
-			if (expansions & expansion_mask_fds) fds.write_shadow_register(addr, data);
-			if (expansions & expansion_mask_mmc5) mmc5.write_shadow_register(addr, data);
-			if (expansions & expansion_mask_namco) namco.write_shadow_register(addr, data);
-			if (expansions & expansion_mask_sunsoft) sunsoft.write_shadow_register(addr, data); 
-			if (expansions & expansion_mask_epsm) epsm.write_shadow_register(addr, data); 
+			const write_range_t& r = write_ranges[i];
+			if (addr >= r.first && addr <= r.last)
+				write_chip_shadow_register(r.exp, addr, data);
 		}
 	}
 	else
 	{
+		// Every write takes time, even if no chip decodes it.
 		blip_time_t clk = clock();
 
-		if (addr >= Nes_Apu::start_addr && addr <= Nes_Apu::end_addr)
+		for (int i = 0; i < write_range_count; i++)
 		{
-			apu.write_register(clk, addr, data);
-		}
-		else
-		{
-			if (expansions & expansion_mask_vrc6) vrc6.write_register(clk, addr, data);
-			if (expansions & expansion_mask_vrc7) vrc7.write_register(clk, addr, data);
-			if (expansions & expansion_mask_fds) fds.write_register(clk, addr, data);
-			if (expansions & expansion_mask_mmc5) mmc5.write_register(clk, addr, data);
-			if (expansions & expansion_mask_namco) namco.write_register(clk, addr, data);
-			if (expansions & expansion_mask_sunsoft) sunsoft.write_register(clk, addr, data);
-			if (expansions & expansion_mask_epsm) epsm.write_register(clk, addr, data);
+			const write_range_t& r = write_ranges[i];
+			if (addr >= r.first && addr <= r.last)
+				PROFILE_CHIP(r.exp, write_chip_register(r.exp, clk, addr, data));
 		}
 	}
 }
 
+void Simple_Apu::write_chip_register(int exp, blip_time_t clk, cpu_addr_t addr, int data)
+{
+	switch (exp)
+	{
+		case expansion_none: apu.write_register(clk, addr, data); break;
+		case expansion_vrc6: vrc6.write_register(clk, addr, data); break;
+		case expansion_vrc7: vrc7.write_register(clk, addr, data); break;
+		case expansion_fds: fds.write_register(clk, addr, data); break;
+		case expansion_mmc5: mmc5.write_register(clk, addr, data); break;
+		case expansion_namco: namco.write_register(clk, addr, data); break;
+		case expansion_sunsoft: sunsoft.write_register(clk, addr, data); break;
+		case expansion_epsm: epsm.write_register(clk, addr, data); break;
+	}
+}
+
+void Simple_Apu::write_chip_shadow_register(int exp, cpu_addr_t addr, int data)
+{
+	switch (exp)
+	{
+		case expansion_none: apu.write_shadow_register(addr, data); break;
+		case expansion_vrc6: vrc6.write_shadow_register(addr, data); break;
+		case expansion_vrc7: vrc7.write_shadow_register(addr, data); break;
+		case expansion_fds: fds.write_shadow_register(addr, data); break;
+		case expansion_mmc5: mmc5.write_shadow_register(addr, data); break;
+		case expansion_namco: namco.write_shadow_register(addr, data); break;
+		case expansion_sunsoft: sunsoft.write_shadow_register(addr, data); break;
+		case expansion_epsm: epsm.write_shadow_register(addr, data); break;
+	}
+}
+
 void Simple_Apu::get_register_values(int exp, void* regs)
 {
 	assert(!seeking);
@@ -314,15 +651,15 @@ int Simple_Apu::skip_cycles(long cycles)
 	if (!seeking)
 	{
 		time += cycles;
-		apu.run_until(time);
-
-		if (expansions & expansion_mask_vrc6) vrc6.run_until(time);
-		if (expansions & expansion_mask_vrc7) vrc7.run_until(time);
-		if (expansions & expansion_mask_fds) fds.run_until(time);
-		if (expansions & expansion_mask_mmc5) mmc5.run_until(time);
-		if (expansions & expansion_mask_namco) namco.run_until(time);
-		if (expansions & expansion_mask_sunsoft) sunsoft.run_until(time);
-		if (expansions & expansion_mask_epsm) epsm.run_until(time); //Disabled until Perkka takes a look.
+		PROFILE_CHIP(expansion_none, apu.run_until(time));
+
+		if (expansions & expansion_mask_vrc6) PROFILE_CHIP(expansion_vrc6, vrc6.run_until(time));
+		if (expansions & expansion_mask_vrc7) PROFILE_CHIP(expansion_vrc7, vrc7.run_until(time));
+		if (expansions & expansion_mask_fds) PROFILE_CHIP(expansion_fds, fds.run_until(time));
+		if (expansions & expansion_mask_mmc5) PROFILE_CHIP(expansion_mmc5, mmc5.run_until(time));
+		if (expansions & expansion_mask_namco) PROFILE_CHIP(expansion_namco, namco.run_until(time));
+		if (expansions & expansion_mask_sunsoft) PROFILE_CHIP(expansion_sunsoft, sunsoft.run_until(time));
+		if (expansions & expansion_mask_epsm) PROFILE_CHIP(expansion_epsm, epsm.run_until(time)); //Disabled until Perkka takes a look.
 	}
 
 	return time;
@@ -353,15 +690,15 @@ void Simple_Apu::end_frame()
 	time = 0;
 	frame_length ^= 1;
 
-	apu.end_frame(frame_length);
+	PROFILE_CHIP(expansion_none, apu.end_frame(frame_length));
 
-	if (expansions & expansion_mask_vrc6) vrc6.end_frame(frame_length);
-	if (expansions & expansion_mask_vrc7) vrc7.end_frame(frame_length);
-	if (expansions & expansion_mask_fds) fds.end_frame(frame_length); 
-	if (expansions & expansion_mask_mmc5) mmc5.end_frame(frame_length); 
-	if (expansions & expansion_mask_namco) namco.end_frame(frame_length); 
-	if (expansions & expansion_mask_sunsoft) sunsoft.end_frame(frame_length); 
-	if (expansions & expansion_mask_epsm) epsm.end_frame(frame_length); 
+	if (expansions & expansion_mask_vrc6) PROFILE_CHIP(expansion_vrc6, vrc6.end_frame(frame_length));
+	if (expansions & expansion_mask_vrc7) PROFILE_CHIP(expansion_vrc7, vrc7.end_frame(frame_length));
+	if (expansions & expansion_mask_fds) PROFILE_CHIP(expansion_fds, fds.end_frame(frame_length));
+	if (expansions & expansion_mask_mmc5) PROFILE_CHIP(expansion_mmc5, mmc5.end_frame(frame_length));
+	if (expansions & expansion_mask_namco) PROFILE_CHIP(expansion_namco, namco.end_frame(frame_length));
+	if (expansions & expansion_mask_sunsoft) PROFILE_CHIP(expansion_sunsoft, sunsoft.end_frame(frame_length));
+	if (expansions & expansion_mask_epsm) PROFILE_CHIP(expansion_epsm, epsm.end_frame(frame_length));
 
 	buf.end_frame(frame_length);
 	buf_tnd[0].end_frame(frame_length);
@@ -371,9 +708,10 @@ void Simple_Apu::end_frame()
 		buf_fds.end_frame(frame_length);
 	}
 
-	if (expansions & (expansion_mask_vrc6 | expansion_mask_vrc7 | expansion_mask_mmc5 | expansion_mask_namco | expansion_mask_sunsoft))
+	for (int i = 1; i < expansion_count; i++)
 	{
-		buf_exp.end_frame(frame_length);
+		if (expansions & exp_bus_mask & (1 << (i - 1)))
+			buf_exp[i].end_frame(frame_length);
 	}
 
 	if ((expansions & expansion_mask_epsm) != 0)
@@ -387,6 +725,38 @@ void Simple_Apu::end_frame()
 		buf_tnd[1].end_frame(frame_length);
 		buf_tnd[2].end_frame(frame_length);
 	}
+
+	for (int i = 0; i < channel_bus_count; i++)
+	{
+		if (chan_bus_mask & (1L << i))
+			buf_chan[i].end_frame(frame_length);
+	}
+
+	if (stats_enabled && !seeking)
+	{
+		stats.frames++;
+		stats.cycles[expansion_none] += frame_length;
+
+		for (int i = 1; i < expansion_count; i++)
+		{
+			if (expansions & (1 << (i - 1)))
+				stats.cycles[i] += frame_length;
+		}
+	}
+
+	if (telemetry_capacity && !seeking)
+	{
+		if (telemetry_count == telemetry_capacity)
+		{
+			telemetry_read = (telemetry_read + 1) % telemetry_capacity;
+			telemetry_count--;
+		}
+
+		get_frame_telemetry(&telemetry[(telemetry_read + telemetry_count) % telemetry_capacity]);
+		telemetry_count++;
+	}
+
+	telemetry_frame++;
 }
 
 void Simple_Apu::reset()
@@ -401,6 +771,9 @@ void Simple_Apu::reset()
 	tnd_accum[0] = 0;
 	tnd_accum[1] = 0;
 	tnd_accum[2] = 0;
+	memset(sq_part_accum, 0, sizeof(sq_part_accum));
+	memset(sq_part_prev, 0, sizeof(sq_part_prev));
+	memset(tnd_part_prev, 0, sizeof(tnd_part_prev));
 	apu.reset(pal_mode);
 	vrc6.reset();
 	vrc7.reset();
@@ -413,7 +786,28 @@ void Simple_Apu::reset()
 
 void Simple_Apu::set_audio_expansions(long exp)
 {
+	clear_keyframes();
 	expansions = exp;
+	build_write_ranges();
+}
+
+void Simple_Apu::build_write_ranges()
+{
+	write_range_count = 0;
+
+	for (int i = 0; i < (int)(sizeof(register_ranges) / sizeof(register_ranges[0])); i++)
+	{
+		const register_range_t& r = register_ranges[i];
+
+		if (r.exp == expansion_none || (expansions & (1 << (r.exp - 1))))
+		{
+			assert(write_range_count < max_write_ranges);
+			write_range_t& w = write_ranges[write_range_count++];
+			w.first = r.first;
+			w.last = r.last;
+			w.exp = r.exp;
+		}
+	}
 }
 
 long Simple_Apu::samples_avail() const
@@ -460,19 +854,168 @@ inline float mix_squares(float sample_float)
     return 95.52f / (8128.0f / (sample_float * sq_scale) + 100.0f);
 }
 
+// A bus (or one side of the EPSM bus), or a routed channel, and its gains in the final mix.
+struct mix_source_t
+{
+	const blip_sample_t* in;
+	float left;
+	float right;
+};
+
+// Balance, a centered source is at full volume on both sides, like a mono one.
+inline void mix_gains(float volume, float pan, bool stereo, float& left, float& right)
+{
+	left  = stereo && pan > 0.0f ? volume * (1.0f - pan) : volume;
+	right = stereo && pan < 0.0f ? volume * (1.0f + pan) : volume;
+}
+
+inline blip_sample_t mix_clamp(float s)
+{
+	long v = lrintf(s);
+	return (blip_sample_t)(v < -32768 ? -32768 : (v > 32767 ? 32767 : v));
+}
+
+// Sums the sources scaled by their gains and saturates to 16-bit, interleaved when stereo.
+// The samples are whole numbers, so unity gains give the exact sum. The SSE2 path and the
+// scalar path add in the same order and round the same way, the results are identical.
+static void mix_sources(const mix_source_t* src, int src_count, blip_sample_t* out, long count, bool stereo)
+{
+	long i = 0;
+
+#if SIMPLE_APU_SSE2
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 l0 = _mm_setzero_ps();
+		__m128 l1 = _mm_setzero_ps();
+		__m128 r0 = _mm_setzero_ps();
+		__m128 r1 = _mm_setzero_ps();
+
+		for (int j = 0; j < src_count; j++)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(src[j].in + i));
+			__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+			__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+			__m128 gl = _mm_set1_ps(src[j].left);
+			__m128 gr = _mm_set1_ps(src[j].right);
+
+			l0 = _mm_add_ps(l0, _mm_mul_ps(lo, gl));
+			l1 = _mm_add_ps(l1, _mm_mul_ps(hi, gl));
+			r0 = _mm_add_ps(r0, _mm_mul_ps(lo, gr));
+			r1 = _mm_add_ps(r1, _mm_mul_ps(hi, gr));
+		}
+
+		__m128i l = _mm_packs_epi32(_mm_cvtps_epi32(l0), _mm_cvtps_epi32(l1));
+
+		if (stereo)
+		{
+			__m128i r = _mm_packs_epi32(_mm_cvtps_epi32(r0), _mm_cvtps_epi32(r1));
+			_mm_storeu_si128((__m128i*)(out + i * 2 + 0), _mm_unpacklo_epi16(l, r));
+			_mm_storeu_si128((__m128i*)(out + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+		}
+		else
+		{
+			_mm_storeu_si128((__m128i*)(out + i), l);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float l = 0.0f;
+		float r = 0.0f;
+
+		for (int j = 0; j < src_count; j++)
+		{
+			l += src[j].in[i] * src[j].left;
+			r += src[j].in[i] * src[j].right;
+		}
+
+		if (stereo)
+		{
+			out[i * 2 + 0] = mix_clamp(l);
+			out[i * 2 + 1] = mix_clamp(r);
+		}
+		else
+		{
+			out[i] = mix_clamp(l);
+		}
+	}
+}
+
+long Simple_Apu::mix_buses(int exp_mask, sample_t* out) const
+{
+	mix_source_t src[expansion_count + 1 + channel_bus_count];
+	int src_count = 0;
+	bool stereo_out = is_stereo();
+
+	for (int i = 0; i < expansion_count; i++)
+	{
+		if (!(exp_mask & (1 << i)))
+			continue;
+		if (i != expansion_none && !(expansions & (1 << (i - 1))))
+			continue;
+
+		float left;
+		float right;
+
+		if (i == expansion_fds && channel_mix[i][0].routed)
+			mix_gains(channel_mix[i][0].volume, channel_mix[i][0].pan, stereo_out, left, right);
+		else
+			mix_gains(1.0f, (float)bus_pan[i], stereo_out, left, right);
+
+		if (i == expansion_epsm)
+		{
+			mix_source_t l = { bus_samples[expansion_epsm], left, 0.0f };
+			mix_source_t r = { bus_samples[bus_epsm_right], 0.0f, right };
+			src[src_count++] = l;
+			src[src_count++] = r;
+		}
+		else
+		{
+			mix_source_t m = { bus_samples[i], left, right };
+			src[src_count++] = m;
+		}
+	}
+
+	// Routed channels, after all the buses.
+	for (int i = 0; i < expansion_count; i++)
+	{
+		if (channel_bus_base[i] < 0 || !(exp_mask & (1 << i)))
+			continue;
+		if (i != expansion_none && !(expansions & (1 << (i - 1))))
+			continue;
+
+		for (int j = 0; j < expansion_channel_counts[i]; j++)
+		{
+			int bus = channel_bus_base[i] + j;
+
+			if (chan_bus_mask & (1L << bus))
+			{
+				mix_source_t m = { chan_samples[bus], 0.0f, 0.0f };
+				mix_gains(channel_mix[i][j].volume, channel_mix[i][j].pan, stereo_out, m.left, m.right);
+				src[src_count++] = m;
+			}
+		}
+	}
+
+	mix_sources(src, src_count, out, bus_samples_count, stereo_out);
+
+	return bus_samples_count;
+}
+
 long Simple_Apu::read_samples( sample_t* out, long count )
 {
 	assert(buf.samples_avail() == buf_tnd[0].samples_avail());
 	assert(buf.samples_avail() == buf_tnd[1].samples_avail() && separate_tnd_mode || buf_tnd[1].samples_avail() == 0 && !separate_tnd_mode);
 	assert(buf.samples_avail() == buf_tnd[2].samples_avail() && separate_tnd_mode || buf_tnd[2].samples_avail() == 0 && !separate_tnd_mode);
+	assert(count <= bus_size);
 
-	sample_t out_left[1024];
-	sample_t out_right[1024];
+	double mix_start = stats_enabled ? stats_clock() : 0.0;
 
 	if (expansions & expansion_mask_epsm)
 	{
-		long count_l = buf_epsm_left.read_samples(out_left, count, false);
-		long count_r = buf_epsm_right.read_samples(out_right, count, false);
+		long count_l = buf_epsm_left.read_samples(bus_samples[expansion_epsm], count, false);
+		long count_r = buf_epsm_right.read_samples(bus_samples[bus_epsm_right], count, false);
 
 		assert(count_l == count);
 		assert(count_r == count);
@@ -485,14 +1028,63 @@ long Simple_Apu::read_samples( sample_t* out, long count )
 	if (count)
 	{
 		// Apply volume mixing to the square buffer
-		Blip_Buffer::buf_t_* p = buf.buffer_;
+		if ((chan_bus_mask & 3) == 0)
+		{
+			Blip_Buffer::buf_t_* p = buf.buffer_;
 
-		for (unsigned n = count; n--; )
+			for (unsigned n = count; n--; )
+			{
+				sq_accum += (long)*p;
+				long sq_mix = pack_sample(mix_squares(unpack_sample(sq_accum)) * tnd_volume);
+				*p++ = (sq_mix - prev_sq_mix);
+				prev_sq_mix = sq_mix;
+			}
+		}
+		else
 		{
-			sq_accum += (long)*p;
-			long sq_mix = pack_sample(mix_squares(unpack_sample(sq_accum)) * tnd_volume);
-			*p++ = (sq_mix - prev_sq_mix);
-			prev_sq_mix = sq_mix;
+			// Some squares have their own buffer, the mix of both is shared between the
+			// buffers in proportion of what each one holds, like the separate TND mode.
+			Blip_Buffer::buf_t_* p[3];
+			long accum[3] = { sq_accum, sq_part_accum[0], sq_part_accum[1] };
+			long prev[3] = { prev_sq_mix, sq_part_prev[0], sq_part_prev[1] };
+			p[0] = buf.buffer_;
+			p[1] = chan_bus_mask & 1 ? buf_chan[0].buffer_ : NULL;
+			p[2] = chan_bus_mask & 2 ? buf_chan[1].buffer_ : NULL;
+
+			for (unsigned n = count; n--; )
+			{
+				float parts[3] = { 0.0f, 0.0f, 0.0f };
+				float sum = 0.0f;
+
+				for (int j = 0; j < 3; j++)
+				{
+					if (p[j])
+					{
+						accum[j] += (long)*p[j];
+						parts[j] = unpack_sample(accum[j]);
+						sum += parts[j];
+					}
+				}
+
+				float ratio = mix_squares(sum) * tnd_volume / sum;
+
+				for (int j = 0; j < 3; j++)
+				{
+					if (p[j])
+					{
+						long sq_mix = pack_sample(parts[j] * ratio);
+						*p[j]++ = sq_mix - prev[j];
+						prev[j] = sq_mix;
+					}
+				}
+			}
+
+			sq_accum = accum[0];
+			sq_part_accum[0] = accum[1];
+			sq_part_accum[1] = accum[2];
+			prev_sq_mix = prev[0];
+			sq_part_prev[0] = prev[1];
+			sq_part_prev[1] = prev[2];
 		}
 
 		// Here, even when doing accurate-seek, we still need 
@@ -505,6 +1097,13 @@ long Simple_Apu::read_samples( sample_t* out, long count )
 			p[1] = buf_tnd[1].buffer_;
 			p[2] = buf_tnd[2].buffer_;
 
+			// Routed channels get their part in their own buffer instead.
+			Blip_Buffer::buf_t_* q[3];
+			q[0] = chan_bus_mask & (1 << 2) ? buf_chan[2].buffer_ : NULL;
+			q[1] = chan_bus_mask & (1 << 3) ? buf_chan[3].buffer_ : NULL;
+			q[2] = chan_bus_mask & (1 << 4) ? buf_chan[4].buffer_ : NULL;
+			bool tnd_routed = (chan_bus_mask & (7 << 2)) != 0;
+
 			for (unsigned n = count; n--; )
 			{
 				// Sum all 3 channels, apply non-linear mixing.
@@ -536,9 +1135,22 @@ long Simple_Apu::read_samples( sample_t* out, long count )
 				float ratio = all_channels_nonlinear_mix / samples_sum;
 
 				float enabled_channels_non_linear_mix = 0.0f;
-				if (separate_tnd_channel_enabled[0]) enabled_channels_non_linear_mix += samples_float[0] * ratio;
-				if (separate_tnd_channel_enabled[1]) enabled_channels_non_linear_mix += samples_float[1] * ratio;
-				if (separate_tnd_channel_enabled[2]) enabled_channels_non_linear_mix += samples_float[2] * ratio;
+				if (separate_tnd_channel_enabled[0] && !q[0]) enabled_channels_non_linear_mix += samples_float[0] * ratio;
+				if (separate_tnd_channel_enabled[1] && !q[1]) enabled_channels_non_linear_mix += samples_float[1] * ratio;
+				if (separate_tnd_channel_enabled[2] && !q[2]) enabled_channels_non_linear_mix += samples_float[2] * ratio;
+
+				if (tnd_routed)
+				{
+					for (int j = 0; j < 3; j++)
+					{
+						if (q[j])
+						{
+							long part = separate_tnd_channel_enabled[j] ? pack_sample(samples_float[j] * ratio * tnd_volume) : 0;
+							*q[j]++ = tnd_skip ? 0 : part - tnd_part_prev[j];
+							tnd_part_prev[j] = part;
+						}
+					}
+				}
 
 				long nonlinear_tnd = pack_sample(enabled_channels_non_linear_mix * tnd_volume);
 
@@ -580,31 +1192,17 @@ long Simple_Apu::read_samples( sample_t* out, long count )
 			int lin_bass = lin.begin(buf);
 			int nonlin_bass = nonlin.begin(buf_tnd[0]);
 			
-			sample_t* p = out;
+			sample_t* p = bus_samples[expansion_none];
 
-			if (expansions & expansion_mask_epsm)
+			for (int n = count; n--; )
 			{
-				for (int i = 0; i < count; i++)
-				{
-					int s = lin.read() + nonlin.read();
-					lin.next(lin_bass);
-					nonlin.next(nonlin_bass);
-					*p++ = (blip_sample_t)clamp((int)(s + out_left[i]), -32768, 32767);
-					*p++ = (blip_sample_t)clamp((int)(s + out_right[i]), -32768, 32767);
-				}
-			}
-			else
-			{
-				for (int n = count; n--; )
-				{
-					int s = lin.read() + nonlin.read();
-					lin.next(lin_bass);
-					nonlin.next(nonlin_bass);
-					*p++ = s;
+				int s = lin.read() + nonlin.read();
+				lin.next(lin_bass);
+				nonlin.next(nonlin_bass);
+				*p++ = s;
 
-					if ((BOOST::int16_t)s != s)
-						p[-1] = 0x7FFF - (s >> 24);
-				}
+				if ((BOOST::int16_t)s != s)
+					p[-1] = 0x7FFF - (s >> 24);
 			}
 
 			lin.end(buf);
@@ -621,7 +1219,8 @@ long Simple_Apu::read_samples( sample_t* out, long count )
 		}
 		else
 		{
-			sample_t dummy[1024];
+			// The bus is not kept when discarding, it can serve as scratch.
+			sample_t* dummy = bus_samples[expansion_none];
 
 			buf.read_samples(dummy, count);
 			buf_tnd[0].read_samples(dummy, count);
@@ -638,56 +1237,75 @@ long Simple_Apu::read_samples( sample_t* out, long count )
 	{
 		assert(buf_fds.samples_avail() == count);
 
-		sample_t fds_samples[1024];
-		buf_fds.read_samples(fds_samples, 1024, false);
+		// Low-pass applied while integrating the blip buffer, in a single pass. The filter is
+		// recursive and rounds at every sample, so it stays scalar to remain bit-exact.
+		Blip_Reader reader;
+		int bass = reader.begin(buf_fds);
+
+		long alpha = fds_filter_alpha;
+		long one_minus_alpha = (1 << fds_filter_bits) - alpha;
+		long accum = fds_filter_accum;
+		sample_t* p = bus_samples[expansion_fds];
 
-		for (int i = 0; i < count; i++)
+		for (int n = count; n--; )
 		{
-			long fds_filter_one_minus_alpha = (1 << fds_filter_bits) - fds_filter_alpha;
-			fds_filter_accum = ((long)fds_samples[i] * fds_filter_alpha + fds_filter_accum * fds_filter_one_minus_alpha) >> fds_filter_bits;
+			long s = reader.read();
+			reader.next(bass);
 
-			if (out)
-			{
-				if (expansions & expansion_mask_epsm)
-				{
-					out[i * 2 + 0] = (blip_sample_t)clamp(out[i * 2 + 0] + fds_filter_accum, -32768, 32767);
-					out[i * 2 + 1] = (blip_sample_t)clamp(out[i * 2 + 1] + fds_filter_accum, -32768, 32767);
-				}
-				else
-				{
-					out[i] = (blip_sample_t)clamp(out[i] + fds_filter_accum, -32768, 32767);
-				}
-			}
+			if ((BOOST::int16_t)s != s)
+				s = (BOOST::int16_t)(0x7FFF - (s >> 24));
+
+			accum = (s * alpha + accum * one_minus_alpha) >> fds_filter_bits;
+			*p++ = (blip_sample_t)clamp(accum, -32768, 32767);
 		}
+
+		reader.end(buf_fds);
+		buf_fds.remove_samples(count);
+		fds_filter_accum = (int)accum;
 	}
 
-	if (expansions & (expansion_mask_vrc6 | expansion_mask_vrc7 | expansion_mask_mmc5 | expansion_mask_namco | expansion_mask_sunsoft))
+	for (int i = 1; i < expansion_count; i++)
 	{
-		assert(buf_exp.samples_avail() == count);
+		if (expansions & exp_bus_mask & (1 << (i - 1)))
+		{
+			assert(buf_exp[i].samples_avail() == count);
+			buf_exp[i].read_samples(bus_samples[i], bus_size, false);
+		}
+	}
 
-		sample_t buf_exp_samples[1024];
-		buf_exp.read_samples(buf_exp_samples, 1024, false);
-        
-		if (out)
+	for (int i = 0; i < channel_bus_count; i++)
+	{
+		if (chan_bus_mask & (1L << i))
 		{
-			for (int i = 0; i < count; i++)
-			{
-				if (expansions & expansion_mask_epsm)
-				{
-					out[i * 2 + 0] = (blip_sample_t)clamp(out[i * 2 + 0] + (long)buf_exp_samples[i], -32768, 32767);
-					out[i * 2 + 1] = (blip_sample_t)clamp(out[i * 2 + 1] + (long)buf_exp_samples[i], -32768, 32767);
-				}
-				else
-				{
-					out[i] = (blip_sample_t)clamp(out[i] + (long)buf_exp_samples[i], -32768, 32767);
-				}
-			}
+			assert(buf_chan[i].samples_avail() == count);
+			buf_chan[i].read_samples(chan_samples[i], bus_size, false);
 		}
 	}
 
+	bus_samples_count = out ? count : 0;
+
+	if (out)
+		mix_buses(~0, out);
+
+	advance_trigger_logs(count);
+
+	if (stats_enabled)
+	{
+		stats.samples += count;
+		stats.mix_seconds += stats_clock() - mix_start;
+	}
+
 	return count;
 }
 
+long Simple_Apu::read_bus_samples( int exp, sample_t* out, long count ) const
+{
+	if (count < bus_samples_count)
+		return 0;
+
+	return mix_buses(1 << exp, out);
+}
+
 void Simple_Apu::remove_samples(long s)
 {
 	buf.remove_samples(s);
@@ -704,9 +1322,10 @@ void Simple_Apu::remove_samples(long s)
 		buf_fds.remove_samples(s);
 	}
 
-	if (expansions & (expansion_mask_vrc6 | expansion_mask_vrc7 | expansion_mask_mmc5 | expansion_mask_namco | expansion_mask_sunsoft))
+	for (int i = 1; i < expansion_count; i++)
 	{
-		buf_exp.remove_samples(s);
+		if (expansions & exp_bus_mask & (1 << (i - 1)))
+			buf_exp[i].remove_samples(s);
 	}
 
 	if (expansions & expansion_mask_epsm)
@@ -714,6 +1333,14 @@ void Simple_Apu::remove_samples(long s)
 		buf_epsm_left.remove_samples(s);
 		buf_epsm_right.remove_samples(s);
 	}
+
+	for (int i = 0; i < channel_bus_count; i++)
+	{
+		if (chan_bus_mask & (1L << i))
+			buf_chan[i].remove_samples(s);
+	}
+
+	advance_trigger_logs(s);
 }
 
 void Simple_Apu::save_snapshot( apu_snapshot_t* out ) const
@@ -725,3 +1352,431 @@ void Simple_Apu::load_snapshot( apu_snapshot_t const& in )
 {
 	apu.load_snapshot( in );
 }
+
+Simple_Apu::state_header_t Simple_Apu::state_header() const
+{
+	state_header_t h;
+	memset(&h, 0, sizeof(h));
+	h.sample_rate = buf.sample_rate();
+	h.length = buf.length();
+	h.expansions = expansions;
+	h.tnd_mode = separate_tnd_mode;
+	h.chan_bus_mask = chan_bus_mask;
+	return h;
+}
+
+long Simple_Apu::save_state(unsigned char* out) const
+{
+	state_writer w = { out, 0 };
+
+	state_header_t h = state_header();
+	w(h);
+
+	w(time);
+	w(frame_length);
+	w(tnd_skip);
+	w(tnd_accum);
+	w(sq_accum);
+	w(prev_nonlinear_tnd);
+	w(prev_sq_mix);
+	w(fds_filter_accum);
+	w.state(apu);
+
+	if (expansions & expansion_mask_vrc6) w.state(vrc6);
+	if (expansions & expansion_mask_vrc7) w.state(vrc7);
+	if (expansions & expansion_mask_fds) w.state(fds);
+	if (expansions & expansion_mask_mmc5) w.state(mmc5);
+	if (expansions & expansion_mask_namco) w.state(namco);
+	if (expansions & expansion_mask_sunsoft) w.state(sunsoft);
+	if (expansions & expansion_mask_epsm) w.state(epsm);
+
+	w.state(buf);
+	w.state(buf_tnd[0]);
+	w.state(buf_tnd[1]);
+	w.state(buf_tnd[2]);
+	w.state(buf_fds);
+	for (int i = 1; i < expansion_count; i++)
+	{
+		if (expansions & exp_bus_mask & (1 << (i - 1)))
+			w.state(buf_exp[i]);
+	}
+	w.state(buf_epsm_left);
+	w.state(buf_epsm_right);
+
+	w(sq_part_accum);
+	w(sq_part_prev);
+	w(tnd_part_prev);
+	for (int i = 0; i < channel_bus_count; i++)
+	{
+		if (chan_bus_mask & (1L << i))
+			w.state(buf_chan[i]);
+	}
+
+	return w.size;
+}
+
+int Simple_Apu::load_state(const unsigned char* in)
+{
+	state_reader r = { in, 0, true };
+
+	// The layout below depends on the configuration, reject it before touching anything.
+	state_header_t h;
+	state_header_t cur = state_header();
+	r(h);
+	if (memcmp(&h, &cur, sizeof(h)))
+		return -1;
+
+	r(time);
+	r(frame_length);
+	r(tnd_skip);
+	r(tnd_accum);
+	r(sq_accum);
+	r(prev_nonlinear_tnd);
+	r(prev_sq_mix);
+	r(fds_filter_accum);
+	r.state(apu);
+
+	if (expansions & expansion_mask_vrc6) r.state(vrc6);
+	if (expansions & expansion_mask_vrc7) r.state(vrc7);
+	if (expansions & expansion_mask_fds) r.state(fds);
+	if (expansions & expansion_mask_mmc5) r.state(mmc5);
+	if (expansions & expansion_mask_namco) r.state(namco);
+	if (expansions & expansion_mask_sunsoft) r.state(sunsoft);
+	if (expansions & expansion_mask_epsm) r.state(epsm);
+
+	r.state(buf);
+	r.state(buf_tnd[0]);
+	r.state(buf_tnd[1]);
+	r.state(buf_tnd[2]);
+	r.state(buf_fds);
+	for (int i = 1; i < expansion_count; i++)
+	{
+		if (expansions & exp_bus_mask & (1 << (i - 1)))
+			r.state(buf_exp[i]);
+	}
+	r.state(buf_epsm_left);
+	r.state(buf_epsm_right);
+
+	r(sq_part_accum);
+	r(sq_part_prev);
+	r(tnd_part_prev);
+	for (int i = 0; i < channel_bus_count; i++)
+	{
+		if (chan_bus_mask & (1L << i))
+			r.state(buf_chan[i]);
+	}
+
+	// A buffer that does not fit leaves the state half loaded, the caller has to reset.
+	if (!r.ok)
+		return -1;
+
+	return 0;
+}
+
+int Simple_Apu::add_keyframe(int frame)
+{
+	assert(!seeking);
+
+	if (keyframes_count && frame <= keyframes[keyframes_count - 1].frame)
+		return -1;
+
+	if (keyframes_count == keyframes_capacity)
+	{
+		int new_capacity = keyframes_capacity ? keyframes_capacity * 2 : 64;
+		keyframe_t* new_keyframes = (keyframe_t*)realloc(keyframes, new_capacity * sizeof(keyframe_t));
+		if (!new_keyframes)
+			return -1;
+
+		keyframes = new_keyframes;
+		keyframes_capacity = new_capacity;
+	}
+
+	keyframe_t& k = keyframes[keyframes_count];
+	k.frame = frame;
+	k.size = save_state(NULL);
+	k.data = (unsigned char*)malloc(k.size);
+
+	if (!k.data)
+		return -1;
+
+	save_state(k.data);
+	keyframes_count++;
+
+	return 0;
+}
+
+int Simple_Apu::find_keyframe(int frame) const
+{
+	// Last keyframe at or before the requested frame.
+	int lo = 0;
+	int hi = keyframes_count;
+
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (keyframes[mid].frame <= frame)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo > 0 ? keyframes[lo - 1].frame : -1;
+}
+
+int Simple_Apu::load_keyframe(int frame)
+{
+	assert(!seeking);
+
+	for (int i = keyframes_count - 1; i >= 0; i--)
+	{
+		if (keyframes[i].frame == frame)
+		{
+			return load_state(keyframes[i].data);
+		}
+	}
+
+	return -1;
+}
+
+void Simple_Apu::clear_keyframes()
+{
+	for (int i = 0; i < keyframes_count; i++)
+		free(keyframes[i].data);
+
+	keyframes_count = 0;
+}
+
+void Simple_Apu::get_frame_telemetry(frame_telemetry_t* out)
+{
+	assert(!seeking);
+
+	memset(out, 0, sizeof(frame_telemetry_t));
+
+	out->frame = telemetry_frame;
+	out->expansions = expansions;
+
+	for (int i = 0; i < expansion_count; i++)
+	{
+		bool enabled = i == expansion_none || (expansions & (1 << (i - 1)));
+
+		for (int j = 0; j < telemetry_max_channels; j++)
+			out->triggers[i][j] = enabled && j < expansion_channel_counts[i] ? get_channel_trigger(i, j) : (int)trigger_none;
+	}
+
+	apu.get_register_values(&out->apu);
+
+	if (expansions & expansion_mask_vrc6) vrc6.get_register_values(&out->vrc6);
+	if (expansions & expansion_mask_vrc7) vrc7.get_register_values(&out->vrc7);
+	if (expansions & expansion_mask_mmc5) mmc5.get_register_values(&out->mmc5);
+	if (expansions & expansion_mask_sunsoft) sunsoft.get_register_values(&out->sunsoft);
+	if (expansions & expansion_mask_epsm) epsm.get_register_values(&out->epsm);
+
+	if (expansions & expansion_mask_fds)
+	{
+		fds.get_register_values(&out->fds);
+		out->fds_wave_pos = fds.get_wave_pos();
+	}
+
+	if (expansions & expansion_mask_namco)
+	{
+		namco.get_register_values(&out->namco);
+		for (int i = 0; i < Nes_Namco::osc_count; i++)
+			out->namco_wave_pos[i] = namco.get_wave_pos(i);
+	}
+}
+
+int Simple_Apu::set_telemetry_capture(int count)
+{
+	free(telemetry);
+
+	telemetry = NULL;
+	telemetry_capacity = 0;
+	telemetry_read = 0;
+	telemetry_count = 0;
+	telemetry_frame = 0;
+
+	if (count > 0)
+	{
+		telemetry = (frame_telemetry_t*)malloc(count * sizeof(frame_telemetry_t));
+		if (!telemetry)
+			return 0;
+
+		telemetry_capacity = count;
+	}
+
+	return 1;
+}
+
+int Simple_Apu::read_telemetry(frame_telemetry_t* out, int count)
+{
+	if (count > telemetry_count)
+		count = telemetry_count;
+
+	for (int i = 0; i < count; i++)
+	{
+		out[i] = telemetry[telemetry_read];
+		telemetry_read = (telemetry_read + 1) % telemetry_capacity;
+	}
+
+	telemetry_count -= count;
+
+	return count;
+}
+
+void Simple_Apu::set_channel_trigger_log(int exp, int idx, trigger_log_t* log)
+{
+	switch (exp)
+	{
+	case expansion_none: apu.set_trigger_log(idx, log); break;
+	case expansion_vrc6: vrc6.set_trigger_log(idx, log); break;
+	case expansion_vrc7: vrc7.set_trigger_log(idx, log); break;
+	case expansion_fds: fds.set_trigger_log(idx, log); break;
+	case expansion_mmc5: mmc5.set_trigger_log(idx, log); break;
+	case expansion_namco: namco.set_trigger_log(idx, log); break;
+	case expansion_sunsoft: sunsoft.set_trigger_log(idx, log); break;
+	case expansion_epsm: epsm.set_trigger_log(idx, log); break;
+	}
+}
+
+void Simple_Apu::attach_trigger_logs()
+{
+	for (int i = 0; i < expansion_count; i++)
+	{
+		for (int j = 0; j < expansion_channel_counts[i]; j++)
+			set_channel_trigger_log(i, j, trigger_logs[i][j].samples ? &trigger_logs[i][j] : NULL);
+	}
+}
+
+void Simple_Apu::advance_trigger_logs(long count)
+{
+	for (int i = 0; i < expansion_count; i++)
+	{
+		for (int j = 0; j < expansion_channel_counts[i]; j++)
+			trigger_logs[i][j].base += count;
+	}
+}
+
+int Simple_Apu::set_trigger_logs(int count)
+{
+	for (int i = 0; i < expansion_count; i++)
+	{
+		for (int j = 0; j < telemetry_max_channels; j++)
+			free(trigger_logs[i][j].samples);
+	}
+
+	memset(trigger_logs, 0, sizeof(trigger_logs));
+
+	if (count > 0)
+	{
+		int capacity = 1;
+		while (capacity < count)
+			capacity <<= 1;
+
+		for (int i = 0; i < expansion_count; i++)
+		{
+			if (i != expansion_none && !(expansions & (1 << (i - 1))))
+				continue;
+
+			for (int j = 0; j < expansion_channel_counts[i]; j++)
+			{
+				trigger_log_t& log = trigger_logs[i][j];
+
+				log.samples = (int*)malloc(capacity * sizeof(int));
+				if (!log.samples)
+				{
+					set_trigger_logs(0);
+					return 0;
+				}
+
+				log.capacity = capacity;
+			}
+		}
+	}
+
+	attach_trigger_logs();
+
+	return 1;
+}
+
+int Simple_Apu::read_trigger_log(int exp, int idx, int* out, int count)
+{
+	trigger_log_t& log = trigger_logs[exp][idx];
+
+	int avail = (int)(log.write - log.read);
+	if (count > avail)
+		count = avail;
+
+	for (int i = 0; i < count; i++)
+		out[i] = log.samples[log.read++ & (log.capacity - 1)];
+
+	return count;
+}
+
+void Simple_Apu::enable_stats(bool enable)
+{
+	stats_enabled = enable;
+
+	// Counting deltas costs a memory write per delta, the buffers only do it when asked.
+	buf.count_deltas_ = enable;
+	buf_tnd[0].count_deltas_ = enable;
+	buf_tnd[1].count_deltas_ = enable;
+	buf_tnd[2].count_deltas_ = enable;
+	buf_fds.count_deltas_ = enable;
+	buf_epsm_left.count_deltas_ = enable;
+	buf_epsm_right.count_deltas_ = enable;
+
+	for (int i = 0; i < expansion_count; i++)
+		buf_exp[i].count_deltas_ = enable;
+
+	for (int i = 0; i < channel_bus_count; i++)
+		buf_chan[i].count_deltas_ = enable;
+}
+
+void Simple_Apu::reset_stats()
+{
+	memset(&stats, 0, sizeof(stats));
+
+	stats_calc_base[0] = vrc7.opll_calc_count;
+	stats_calc_base[1] = epsm.opn2_clock_count;
+	stats_calc_base[2] = sunsoft.psg_calc_count;
+	stats_calc_base[3] = epsm.psg_calc_count;
+}
+
+void Simple_Apu::get_stats(stats_t* out) const
+{
+	*out = stats;
+	out->enabled = stats_enabled;
+	out->opll_calc = vrc7.opll_calc_count - stats_calc_base[0];
+	out->opn2_clock = epsm.opn2_clock_count - stats_calc_base[1];
+	out->psg_calc[0] = sunsoft.psg_calc_count - stats_calc_base[2];
+	out->psg_calc[1] = epsm.psg_calc_count - stats_calc_base[3];
+}
+
+long long Simple_Apu::stats_deltas() const
+{
+	long long deltas = buf.delta_count_ + 
+		buf_tnd[0].delta_count_ + buf_tnd[1].delta_count_ + buf_tnd[2].delta_count_ + 
+		buf_fds.delta_count_ + buf_epsm_left.delta_count_ + buf_epsm_right.delta_count_;
+
+	for (int i = 0; i < expansion_count; i++)
+		deltas += buf_exp[i].delta_count_;
+
+	for (int i = 0; i < channel_bus_count; i++)
+		deltas += buf_chan[i].delta_count_;
+
+	return deltas;
+}
+
+Simple_Apu::stats_probe_t Simple_Apu::stats_begin() const
+{
+	stats_probe_t probe;
+	probe.deltas = stats_deltas();
+	probe.time = stats_clock();
+	return probe;
+}
+
+void Simple_Apu::stats_end(int exp, const stats_probe_t& probe)
+{
+	stats.seconds[exp] += stats_clock() - probe.time;
+	stats.deltas[exp] += stats_deltas() - probe.deltas;
+}
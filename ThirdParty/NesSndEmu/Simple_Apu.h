@@ -27,6 +27,7 @@ public:
 	enum { expansion_namco      = 5 };
 	enum { expansion_sunsoft    = 6 };
 	enum { expansion_epsm		= 7 };
+	enum { expansion_count      = 8 };
 
 	enum { expansion_mask_none       = 0 };
 	enum { expansion_mask_vrc6       = 1 << 0 };
@@ -65,6 +66,17 @@ public:
 	// Set function for APU to call when it needs to read memory (DMC samples)
 	void dmc_reader( int (*callback)( void* user_data, cpu_addr_t ), void* user_data = NULL );
 	
+	// DPCM sample memory owned by the APU. Each bank is a copy of the data, mapped
+	// at 'addr'. Only the selected bank is visible to the DMC, a size of 0 clears the
+	// bank. Writing to the bank register (if set) selects the bank, like a mapper would.
+	enum { max_dmc_banks = 8 };
+	void set_dmc_memory( int bank, cpu_addr_t addr, const unsigned char* data, int size );
+	void select_dmc_bank( int bank );
+	void set_dmc_bank_register( cpu_addr_t addr );
+	const unsigned char* dmc_memory( int bank, cpu_addr_t* addr, int* size ) const;
+	int dmc_bank() const { return dmc_bank_idx; }
+	cpu_addr_t dmc_bank_register() const { return dmc_bank_reg; }
+	
 	// Set output sample rate
 	blargg_err_t sample_rate( long sample_rate, bool pal, int tnd_mode );
 	
@@ -93,6 +105,7 @@ public:
 	long samples_avail() const;
 
 	void enable_channel(int, int, bool);
+	static int channel_count(int exp); // 0 for an unknown chip.
 	
 	void reset_triggers();
 	int get_channel_trigger(int exp, int idx);
@@ -101,10 +114,33 @@ public:
 	void bass_freq(int exp, int bass_freq);
 	void set_expansion_volume(int expansion, double evolume);
 
+	// Output buses. Each chip renders in its own bus (the 2A03 bus being the square + TND
+	// mix and the EPSM one being stereo), with its own treble (treble_eq), bass (bass_freq,
+	// 'expansion_none' sets every bus except FDS) and gain (set_expansion_volume). The
+	// buses are mixed together at the end of read_samples(). The output is stereo when
+	// EPSM is enabled or when set_stereo(true) was called, each bus is then panned from
+	// -1 (left) to 1 (right), 0 being both sides at full volume.
+	void set_bus_pan(int exp, double pan);
+	void set_stereo(bool stereo);
+	bool is_stereo() const { return stereo || (expansions & expansion_mask_epsm) != 0; }
+
+	// Channel mix. A channel given a gain other than 1 or a pan other than 0 renders in a
+	// buffer of its own from then on (until the next sample_rate()), mixed after the buses
+	// in the same emulation pass. Like enable_channel(), it is meant to be set before
+	// playing. Both squares share their nonlinear mix, each getting its part of it. The
+	// triangle, noise and DPCM can only be routed in the separate TND modes, FDS has its
+	// bus gains replaced and EPSM channels are only panned by their own registers.
+	void set_channel_mix(int exp, int idx, double volume, double pan);
+
 	// Read at most 'count' samples and return number of samples actually read
 	typedef blip_sample_t sample_t;
 	long read_samples( sample_t* buf, long buf_size );
 
+	// Stems. Contribution of one bus to the samples returned by the last read_samples(),
+	// in the same format (panned, interleaved when stereo). Returns 0 if that call was
+	// only discarding samples (NULL buffer).
+	long read_bus_samples( int exp, sample_t* buf, long buf_size ) const;
+
 	// Discard 'count' samples.
 	void remove_samples(long buf_size);
 	
@@ -116,9 +152,79 @@ public:
 	void stop_seeking();
 	bool is_seeking() const { return seeking; }
 
+	// Seek keyframes. A keyframe is a snapshot of the enabled chips and of the mixer,
+	// taken at the end of a frame once the samples have been read. Loading one restores
+	// the exact state at that frame, so seeking only needs to emulate what comes after.
+	// Keyframes must be added in increasing frame order. Changing the sample rate, the
+	// expansions or the channel routing clears them, loading fails on any mismatch.
+	int add_keyframe(int frame);
+	int find_keyframe(int frame) const;
+	int load_keyframe(int frame);
+	void clear_keyframes();
+
+	// Per-frame telemetry, everything the register viewer and the oscilloscopes need 
+	// to know about the last frame. Only the enabled chips are filled, the rest is zero
+	// and the triggers of channels that do not exist are trigger_none.
+	enum { telemetry_max_channels = 16 };
+	struct frame_telemetry_t
+	{
+		int frame; // Frames ended since capture was last enabled.
+		int expansions;
+		int fds_wave_pos;
+		int namco_wave_pos[8];
+		int triggers[expansion_count][telemetry_max_channels];
+		apu_register_values apu;
+		vrc6_register_values vrc6;
+		vrc7_register_values vrc7;
+		fds_register_values fds;
+		mmc5_register_values mmc5;
+		n163_register_values namco;
+		sunsoft5b_register_values sunsoft;
+		epsm_register_values epsm;
+	};
+	void get_frame_telemetry(frame_telemetry_t* out);
+
+	// Telemetry capture, for offline exports. While enabled, end_frame() appends the
+	// telemetry of every frame (except when seeking) to a ring of 'count' frames, the 
+	// oldest frames are dropped when it is full. A count of 0 disables capture.
+	// Returns 0 if out of memory.
+	int set_telemetry_capture(int count);
+	int read_telemetry(frame_telemetry_t* out, int count);
+
+	// Trigger logs. While enabled, every trigger of every channel is logged, not only 
+	// the one closest to the middle of the frame. Times are in output samples, counted
+	// from when logging was enabled. Each channel keeps the last 'count' triggers 
+	// (rounded up to a power of two), a count of 0 disables logging. Only the chips that
+	// are enabled at that time are logged. Returns 0 if out of memory.
+	int set_trigger_logs(int count);
+	int read_trigger_log(int exp, int idx, int* out, int count);
+
+	// Profiling counters, to get a per-chip cost breakdown of an export. Disabled by 
+	// default, where they cost almost nothing. Once enabled, every call into a chip 
+	// (register writes, skip_cycles() and end_frame()) is timed and the Blip deltas it 
+	// emitted are counted. The per-chip arrays are indexed by expansion, 'expansion_none' 
+	// being the 2A03. Nothing is cleared by reset(), only by reset_stats().
+	struct stats_t
+	{
+		int frames;             // Frames ended, not counting the ones while seeking.
+		int enabled;
+		long long samples;      // Samples mixed by read_samples().
+		double mix_seconds;     // Time spent in read_samples().
+		long long opll_calc;    // OPLL_calc() calls (VRC7).
+		long long opn2_clock;   // OPN2_Clock() calls (EPSM).
+		long long psg_calc[2];  // PSG_calc() calls (S5B, EPSM).
+		long long cycles[expansion_count];  // CPU cycles emulated.
+		long long deltas[expansion_count];  // Blip deltas emitted.
+		double seconds[expansion_count];    // Time spent emulating.
+	};
+	void enable_stats(bool enable);
+	void get_stats(stats_t* out) const;
+	void reset_stats();
+
 private:
 	bool pal_mode;
 	bool seeking;
+	bool stereo;
 	float tnd_volume;
 	int expansions;
 	int separate_tnd_mode;
@@ -130,6 +236,71 @@ private:
 	long sq_accum;
 	long prev_nonlinear_tnd;
 	long prev_sq_mix;
+	struct dmc_bank_t
+	{
+		unsigned char* data;
+		cpu_addr_t addr;
+		int size;
+		int capacity;
+	};
+	struct keyframe_t
+	{
+		int frame;
+		long size;
+		unsigned char* data;
+	};
+	// Configuration a keyframe was saved with, it can only be loaded back into the same one.
+	struct state_header_t
+	{
+		long sample_rate;
+		int length;
+		int expansions;
+		int tnd_mode;
+		long chan_bus_mask;
+	};
+	keyframe_t* keyframes;
+	int keyframes_count;
+	int keyframes_capacity;
+	frame_telemetry_t* telemetry;
+	int telemetry_capacity;
+	int telemetry_read;
+	int telemetry_count;
+	int telemetry_frame;
+	trigger_log_t trigger_logs[expansion_count][telemetry_max_channels];
+	void set_channel_trigger_log(int exp, int idx, trigger_log_t* log);
+	void attach_trigger_logs();
+	void advance_trigger_logs(long count);
+	struct stats_probe_t
+	{
+		double time;
+		long long deltas;
+	};
+	bool stats_enabled;
+	stats_t stats;
+	long long stats_calc_base[4];
+	stats_probe_t stats_begin() const;
+	void stats_end(int exp, const stats_probe_t& probe);
+	long long stats_deltas() const;
+	state_header_t state_header() const;
+	long save_state(unsigned char* out) const;
+	int load_state(const unsigned char* in);
+	// Register ranges of the enabled chips, in chip order ('expansion_none' is the 2A03).
+	// Built by set_audio_expansions(), so writes only go to the chips that own the register.
+	struct write_range_t
+	{
+		cpu_addr_t first;
+		cpu_addr_t last;
+		int exp;
+	};
+	enum { max_write_ranges = 16 };
+	write_range_t write_ranges[max_write_ranges];
+	int write_range_count;
+	void build_write_ranges();
+	void write_chip_register(int exp, blip_time_t clk, cpu_addr_t addr, int data);
+	void write_chip_shadow_register(int exp, cpu_addr_t addr, int data);
+	dmc_bank_t dmc_banks[max_dmc_banks];
+	int dmc_bank_idx;
+	cpu_addr_t dmc_bank_reg;
 	Nes_Apu apu;
 	Nes_Vrc6 vrc6;
 	Nes_Vrc7 vrc7;
@@ -142,13 +313,46 @@ private:
 	Blip_Buffer buf;
 	Blip_Buffer buf_tnd[3]; // [0] is used normally, [0][1][2] are only used in "separate_tnd_mode", for stereo/separate channels export.
 	Blip_Buffer buf_fds;
-	Blip_Buffer buf_exp;
+	Blip_Buffer buf_exp[expansion_count]; // Only VRC6, VRC7, MMC5, N163 and S5B use theirs.
 	Blip_Buffer buf_epsm_left;
 	Blip_Buffer buf_epsm_right;
 	blip_time_t time;
 	blip_time_t frame_length;
 	blip_time_t clock(blip_time_t t = 4) { return time += t; }
 
+	// Samples of each bus for the last read_samples(), EPSM right being after the last expansion.
+	// A read can empty the whole blip buffers, so sample_rate() sizes the buses like them.
+	enum { exp_bus_mask = expansion_mask_vrc6 | expansion_mask_vrc7 | expansion_mask_mmc5 | expansion_mask_namco | expansion_mask_sunsoft };
+	enum { bus_epsm_right = expansion_count };
+	sample_t* bus_samples[expansion_count + 1];
+	sample_t* bus_samples_data;
+	long bus_size;
+	long bus_samples_count;
+	bool resize_buses(long size);
+	double bus_pan[expansion_count];
+	long mix_buses(int exp_mask, sample_t* out) const;
+
+	// Routed channels (see set_channel_mix()), bit N of 'chan_bus_mask' being 'buf_chan[N]'.
+	// The squares synthesize in their buffers, the TND ones only carry their part of the
+	// nonlinear mix, written by read_samples().
+	enum { channel_bus_count = 27 };
+	struct channel_mix_t
+	{
+		bool routed;
+		float volume;
+		float pan;
+	};
+	channel_mix_t channel_mix[expansion_count][telemetry_max_channels];
+	int channels_disabled[expansion_count];
+	long chan_bus_mask;
+	long sq_part_accum[2];
+	long sq_part_prev[2];
+	long tnd_part_prev[3];
+	Blip_Buffer buf_chan[channel_bus_count];
+	sample_t* chan_samples[channel_bus_count]; // 'bus_size' samples, allocated when routed.
+	void reset_channel_mix();
+	void update_channel_output(int exp, int idx);
+
 	const long fds_filter_bits = 12;
 };
 
@@ -0,0 +1,789 @@
+// Headless benchmark and regression harness. Replays register logs (see Register_Log.h)
+// through Simple_Apu, reports how fast each log is emulated and mixed, and compares a
+// hash of the output against the golden hash stored next to each log ("<log>.hash").
+//
+//   nes_snd_bench -generate <dir>        Write the synthetic logs (one per chip, plus
+//                                        multi_logs and variant_logs) in <dir>.
+//   nes_snd_bench [options] <log> ...    Replay the logs.
+//
+//   -repeat <n>   Replay each log n times, the fastest run is reported (default 3).
+//   -update       Write the golden hashes instead of comparing them.
+//   -wav          Also write the output of each log to "<log>.wav".
+//   -stats        Also print the cost of each chip (see Simple_Apu::stats_t), measured
+//                 on an extra replay since the counters slow the emulation down a bit.
+//   -jobs <n>     Replay all the logs at once on n threads (0 = one per core) through
+//                 Batch_Render, like the nightly renders, and only check the hashes.
+//
+// Returns EXIT_FAILURE if a log cannot be replayed or if a hash does not match.
+// The logs in bench_logs/ cover every chip, a few combinations of them (see
+// multi_logs) and a few paths the usual notes miss (see variant_logs), "nes_snd_bench bench_logs/*.nsrl" must pass before and after any
+// change to the emulation or the mixing. Logs of real songs can be captured from the
+// app with NesApuStartCapture().
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Batch_Render.h"
+#include "Register_Log.h"
+#include "Wave_Writer.hpp"
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char* const chip_names [Simple_Apu::expansion_count] =
+{
+	"2a03", "vrc6", "vrc7", "fds", "mmc5", "n163", "s5b", "epsm"
+};
+
+static std::string chips_string( int expansions )
+{
+	std::string s = chip_names [0];
+	for ( int i = 1; i < Simple_Apu::expansion_count; i++ )
+	{
+		if ( expansions & (1 << (i - 1)) )
+		{
+			s += "+";
+			s += chip_names [i];
+		}
+	}
+	return s;
+}
+
+// 64-bit FNV-1a of the samples, in little-endian order.
+struct pcm_hash_t
+{
+	unsigned long long h;
+
+	pcm_hash_t() : h( 0xcbf29ce484222325ULL ) { }
+
+	void add( const blip_sample_t* samples, long count )
+	{
+		for ( long i = 0; i < count; i++ )
+		{
+			h = (h ^ (unsigned char) (samples [i] & 0xff)) * 0x100000001b3ULL;
+			h = (h ^ (unsigned char) ((samples [i] >> 8) & 0xff)) * 0x100000001b3ULL;
+		}
+	}
+};
+
+struct run_result_t
+{
+	long frames;
+	long samples;
+	double emulate_time;
+	double mix_time;
+	unsigned long long hash;
+};
+
+static double seconds_since( bench_clock::time_point start )
+{
+	return std::chrono::duration<double>( bench_clock::now() - start ).count();
+}
+
+// Emulation (register writes + end of frame, where the chips run into their
+// Blip_Buffers) and mixing (read_samples, where the buffers are synthesized,
+// mixed and filtered) are timed separately.
+static bool replay( Register_Log& log, run_result_t& result, Wave_Writer* wave, Simple_Apu::stats_t* stats = NULL )
+{
+	static Simple_Apu apu;
+	static std::vector<blip_sample_t> buf; // Grown to the largest frame, read_samples() takes a whole frame.
+
+	pcm_hash_t hash;
+	memset( &result, 0, sizeof result );
+	log.rewind();
+
+	apu.enable_stats( stats != NULL );
+	apu.reset_stats();
+
+	while ( true )
+	{
+		bench_clock::time_point start = bench_clock::now();
+		int status = log.replay_frame( apu );
+		result.emulate_time += seconds_since( start );
+
+		if ( status < 0 )
+			return false;
+		if ( status == 0 )
+			break;
+
+		long count = apu.samples_avail();
+		long values = count * (apu.is_stereo() ? 2 : 1);
+		if ( buf.size() < (size_t) values + 1 )
+			buf.resize( values + 1 );
+
+		start = bench_clock::now();
+		apu.read_samples( &buf [0], count );
+		result.mix_time += seconds_since( start );
+
+		hash.add( &buf [0], values );
+		if ( wave )
+			wave->write( &buf [0], values );
+
+		result.frames++;
+		result.samples += count;
+	}
+
+	if ( stats )
+	{
+		apu.get_stats( stats );
+		apu.enable_stats( false );
+	}
+
+	result.hash = hash.h;
+	return true;
+}
+
+static void print_stats( Simple_Apu::stats_t const& stats, int expansions )
+{
+	double total = stats.mix_seconds;
+	for ( int i = 0; i < Simple_Apu::expansion_count; i++ )
+		total += stats.seconds [i];
+
+	for ( int i = 0; i < Simple_Apu::expansion_count; i++ )
+	{
+		if ( i && !(expansions & (1 << (i - 1))) )
+			continue;
+
+		long long calls = 0;
+		switch ( i )
+		{
+			case Simple_Apu::expansion_vrc7:    calls = stats.opll_calc; break;
+			case Simple_Apu::expansion_sunsoft: calls = stats.psg_calc [0]; break;
+			case Simple_Apu::expansion_epsm:    calls = stats.opn2_clock + stats.psg_calc [1]; break;
+		}
+
+		printf( "  %-8s %12lld cycles %10lld deltas %10lld core calls %8.2f us/frame %5.1f%%\n",
+			chip_names [i], stats.cycles [i], stats.deltas [i], calls,
+			stats.frames ? stats.seconds [i] * 1e6 / stats.frames : 0.0,
+			total > 0 ? stats.seconds [i] * 100.0 / total : 0.0 );
+	}
+
+	printf( "  %-8s %12lld samples %38s %8.2f us/frame %5.1f%%\n",
+		"mix", stats.samples, "",
+		stats.frames ? stats.mix_seconds * 1e6 / stats.frames : 0.0,
+		total > 0 ? stats.mix_seconds * 100.0 / total : 0.0 );
+}
+
+static bool read_golden( const std::string& path, unsigned long long& hash )
+{
+	FILE* f = fopen( path.c_str(), "r" );
+	if ( !f )
+		return false;
+
+	bool success = fscanf( f, "%llx", &hash ) == 1;
+	fclose( f );
+	return success;
+}
+
+static bool write_golden( const std::string& path, unsigned long long hash )
+{
+	FILE* f = fopen( path.c_str(), "w" );
+	if ( !f )
+		return false;
+
+	fprintf( f, "%016llx\n", hash );
+	return fclose( f ) == 0;
+}
+
+static int bench( int count, char** paths, int repeat, bool update, bool wav, bool stats )
+{
+	int failures = 0;
+
+	printf( "%-32s %-16s %7s %10s %12s %12s %10s  %s\n",
+		"log", "chips", "frames", "samples", "emu smp/s", "mix smp/s", "realtime", "hash" );
+
+	for ( int i = 0; i < count; i++ )
+	{
+		Register_Log log;
+		if ( !log.load( paths [i] ) )
+		{
+			printf( "%-32s cannot be loaded\n", paths [i] );
+			failures++;
+			continue;
+		}
+
+		std::string name = paths [i];
+		size_t slash = name.find_last_of( "/\\" );
+		if ( slash != std::string::npos )
+			name = name.substr( slash + 1 );
+
+		run_result_t best;
+		memset( &best, 0, sizeof best );
+		bool valid = true;
+
+		for ( int r = 0; r < repeat && valid; r++ )
+		{
+			Wave_Writer* wave = NULL;
+			if ( wav && r == 0 )
+			{
+				wave = new Wave_Writer( log.sample_rate(), (std::string( paths [i] ) + ".wav").c_str() );
+				wave->stereo( log.is_stereo() );
+			}
+
+			run_result_t result;
+			valid = replay( log, result, wave );
+			delete wave;
+
+			// Replays must be deterministic, otherwise the hashes are meaningless.
+			if ( r > 0 && result.hash != best.hash )
+				valid = false;
+
+			if ( r == 0 || result.emulate_time + result.mix_time < best.emulate_time + best.mix_time )
+				best = result;
+		}
+
+		if ( !valid )
+		{
+			printf( "%-32s replay failed or is not deterministic\n", name.c_str() );
+			failures++;
+			continue;
+		}
+
+		std::string golden_path = std::string( paths [i] ) + ".hash";
+		const char* status;
+
+		if ( update )
+		{
+			status = write_golden( golden_path, best.hash ) ? "updated" : "cannot write";
+		}
+		else
+		{
+			unsigned long long golden;
+			if ( !read_golden( golden_path, golden ) )
+				status = "no golden";
+			else if ( golden == best.hash )
+				status = "ok";
+			else
+				status = "MISMATCH";
+
+			if ( strcmp( status, "ok" ) )
+				failures++;
+		}
+
+		double audio_time = log.sample_rate() ? best.samples / (double) log.sample_rate() : 0.0;
+		double total_time = best.emulate_time + best.mix_time;
+
+		printf( "%-32s %-16s %7ld %10ld %12.0f %12.0f %9.1fx  %016llx %s\n",
+			name.c_str(),
+			chips_string( log.expansions() ).c_str(),
+			best.frames,
+			best.samples,
+			best.emulate_time > 0 ? best.samples / best.emulate_time : 0.0,
+			best.mix_time > 0 ? best.samples / best.mix_time : 0.0,
+			total_time > 0 ? audio_time / total_time : 0.0,
+			best.hash,
+			status );
+
+		if ( stats )
+		{
+			Simple_Apu::stats_t chip_stats;
+			run_result_t result;
+			if ( replay( log, result, NULL, &chip_stats ) && result.hash == best.hash )
+				print_stats( chip_stats, log.expansions() );
+			else
+				printf( "  profiled replay does not match\n" );
+		}
+	}
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Every log is a job of its own, the output goes to a buffer sized from the frame count
+// and hashed once everything is done.
+static int batch( int count, char** paths, int threads )
+{
+	std::vector<Batch_Render::job_t> jobs( count );
+	std::vector<std::vector<blip_sample_t> > outs( count );
+	Batch_Render render;
+	int failures = 0;
+
+	render.start( threads );
+
+	bench_clock::time_point start = bench_clock::now();
+
+	for ( int i = 0; i < count; i++ )
+	{
+		Register_Log log;
+		long size = 0;
+		if ( log.load( paths [i] ) )
+			size = (log.frame_count() + 1) * (log.sample_rate() / 50 + 2) * 2; // PAL frames, stereo.
+
+		outs [i].resize( size ? size : 1 );
+
+		Batch_Render::job_t& job = jobs [i];
+		memset( &job, 0, sizeof job );
+		job.log_path = paths [i];
+		job.expansions = -1;
+		job.out = &outs [i] [0];
+		job.out_size = size;
+		render.submit( &job );
+	}
+
+	render.wait();
+
+	double time = seconds_since( start );
+	double audio_time = 0.0;
+
+	for ( int i = 0; i < count; i++ )
+	{
+		Batch_Render::job_t const& job = jobs [i];
+		const char* status;
+		pcm_hash_t hash;
+		unsigned long long golden;
+
+		hash.add( &outs [i] [0], job.samples );
+
+		if ( job.status != Batch_Render::status_ok )
+			status = "FAILED";
+		else if ( !read_golden( std::string( paths [i] ) + ".hash", golden ) )
+			status = "no golden";
+		else if ( golden != hash.h )
+			status = "MISMATCH";
+		else
+			status = "ok";
+
+		if ( strcmp( status, "ok" ) )
+			failures++;
+
+		if ( job.sample_rate_out && job.channels )
+			audio_time += job.samples / (double) (job.sample_rate_out * job.channels);
+
+		printf( "%-32s %10ld  %016llx %s\n", paths [i], job.samples, hash.h, status );
+	}
+
+	printf( "%d logs on %d threads in %.2f s, %.1fx realtime\n",
+		count, render.thread_count(), time, time > 0 ? audio_time / time : 0.0 );
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Synthetic logs, one per chip, each playing random notes on every channel of
+// the chip for 10 seconds. They are only meant to keep the chips busy, not to
+// sound good. A fixed seed keeps them identical from one run to the next.
+
+static const int generate_frames = 600;
+static const long generate_rate = 44100;
+static unsigned long generate_seed;
+
+static int rnd( int range )
+{
+	generate_seed = generate_seed * 1103515245 + 12345;
+	return (int) ((generate_seed >> 16) & 0x7fff) % range;
+}
+
+static void begin_log( Register_Log& log, int expansions, unsigned long seed )
+{
+	generate_seed = seed;
+
+	log.init( generate_rate, 16, false, Simple_Apu::tnd_mode_single, expansions );
+	log.reset();
+	log.expansion_volume( 0, 1.0 );
+	for ( int exp = 1; exp < Simple_Apu::expansion_count; exp++ )
+	{
+		if ( expansions & (1 << (exp - 1)) )
+			log.expansion_volume( exp, 1.0 );
+	}
+
+	// Same as NesApu.InitAndReset().
+	log.write( 0x4015, 0x0f );
+	log.write( 0x4008, 0x80 );
+	log.write( 0x400f, 0x00 );
+	log.write( 0x4000, 0x30 );
+	log.write( 0x4004, 0x30 );
+	log.write( 0x400c, 0x30 );
+	log.write( 0x4001, 0x08 );
+	log.write( 0x4005, 0x08 );
+}
+
+static void write_2a03( Register_Log& log, int f )
+{
+	if ( f == 0 )
+	{
+		unsigned char dmc [0x1000];
+		for ( int i = 0; i < (int) sizeof dmc; i++ )
+			dmc [i] = (unsigned char) rnd( 256 );
+		log.dmc_memory( 0, 0xc000, dmc, sizeof dmc );
+		log.write( 0x4010, 0x0f );
+		log.write( 0x4012, 0x00 );
+		log.write( 0x4013, 0xff );
+		log.write( 0x4008, 0xff );
+	}
+
+	if ( f % 8 == 0 )
+	{
+		for ( int addr = 0x4000; addr <= 0x4008; addr += 4 )
+		{
+			int period = 0x80 + rnd( 0x600 );
+			log.write( addr + 2, period & 0xff );
+			log.write( addr + 3, (period >> 8) | 0xf8 );
+		}
+		log.write( 0x400e, rnd( 256 ) & 0x8f );
+		log.write( 0x400f, 0xf8 );
+	}
+
+	if ( f % 64 == 0 )
+		log.write( 0x4015, 0x1f );
+
+	int volume = 15 - (f % 8) * 2;
+	log.write( 0x4000, 0xb0 | volume );
+	log.write( 0x4004, 0x70 | volume );
+	log.write( 0x400c, 0x30 | volume );
+}
+
+// Same, with the triangle up in the periods below 0x80, where a step is shorter than a
+// sample and Nes_Triangle sums the steps with offset_batch().
+static void write_2a03_high( Register_Log& log, int f )
+{
+	write_2a03( log, f );
+
+	if ( f % 8 == 0 )
+	{
+		int period = 2 + rnd( 0x7e );
+		log.write( 0x400a, period );
+		log.write( 0x400b, 0xf8 );
+	}
+}
+
+static void write_vrc6( Register_Log& log, int f )
+{
+	if ( f == 0 )
+		log.write( 0x9003, 0x00 );
+
+	if ( f % 8 == 0 )
+	{
+		for ( int addr = 0x9000; addr <= 0xb000; addr += 0x1000 )
+		{
+			int period = 0x80 + rnd( 0xe00 );
+			log.write( addr + 1, period & 0xff );
+			log.write( addr + 2, 0x80 | (period >> 8) );
+		}
+	}
+
+	int volume = 15 - (f % 8) * 2;
+	log.write( 0x9000, 0x40 | volume );
+	log.write( 0xa000, 0x20 | volume );
+	log.write( 0xb000, volume * 2 );
+}
+
+static void write_vrc7( Register_Log& log, int f )
+{
+	if ( f == 0 )
+		log.write( 0xe000, 0x00 );
+
+	if ( f % 8 == 0 )
+	{
+		for ( int ch = 0; ch < 6; ch++ )
+		{
+			int fnum = 0x100 + rnd( 0xff );
+			log.write( 0x9010, 0x20 + ch ); log.write( 0x9030, 0x00 );
+			log.write( 0x9010, 0x30 + ch ); log.write( 0x9030, ((1 + rnd( 15 )) << 4) | rnd( 4 ) );
+			log.write( 0x9010, 0x10 + ch ); log.write( 0x9030, fnum & 0xff );
+			log.write( 0x9010, 0x20 + ch ); log.write( 0x9030, 0x10 | ((2 + rnd( 4 )) << 1) | (fnum >> 8) );
+		}
+	}
+}
+
+static void write_fds( Register_Log& log, int f )
+{
+	if ( f == 0 )
+	{
+		log.write( 0x4089, 0x80 );
+		for ( int i = 0; i < 64; i++ )
+			log.write( 0x4040 + i, i < 32 ? i * 2 : (63 - i) * 2 );
+		log.write( 0x4089, 0x00 );
+		log.write( 0x4084, 0x80 | 0x10 );
+		log.write( 0x4087, 0x80 );
+		for ( int i = 0; i < 32; i++ )
+			log.write( 0x4088, i < 16 ? 1 : 7 );
+		log.write( 0x4086, 0x40 );
+		log.write( 0x4087, 0x00 );
+	}
+
+	if ( f % 8 == 0 )
+	{
+		int period = 0x100 + rnd( 0x600 );
+		log.write( 0x4082, period & 0xff );
+		log.write( 0x4083, period >> 8 );
+		log.write( 0x4085, 0x00 );
+	}
+
+	log.write( 0x4080, 0x80 | (32 - (f % 8) * 4) );
+}
+
+static void write_mmc5( Register_Log& log, int f )
+{
+	if ( f == 0 )
+		log.write( 0x5015, 0x03 );
+
+	if ( f % 8 == 0 )
+	{
+		for ( int addr = 0x5000; addr <= 0x5004; addr += 4 )
+		{
+			int period = 0x80 + rnd( 0x600 );
+			log.write( addr + 2, period & 0xff );
+			log.write( addr + 3, (period >> 8) | 0xf8 );
+		}
+	}
+
+	int volume = 15 - (f % 8) * 2;
+	log.write( 0x5000, 0xb0 | volume );
+	log.write( 0x5004, 0x70 | volume );
+}
+
+static void write_n163( Register_Log& log, int f )
+{
+	if ( f == 0 )
+	{
+		// 8 waves of 16 samples, auto-increment from address 0.
+		log.write( 0xf800, 0x80 );
+		for ( int i = 0; i < 64; i++ )
+			log.write( 0x4800, rnd( 256 ) );
+	}
+
+	if ( f % 8 == 0 )
+	{
+		for ( int ch = 0; ch < 8; ch++ )
+		{
+			long freq = 0x1000 + rnd( 0x7000 );
+			log.write( 0xf800, 0x80 | (0x40 + ch * 8) );
+			log.write( 0x4800, freq & 0xff );
+			log.write( 0x4800, 0x00 );
+			log.write( 0x4800, (freq >> 8) & 0xff );
+			log.write( 0x4800, 0x00 );
+			log.write( 0x4800, (0x100 - 16) | ((freq >> 16) & 3) );
+			log.write( 0x4800, 0x00 );
+			log.write( 0x4800, ch * 16 );
+			log.write( 0x4800, (ch == 7 ? 0x70 : 0x00) | 15 );
+		}
+	}
+}
+
+static void write_ssg( Register_Log& log, int f, cpu_addr_t select, cpu_addr_t data, int skip_addr, int skip_data )
+{
+	if ( f == 0 )
+	{
+		log.write( select, 0x07 ); if ( skip_addr ) log.skip_cycles( skip_addr );
+		log.write( data, 0x38 );   if ( skip_data ) log.skip_cycles( skip_data );
+	}
+
+	for ( int ch = 0; ch < 3; ch++ )
+	{
+		if ( f % 8 == 0 )
+		{
+			int period = 0x40 + rnd( 0x400 );
+			log.write( select, ch * 2 + 0 ); if ( skip_addr ) log.skip_cycles( skip_addr );
+			log.write( data, period & 0xff ); if ( skip_data ) log.skip_cycles( skip_data );
+			log.write( select, ch * 2 + 1 ); if ( skip_addr ) log.skip_cycles( skip_addr );
+			log.write( data, period >> 8 );   if ( skip_data ) log.skip_cycles( skip_data );
+		}
+
+		log.write( select, 0x08 + ch );   if ( skip_addr ) log.skip_cycles( skip_addr );
+		log.write( data, 15 - (f % 8) );  if ( skip_data ) log.skip_cycles( skip_data );
+	}
+}
+
+static void write_s5b( Register_Log& log, int f )
+{
+	write_ssg( log, f, 0xc000, 0xe000, 0, 0 );
+}
+
+static void write_epsm_fm( Register_Log& log, int reg, int data )
+{
+	// Same delays as the player, see NesApu.EpsmCycleAddrSkip/EpsmCycleDataSkip.
+	log.write( 0x401c, reg );  log.skip_cycles( 4 );
+	log.write( 0x401d, data ); log.skip_cycles( 20 );
+}
+
+static void write_epsm( Register_Log& log, int f )
+{
+	if ( f == 0 )
+	{
+		// Same as NesApu.InitAndReset().
+		write_epsm_fm( log, 0x29, 0x80 );
+		write_epsm_fm( log, 0x27, 0x00 );
+		write_epsm_fm( log, 0x11, 0x37 );
+
+		for ( int ch = 0; ch < 3; ch++ )
+		{
+			for ( int op = 0; op < 16; op += 4 )
+			{
+				write_epsm_fm( log, 0x30 + op + ch, 0x01 );
+				write_epsm_fm( log, 0x40 + op + ch, 0x10 );
+				write_epsm_fm( log, 0x50 + op + ch, 0x1f );
+				write_epsm_fm( log, 0x60 + op + ch, 0x05 );
+				write_epsm_fm( log, 0x70 + op + ch, 0x02 );
+				write_epsm_fm( log, 0x80 + op + ch, 0x24 );
+			}
+			write_epsm_fm( log, 0xb0 + ch, 0x07 );
+			write_epsm_fm( log, 0xb4 + ch, 0xc0 );
+		}
+	}
+
+	write_ssg( log, f, 0x401c, 0x401d, 4, 20 );
+
+	if ( f % 8 == 0 )
+	{
+		for ( int ch = 0; ch < 3; ch++ )
+		{
+			int fnum = 0x200 + rnd( 0x400 );
+			write_epsm_fm( log, 0x28, ch );
+			write_epsm_fm( log, 0xa4 + ch, ((2 + rnd( 4 )) << 3) | (fnum >> 8) );
+			write_epsm_fm( log, 0xa0 + ch, fnum & 0xff );
+			write_epsm_fm( log, 0x28, 0xf0 | ch );
+		}
+	}
+}
+
+typedef void (*write_func_t)( Register_Log&, int );
+
+static const write_func_t write_funcs [Simple_Apu::expansion_count] =
+{
+	write_2a03, write_vrc6, write_vrc7, write_fds, write_mmc5, write_n163, write_s5b, write_epsm
+};
+
+// Logs with several expansions at once, for what only happens when chips share the
+// APU: overlapping register ranges, chips syncing on each other's writes, bus mixing.
+// Every chip plays its usual notes, one after the other in each frame.
+struct multi_log_t
+{
+	const char* name;
+	int exps [2];
+};
+
+static const multi_log_t multi_logs [] =
+{
+	{ "n163+s5b", { Simple_Apu::expansion_namco, Simple_Apu::expansion_sunsoft } },
+	{ "vrc6+mmc5", { Simple_Apu::expansion_vrc6, Simple_Apu::expansion_mmc5 } },
+};
+
+// Logs of a single chip playing what its usual notes do not reach.
+struct variant_log_t
+{
+	const char* name;
+	int exp;
+	write_func_t write;
+};
+
+static const variant_log_t variant_logs [] =
+{
+	{ "2a03-high", Simple_Apu::expansion_none, write_2a03_high },
+};
+
+static bool save_log( Register_Log& log, const char* dir, const char* name )
+{
+	std::string path = std::string( dir ) + "/" + name + ".nsrl";
+	if ( !log.is_ok() || !log.save( path.c_str() ) )
+	{
+		printf( "Cannot write %s\n", path.c_str() );
+		return false;
+	}
+
+	printf( "%s\n", path.c_str() );
+	return true;
+}
+
+static int generate( const char* dir )
+{
+	for ( int exp = 0; exp < Simple_Apu::expansion_count; exp++ )
+	{
+		Register_Log log;
+		begin_log( log, exp ? 1 << (exp - 1) : 0, 1 + exp );
+
+		for ( int f = 0; f < generate_frames; f++ )
+		{
+			write_funcs [exp]( log, f );
+			log.end_frame();
+		}
+
+		if ( !save_log( log, dir, chip_names [exp] ) )
+			return EXIT_FAILURE;
+	}
+
+	for ( int i = 0; i < (int) (sizeof multi_logs / sizeof multi_logs [0]); i++ )
+	{
+		const multi_log_t& m = multi_logs [i];
+		int count = (int) (sizeof m.exps / sizeof m.exps [0]);
+		int mask = 0;
+
+		for ( int j = 0; j < count; j++ )
+			mask |= 1 << (m.exps [j] - 1);
+
+		Register_Log log;
+		begin_log( log, mask, 1 + Simple_Apu::expansion_count + i );
+
+		for ( int f = 0; f < generate_frames; f++ )
+		{
+			for ( int j = 0; j < count; j++ )
+				write_funcs [m.exps [j]]( log, f );
+			log.end_frame();
+		}
+
+		if ( !save_log( log, dir, m.name ) )
+			return EXIT_FAILURE;
+	}
+
+	int seed = 1 + Simple_Apu::expansion_count + (int) (sizeof multi_logs / sizeof multi_logs [0]);
+	for ( int i = 0; i < (int) (sizeof variant_logs / sizeof variant_logs [0]); i++ )
+	{
+		const variant_log_t& v = variant_logs [i];
+
+		Register_Log log;
+		begin_log( log, v.exp ? 1 << (v.exp - 1) : 0, seed + i );
+
+		for ( int f = 0; f < generate_frames; f++ )
+		{
+			v.write( log, f );
+			log.end_frame();
+		}
+
+		if ( !save_log( log, dir, v.name ) )
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+	int repeat = 3;
+	bool update = false;
+	bool wav = false;
+	bool stats = false;
+	int jobs = -1;
+	int i = 1;
+
+	if ( argc == 3 && !strcmp( argv [1], "-generate" ) )
+		return generate( argv [2] );
+
+	for ( ; i < argc && argv [i] [0] == '-'; i++ )
+	{
+		if ( !strcmp( argv [i], "-repeat" ) && i + 1 < argc )
+			repeat = atoi( argv [++i] ) > 0 ? atoi( argv [i] ) : 1;
+		else if ( !strcmp( argv [i], "-update" ) )
+			update = true;
+		else if ( !strcmp( argv [i], "-wav" ) )
+			wav = true;
+		else if ( !strcmp( argv [i], "-stats" ) )
+			stats = true;
+		else if ( !strcmp( argv [i], "-jobs" ) && i + 1 < argc )
+			jobs = atoi( argv [++i] );
+		else
+			break;
+	}
+
+	if ( i >= argc )
+	{
+		printf( "Usage: nes_snd_bench -generate <dir>\n" );
+		printf( "       nes_snd_bench [-repeat <n>] [-update] [-wav] [-stats] <log> ...\n" );
+		printf( "       nes_snd_bench -jobs <n> <log> ...\n" );
+		return EXIT_FAILURE;
+	}
+
+	if ( jobs >= 0 )
+		return batch( argc - i, argv + i, jobs );
+
+	return bench( argc - i, argv + i, repeat, update, wav, stats );
+}
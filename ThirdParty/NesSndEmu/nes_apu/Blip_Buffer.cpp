@@ -28,6 +28,8 @@ Blip_Buffer::Blip_Buffer()
 	offset_ = 0;
 	buffer_ = 0;
 	buffer_size_ = 0;
+	delta_count_ = 0;
+	count_deltas_ = false;
 	sample_rate_ = 0;
 	reader_accum = 0;
 	bass_shift = 0;
@@ -140,6 +142,43 @@ blip_time_t Blip_Buffer::count_clocks( long count ) const
 	return (blip_time_t) ((time - offset_ + factor_ - 1) / factor_);
 }
 
+long Blip_Buffer::save_state( unsigned char* out ) const
+{
+	long count = buffer_ ? samples_avail() + buffer_extra : 0;
+	long size = sizeof offset_ + sizeof reader_accum + sizeof count + count * sizeof *buffer_;
+	
+	if ( out )
+	{
+		memcpy( out, &offset_, sizeof offset_ );
+		out += sizeof offset_;
+		memcpy( out, &reader_accum, sizeof reader_accum );
+		out += sizeof reader_accum;
+		memcpy( out, &count, sizeof count );
+		out += sizeof count;
+		memcpy( out, buffer_, count * sizeof *buffer_ );
+	}
+	
+	return size;
+}
+
+long Blip_Buffer::load_state( const unsigned char* in )
+{
+	long count;
+	memcpy( &count, in + sizeof offset_ + sizeof reader_accum, sizeof count );
+	
+	if ( count < 0 || count > (buffer_ ? buffer_size_ + buffer_extra : 0) )
+		return -1;
+	
+	// Anything past the saved samples must be silent.
+	clear();
+	
+	memcpy( &offset_, in, sizeof offset_ );
+	memcpy( &reader_accum, in + sizeof offset_, sizeof reader_accum );
+	memcpy( buffer_, in + sizeof offset_ + sizeof reader_accum + sizeof count, count * sizeof *buffer_ );
+	
+	return sizeof offset_ + sizeof reader_accum + sizeof count + count * sizeof *buffer_;
+}
+
 void Blip_Buffer::remove_samples( long count )
 {
 	if ( count )
@@ -164,6 +203,7 @@ Blip_Synth_::Blip_Synth_( short* p, int w ) :
 	buf = 0;
 	last_amp = 0;
 	delta_factor = 0;
+	serial = 0;
 }
 
 static double const pi = 3.1415926535897932384626433832795029;
@@ -219,6 +259,8 @@ void blip_eq_t::generate( float* out, int count ) const
 
 void Blip_Synth_::adjust_impulse()
 {
+	serial++;
+	
 	// sum pairs for each phase and add error correction to end of first half
 	int const size = impulses_size();
 	for ( int p = blip_res; p-- >= blip_res / 2; )
@@ -327,6 +369,7 @@ void Blip_Synth_::volume_unit( double new_unit )
 			}
 		}
 		delta_factor = (int) floor( factor + 0.5 );
+		serial++;
 		//printf( "delta_factor: %d, kernel_unit: %d\n", delta_factor, kernel_unit );
 	}
 }
@@ -49,6 +49,7 @@ public:
 	
 	// Set frequency high-pass filter frequency, where higher values reduce bass more
 	void bass_freq( int frequency );
+	int bass_freq() const { return bass_freq_; }
 	
 	// Number of samples delay from synthesis to samples read out
 	int output_latency() const;
@@ -76,6 +77,12 @@ public:
 	// buffer becomes full.
 	blip_time_t count_clocks( long count ) const;
 	
+	// Save/load the samples that have not been read yet along with the read position,
+	// used for seek keyframes. Pass NULL to get the size. Loading returns the number
+	// of bytes read, or -1 if the state holds more samples than this buffer.
+	long save_state( unsigned char* out ) const;
+	long load_state( const unsigned char* in );
+	
 	// not documented yet
 	typedef unsigned long long blip_resampled_time_t;
 	void remove_silence( long count );
@@ -100,6 +107,8 @@ public:
 	blip_resampled_time_t offset_;
 	buf_t_* buffer_;
 	long buffer_size_;
+	long long delta_count_; // Deltas added by all synths, for profiling. Only counted
+	bool count_deltas_;     // when count_deltas_ is set, it is off by default.
 private:
 	long reader_accum;
 	int bass_shift;
@@ -144,6 +153,7 @@ private:
 		Blip_Buffer* buf;
 		int last_amp;
 		int delta_factor;
+		int serial; // Changes every time the impulses or delta_factor do.
 		
 		Blip_Synth_( short* impulses, int width );
 		void treble_eq( blip_eq_t const& );
@@ -194,6 +204,18 @@ public:
 		offset_resampled( (blip_resampled_time_t) t * impl.buf->factor_ + impl.buf->offset_, delta, impl.buf );
 	}
 	
+	// Impulse of every phase offset already multiplied by a delta, laid out contiguously
+	// for offset_batch(). Must be made again when kernel_serial() changes (volume or eq).
+	typedef Blip_Buffer::buf_t_ kernel_t [blip_res] [quality];
+	void make_kernel( int delta, kernel_t& ) const;
+	int kernel_serial() const { return impl.serial; }
+	
+	// Same as offset_resampled() with the delta of the kernel (or its negation) for 'count'
+	// transitions in increasing time order. The ones landing on the same sample are summed
+	// before being added to the buffer, high notes have several per sample.
+	void offset_batch( blip_resampled_time_t const* times, unsigned char const* negate, int count,
+			kernel_t const&, Blip_Buffer* ) const;
+	
 public:
 	Blip_Synth() : impl( impulses, quality ) { }
 private:
@@ -280,6 +302,8 @@ inline void Blip_Synth<quality,range>::offset_resampled( blip_resampled_time_t t
 	// Fails if time is beyond end of Blip_Buffer, due to a bug in caller code or the
 	// need for a longer buffer as set by set_sample_rate().
 	assert( (long) (time >> BLIP_BUFFER_ACCURACY) < blip_buf->buffer_size_ );
+	if ( blip_buf->count_deltas_ )
+		blip_buf->delta_count_++;
 	delta *= impl.delta_factor;
 	int phase = (int) (time >> (BLIP_BUFFER_ACCURACY - BLIP_PHASE_BITS) & (blip_res - 1));
 	imp_t const* imp = impulses + blip_res - phase;
@@ -314,6 +338,75 @@ inline void Blip_Synth<quality,range>::offset_resampled( blip_resampled_time_t t
 #undef BLIP_FWD
 #undef BLIP_REV
 
+template<int quality,int range>
+void Blip_Synth<quality,range>::make_kernel( int delta, kernel_t& kernel ) const
+{
+	// Same taps as offset_resampled(), in the order they land in the buffer.
+	delta *= impl.delta_factor;
+	for ( int phase = 0; phase < blip_res; phase++ )
+	{
+		for ( int i = 0; i < quality / 2; i++ )
+		{
+			kernel [phase] [i] = (long) impulses [blip_res - phase + blip_res * i] * delta;
+			kernel [phase] [quality - 1 - i] = (long) impulses [phase + blip_res * i] * delta;
+		}
+	}
+}
+
+// Applies F( sum, tap ) to every tap of the impulse, the sums are locals so that they
+// can stay in registers.
+#define BLIP_TAPS( F ) {                                                    \
+	F( s0, 0 ) F( s1, 1 ) F( s2, 2 ) F( s3, 3 ) F( s4, 4 ) F( s5, 5 ) F( s6, 6 ) F( s7, 7 ) \
+	if ( quality > 8  ) { F( s8,  8  ) F( s9,  9  ) F( s10, 10 ) F( s11, 11 ) } \
+	if ( quality > 12 ) { F( s12, 12 ) F( s13, 13 ) F( s14, 14 ) F( s15, 15 ) } }
+
+#define BLIP_ADD( s, i )   s += imp [i];
+#define BLIP_SUB( s, i )   s -= imp [i];
+#define BLIP_FLUSH( s, i ) out [i] += s; s = 0;
+
+template<int quality,int range>
+void Blip_Synth<quality,range>::offset_batch( blip_resampled_time_t const* times,
+		unsigned char const* negate, int count, kernel_t const& kernel, Blip_Buffer* blip_buf ) const
+{
+	if ( count <= 0 )
+		return;
+	
+	assert( (long) (times [count - 1] >> BLIP_BUFFER_ACCURACY) < blip_buf->buffer_size_ );
+	if ( blip_buf->count_deltas_ )
+		blip_buf->delta_count_ += count;
+	
+	long s0 = 0, s1 = 0, s2  = 0, s3  = 0, s4  = 0, s5  = 0, s6  = 0, s7  = 0;
+	long s8 = 0, s9 = 0, s10 = 0, s11 = 0, s12 = 0, s13 = 0, s14 = 0, s15 = 0;
+	long pos = (long) (times [0] >> BLIP_BUFFER_ACCURACY);
+	
+	for ( int n = 0; n < count; n++ )
+	{
+		blip_resampled_time_t time = times [n];
+		long sample = (long) (time >> BLIP_BUFFER_ACCURACY);
+		if ( sample != pos )
+		{
+			long* out = blip_buf->buffer_ + pos + (blip_widest_impulse_ - quality) / 2;
+			BLIP_TAPS( BLIP_FLUSH )
+			pos = sample;
+		}
+		
+		int phase = (int) (time >> (BLIP_BUFFER_ACCURACY - BLIP_PHASE_BITS) & (blip_res - 1));
+		Blip_Buffer::buf_t_ const* imp = kernel [phase];
+		if ( negate [n] )
+			BLIP_TAPS( BLIP_SUB )
+		else
+			BLIP_TAPS( BLIP_ADD )
+	}
+	
+	long* out = blip_buf->buffer_ + pos + (blip_widest_impulse_ - quality) / 2;
+	BLIP_TAPS( BLIP_FLUSH )
+}
+
+#undef BLIP_TAPS
+#undef BLIP_ADD
+#undef BLIP_SUB
+#undef BLIP_FLUSH
+
 template<int quality,int range>
 void Blip_Synth<quality,range>::offset( blip_time_t t, int delta, Blip_Buffer* buf ) const
 {
@@ -2,6 +2,7 @@
 // Nes_Snd_Emu 0.1.7. http://www.slack.net/~ant/libs/
 
 #include "Nes_Apu.h"
+#include "Nes_State.h"
 
 /* Copyright (C) 2003-2005 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -20,6 +21,9 @@ Nes_Apu::Nes_Apu()
 {
 	dmc.apu = this;
 	dmc.rom_reader = NULL;
+	dmc.rom_data = NULL;
+	dmc.rom_data_addr = 0;
+	dmc.rom_data_size = 0;
 	square1.synth = &square_synth;
 	square2.synth = &square_synth;
 	irq_notifier_ = NULL;
@@ -30,6 +34,9 @@ Nes_Apu::Nes_Apu()
 	oscs [3] = &noise;
 	oscs [4] = &dmc;
 	
+	for ( int i = 0; i < osc_count; i++ )
+		oscs [i]->trigger_log = NULL;
+	
 	output( NULL, NULL );
 	volume( 1.0 );
 	reset( false );
@@ -84,6 +91,11 @@ int Nes_Apu::get_channel_trigger(int idx) const
 	return oscs[idx]->trigger;
 }
 
+void Nes_Apu::set_trigger_log(int idx, trigger_log_t* log)
+{
+	oscs[idx]->trigger_log = log;
+}
+
 void Nes_Apu::volume( double v )
 {
 	dmc.nonlinear = false;
@@ -247,6 +259,41 @@ void Nes_Apu::end_frame( cpu_time_t end_time )
 	}
 }
 
+// state
+
+template<class S>
+void Nes_Apu::reflect_state( S& s )
+{
+	square1.reflect_state( s );
+	square2.reflect_state( s );
+	triangle.reflect_state( s );
+	noise.reflect_state( s );
+	dmc.reflect_state( s );
+	
+	s( last_time );
+	s( earliest_irq_ );
+	s( next_irq );
+	s( frame_delay );
+	s( frame );
+	s( osc_enables );
+	s( frame_mode );
+	s( irq_flag );
+}
+
+long Nes_Apu::save_state( unsigned char* out ) const
+{
+	state_writer w = { out, 0 };
+	((Nes_Apu*) this)->reflect_state( w ); // const_cast
+	return w.size;
+}
+
+long Nes_Apu::load_state( const unsigned char* in )
+{
+	state_reader r = { in, 0, true };
+	reflect_state( r );
+	return r.size;
+}
+
 // registers
 
 const unsigned char length_table [0x20] = {
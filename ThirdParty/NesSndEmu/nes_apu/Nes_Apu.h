@@ -31,6 +31,10 @@ public:
 	// first parameter.
 	void dmc_reader( int (*callback)( void* user_data, cpu_addr_t ), void* user_data = NULL );
 	
+	// Set memory the DMC reads directly from, mapped at 'addr' (0x8000-0xFFFF). The
+	// memory is not copied and must stay valid. Reads outside of it use the dmc_reader.
+	void dmc_memory( const unsigned char* data, cpu_addr_t addr, int size );
+	
 	// All time values are the number of CPU clock cycles relative to the
 	// beginning of the current time frame. Before resetting the CPU clock
 	// count, call end_frame( last_cpu_time ).
@@ -62,6 +66,10 @@ public:
 	void save_snapshot( apu_snapshot_t* out ) const;
 	void load_snapshot( apu_snapshot_t const& );
 	
+	// State for seek keyframes, see Simple_Apu. Pass NULL to get the size.
+	long save_state( unsigned char* out ) const;
+	long load_state( const unsigned char* in );
+	
 	// Set overall volume (default is 1.0)
 	void volume( double );
 	
@@ -110,6 +118,7 @@ public:
 
 	void reset_triggers();
 	int  get_channel_trigger(int idx) const;
+	void set_trigger_log(int idx, trigger_log_t* log);
 
 private:
 	// noncopyable
@@ -140,6 +149,7 @@ private:
 
 	void irq_changed();
 	void state_restored();
+	template<class S> void reflect_state( S& );
 	
 	friend struct Nes_Dmc;
 };
@@ -161,6 +171,13 @@ inline void Nes_Apu::dmc_reader( int (*func)( void*, cpu_addr_t ), void* user_da
 	dmc.rom_reader = func;
 }
 
+inline void Nes_Apu::dmc_memory( const unsigned char* data, cpu_addr_t addr, int size )
+{
+	dmc.rom_data = data;
+	dmc.rom_data_addr = addr;
+	dmc.rom_data_size = data ? size : 0;
+}
+
 inline void Nes_Apu::irq_notifier( void (*func)( void* user_data ), void* user_data )
 {
 	irq_notifier_ = func;
@@ -175,10 +192,38 @@ inline int Nes_Apu::count_dmc_reads( cpu_time_t time, cpu_time_t* last_read ) co
 enum { trigger_none = -2 }; // Unable to provide trigger, must use fallback.
 enum { trigger_hold = -1 }; // A valid trigger should be coming, hold previous valid one until.
 
-inline void update_trigger(const Blip_Buffer* output, cpu_time_t time, int& out_trigger)
+// Optional log of every trigger of a channel, not just the one closest to the middle
+// of the frame. Times are in output samples, 'base' being the number of samples that
+// were read before the current frame. The ring holds 'capacity' (a power of two) 
+// events, the oldest ones are overwritten when it is full.
+struct trigger_log_t
+{
+	int* samples;
+	int capacity;
+	unsigned read;
+	unsigned write;
+	int base;
+};
+
+inline void log_trigger(trigger_log_t* log, int sample)
+{
+	// Multiple wraps within the same sample (very high frequencies) are only logged once.
+	if (log->write != log->read && log->samples[(log->write - 1) & (log->capacity - 1)] == sample)
+		return;
+
+	if (log->write - log->read == (unsigned)log->capacity)
+		log->read++;
+
+	log->samples[log->write++ & (log->capacity - 1)] = sample;
+}
+
+inline void update_trigger(const Blip_Buffer* output, cpu_time_t time, int& out_trigger, trigger_log_t* log = NULL)
 {
 	int new_trigger = output->resampled_time(time) >> BLIP_BUFFER_ACCURACY;
 
+	if (log)
+		log_trigger(log, log->base + new_trigger);
+
 	if (out_trigger < 0)
 	{
 		out_trigger = new_trigger;
@@ -4,10 +4,14 @@
 #include "Nes_EPSM.h"
 #include "emu2149.h"
 #include "ym3438.h"
+#include "Nes_State.h"
 #include BLARGG_SOURCE_BEGIN
 
 Nes_EPSM::Nes_EPSM() : psg(NULL), output_buffer_left(NULL), output_buffer_right(NULL)
 {
+	psg_calc_count = 0;
+	opn2_clock_count = 0;
+	memset(trigger_logs, 0, sizeof(trigger_logs));
 	output(NULL,NULL);
 	volume(1.0);
 	reset(false);
@@ -54,6 +58,45 @@ void Nes_EPSM::reset_psg()
 	PSG_reset(psg);
 }
 
+template<class S>
+void Nes_EPSM::reflect_state(S& s)
+{
+	s(regs_a0);
+	s(ages_a0);
+	s(regs_a1);
+	s(ages_a1);
+	s(reg);
+	s(current_register);
+	s(last_time);
+	s(psg_delay);
+	s(opn2_delay);
+	s(last_psg_amp);
+	s(sample_left);
+	s(sample_right);
+	s(last_opn2_amp_left);
+	s(last_opn2_amp_right);
+	s(triggers);
+	s(opn2); // Plain values only.
+}
+
+long Nes_EPSM::save_state(unsigned char* out) const
+{
+	state_writer w = { out, 0 };
+	((Nes_EPSM*)this)->reflect_state(w); // const_cast
+	return w.size + PSG_saveState(psg, w.ptr());
+}
+
+long Nes_EPSM::load_state(const unsigned char* in)
+{
+	// The channel mask is a setting, see enable_channel().
+	Bit16u mask = opn2.mask;
+	state_reader r = { in, 0, true };
+	reflect_state(r);
+	opn2.mask = mask;
+
+	return r.size + PSG_loadState(psg, in + r.size);
+}
+
 void Nes_EPSM::reset_opn2()
 {
 	OPN2_Reset(&opn2);
@@ -141,12 +184,18 @@ void Nes_EPSM::write_register(cpu_time_t time, cpu_addr_t addr, int data)
 				PSG_writeReg(psg, reg, data);
 				psg_reg = true;
 			}
-			regs_a0[current_register] = data;
-			ages_a0[current_register] = 0;
+			if (current_register < array_count(regs_a0))
+			{
+				regs_a0[current_register] = data;
+				ages_a0[current_register] = 0;
+			}
 			break;
 		case reg_write2:
-			regs_a1[current_register] = data;
-			ages_a1[current_register] = 0;
+			if (current_register < array_count(regs_a1))
+			{
+				regs_a1[current_register] = data;
+				ages_a1[current_register] = 0;
+			}
 			break;
 		}
 
@@ -172,6 +221,7 @@ long Nes_EPSM::run_until(cpu_time_t end_time)
 
 	cpu_time_t psg_increment = 16 << epsm_time_precision;
 	cpu_time_t psg_time = last_time + psg_delay;
+	cpu_time_t psg_start = psg_time;
 
 	while (psg_time < end_time)
 	{
@@ -189,7 +239,7 @@ long Nes_EPSM::run_until(cpu_time_t end_time)
 		for (int i = 0; i < 3; i++)
 		{
 			if (psg->trigger_mask & (1 << i))
-				update_trigger(output_buffer_left, psg_time >> epsm_time_precision, triggers[i]);
+				update_trigger(output_buffer_left, psg_time >> epsm_time_precision, triggers[i], trigger_logs[i]);
 			else if ((psg->trigger_mask & (8 << i)) == 0)
 				triggers[i] = trigger_none;
 
@@ -200,6 +250,7 @@ long Nes_EPSM::run_until(cpu_time_t end_time)
 
 	cpu_time_t opn2_increment = ((int64_t)(output_buffer_left->clock_rate() * 6) << epsm_time_precision) / epsm_clock;
 	cpu_time_t opn2_time = last_time + opn2_delay;
+	cpu_time_t opn2_start = opn2_time;
 
 	while (opn2_time < end_time)
 	{
@@ -235,7 +286,7 @@ long Nes_EPSM::run_until(cpu_time_t end_time)
 			for (int i = 0; i < 6; i++)
 			{
 				if (opn2.triggers[i] == 1)
-					update_trigger(output_buffer_left, opn2_time >> epsm_time_precision, triggers[i + 3]);
+					update_trigger(output_buffer_left, opn2_time >> epsm_time_precision, triggers[i + 3], trigger_logs[i + 3]);
 				else if (opn2.triggers[i] == 2)
 					triggers[i + 3] = trigger_none;
 			}
@@ -247,6 +298,10 @@ long Nes_EPSM::run_until(cpu_time_t end_time)
 		opn2_time += opn2_increment;
 	}
 
+	// Derived from the time covered rather than counted in the loops.
+	psg_calc_count += (psg_time - psg_start) / psg_increment;
+	opn2_clock_count += (opn2_time - opn2_start) / opn2_increment;
+
 	opn2_delay = opn2_time - end_time;
 	psg_delay  = psg_time  - end_time;
 
@@ -309,14 +364,14 @@ void Nes_EPSM::write_shadow_register(int addr, int data)
 	{
 		if(reg == 0x28)
 			shadow_internal_regs[0xC0+(0xF & data)] = data;
-		else if(reg != 0x10)
+		else if(reg != 0x10 && (unsigned)reg < shadow_internal_regs_count)
 			shadow_internal_regs[reg] = data;
 	}
 	if (addr >= reg_select2 && addr < (reg_select2 + reg_range)) 
 	{
 		reg = data;
 	}
-	else if (addr >= reg_write2 && addr < (reg_write2 + reg_range)) 
+	else if (addr >= reg_write2 && addr < (reg_write2 + reg_range) && (unsigned)reg < shadow_internal_regs_count) 
 	{
 		shadow_internal_regs2[reg] = data;
 	}
@@ -346,3 +401,8 @@ int Nes_EPSM::get_channel_trigger(int idx) const
 {
 	return triggers[idx];
 }
+
+void Nes_EPSM::set_trigger_log(int idx, trigger_log_t* log)
+{
+	trigger_logs[idx] = log;
+}
@@ -49,8 +49,17 @@ public:
 	void stop_seeking(blip_time_t& clock);
 	void write_shadow_register(int addr, int data);
 
+	// State for seek keyframes, see Simple_Apu. Pass NULL to get the size.
+	long save_state(unsigned char* out) const;
+	long load_state(const unsigned char* in);
+
 	void reset_triggers(bool force_none = false);
 	int  get_channel_trigger(int idx) const;
+	void set_trigger_log(int idx, trigger_log_t* log);
+
+	// Number of PSG_calc() and OPN2_Clock() calls, for profiling. Not cleared by reset().
+	long long psg_calc_count;
+	long long opn2_clock_count;
 
 private:
 
@@ -60,6 +69,7 @@ private:
 	
 	void reset_psg();
 	void reset_opn2();
+	template<class S> void reflect_state(S& s);
 
 	int reg;
 	BOOST::uint8_t current_register;
@@ -84,6 +94,7 @@ private:
 	Blip_Synth<blip_med_quality, 163430> synth_left;
 	Blip_Synth<blip_med_quality, 163430> synth_right;
 	int triggers[15];
+	trigger_log_t* trigger_logs[15];
 
 	const int epsm_time_precision = 14;
 
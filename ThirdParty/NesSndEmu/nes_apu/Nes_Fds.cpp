@@ -2,6 +2,7 @@
 // Added to Nes_Snd_Emu by @NesBleuBleu, mostly adapted from Disch / NotSoFatso
 
 #include "Nes_Fds.h"
+#include "Nes_State.h"
 #include <string.h>
 
 #include BLARGG_SOURCE_BEGIN
@@ -21,6 +22,7 @@ static int dac_lookup[] =
 
 Nes_Fds::Nes_Fds() : vol(1.0f)
 {
+	osc.trigger_log = NULL;
 	output(NULL);
 	volume(1.0);
 	reset();
@@ -46,6 +48,43 @@ void Nes_Fds::reset()
 	osc.volume_env = 0x20;
 	osc.regs[10] = 0xff;
 	osc.trigger = trigger_hold;
+	pitch_gain = -1;
+	pitch_period = -1;
+}
+
+// The pitch cache only depends on the gain and period it was filled for, so it stays valid.
+template<class S>
+void Nes_Fds::reflect_state(S& s)
+{
+	s(osc.wave);
+	s(osc.modt);
+	s(osc.regs);
+	s(osc.ages);
+	s(osc.mod_pos);
+	s(osc.mod_phase);
+	s(osc.delay);
+	s(osc.last_amp);
+	s(osc.phase);
+	s(osc.pending_volume_env);
+	s(osc.volume_env);
+	s(osc.trigger);
+	s(osc.mod_lo);
+	s(osc.mod_hi);
+	s(last_time);
+}
+
+long Nes_Fds::save_state(unsigned char* out) const
+{
+	state_writer w = { out, 0 };
+	((Nes_Fds*)this)->reflect_state(w); // const_cast
+	return w.size;
+}
+
+long Nes_Fds::load_state(const unsigned char* in)
+{
+	state_reader r = { in, 0, true };
+	reflect_state(r);
+	return r.size;
 }
 
 void Nes_Fds::volume(double v)
@@ -110,8 +149,8 @@ void Nes_Fds::write_register(cpu_time_t time, cpu_addr_t addr, int data)
 			case 8:
 				// TODO: Ring buffer? I cant imagine that's of the hardware does it.
 				memmove(&osc.modt[0], &osc.modt[2], modt_count - 2); 
-				osc.modt[modt_count - 2] = data;
-				osc.modt[modt_count - 1] = data;
+				osc.modt[modt_count - 2] = (data & 0x07);
+				osc.modt[modt_count - 1] = (data & 0x07);
 				break;
 			}
 
@@ -138,6 +177,58 @@ void Nes_Fds::run_until(cpu_time_t time)
 
 #include BLARGG_ENABLE_OPTIMIZER
 
+// Pitch offset the modulator adds to the wave period at a given modulator position.
+static int mod_pitch(int mod_pos, int sweep_gain, int wav_period)
+{
+	int pos = (mod_pos < 64) ? mod_pos : (mod_pos - 128);
+
+	while (pos >= 64) pos -= 128;
+	while (pos < -64) pos += 128;
+
+	int temp = pos * sweep_gain;
+	int rem = temp & 0xf;
+	temp >>= 4;
+	if ((rem > 0) && ((temp & 0x80) == 0))
+		temp += pos < 0 ? -1 : 2;
+
+	while (temp >= 192) temp -= 256;
+	while (temp <  -64) temp += 256;
+
+	temp *= wav_period;
+	rem = temp & 0x3f;
+	temp >>= 6;
+	if (rem >= 32)
+		temp++;
+
+	return temp;
+}
+
+// Number of 16 clock steps an accumulator can advance by 'step' before its top bits change.
+static inline int quiet_steps(int accum, int step)
+{
+	int room = 0xffff - (accum & 0xffff);
+	int inc = step * 16;
+	return room < inc ? 0 : room / inc; // Fast modulators move at every step, no need to divide.
+}
+
+void Nes_Fds::run_mod(int delta)
+{
+	const int modulation_table[8] = { 0,1,2,4,0,-4,-2,-1 };
+
+	int start_pos = osc.mod_phase >> 16;
+	osc.mod_phase += delta;
+	int end_pos = osc.mod_phase >> 16;
+
+	osc.mod_phase = osc.mod_phase & 0x3fffff;
+
+	for (int p = start_pos; p < end_pos; ++p)
+	{
+		int wv = osc.modt[p & 0x3f];
+		osc.mod_pos = wv == 4 ? 0 : osc.mod_pos + modulation_table[wv];
+		osc.mod_pos &= 0x7f;
+	}
+}
+
 void Nes_Fds::run_fds(cpu_time_t end_time)
 {
 	require(end_time >= last_time);
@@ -149,8 +240,25 @@ void Nes_Fds::run_fds(cpu_time_t end_time)
 	}
 
 	// Code here is kind of a mix of Disch/NotSoFatso + NSFPlay.
-	bool mod_on = osc.mod_period() && !(osc.regs[7] & 0x80);
-	bool wav_on = osc.wav_period() && !(osc.regs[3] & 0x80);
+	int mod_period = osc.mod_period();
+	int wav_period = osc.wav_period();
+	int sweep_gain = osc.regs[4] & 0x3f; // TODO: Sweep envelopes.
+	bool mod_on = mod_period && !(osc.regs[7] & 0x80);
+	bool wav_on = wav_period && !(osc.regs[3] & 0x80);
+
+	// Without a sweep gain, the modulator doesn't bend the pitch and can be advanced in bulk.
+	bool pitch_mod = wav_on && mod_on && sweep_gain;
+	unsigned pitch_pos = pitch_cache_size; // Never a valid position, forces the first lookup.
+	int f = wav_period;
+
+	// Offsets are cached per modulator position, for the current gain and period.
+	if (pitch_mod && (sweep_gain != pitch_gain || wav_period != pitch_period))
+	{
+		pitch_gain = sweep_gain;
+		pitch_period = wav_period;
+		for (int i = 0; i < pitch_cache_size; i++)
+			pitch_cache[i] = pitch_unknown;
+	}
 
 	cpu_time_t time = last_time;
 
@@ -164,56 +272,21 @@ void Nes_Fds::run_fds(cpu_time_t end_time)
 
 		// Modulation
 		if (mod_on)
-		{
-			const int modulation_table[8] = { 0,1,2,4,0,-4,-2,-1 };
-
-			int start_pos = osc.mod_phase >> 16;
-			osc.mod_phase += (sub_step * osc.mod_period());
-			int end_pos = osc.mod_phase >> 16;
-
-			osc.mod_phase = osc.mod_phase & 0x3fffff;
-
-			for (int p = start_pos; p < end_pos; ++p)
-			{
-				int wv = osc.modt[p & 0x3f];
-				osc.mod_pos = wv == 4 ? 0 : osc.mod_pos + modulation_table[wv];
-				osc.mod_pos &= 0x7f;
-			}
-		}
+			run_mod(sub_step * mod_period);
 
 		// Wave generation
 		if (wav_on)
 		{
-			int mod = 0;
-			int sweep_gain = osc.regs[4] & 0x3f; // TODO: Sweep envelopes.
-
-			if (sweep_gain && mod_on)
+			// The pitch only changes when the modulator moves to another position.
+			if (pitch_mod && osc.mod_pos != pitch_pos)
 			{
-				int pos = (osc.mod_pos < 64) ? osc.mod_pos : (osc.mod_pos - 128);
-
-				while (pos >= 64) pos -= 128;
-				while (pos < -64) pos += 128;
-
-				int temp = pos * sweep_gain;
-				int rem = temp & 0xf;
-				temp >>= 4;
-				if ((rem > 0) && ((temp & 0x80) == 0))
-					temp += pos < 0 ? -1 : 2;
-
-				while (temp >= 192) temp -= 256;
-				while (temp <  -64) temp += 256;
-
-				temp *= osc.wav_period();
-				rem = temp & 0x3f;
-				temp >>= 6;
-				if (rem >= 32)
-					temp++;
-
-				mod = temp;
+				pitch_pos = osc.mod_pos;
+				if (pitch_cache[pitch_pos] == pitch_unknown)
+					pitch_cache[pitch_pos] = mod_pitch(pitch_pos, sweep_gain, wav_period);
+				f = wav_period + pitch_cache[pitch_pos];
 			}
 
 			int prev_phase = osc.phase;
-			int f = osc.wav_period() + mod;
 			osc.phase = osc.phase + (sub_step * f);
 			bool passed_zero = osc.phase & (~0x3fffff); // If we overflowed, considered that we passed zero.
 			osc.phase = osc.phase & 0x3fffff;
@@ -225,7 +298,7 @@ void Nes_Fds::run_fds(cpu_time_t end_time)
 
 			// Wrapping around the wave is our trigger.
 			if (osc.phase < prev_phase)
-				update_trigger(osc.output, time, osc.trigger);
+				update_trigger(osc.output, time, osc.trigger, osc.trigger_log);
 		}
 		else
 		{
@@ -256,6 +329,24 @@ void Nes_Fds::run_fds(cpu_time_t end_time)
 		}
 
 		time += sub_step;
+
+		// Skip ahead to the next step that can change anything: until the wave moves to
+		// another sample (or the modulator to another position, if it bends the pitch)
+		// the amplitude, the volume envelope and the trigger all stay the same.
+		int quiet = (int)min((end_time - time) >> 4, 0x4000); // Keeps the accumulators from overflowing.
+		if (quiet > 0 && pitch_mod)
+			quiet = min(quiet, quiet_steps(osc.mod_phase, mod_period));
+		if (quiet > 0 && wav_on && f > 0)
+			quiet = min(quiet, quiet_steps(osc.phase, f));
+
+		if (quiet > 0)
+		{
+			if (mod_on)
+				run_mod(quiet * 16 * mod_period);
+			if (wav_on)
+				osc.phase += quiet * 16 * f;
+			time += quiet * 16;
+		}
 	}
 
 	osc.last_amp = last_amp;
@@ -294,8 +385,8 @@ void Nes_Fds::write_shadow_register(int addr, int data)
 		if (addr == 0x4088)
 		{
 			// Assume we always write to mod table in batch of 32. This is true for FamiStudio.
-			shadow_modt[shadow_modt_idx + 0] = data;
-			shadow_modt[shadow_modt_idx + 1] = data;
+			shadow_modt[shadow_modt_idx + 0] = (data & 0x07);
+			shadow_modt[shadow_modt_idx + 1] = (data & 0x07);
 			shadow_modt_idx = (shadow_modt_idx + 2) % modt_count;
 		}
 		else
@@ -329,3 +420,8 @@ int Nes_Fds::get_channel_trigger(int idx) const
 	return osc.trigger;
 }
 
+void Nes_Fds::set_trigger_log(int idx, trigger_log_t* log)
+{
+	osc.trigger_log = log;
+}
+
@@ -22,13 +22,21 @@ public:
 	void get_register_values(struct fds_register_values* regs);
 	void reset_triggers();
 	int get_channel_trigger(int idx) const;
+	void set_trigger_log(int idx, trigger_log_t* log);
 	int get_wave_pos();
 
+	enum { start_addr = 0x4040 };
+	enum { end_addr   = 0x408a };
+
 	enum { shadow_regs_count = 11 };
 	void start_seeking();
 	void stop_seeking(blip_time_t& clock);
 	void write_shadow_register(int addr, int data);
 
+	// State for seek keyframes, see Simple_Apu. Pass NULL to get the size.
+	long save_state(unsigned char* out) const;
+	long load_state(const unsigned char* in);
+
 private:
 	// noncopyable
 	Nes_Fds(const Nes_Fds&);
@@ -55,6 +63,7 @@ private:
 		int pending_volume_env;
 		int volume_env;
 		int trigger;
+		trigger_log_t* trigger_log;
 		int mod_lo;
 		int mod_hi;
 
@@ -75,12 +84,21 @@ private:
 
 	static double dac_approx(int level);
 
+	// Pitch offset of each modulator position (mod_pos is 7 bits).
+	enum { pitch_cache_size = 128 };
+	enum { pitch_unknown = -32768 };
+	BOOST::int16_t pitch_cache[pitch_cache_size];
+	int pitch_gain;
+	int pitch_period;
+
 	short shadow_regs[shadow_regs_count];
 	BOOST::uint8_t shadow_wave[modt_count];
 	BOOST::uint8_t shadow_modt[modt_count];
 	BOOST::uint8_t shadow_modt_idx;
 
 	void run_fds(cpu_time_t end_time);
+	void run_mod(int delta);
+	template<class S> void reflect_state(S& s);
 };
 
 inline int Nes_Fds::get_wave_pos()
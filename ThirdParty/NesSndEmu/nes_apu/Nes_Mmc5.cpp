@@ -2,6 +2,7 @@
 // Added to Nes_Snd_Emu by @NesBleuBleu
 
 #include "Nes_Mmc5.h"
+#include "Nes_State.h"
 #include <string.h>
 
 #include BLARGG_SOURCE_BEGIN
@@ -16,6 +17,9 @@ Nes_Mmc5::Nes_Mmc5()
 	oscs[0] = &square1;
 	oscs[1] = &square2;
 
+	for (int i = 0; i < osc_count; i++)
+		oscs[i]->trigger_log = NULL;
+
 	output(NULL);
 	volume(1.0);
 	reset();
@@ -49,6 +53,31 @@ void Nes_Mmc5::reset()
 	reset_triggers();
 }
 
+template<class S>
+void Nes_Mmc5::reflect_state(S& s)
+{
+	square1.reflect_state(s);
+	square2.reflect_state(s);
+	s(last_time);
+	s(frame_delay);
+	s(frame);
+	s(osc_enables);
+}
+
+long Nes_Mmc5::save_state(unsigned char* out) const
+{
+	state_writer w = { out, 0 };
+	((Nes_Mmc5*)this)->reflect_state(w); // const_cast
+	return w.size;
+}
+
+long Nes_Mmc5::load_state(const unsigned char* in)
+{
+	state_reader r = { in, 0, true };
+	reflect_state(r);
+	return r.size;
+}
+
 void Nes_Mmc5::volume(double v)
 {
 	square_synth.volume(0.3 * v);
@@ -94,6 +123,9 @@ void Nes_Mmc5::write_register(cpu_time_t time, cpu_addr_t addr, int data)
 	{
 		// Write to channel
 		int osc_index = (addr - start_addr) >> 2;
+		if (osc_index >= osc_count)
+			return;
+
 		Nes_Osc* osc = oscs[osc_index];
 
 		int reg = addr & 3;
@@ -211,3 +243,8 @@ int Nes_Mmc5::get_channel_trigger(int idx) const
 	return oscs[idx]->trigger;
 }
 
+void Nes_Mmc5::set_trigger_log(int idx, trigger_log_t* log)
+{
+	oscs[idx]->trigger_log = log;
+}
+
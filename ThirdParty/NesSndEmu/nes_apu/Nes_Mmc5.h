@@ -23,6 +23,7 @@ public:
 	void get_register_values(struct mmc5_register_values* regs);
 	void reset_triggers();
 	int  get_channel_trigger(int idx) const;
+	void set_trigger_log(int idx, trigger_log_t* log);
 
 	enum { start_addr = 0x5000 };
 	enum { end_addr   = 0x5015 };
@@ -32,6 +33,10 @@ public:
 	void stop_seeking(blip_time_t& clock);
 	void write_shadow_register(int addr, int data);
 
+	// State for seek keyframes, see Simple_Apu. Pass NULL to get the size.
+	long save_state(unsigned char* out) const;
+	long load_state(const unsigned char* in);
+
 private:
 	// noncopyable
 	Nes_Mmc5(const Nes_Mmc5&);
@@ -55,6 +60,8 @@ private:
 	int osc_enables;
 
 	short shadow_regs[shadow_regs_count];
+
+	template<class S> void reflect_state(S& s);
 };
 
 // Must match the definition in NesApu.cs.
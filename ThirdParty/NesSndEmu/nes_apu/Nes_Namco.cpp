@@ -2,6 +2,7 @@
 // Nes_Snd_Emu 0.1.7. http://www.slack.net/~ant/libs/
 
 #include "Nes_Namco.h"
+#include "Nes_State.h"
 
 /* Copyright (C) 2003-2005 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -18,6 +19,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
 
 Nes_Namco::Nes_Namco()
 {
+	for ( int i = 0; i < osc_count; i++ )
+		oscs [i].trigger_log = NULL;
+
 	output( NULL );
 	volume( 1.0 );
 	reset();
@@ -48,11 +52,46 @@ void Nes_Namco::reset()
 		Namco_Osc& osc = oscs [i];
 		osc.delay = 0;
 		osc.sample = 0;
+		osc.amp = 0;
 	}
 
 	reset_triggers();
 }
 
+template<class S>
+void Nes_Namco::reflect_state( S& s )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Namco_Osc& osc = oscs [i];
+		s( osc.delay );
+		s( osc.sample );
+		s( osc.amp );
+		s( osc.trigger );
+	}
+	s( last_time );
+	s( addr_reg );
+	s( last_amp );
+	s( active_osc );
+	s( delay );
+	s( reg );
+	s( age );
+}
+
+long Nes_Namco::save_state( unsigned char* out ) const
+{
+	state_writer w = { out, 0 };
+	((Nes_Namco*) this)->reflect_state( w ); // const_cast
+	return w.size;
+}
+
+long Nes_Namco::load_state( const unsigned char* in )
+{
+	state_reader r = { in, 0, true };
+	reflect_state( r );
+	return r.size;
+}
+
 void Nes_Namco::output( Blip_Buffer* buf )
 {
 	buffer = buf;
@@ -85,6 +124,11 @@ void Nes_Namco::run_until(cpu_time_t end_time)
 
 	int active_oscs = ((reg[0x7f] >> 4) & 7) + 1;
 
+	// Oscillators with an output other than the main buffer are mixed on their own.
+	bool routed = false;
+	for (int i = 0; i < osc_count; i++)
+		routed |= oscs[i].output && oscs[i].output != buffer;
+
 	cpu_time_t time = last_time + delay;
 
 	while (time < end_time)
@@ -110,7 +154,7 @@ void Nes_Namco::run_until(cpu_time_t end_time)
 
 			// Wrapping around the wave is our trigger.
 			if (phase < prev_phase)
-				update_trigger(osc.output, time, osc.trigger);
+				update_trigger(osc.output, time, osc.trigger, osc.trigger_log);
 
 			int addr = ((phase >> 16) + osc_reg[6]) & 0xff;
 			int sample = reg[addr >> 1];
@@ -141,12 +185,37 @@ void Nes_Namco::run_until(cpu_time_t end_time)
 		{
 			float sum = 0.0f;
 			for (int i = osc_count - active_oscs; i < osc_count; i++)
-				sum += oscs[i].sample;
+			{
+				if (!routed || oscs[i].output == buffer)
+					sum += oscs[i].sample;
+			}
 			output = (int)(sum / max(1, active_oscs) + 0.5f);
 		}
 		else
 		{
-			output = osc.sample;
+			output = !routed || osc.output == buffer ? osc.sample : 0;
+		}
+
+		// A routed oscillator gets its part of the mix, or its own time slot when multiplexing.
+		if (routed)
+		{
+			for (int i = 0; i < osc_count; i++)
+			{
+				Namco_Osc& o = oscs[i];
+
+				if (o.output && o.output != buffer)
+				{
+					int amp = 0;
+					if (i >= osc_count - active_oscs)
+						amp = mix ? (int)(o.sample / (float)max(1, active_oscs) + 0.5f) : (i == active_osc ? o.sample : 0);
+
+					if (amp != o.amp)
+					{
+						synth.offset(time, amp - o.amp, o.output);
+						o.amp = amp;
+					}
+				}
+			}
 		}
 
 		// Re-add bias * max volume because we only deal with positive values here (0...225).
@@ -217,3 +286,8 @@ int Nes_Namco::get_channel_trigger(int idx) const
 	int active_oscs = ((reg[0x7f] >> 4) & 7) + 1;
 	return oscs[osc_count - idx - 1].trigger;
 }
+
+void Nes_Namco::set_trigger_log(int idx, trigger_log_t* log)
+{
+	oscs[osc_count - idx - 1].trigger_log = log;
+}
@@ -42,6 +42,7 @@ public:
 
 	void reset_triggers();
 	int  get_channel_trigger(int idx) const;
+	void set_trigger_log(int idx, trigger_log_t* log);
 
 	// to do: implement save/restore
 	void save_snapshot( namco_snapshot_t* out );
@@ -52,6 +53,10 @@ public:
 	void stop_seeking(blip_time_t& clock);
 	void write_shadow_register(int addr, int data);
 
+	// State for seek keyframes, see Simple_Apu. Pass NULL to get the size.
+	long save_state( unsigned char* out ) const;
+	long load_state( const unsigned char* in );
+
 private:
 	// noncopyable
 	Nes_Namco( const Nes_Namco& );
@@ -62,7 +67,9 @@ private:
 	struct Namco_Osc {
 		long delay;
 		short sample;
+		int amp; // Last amplitude in its own buffer, when it has one.
 		int trigger;
+		trigger_log_t* trigger_log;
 		Blip_Buffer* output;
 	};
 	
@@ -84,6 +91,7 @@ private:
 	short shadow_internal_regs[shadow_internal_regs_count];
 
 	BOOST::uint8_t& access();
+	template<class S> void reflect_state( S& );
 };
 
 // Must match the definition in NesApu.cs.
@@ -149,14 +149,22 @@ void Nes_Square::run( cpu_time_t time, cpu_time_t end_time )
 			int phase = this->phase;
 			
 			do {
-				phase = (phase + 1) & (phase_range - 1);
-				if ( phase == 0 || phase == duty ) {
-					delta = -delta;
-					synth->offset_inline( time, delta, output );
-					if (delta > 0)
-						update_trigger(output, time, trigger);
+				// Jump straight to the next duty edge, the steps in between change nothing.
+				int steps = (phase < duty ? duty : phase_range) - phase;
+				cpu_time_t edge = time + (steps - 1) * timer_period;
+				if ( edge >= end_time ) {
+					steps = (end_time - time + timer_period - 1) / timer_period;
+					phase = (phase + steps) & (phase_range - 1);
+					time += steps * timer_period;
+					break;
 				}
-				time += timer_period;
+				
+				phase = (phase + steps) & (phase_range - 1);
+				delta = -delta;
+				synth->offset_inline( edge, delta, output );
+				if (delta > 0)
+					update_trigger(output, edge, trigger, trigger_log);
+				time = edge + timer_period;
 			}
 			while ( time < end_time );
 			
@@ -241,20 +249,63 @@ void Nes_Triangle::run( cpu_time_t time, cpu_time_t end_time )
 			volume = -volume;
 		}
 		
-		do {
-			if ( --phase == 0 ) {
-				phase = phase_range;
-				volume = -volume;
-				if (volume > 0)
-					update_trigger(output, time, trigger);
+		Blip_Buffer::resampled_time_t rperiod = output->resampled_duration( timer_period );
+		
+		if ( rperiod < (Blip_Buffer::resampled_time_t) 1 << BLIP_BUFFER_ACCURACY )
+		{
+			// High notes have several steps per sample, they are added from a kernel and
+			// summed per sample before touching the buffer.
+			if ( kernel_serial != synth.kernel_serial() )
+			{
+				synth.make_kernel( 1, kernel );
+				kernel_serial = synth.kernel_serial();
 			}
-			else {
-				synth.offset_inline( time, volume, output );
+			
+			Blip_Buffer::resampled_time_t rtime = output->resampled_time( time );
+			Blip_Buffer::resampled_time_t times [batch_size];
+			unsigned char negate [batch_size];
+			int count = 0;
+			
+			do {
+				if ( --phase == 0 ) {
+					phase = phase_range;
+					volume = -volume;
+					if (volume > 0)
+						update_trigger(output, time, trigger, trigger_log);
+				}
+				else {
+					times [count] = rtime;
+					negate [count] = volume < 0;
+					if ( ++count == batch_size ) {
+						synth.offset_batch( times, negate, count, kernel, output );
+						count = 0;
+					}
+				}
+				
+				time += timer_period;
+				rtime += rperiod;
 			}
+			while ( time < end_time );
 			
-			time += timer_period;
+			synth.offset_batch( times, negate, count, kernel, output );
+		}
+		else
+		{
+			do {
+				if ( --phase == 0 ) {
+					phase = phase_range;
+					volume = -volume;
+					if (volume > 0)
+						update_trigger(output, time, trigger, trigger_log);
+				}
+				else {
+					synth.offset_inline( time, volume, output );
+				}
+				
+				time += timer_period;
+			}
+			while ( time < end_time );
 		}
-		while ( time < end_time );
 		
 		if ( volume < 0 )
 			phase += phase_range;
@@ -395,8 +446,14 @@ void Nes_Dmc::fill_buffer()
 {
 	if ( !buf_full && length_counter )
 	{
-		require( rom_reader ); // rom_reader must be set
-		buf = rom_reader( rom_reader_data, 0x8000u + address );
+		int offset = 0x8000 + address - rom_data_addr;
+		if ( rom_data && (unsigned) offset < (unsigned) rom_data_size ) {
+			buf = rom_data [offset];
+		}
+		else {
+			require( rom_reader ); // rom_reader must be set
+			buf = rom_reader( rom_reader_data, 0x8000u + address );
+		}
 		address = (address + 1) & 0x7FFF;
 		buf_full = true;
 		if ( --length_counter == 0 )
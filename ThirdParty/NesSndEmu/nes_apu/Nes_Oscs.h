@@ -10,6 +10,7 @@
 #include "blargg_common.h"
 
 class Nes_Apu;
+struct trigger_log_t;
 
 struct Nes_Osc
 {
@@ -21,6 +22,7 @@ struct Nes_Osc
 	int delay;      // delay until next (potential) transition
 	int last_amp;   // last amplitude oscillator was outputting
 	int trigger;
+	trigger_log_t* trigger_log;
 
 	void clock_length( int halt_mask );
 	int period() const {
@@ -40,6 +42,15 @@ struct Nes_Osc
 	{
 		output = o;
 	}
+	template<class S> void reflect_state( S& s ) {
+		s( regs );
+		s( ages );
+		s( reg_written );
+		s( length_counter );
+		s( delay );
+		s( last_amp );
+		s( trigger );
+	}
 };
 
 struct Nes_Envelope : Nes_Osc
@@ -54,6 +65,11 @@ struct Nes_Envelope : Nes_Osc
 		env_delay = 0;
 		Nes_Osc::reset();
 	}
+	template<class S> void reflect_state( S& s ) {
+		Nes_Osc::reflect_state( s );
+		s( envelope );
+		s( env_delay );
+	}
 };
 
 // Nes_Square
@@ -76,6 +92,11 @@ struct Nes_Square : Nes_Envelope
 		sweep_delay = 0;
 		Nes_Envelope::reset();
 	}
+	template<class S> void reflect_state( S& s ) {
+		Nes_Envelope::reflect_state( s );
+		s( phase );
+		s( sweep_delay );
+	}
 	cpu_time_t maintain_phase( cpu_time_t time, cpu_time_t end_time,
 			cpu_time_t timer_period );
 };
@@ -86,7 +107,15 @@ struct Nes_Triangle : Nes_Osc
 	enum { phase_range = 16 };
 	int phase;
 	int linear_counter;
-	Blip_Synth<blip_good_quality,15> synth;
+	typedef Blip_Synth<blip_good_quality,15> Synth;
+	Synth synth;
+	
+	// High notes add their steps from a kernel of the synth, made again when it changes.
+	enum { batch_size = 64 };
+	Synth::kernel_t kernel;
+	int kernel_serial;
+	
+	Nes_Triangle() : kernel_serial( -1 ) {}
 	
 	int calc_amp() const;
 	void run( cpu_time_t, cpu_time_t );
@@ -99,6 +128,11 @@ struct Nes_Triangle : Nes_Osc
 		phase = 1;
 		Nes_Osc::reset();
 	}
+	template<class S> void reflect_state( S& s ) {
+		Nes_Osc::reflect_state( s );
+		s( phase );
+		s( linear_counter );
+	}
 	cpu_time_t maintain_phase( cpu_time_t time, cpu_time_t end_time,
 			cpu_time_t timer_period );
 };
@@ -119,6 +153,10 @@ struct Nes_Noise : Nes_Envelope
 		noise = 4141;
 		Nes_Envelope::reset();
 	}
+	template<class S> void reflect_state( S& s ) {
+		Nes_Envelope::reflect_state( s );
+		s( noise );
+	}
 };
 
 // Nes_Dmc
@@ -147,6 +185,12 @@ struct Nes_Dmc : Nes_Osc
 	int (*rom_reader)( void*, cpu_addr_t ); // needs to be initialized to rom read function
 	void* rom_reader_data;
 	
+	// Optional native sample memory, read directly when the address falls inside it.
+	// Anything outside still goes through rom_reader.
+	const unsigned char* rom_data;
+	int rom_data_addr;
+	int rom_data_size;
+	
 	Nes_Apu* apu;
 	
 	Blip_Synth<blip_med_quality,127> synth;
@@ -161,6 +205,21 @@ struct Nes_Dmc : Nes_Osc
 	virtual void set_output(Blip_Buffer* output) override;
 	int count_reads( cpu_time_t, cpu_time_t* ) const;
 	cpu_time_t next_read_time() const;
+	template<class S> void reflect_state( S& s ) {
+		Nes_Osc::reflect_state( s );
+		s( address );
+		s( period );
+		s( buf );
+		s( bits_remain );
+		s( bits );
+		s( buf_full );
+		s( silence );
+		s( dac );
+		s( paused_dac );
+		s( next_irq );
+		s( irq_enabled );
+		s( irq_flag );
+	}
 };
 
 // Must match the definition in NesApu.cs.
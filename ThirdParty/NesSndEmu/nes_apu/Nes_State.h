@@ -0,0 +1,53 @@
+// Emulation state of the sound chips, for seek keyframes (see Simple_Apu::add_keyframe).
+
+#ifndef NES_STATE_H
+#define NES_STATE_H
+
+#include <string.h>
+
+// Each chip lists the fields of its state once, in a reflect_state() template called with
+// a writer to save it or a reader to load it. Only plain values (or arrays of them) are
+// listed, never pointers or settings such as the outputs, volumes, eq or sample memory,
+// so loading a state leaves those as they currently are.
+struct state_writer
+{
+	unsigned char* out; // NULL to only compute the size.
+	long size;
+
+	unsigned char* ptr() const { return out ? out + size : NULL; }
+
+	template<class T> void operator () ( T& v )
+	{
+		if ( out )
+			memcpy( out + size, &v, sizeof v );
+		size += sizeof v;
+	}
+
+	// Member with its own save_state().
+	template<class T> void state( const T& v ) { size += v.save_state( ptr() ); }
+};
+
+struct state_reader
+{
+	const unsigned char* in;
+	long size;
+	bool ok;
+
+	template<class T> void operator () ( T& v )
+	{
+		memcpy( &v, in + size, sizeof v );
+		size += sizeof v;
+	}
+
+	// Member with its own load_state(), which returns -1 if the state does not fit.
+	template<class T> void state( T& v )
+	{
+		long n = ok ? v.load_state( in + size ) : -1;
+		if ( n < 0 )
+			ok = false;
+		else
+			size += n;
+	}
+};
+
+#endif
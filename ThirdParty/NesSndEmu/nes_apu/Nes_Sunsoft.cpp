@@ -3,11 +3,16 @@
 
 #include "Nes_Sunsoft.h"
 #include "emu2149.h"
+#include "Nes_State.h"
 
 #include BLARGG_SOURCE_BEGIN
 
 Nes_Sunsoft::Nes_Sunsoft() : psg(NULL), output_buffer(NULL)
 {
+	psg_calc_count = 0;
+	memset(trigger_logs, 0, sizeof(trigger_logs));
+	memset(osc_buffers, 0, sizeof(osc_buffers));
+	osc_routed = false;
 	output(NULL);
 	volume(1.0);
 	reset();
@@ -23,8 +28,11 @@ void Nes_Sunsoft::reset()
 {
 	reset_psg();
 	memset(&ages[0], 0, array_count(ages));
+	reg = 0;
 	last_time = 0;
 	last_amp = 0;
+	memset(osc_amps, 0, sizeof(osc_amps));
+	delay = 0;
 	reset_triggers();
 }
 
@@ -46,6 +54,32 @@ void Nes_Sunsoft::reset_psg()
 }
 
 
+template<class S>
+void Nes_Sunsoft::reflect_state(S& s)
+{
+	s(reg);
+	s(ages);
+	s(last_time);
+	s(delay);
+	s(last_amp);
+	s(osc_amps);
+	s(triggers);
+}
+
+long Nes_Sunsoft::save_state(unsigned char* out) const
+{
+	state_writer w = { out, 0 };
+	((Nes_Sunsoft*)this)->reflect_state(w); // const_cast
+	return w.size + PSG_saveState(psg, w.ptr());
+}
+
+long Nes_Sunsoft::load_state(const unsigned char* in)
+{
+	state_reader r = { in, 0, true };
+	reflect_state(r);
+	return r.size + PSG_loadState(psg, in + r.size);
+}
+
 void Nes_Sunsoft::output(Blip_Buffer* buf)
 {
 	output_buffer = buf;
@@ -70,8 +104,20 @@ void Nes_Sunsoft::enable_channel(int idx, bool enabled)
 	}
 }
 
+void Nes_Sunsoft::osc_output(int idx, Blip_Buffer* buf)
+{
+	assert((unsigned)idx < array_count(osc_buffers));
+	osc_buffers[idx] = buf;
+	osc_routed = false;
+	for (int i = 0; i < (int)array_count(osc_buffers); i++)
+		osc_routed |= osc_buffers[i] != NULL;
+}
+
 void Nes_Sunsoft::write_register(cpu_time_t time, cpu_addr_t addr, int data)
 {
+	// Catch up first, the write only affects what comes after it.
+	run_until(time);
+
 	if (addr >= reg_select && addr < (reg_select + reg_range))
 	{
 		reg = data;
@@ -79,9 +125,9 @@ void Nes_Sunsoft::write_register(cpu_time_t time, cpu_addr_t addr, int data)
 	else if (addr >= reg_write && addr < (reg_write + reg_range))
 	{
 		PSG_writeReg(psg, reg, data);
-		ages[reg] = 0;
+		if ((unsigned)reg < array_count(ages))
+			ages[reg] = 0;
 	}
-	run_until(time);
 }
 
 long Nes_Sunsoft::run_until(cpu_time_t time)
@@ -94,10 +140,30 @@ long Nes_Sunsoft::run_until(cpu_time_t time)
 	t += delay;
 	delay = 0;
 
+	cpu_time_t start = t;
+
 	while (t < time)
 	{
 		int sample = PSG_calc(psg);
 
+		if (osc_routed)
+		{
+			for (int i = 0; i < (int)array_count(osc_buffers); i++)
+			{
+				if (osc_buffers[i])
+				{
+					int amp = (psg->mask & (1 << i)) ? 0 : psg->ch_out[i];
+					sample -= psg->ch_out[i];
+
+					if (amp != osc_amps[i])
+					{
+						synth.offset(t, amp - osc_amps[i], osc_buffers[i]);
+						osc_amps[i] = amp;
+					}
+				}
+			}
+		}
+
 		int delta = sample - last_amp;
 		if (delta)
 		{
@@ -108,7 +174,7 @@ long Nes_Sunsoft::run_until(cpu_time_t time)
 		for (int i = 0; i < 3; i++)
 		{
 			if (psg->trigger_mask & (1 << i))
-				update_trigger(output_buffer, t, triggers[i]);
+				update_trigger(output_buffer, t, triggers[i], trigger_logs[i]);
 			else if ((psg->trigger_mask & (8 << i)) == 0)
 				triggers[i] = trigger_none;
 		}
@@ -116,6 +182,9 @@ long Nes_Sunsoft::run_until(cpu_time_t time)
 		t += 16;
 	}
 
+	// Derived from the time covered rather than counted in the loop.
+	psg_calc_count += (t - start) / 16;
+
 	delay = t - time;
 	last_time = time;
 	return t;
@@ -151,7 +220,7 @@ void Nes_Sunsoft::write_shadow_register(int addr, int data)
 {
 	if (addr >= reg_select && addr < (reg_select + reg_range))
 		reg = data;
-	else if (addr >= reg_write && addr < (reg_write + reg_range))
+	else if (addr >= reg_write && addr < (reg_write + reg_range) && (unsigned)reg < shadow_internal_regs_count)
 		shadow_internal_regs[reg] = data;
 }
 
@@ -175,4 +244,9 @@ void Nes_Sunsoft::reset_triggers()
 int Nes_Sunsoft::get_channel_trigger(int idx) const
 {
 	return triggers[idx];
+}
+
+void Nes_Sunsoft::set_trigger_log(int idx, trigger_log_t* log)
+{
+	trigger_logs[idx] = log;
 }
\ No newline at end of file
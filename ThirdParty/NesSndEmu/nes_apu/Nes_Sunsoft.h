@@ -17,6 +17,8 @@ public:
 	void output( Blip_Buffer* );
 	void treble_eq(blip_eq_t const& eq);
 	void enable_channel(int idx, bool enabled);
+	// Renders a channel in its own buffer instead of the main output, NULL puts it back.
+	void osc_output(int idx, Blip_Buffer*);
 	long run_until(cpu_time_t);
 	void end_frame( cpu_time_t );
 	void mix_samples(blip_sample_t* sample_buffer, long sample_cnt);
@@ -33,8 +35,16 @@ public:
 	void stop_seeking(blip_time_t& clock);
 	void write_shadow_register(int addr, int data);
 
+	// State for seek keyframes, see Simple_Apu. Pass NULL to get the size.
+	long save_state(unsigned char* out) const;
+	long load_state(const unsigned char* in);
+
 	void reset_triggers();
 	int  get_channel_trigger(int idx) const;
+	void set_trigger_log(int idx, trigger_log_t* log);
+
+	// Number of PSG_calc() calls, for profiling. Not cleared by reset().
+	long long psg_calc_count;
 
 private:
 	// noncopyable
@@ -42,6 +52,7 @@ private:
 	Nes_Sunsoft& operator = ( const Nes_Sunsoft& );
 	
 	void reset_psg();
+	template<class S> void reflect_state(S& s);
 
 	int reg;
 	BOOST::uint8_t ages[16];
@@ -51,9 +62,13 @@ private:
 	cpu_time_t last_time;
 	int delay;
 	int last_amp;
+	Blip_Buffer* osc_buffers[3];
+	int osc_amps[3];
+	bool osc_routed;
 	// (255<<4)=4080 is the maximum a channel can be. It sums all 3 channels.
 	Blip_Synth<blip_med_quality, (255<<4) * 3> synth;
 	int triggers[3];
+	trigger_log_t* trigger_logs[3];
 
 	short shadow_internal_regs[shadow_internal_regs_count];
 };
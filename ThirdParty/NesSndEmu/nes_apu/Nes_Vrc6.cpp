@@ -2,6 +2,7 @@
 // Nes_Snd_Emu 0.1.7. http://www.slack.net/~ant/libs/
 
 #include "Nes_Vrc6.h"
+#include "Nes_State.h"
 
 /* Copyright (C) 2003-2005 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
@@ -18,6 +19,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
 
 Nes_Vrc6::Nes_Vrc6()
 {
+	for ( int i = 0; i < osc_count; i++ )
+		oscs [i].trigger_log = NULL;
+
 	output( NULL );
 	volume( 1.0 );
 	reset();
@@ -46,6 +50,37 @@ void Nes_Vrc6::reset()
 	}
 }
 
+template<class S>
+void Nes_Vrc6::reflect_state( S& s )
+{
+	for ( int i = 0; i < osc_count; i++ )
+	{
+		Vrc6_Osc& osc = oscs [i];
+		s( osc.regs );
+		s( osc.ages );
+		s( osc.delay );
+		s( osc.last_amp );
+		s( osc.phase );
+		s( osc.amp );
+		s( osc.trigger );
+	}
+	s( last_time );
+}
+
+long Nes_Vrc6::save_state( unsigned char* out ) const
+{
+	state_writer w = { out, 0 };
+	((Nes_Vrc6*) this)->reflect_state( w ); // const_cast
+	return w.size;
+}
+
+long Nes_Vrc6::load_state( const unsigned char* in )
+{
+	state_reader r = { in, 0, true };
+	reflect_state( r );
+	return r.size;
+}
+
 void Nes_Vrc6::volume( double v )
 {
 	saw_synth.volume( v * 0.333 );
@@ -155,6 +190,11 @@ int Nes_Vrc6::get_channel_trigger(int idx) const
 	return oscs[idx].trigger;
 }
 
+void Nes_Vrc6::set_trigger_log(int idx, trigger_log_t* log)
+{
+	oscs[idx].trigger_log = log;
+}
+
 #include BLARGG_ENABLE_OPTIMIZER
 inline cpu_time_t Nes_Vrc6::maintain_square_phase(Vrc6_Osc& osc, cpu_time_t time, cpu_time_t end_time, cpu_time_t period)
 {
@@ -208,7 +248,7 @@ void Nes_Vrc6::run_square( Vrc6_Osc& osc, cpu_time_t end_time )
 				{
 					phase = 0;
 					osc.last_amp = volume;
-					update_trigger(output, time, osc.trigger);
+					update_trigger(output, time, osc.trigger, osc.trigger_log);
 					square_synth.offset( time, volume, output );
 				}
 				if ( phase == duty )
@@ -274,7 +314,7 @@ void Nes_Vrc6::run_saw( cpu_time_t end_time )
 				{
 					phase = 7;
 					amp = 0;
-					update_trigger(output, time, osc.trigger);
+					update_trigger(output, time, osc.trigger, osc.trigger_log);
 				}
 				
 				int delta = (amp >> 3) - last_amp;
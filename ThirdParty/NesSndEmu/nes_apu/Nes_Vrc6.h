@@ -28,6 +28,7 @@ public:
 	void load_snapshot( vrc6_snapshot_t const& );
 	void reset_triggers();
 	int  get_channel_trigger(int idx) const;
+	void set_trigger_log(int idx, trigger_log_t* log);
 
 	// Oscillator 0 write-only registers are at $9000-$9002
 	// Oscillator 1 write-only registers are at $A000-$A002
@@ -44,6 +45,10 @@ public:
 	void stop_seeking(blip_time_t& clock);
 	void write_shadow_register(int addr, int data);
 
+	// State for seek keyframes, see Simple_Apu. Pass NULL to get the size.
+	long save_state( unsigned char* out ) const;
+	long load_state( const unsigned char* in );
+
 private:
 	// noncopyable
 	Nes_Vrc6( const Nes_Vrc6& );
@@ -59,6 +64,7 @@ private:
 		int phase;
 		int amp; // only used by saw
 		int trigger;
+		trigger_log_t* trigger_log;
 		
 		int period() const
 		{
@@ -77,6 +83,7 @@ private:
 	void run_square( Vrc6_Osc& osc, cpu_time_t );
 	void run_saw( cpu_time_t );
 	cpu_time_t maintain_square_phase(Vrc6_Osc& osc, cpu_time_t time, cpu_time_t end_time, cpu_time_t period);
+	template<class S> void reflect_state( S& );
 };
 
 struct vrc6_snapshot_t
@@ -3,11 +3,16 @@
 
 #include "Nes_Vrc7.h"
 #include "emu2413.h"
+#include "Nes_State.h"
 
 #include BLARGG_SOURCE_BEGIN
 
 Nes_Vrc7::Nes_Vrc7() : opll(NULL), output_buffer(NULL)
 {
+	opll_calc_count = 0;
+	memset(trigger_logs, 0, sizeof(trigger_logs));
+	memset(osc_buffers, 0, sizeof(osc_buffers));
+	osc_routed = false;
 	output(NULL);
 	volume(1.0);
 	reset();
@@ -23,6 +28,7 @@ void Nes_Vrc7::reset()
 {
 	reg = 0;
 	last_amp = 0;
+	memset(osc_amps, 0, sizeof(osc_amps));
 	last_time = 0;
 	delay = 0;
 	silence = false;
@@ -37,6 +43,43 @@ void Nes_Vrc7::volume(double v)
 	synth.volume(v);
 }
 
+template<class S>
+void Nes_Vrc7::reflect_state(S& s)
+{
+	s(silence);
+	s(silence_age);
+	s(regs_age);
+	s(reg);
+	s(triggers);
+	s(last_time);
+	s(delay);
+	s(last_amp);
+	s(osc_amps);
+}
+
+long Nes_Vrc7::save_state(unsigned char* out) const
+{
+	state_writer w = { out, 0 };
+	((Nes_Vrc7*)this)->reflect_state(w); // const_cast
+	return w.size + OPLL_saveState(opll, w.ptr());
+}
+
+long Nes_Vrc7::load_state(const unsigned char* in)
+{
+	state_reader r = { in, 0, true };
+	reflect_state(r);
+	r.size += OPLL_loadState(opll, in + r.size);
+
+	// Same as enable_channel(), the muted channels must not keep their old output.
+	for (int i = 0; i < 6; i++)
+	{
+		if (opll->mask & (1 << i))
+			opll->ch_out[i] = 0;
+	}
+
+	return r.size;
+}
+
 void Nes_Vrc7::reset_opll()
 {
 	if (opll)
@@ -81,6 +124,15 @@ void Nes_Vrc7::enable_channel(int idx, bool enabled)
 	}
 }
 
+void Nes_Vrc7::osc_output(int idx, Blip_Buffer* buf)
+{
+	assert((unsigned)idx < array_count(osc_buffers));
+	osc_buffers[idx] = buf;
+	osc_routed = false;
+	for (int i = 0; i < (int)array_count(osc_buffers); i++)
+		osc_routed |= osc_buffers[i] != NULL;
+}
+
 void Nes_Vrc7::write_register(cpu_time_t time, cpu_addr_t addr, int data)
 {
 	switch (addr)
@@ -94,7 +146,8 @@ void Nes_Vrc7::write_register(cpu_time_t time, cpu_addr_t addr, int data)
 		break;
 	case reg_write:
 		OPLL_writeReg(opll, reg, data);
-		regs_age[reg] = 0;
+		if ((unsigned)reg < array_count(regs_age))
+			regs_age[reg] = 0;
 		break;
 	default:
 		return;
@@ -117,10 +170,31 @@ void Nes_Vrc7::run_until(cpu_time_t end_time)
 	delay = 0;
 
 	cpu_time_t increment = (output_buffer->clock_rate() << 8) / opll->rate;
+	cpu_time_t start = time;
 
 	while (time < end_time)
 	{
 		int sample = OPLL_calc(opll);
+
+		// Routed channels are taken out of the mix, they are not clamped with it.
+		if (osc_routed)
+		{
+			for (int i = 0; i < (int)array_count(osc_buffers); i++)
+			{
+				if (osc_buffers[i])
+				{
+					int amp = silence ? 0 : opll->ch_out[i];
+					sample -= opll->ch_out[i];
+
+					if (amp != osc_amps[i])
+					{
+						synth.offset(time >> 8, amp - osc_amps[i], osc_buffers[i]);
+						osc_amps[i] = amp;
+					}
+				}
+			}
+		}
+
 		sample = clamp(sample, -3200, 3600);
 
 		if (silence)
@@ -141,12 +215,15 @@ void Nes_Vrc7::run_until(cpu_time_t end_time)
 			if (slot.fnum == 0 && triggers[i] < 0)
 				triggers[i] = trigger_none; 
 			else if (opll->slot[i * 2 + 1].trigger)
-				update_trigger(output_buffer, time >> 8, triggers[i]);
+				update_trigger(output_buffer, time >> 8, triggers[i], trigger_logs[i]);
 		}
 
 		time += increment;
 	}
 
+	// Derived from the time covered rather than counted in the loop.
+	opll_calc_count += (time - start) / increment;
+
 	delay = time - end_time;
 	last_time = end_time;
 } 
@@ -205,7 +282,7 @@ void Nes_Vrc7::write_shadow_register(int addr, int data)
 	{
 		case reg_silence: shadow_regs[0] = data; break;
 		case reg_select:  reg = data; break;
-		case reg_write:   shadow_internal_regs[reg] = data; break;
+		case reg_write:   if ((unsigned)reg < shadow_internal_regs_count) shadow_internal_regs[reg] = data; break;
 	}
 }
 
@@ -235,3 +312,8 @@ int Nes_Vrc7::get_channel_trigger(int idx) const
 {
 	return triggers[idx];
 }
+
+void Nes_Vrc7::set_trigger_log(int idx, trigger_log_t* log)
+{
+	trigger_logs[idx] = log;
+}
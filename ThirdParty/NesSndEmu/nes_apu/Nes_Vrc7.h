@@ -17,18 +17,28 @@ public:
 	void output(Blip_Buffer*);
 	void treble_eq(blip_eq_t const& eq);
 	void enable_channel(int idx, bool enabled);
+	// Renders a channel in its own buffer instead of the main output, NULL puts it back.
+	void osc_output(int idx, Blip_Buffer*);
 	void run_until(cpu_time_t);
 	void end_frame(cpu_time_t);
 	void write_register(cpu_time_t time, cpu_addr_t addr, int data);
 	void get_register_values(struct vrc7_register_values* regs);
 	void reset_triggers();
 	int  get_channel_trigger(int idx) const;
+	void set_trigger_log(int idx, trigger_log_t* log);
+
+	// Number of OPLL_calc() calls, for profiling. Not cleared by reset().
+	long long opll_calc_count;
 
 	enum { shadow_regs_count = 1 };
 	enum { shadow_internal_regs_count = 54 };
 	void start_seeking();
 	void stop_seeking(blip_time_t& clock);
 	void write_shadow_register(int addr, int data);
+
+	// State for seek keyframes, see Simple_Apu. Pass NULL to get the size.
+	long save_state(unsigned char* out) const;
+	long load_state(const unsigned char* in);
 	void write_internal_register(blip_time_t& clock, int reg, int data);
 
 	enum { vrc7_clock  = 3579545 };
@@ -42,17 +52,22 @@ private:
 	Nes_Vrc7& operator = (const Nes_Vrc7&);
 
 	void reset_opll();
+	template<class S> void reflect_state(S& s);
 
 	bool silence;
 	BOOST::uint8_t silence_age;
 	BOOST::uint8_t regs_age[54];
 	int reg;
 	int triggers[6];
+	trigger_log_t* trigger_logs[6];
 	struct __OPLL* opll;
 	Blip_Buffer* output_buffer;
 	cpu_time_t last_time;
 	int delay;
 	int last_amp;
+	Blip_Buffer* osc_buffers[6];
+	int osc_amps[6];
+	bool osc_routed;
 	Blip_Synth<blip_med_quality, 7200> synth;
 
 	short shadow_regs[shadow_regs_count];
@@ -208,6 +208,10 @@ PSG_reset (PSG * psg)
     psg->edge[i] = 0;
     psg->volume[i] = 0;
     psg->ch_out[i] = 0;
+    /* FamiStudio : the masks and envelope shape are decoded from registers 7 and 13,
+       clear them with the registers so that a reset PSG behaves like a new one. */
+    psg->tmask[i] = 0;
+    psg->nmask[i] = 0;
   }
 
   psg->mask = 0;
@@ -225,6 +229,11 @@ PSG_reset (PSG * psg)
   psg->env_freq = 0;
   psg->env_count = 0;
   psg->env_pause = 1;
+  psg->env_face = 0;
+  psg->env_continue = 0;
+  psg->env_attack = 0;
+  psg->env_alternate = 0;
+  psg->env_hold = 0;
 
   psg->out = 0;
 
@@ -480,3 +489,57 @@ PSG_writeReg (PSG * psg, uint32_t reg, uint32_t val)
 
   return;
 }
+
+/* FamiStudio : Lists the fields of the state once, for both saving and loading. */
+#define STATE_FIELD(f) \
+  (save ? (void) memcpy (save + size, &(f), sizeof (f)) : load ? (void) memcpy (&(f), load + size, sizeof (f)) : (void) 0, \
+   size += sizeof (f))
+
+static int32_t
+reflect_state (PSG * psg, uint8_t * save, const uint8_t * load)
+{
+  int32_t size = 0;
+
+  STATE_FIELD (psg->reg);
+  STATE_FIELD (psg->out);
+  STATE_FIELD (psg->count);
+  STATE_FIELD (psg->volume);
+  STATE_FIELD (psg->freq);
+  STATE_FIELD (psg->edge);
+  STATE_FIELD (psg->tmask);
+  STATE_FIELD (psg->nmask);
+  STATE_FIELD (psg->base_count);
+  STATE_FIELD (psg->env_ptr);
+  STATE_FIELD (psg->env_face);
+  STATE_FIELD (psg->env_continue);
+  STATE_FIELD (psg->env_attack);
+  STATE_FIELD (psg->env_alternate);
+  STATE_FIELD (psg->env_hold);
+  STATE_FIELD (psg->env_pause);
+  STATE_FIELD (psg->env_freq);
+  STATE_FIELD (psg->env_count);
+  STATE_FIELD (psg->noise_seed);
+  STATE_FIELD (psg->noise_scaler);
+  STATE_FIELD (psg->noise_count);
+  STATE_FIELD (psg->noise_freq);
+  STATE_FIELD (psg->psgtime);
+  STATE_FIELD (psg->adr);
+  STATE_FIELD (psg->trigger_mask);
+  STATE_FIELD (psg->ch_out);
+
+  return size;
+}
+
+#undef STATE_FIELD
+
+int32_t
+PSG_saveState (const PSG * psg, uint8_t * out)
+{
+  return reflect_state ((PSG *) psg, out, NULL);
+}
+
+int32_t
+PSG_loadState (PSG * psg, const uint8_t * in)
+{
+  return reflect_state (psg, NULL, in);
+}
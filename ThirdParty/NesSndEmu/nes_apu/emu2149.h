@@ -86,6 +86,12 @@ extern "C"
   void PSG_setVolumeMode (PSG * psg, int type);
   uint32_t PSG_setMask (PSG *, uint32_t mask);
   uint32_t PSG_toggleMask (PSG *, uint32_t mask);
+
+  /* FamiStudio : Save/load the emulation state, for seek keyframes. The settings (volume
+     table, clock, rate, quality and mask) are not part of it and are left as they are when
+     loading. Pass NULL to get the size. */
+  int32_t PSG_saveState (const PSG * psg, uint8_t * out);
+  int32_t PSG_loadState (PSG * psg, const uint8_t * in);
     
 #ifdef __cplusplus
 }
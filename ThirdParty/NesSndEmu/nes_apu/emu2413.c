@@ -1581,3 +1581,76 @@ uint32_t OPLL_toggleMask(OPLL *opll, uint32_t mask) {
   } else
     return 0;
 }
+
+/* FamiStudio : Lists the fields of the state once, for both saving and loading. */
+#define STATE_FIELD(f)                                                                                                 \
+  (save ? (void)memcpy(save + size, &(f), sizeof(f)) : load ? (void)memcpy(&(f), load + size, sizeof(f)) : (void)0,  \
+   size += sizeof(f))
+
+static int32_t reflect_state(OPLL *opll, uint8_t *save, const uint8_t *load) {
+  int32_t size = 0;
+  int i;
+
+  STATE_FIELD(opll->adr);
+  STATE_FIELD(opll->out_time);
+  STATE_FIELD(opll->reg);
+  STATE_FIELD(opll->test_flag);
+  STATE_FIELD(opll->slot_key_status);
+  STATE_FIELD(opll->rhythm_mode);
+  STATE_FIELD(opll->eg_counter);
+  STATE_FIELD(opll->pm_phase);
+  STATE_FIELD(opll->am_phase);
+  STATE_FIELD(opll->lfo_am);
+  STATE_FIELD(opll->noise_seed);
+  STATE_FIELD(opll->noise);
+  STATE_FIELD(opll->short_noise);
+  STATE_FIELD(opll->patch_number);
+  STATE_FIELD(opll->patch);
+  STATE_FIELD(opll->patch_update);
+  STATE_FIELD(opll->ch_out);
+  STATE_FIELD(opll->mix_out);
+
+  for (i = 0; i < 18; i++) {
+    OPLL_SLOT *slot = &opll->slot[i];
+
+    /* A reset points every slot to one of the patches of the chip, -1 is the null patch. */
+    int8_t patch = slot->patch == &null_patch ? -1 : (int8_t)(slot->patch - opll->patch);
+    uint8_t wave = slot->wave_table == wave_table_map[1];
+
+    STATE_FIELD(patch);
+    STATE_FIELD(wave);
+
+    if (load) {
+      slot->patch = patch < 0 ? &null_patch : &opll->patch[patch];
+      slot->wave_table = wave_table_map[wave & 1];
+    }
+
+    STATE_FIELD(slot->output);
+    STATE_FIELD(slot->pg_phase);
+    STATE_FIELD(slot->pg_out);
+    STATE_FIELD(slot->pg_keep);
+    STATE_FIELD(slot->blk_fnum);
+    STATE_FIELD(slot->fnum);
+    STATE_FIELD(slot->blk);
+    STATE_FIELD(slot->eg_state);
+    STATE_FIELD(slot->volume);
+    STATE_FIELD(slot->sus_flag);
+    STATE_FIELD(slot->tll);
+    STATE_FIELD(slot->rks);
+    STATE_FIELD(slot->eg_rate_h);
+    STATE_FIELD(slot->eg_rate_l);
+    STATE_FIELD(slot->eg_shift);
+    STATE_FIELD(slot->eg_out);
+    STATE_FIELD(slot->update_requests);
+    STATE_FIELD(slot->pg_phase_trigger);
+    STATE_FIELD(slot->trigger);
+  }
+
+  return size;
+}
+
+#undef STATE_FIELD
+
+int32_t OPLL_saveState(const OPLL *opll, uint8_t *out) { return reflect_state((OPLL *)opll, out, NULL); }
+
+int32_t OPLL_loadState(OPLL *opll, const uint8_t *in) { return reflect_state(opll, NULL, in); }
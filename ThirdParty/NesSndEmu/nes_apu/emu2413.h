@@ -214,6 +214,14 @@ uint32_t OPLL_setMask(OPLL *, uint32_t mask);
  */
 uint32_t OPLL_toggleMask(OPLL *, uint32_t mask);
 
+/**
+ * FamiStudio : Save/load the emulation state, for seek keyframes. The settings (clock, rate,
+ * chip mode, pan and mask) are not part of it and are left as they are when loading.
+ * The slot patches and wave tables are saved as indices. Pass NULL to get the size.
+ */
+int32_t OPLL_saveState(const OPLL *opll, uint8_t *out);
+int32_t OPLL_loadState(OPLL *opll, const uint8_t *in);
+
 /* for compatibility */
 #define OPLL_set_rate OPLL_setRate
 #define OPLL_set_quality OPLL_setQuality
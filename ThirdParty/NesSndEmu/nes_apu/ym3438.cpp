@@ -1509,7 +1509,10 @@ ym3438_t* OPN_New()
 
 void OPN2_SetChipType(Bit32u type)
 {
-    chip_type = type;
+    // FamiStudio : Every chip sets the same type, only write it once so that chips can be
+    // created on several threads.
+    if (chip_type != type)
+        chip_type = type;
 }
 
 void OPN2_Clock(ym3438_t* chip, Bit16s* buffer, bool fm, bool rythm, bool misc)
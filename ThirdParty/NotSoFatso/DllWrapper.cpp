@@ -1,3 +1,10 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
 #include "NSF_Core.h"
 #include "NSF_File.h"
 
@@ -6,21 +13,50 @@
 #define __cdecl
 #endif
  
+struct NsfProfileLabel
+{
+	int addr;
+	std::string name;
+};
+
+struct NsfProfileBucket
+{
+	int addr;
+	INT64 cycles;
+	std::string name;
+};
+
+// Must match NotSoFatso.NsfProfileSummary.
+struct NsfProfileSummary
+{
+	int frames;
+	int peakFrame;
+	UINT peakCycles;
+	UINT initCycles;
+	INT64 totalCycles;
+	double averageCycles;
+};
+
 struct NsfCoreFile
 {
 	CNSFFile file;
 	CNSFCore core;
+	std::vector<NsfProfileLabel> labels;   // Sorted by address.
+	std::vector<NsfProfileBucket> buckets; // Sorted by cost, see NsfGetProfileBucketCount.
 };
 
-extern "C" void* __stdcall NsfOpen(const char* file)
+// The NSF data is only referenced by the file while loading, the core makes its own copy of the ROM.
+static void* NsfOpenData(const void* data, int size)
 {
 	NsfCoreFile* nsf = new NsfCoreFile();
 
-	if (!nsf->file.LoadFile(file, 1, false) &&
+	if (!nsf->file.LoadMemory(data, size, 1, false, 0) &&
 		 nsf->core.Initialize() &&
 		 nsf->core.SetPlaybackOptions(44100, 1) &&
 		 nsf->core.LoadNSF(&nsf->file))
 	{
+		nsf->file.ReleaseData();
+
 		float fBasedPlaysPerSec;
 		if ((nsf->file.nIsPal & 0x03) == 0x01)
 			fBasedPlaysPerSec = PAL_NMIRATE;
@@ -41,6 +77,25 @@ extern "C" void* __stdcall NsfOpen(const char* file)
 	}
 }
 
+extern "C" void* __stdcall NsfOpen(const char* file)
+{
+	int size;
+	BYTE* data = CNSFFile::MapFile(file, &size);
+
+	if (!data)
+		return NULL;
+
+	void* nsf = NsfOpenData(data, size);
+	CNSFFile::UnmapFile(data, size);
+	return nsf;
+}
+
+// Same as NsfOpen, for a NSF/NSFE that is already in memory. The data isn't needed after this returns.
+extern "C" void* __stdcall NsfOpenMemory(const void* data, int size)
+{
+	return NsfOpenData(data, size);
+}
+
 extern "C" int __stdcall NsfGetTrackCount(void* nsfPtr)
 {
 	return ((NsfCoreFile*)nsfPtr)->file.nTrackCount;
@@ -113,3 +168,205 @@ extern "C" void __stdcall NsfSetApuWriteCallback(void* nsfPtr, ApuRegWriteCallba
 {
 	return ((NsfCoreFile*)nsfPtr)->core.SetApuWriteCallback(callback);
 }
+
+extern "C" int __stdcall NsfSetProfiling(void* nsfPtr, int enable)
+{
+	NsfCoreFile* nsf = (NsfCoreFile*)nsfPtr;
+	nsf->buckets.clear();
+	return nsf->core.SetProfiling(enable);
+}
+
+// Reads the labels of a ca65 debug file ("sym" lines of type "lab", from ld65 --dbgfile) or 
+// a VICE label file ("al" lines, from ld65 -Ln). Returns the number of labels loaded.
+extern "C" int __stdcall NsfLoadProfileLabels(void* nsfPtr, const char* path)
+{
+	NsfCoreFile* nsf = (NsfCoreFile*)nsfPtr;
+	nsf->labels.clear();
+	nsf->buckets.clear();
+
+	FILE* f = fopen(path, "r");
+	if (!f)
+		return 0;
+
+	char line[1024];
+	while (fgets(line, sizeof(line), f))
+	{
+		NsfProfileLabel label;
+		char name[256];
+		unsigned int addr;
+
+		if (!strncmp(line, "al ", 3))
+		{
+			if (sscanf(line, "al %x .%255s", &addr, name) != 2)
+				continue;
+			label.name = name;
+		}
+		else if (!strncmp(line, "sym\t", 4))
+		{
+			const char* n = strstr(line, "name=\"");
+			const char* v = strstr(line, "val=0x");
+			if (!n || !v || !strstr(line, "type=lab"))
+				continue;
+			n += 6;
+			const char* e = strchr(n, '"');
+			if (!e)
+				continue;
+			label.name.assign(n, e);
+			addr = (unsigned int)strtoul(v + 6, NULL, 16);
+		}
+		else
+		{
+			continue;
+		}
+
+		// Linker symbols (__CODE_LOAD__, etc.) would hide the actual code labels.
+		if (addr > 0xffff || label.name.empty() || !label.name.compare(0, 2, "__"))
+			continue;
+
+		label.addr = (int)addr;
+		nsf->labels.push_back(label);
+	}
+
+	fclose(f);
+
+	std::stable_sort(nsf->labels.begin(), nsf->labels.end(), 
+		[](const NsfProfileLabel& a, const NsfProfileLabel& b) { return a.addr < b.addr; });
+
+	return (int)nsf->labels.size();
+}
+
+extern "C" void __stdcall NsfGetProfileSummary(void* nsfPtr, NsfProfileSummary* summary)
+{
+	CNSFCore& core = ((NsfCoreFile*)nsfPtr)->core;
+	memset(summary, 0, sizeof(NsfProfileSummary));
+
+	summary->frames = core.GetProfileFrameCount();
+	summary->initCycles = core.GetProfileInitCycles();
+
+	for (UINT i = 0; i < core.GetProfileFrameCount(); i++)
+	{
+		UINT cycles = core.GetProfileFrames()[i];
+		summary->totalCycles += cycles;
+
+		if (cycles > summary->peakCycles)
+		{
+			summary->peakCycles = cycles;
+			summary->peakFrame = i;
+		}
+	}
+
+	if (summary->frames)
+		summary->averageCycles = summary->totalCycles / (double)summary->frames;
+}
+
+// Cycles spent in the play routine for each profiled frame. Returns the number of frames 
+// available, only the first 'count' are copied.
+extern "C" int __stdcall NsfGetProfileFrames(void* nsfPtr, unsigned int* frames, int count)
+{
+	CNSFCore& core = ((NsfCoreFile*)nsfPtr)->core;
+	int num = (int)core.GetProfileFrameCount();
+
+	if (frames && count > 0)
+		memcpy(frames, core.GetProfileFrames(), min(count, num) * sizeof(UINT));
+
+	return num;
+}
+
+// Groups the cycles of each PC under the closest label at or before it, or under the PC itself
+// if no labels were loaded. Buckets are sorted from the most to the least expensive and stay
+// valid until the next call. Bank switching is ignored, all banks mapped at a PC share it.
+extern "C" int __stdcall NsfGetProfileBucketCount(void* nsfPtr)
+{
+	NsfCoreFile* nsf = (NsfCoreFile*)nsfPtr;
+	const INT64* pcs = nsf->core.GetProfilePCs();
+	const std::vector<NsfProfileLabel>& labels = nsf->labels;
+
+	nsf->buckets.clear();
+
+	if (!pcs)
+		return 0;
+
+	if (labels.empty())
+	{
+		for (int pc = 0; pc < 0x10000; pc++)
+		{
+			if (pcs[pc])
+			{
+				char name[8];
+				sprintf(name, "$%04X", pc);
+
+				NsfProfileBucket bucket;
+				bucket.addr = pc;
+				bucket.cycles = pcs[pc];
+				bucket.name = name;
+				nsf->buckets.push_back(bucket);
+			}
+		}
+	}
+	else
+	{
+		std::vector<INT64> cycles(labels.size() + 1, 0); // Last one is for the PCs before the first label.
+		size_t idx = 0;
+
+		for (int pc = 0; pc < 0x10000; pc++)
+		{
+			while (idx < labels.size() && labels[idx].addr <= pc)
+				idx++;
+
+			cycles[idx == 0 ? labels.size() : idx - 1] += pcs[pc];
+		}
+
+		for (size_t i = 0; i < cycles.size(); i++)
+		{
+			if (cycles[i])
+			{
+				NsfProfileBucket bucket;
+				bucket.addr = i < labels.size() ? labels[i].addr : 0;
+				bucket.cycles = cycles[i];
+				bucket.name = i < labels.size() ? labels[i].name : "(unlabeled)";
+				nsf->buckets.push_back(bucket);
+			}
+		}
+	}
+
+	std::stable_sort(nsf->buckets.begin(), nsf->buckets.end(),
+		[](const NsfProfileBucket& a, const NsfProfileBucket& b) { return a.cycles > b.cycles; });
+
+	return (int)nsf->buckets.size();
+}
+
+extern "C" const char* __stdcall NsfGetProfileBucketName(void* nsfPtr, int idx)
+{
+	return ((NsfCoreFile*)nsfPtr)->buckets[idx].name.c_str();
+}
+
+extern "C" int __stdcall NsfGetProfileBucketAddress(void* nsfPtr, int idx)
+{
+	return ((NsfCoreFile*)nsfPtr)->buckets[idx].addr;
+}
+
+extern "C" INT64 __stdcall NsfGetProfileBucketCycles(void* nsfPtr, int idx)
+{
+	return ((NsfCoreFile*)nsfPtr)->buckets[idx].cycles;
+}
+
+extern "C" int __stdcall NsfSetTrace(void* nsfPtr, int capacity, int minAddr, int maxAddr)
+{
+	return ((NsfCoreFile*)nsfPtr)->core.SetTrace(capacity, (WORD)minAddr, (WORD)maxAddr);
+}
+
+extern "C" int __stdcall NsfReadTrace(void* nsfPtr, NSF_TRACE_ENTRY* entries, int count)
+{
+	return ((NsfCoreFile*)nsfPtr)->core.ReadTrace(entries, count);
+}
+
+extern "C" int __stdcall NsfGetTraceDropped(void* nsfPtr)
+{
+	return ((NsfCoreFile*)nsfPtr)->core.GetTraceDropped();
+}
+
+// Doesn't need the NSF, traces can be disassembled after it is closed. NULL entry = column header.
+extern "C" int __stdcall NsfDisassembleTrace(const NSF_TRACE_ENTRY* entry, char* text, int size)
+{
+	return CNSFCore::DisassembleTrace(entry, text, size);
+}
@@ -379,9 +379,15 @@ UINT CNSFCore::Emulate6502(UINT runto)
 
 	while(nCPUCycle < runto)
 	{
+		WORD opPC = PC.W;
+		UINT opCycle = nCPUCycle;
+
 		op = Rd(PC.W);
 		PC.W++;
 
+		if(pTrace)
+			TraceInstruction(opPC, op, A, X, Y, SP, ST);
+
 		nCPUCycle += CPU_Cycles[op];
 		switch(op)
 		{
@@ -823,6 +829,14 @@ UINT CNSFCore::Emulate6502(UINT runto)
 			UpdateNZ(A);
 			break;
 		}
+
+		//  Charge the instruction to its PC, including page crossings, branches taken
+		//  and DMC stalls. The NSF player stub isn't part of the engine.
+		if(pProfilePC && (WORD)(opPC - 0x5000) >= 0x10)
+		{
+			pProfilePC[opPC] += nCPUCycle - opCycle;
+			nProfileCycles += nCPUCycle - opCycle;
+		}
 	}
 
 jammed:
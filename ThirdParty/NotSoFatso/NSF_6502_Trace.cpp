@@ -22,18 +22,14 @@
 //
 //  NSF_6502_Trace.cpp
 //
+//  Instruction trace. The emulator only copies each instruction and the registers in a
+//  ring, the disassembly is done offline when the trace is read.
+//
 
-
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
 #include <stdio.h>
+#include <string.h>
 #include "NSF_Core.h"
 
-#ifdef TRACE_6502
-
-FILE* pLogFile = NULL;
-
-
 const LPCSTR OpCodeNames[0x100] = {
 " BRK "," ORA ","(HLT)","(ASO)","(SKB)"," ORA "," ASL ","(ASO)"," PHP "," ORA "," ASL ","(ANC)","(SKW)"," ORA "," ASL ","(ASO)",
 " BPL "," ORA ","(HLT)","(ASO)","(SKB)"," ORA "," ASL ","(ASO)"," CLC "," ORA ","(NOP)","(ASO)","(SKW)"," ORA "," ASL ","(ASO)",
@@ -85,134 +81,132 @@ amIm,amIx,amIm,amIx,amZp,amZp,amZp,amZp,amXx,amIm,amXx,amIm,amAb,amAb,amAb,amAb,
 amRl,amIy,amXx,amIy,amZx,amZx,amZx,amZx,amXx,amAy,amXx,amAy,amAx,amAx,amAx,amAx
 };
 
+static int InstructionLength(BYTE op)
+{
+	switch(AddressingModes[op])
+	{
+	case amXx:
+	case amAc:	return 1;
+	case amIn:
+	case amAb:
+	case amAx:
+	case amAy:	return 3;
+	default:	return 2;
+	}
+}
+
 #define Read(a) ((this->*ReadMemory[(a) >> 12])(a))	
 
-void CNSFCore::Trace6502(WORD pc,BYTE a, BYTE x, BYTE y, BYTE sp, BYTE st)
+int CNSFCore::SetTrace(int capacity, WORD minaddr, WORD maxaddr)
 {
-	if(bHasBeenOpened)
-	{
-		pLogFile = fopen("C:\\NotSo Log.txt","r+b");
-		if(!pLogFile)
-			return;
+	delete[] pTrace;
+	pTrace = NULL;
+	nTraceMask = 0;
+	nTraceRead = 0;
+	nTraceWrite = 0;
+	nTraceDropped = 0;
+	nTraceMin = minaddr;
+	nTraceMax = maxaddr;
+
+	if(capacity <= 0)
+		return 1;
+
+	UINT size = 1;
+	while(size < (UINT)capacity)
+		size <<= 1;
+
+	pTrace = new NSF_TRACE_ENTRY[size];
+	if(!pTrace)
+		return 0;
+
+	nTraceMask = size - 1;
+	return 1;
+}
 
-		fseek(pLogFile,0,SEEK_END);
-	}
-	else
-	{
-		pLogFile = fopen("C:\\NotSo Log.txt","wb");
-		if(!pLogFile)
-			return;
+int CNSFCore::ReadTrace(NSF_TRACE_ENTRY* out, int count)
+{
+	int num = 0;
 
-		bHasBeenOpened = 1;
+	while(num < count && nTraceRead != nTraceWrite)
+		out[num++] = pTrace[nTraceRead++ & nTraceMask];
+
+	return num;
+}
 
-		fprintf(pLogFile,"PC     Instr.      Context            A  X  Y  Status    SP\r\n===========================================================\r\n\r\n");
+void FASTCALL CNSFCore::TraceInstruction(WORD pc, BYTE op, BYTE a, BYTE x, BYTE y, BYTE sp, BYTE st)
+{
+	if((WORD)(pc - nTraceMin) > (WORD)(nTraceMax - nTraceMin))
+		return;
+
+	//  Full, the oldest entry is overwritten.
+	if(nTraceWrite - nTraceRead > nTraceMask)
+	{
+		nTraceRead++;
+		nTraceDropped++;
 	}
 
-	BYTE inst = Read(pc);
+	NSF_TRACE_ENTRY& e = pTrace[nTraceWrite++ & nTraceMask];
+	int len = InstructionLength(op);
+
+	e.nPC = pc;
+	e.nOpcode = op;
+	e.nOperand[0] = len > 1 ? Read((WORD)(pc + 1)) : 0;
+	e.nOperand[1] = len > 2 ? Read((WORD)(pc + 2)) : 0;
+	e.regA = a;
+	e.regX = x;
+	e.regY = y;
+	e.regSP = sp;
+	e.regP = st;
+	e.nFrame = (WORD)nTotalPlays;
+	e.nCycle = nCPUCycle;
+}
+
+int CNSFCore::DisassembleTrace(const NSF_TRACE_ENTRY* e, char* text, int size)
+{
+	if(!e)
+		return snprintf(text, size, "Frame  Cycle  PC    Bytes     Instr.  Operand            A  X  Y  Status   SP");
+
+	BYTE op = e->nOpcode;
+	BYTE lo = e->nOperand[0];
+	WORD abs = lo | (e->nOperand[1] << 8);
+	int len = InstructionLength(op);
+	char bytes[16];
+	char operand[32];
 
-	WORD frontaddress;
-	WORD finaladdress;
-	BYTE val;
-	
-	fprintf(pLogFile,"%04X   %02X   %s  ",pc,inst,OpCodeNames[inst]);
+	switch(len)
+	{
+	case 1:	snprintf(bytes, sizeof(bytes), "%02X      ", op);						break;
+	case 2:	snprintf(bytes, sizeof(bytes), "%02X %02X   ", op, lo);					break;
+	default:snprintf(bytes, sizeof(bytes), "%02X %02X %02X", op, lo, e->nOperand[1]);	break;
+	}
 
-	switch(AddressingModes[inst])
+	//  Memory isn't part of the trace, only the addresses that the registers give are known.
+	switch(AddressingModes[op])
 	{
-	case amXx:		//implied
-		fprintf(pLogFile,"                ");
-		break;
-
-	case amIx:		//indirect X
-		frontaddress = Read(pc + 1);
-		finaladdress = BYTE(frontaddress + x);
-		finaladdress = Read(finaladdress) | (Read(finaladdress + 1) << 8);
-		val = Read(finaladdress);
-		fprintf(pLogFile,"(%02X,X) [%04X=%02X]",frontaddress,finaladdress,val);
-		break;
-
-	case amIy:		//indirect Y
-		frontaddress = Read(pc + 1);
-		finaladdress = (Read(frontaddress) | (Read(frontaddress + 1) << 8)) + y;
-		val = Read(finaladdress);
-		fprintf(pLogFile,"(%02X),Y [%04X=%02X]",frontaddress,finaladdress,val);
-		break;
-
-	case amIn:		//indirect
-		frontaddress = Read(pc + 1) | (Read(pc + 2) << 8);
-		finaladdress = (Read(frontaddress) | (Read(frontaddress + 1) << 8));
-		fprintf(pLogFile,"(%04X)    [%04X]",frontaddress,finaladdress);
-		break;
-
-	case amZp:		//zero page
-		frontaddress = Read(pc + 1);
-		val = Read(frontaddress);
-		fprintf(pLogFile,"%02X          [%02X]",frontaddress,val);
-		break;
-
-	case amZx:		//zero page X
-		frontaddress = Read(pc + 1);
-		finaladdress = frontaddress + x;
-		val = Read(finaladdress);
-		fprintf(pLogFile,"%02X,X   [%04X=%02X]",frontaddress,finaladdress,val);
-		break;
-
-	case amZy:		//zero page Y
-		frontaddress = Read(pc + 1);
-		finaladdress = frontaddress + y;
-		val = Read(finaladdress);
-		fprintf(pLogFile,"%02X,Y   [%04X=%02X]",frontaddress,finaladdress,val);
-		break;
-
-	case amAb:		//absolute
-		frontaddress = Read(pc + 1) | (Read(pc + 2) << 8);
-		val = Read(frontaddress);
-		fprintf(pLogFile,"%04X        [%02X]",frontaddress,val);
-		break;
-
-	case amAx:		//absolute X
-		frontaddress = Read(pc + 1) | (Read(pc + 2) << 8);
-		finaladdress = frontaddress + x;
-		val = Read(finaladdress);
-		fprintf(pLogFile,"%04X,X [%04X=%02X]",frontaddress,finaladdress,val);
-		break;
-
-	case amAy:		//absolute Y
-		frontaddress = Read(pc + 1) | (Read(pc + 2) << 8);
-		finaladdress = frontaddress + y;
-		val = Read(finaladdress);
-		fprintf(pLogFile,"%04X,Y [%04X=%02X]",frontaddress,finaladdress,val);
-		break;
-
-	case amAc:		//Accumulator
-		fprintf(pLogFile,"A               ");
-		break;
-
-	case amIm:		//Immediate
-		val = Read(pc + 1);
-		fprintf(pLogFile,"#%02X             ",val);
-		break;
-
-	case amRl:		//relative
-		val = Read(pc + 1);
-		frontaddress = pc + 2 + (char)val;
-		fprintf(pLogFile,"%02X        [%04X]",val,frontaddress);
-		break;
+	case amIx:	snprintf(operand, sizeof(operand), "($%02X,X)", lo);								break;
+	case amIy:	snprintf(operand, sizeof(operand), "($%02X),Y", lo);								break;
+	case amIn:	snprintf(operand, sizeof(operand), "($%04X)", abs);								break;
+	case amZp:	snprintf(operand, sizeof(operand), "$%02X", lo);									break;
+	case amZx:	snprintf(operand, sizeof(operand), "$%02X,X   [%04X]", lo, (BYTE)(lo + e->regX));	break;
+	case amZy:	snprintf(operand, sizeof(operand), "$%02X,Y   [%04X]", lo, (BYTE)(lo + e->regY));	break;
+	case amAb:	snprintf(operand, sizeof(operand), "$%04X", abs);								break;
+	case amAx:	snprintf(operand, sizeof(operand), "$%04X,X [%04X]", abs, (WORD)(abs + e->regX));	break;
+	case amAy:	snprintf(operand, sizeof(operand), "$%04X,Y [%04X]", abs, (WORD)(abs + e->regY));	break;
+	case amAc:	snprintf(operand, sizeof(operand), "A");											break;
+	case amIm:	snprintf(operand, sizeof(operand), "#$%02X", lo);								break;
+	case amRl:	snprintf(operand, sizeof(operand), "$%04X", (WORD)(e->nPC + 2 + (signed char)lo));	break;
+	default:	operand[0] = 0;																	break;
 	}
 
-	fprintf(pLogFile,"  %02X %02X %02X  [%c%c%c%c%c]   %02X\r\n",
-		a,x,y,
+	BYTE st = e->regP;
+
+	return snprintf(text, size, "%5u %6u  %04X  %s  %s  %-17s  %02X %02X %02X  [%c%c%c%c%c]  %02X",
+		e->nFrame, e->nCycle, e->nPC, bytes, OpCodeNames[op], operand,
+		e->regA, e->regX, e->regY,
 		(st & 0x80) ? 'N' : '.',
 		(st & 0x40) ? 'V' : '.',
 		(st & 0x04) ? 'I' : '.',
 		(st & 0x02) ? 'Z' : '.',
 		(st & 0x01) ? 'C' : '.',
-		sp);
-
-	fclose(pLogFile);
+		e->regSP);
 }
-
-
-
-
-
-#endif
\ No newline at end of file
@@ -1501,6 +1501,9 @@ void CNSFCore::Destroy()
 	SAFE_DELETE(pROM_Full);
 	SAFE_DELETE(mWave_TND.nOutputTable_L);
 	SAFE_DELETE(mWave_TND.nOutputTable_R);
+	SAFE_DELETE(pProfilePC);
+	SAFE_DELETE(pProfileFrames);
+	SAFE_DELETE(pTrace);
 
 	pStack = NULL;
 	ZeroMemory(pROM,sizeof(BYTE*) * 10);
@@ -2688,6 +2691,8 @@ int CNSFCore::RunOneFrame()
 	ResetFrameState();
 
 	nCPUCycle = nAPUCycle = 0;
+	nProfileCycles = 0;
+	BYTE bInitFrame = (regPC == 0x5000);
 	UINT tick;
 		
 	while (1)
@@ -2725,9 +2730,52 @@ int CNSFCore::RunOneFrame()
 	nCPUCycle = nAPUCycle = 0;
 	bIsGeneratingSamples = 0;
 
+	if (pProfilePC)
+	{
+		if (bInitFrame)
+		{
+			nProfileInitCycles += nProfileCycles;
+		}
+		else
+		{
+			if (nProfileFrameCount == nProfileFrameMax)
+			{
+				UINT newMax = nProfileFrameMax ? nProfileFrameMax * 2 : 4096;
+				UINT* newFrames = new UINT[newMax];
+				if (nProfileFrameCount)
+					memcpy(newFrames, pProfileFrames, nProfileFrameCount * sizeof(UINT));
+				SAFE_DELETE(pProfileFrames);
+				pProfileFrames = newFrames;
+				nProfileFrameMax = newMax;
+			}
+
+			pProfileFrames[nProfileFrameCount++] = nProfileCycles;
+		}
+	}
+
 	return nPlayCalled;
 }
 
+int CNSFCore::SetProfiling(int enable)
+{
+	SAFE_DELETE(pProfilePC);
+	SAFE_DELETE(pProfileFrames);
+	nProfileFrameCount = 0;
+	nProfileFrameMax = 0;
+	nProfileCycles = 0;
+	nProfileInitCycles = 0;
+
+	if (!enable)
+		return 1;
+
+	pProfilePC = new INT64[0x10000];
+	if (!pProfilePC)
+		return 0;
+
+	ZeroMemory(pProfilePC, 0x10000 * sizeof(INT64));
+	return 1;
+}
+
 template <typename T>
 int IndexOf(const T* array, int arraySize, T val)
 {
@@ -80,6 +80,21 @@ struct NSF_ADVANCEDOPTIONS
 	int			nPrePassBase;
 };
 
+//	One instruction of the trace (see CNSFCore::SetTrace)
+struct NSF_TRACE_ENTRY
+{
+	WORD		nPC;
+	BYTE		nOpcode;
+	BYTE		nOperand[2];			//only the bytes the addressing mode uses, 0 otherwise
+	BYTE		regA;
+	BYTE		regX;
+	BYTE		regY;
+	BYTE		regSP;
+	BYTE		regP;
+	WORD		nFrame;					//low 16 bits of the play count
+	UINT		nCycle;					//CPU cycle in the frame, before the instruction
+};
+
 #define NTSC_FREQUENCY			 1789772.727273f
 #define PAL_FREQUENCY			 1652097.692308f
 #define NTSC_NMIRATE			      60.098814f
@@ -234,6 +249,27 @@ public:
 	void	ResetFrameState();
 	void	SetApuWriteCallback(ApuRegWriteCallback callback);
 
+	//
+	//	Profiling (FamiStudio). While enabled, every instruction charges its cycles to its
+	//	PC and RunOneFrame() records the cycles spent in the init/play routines that frame.
+	//	The player stub at 0x5000-0x500F is not counted. Enabling clears the previous data.
+	//
+	int		SetProfiling(int enable);		//1 = ok, 0 = couldn't allocate the histogram
+	const INT64*	GetProfilePCs()			{ return pProfilePC; }			//cycles spent at each PC (0x10000 entries), NULL if not profiling
+	const UINT*		GetProfileFrames()		{ return pProfileFrames; }		//cycles spent in the play routine, for each frame
+	UINT			GetProfileFrameCount()	{ return nProfileFrameCount; }
+	UINT			GetProfileInitCycles()	{ return nProfileInitCycles; }
+
+	//
+	//	Tracing (FamiStudio). While enabled, every instruction whose PC is in [minaddr, maxaddr]
+	//	is copied in a ring of 'capacity' entries (rounded up to a power of 2), overwriting the
+	//	oldest ones when full. ReadTrace() drains the ring, oldest first.
+	//
+	int		SetTrace(int capacity, WORD minaddr, WORD maxaddr);		//0 = disables, returns 0 if couldn't allocate the ring
+	int		ReadTrace(NSF_TRACE_ENTRY* out, int count);				//returns the number of entries read
+	UINT	GetTraceDropped()				{ return nTraceDropped; }	//entries overwritten before being read
+	static int	DisassembleTrace(const NSF_TRACE_ENTRY* entry, char* text, int size);	//NULL entry = column header
+
 	//
 	//	Playback options
 	//
@@ -310,6 +346,7 @@ protected:
 	 */
 	void				EmulateAPU(BYTE bBurnCPUCycles);
 	UINT				Emulate6502(UINT runto);
+	void FASTCALL		TraceInstruction(WORD pc, BYTE op, BYTE a, BYTE x, BYTE y, BYTE sp, BYTE st);
 
 
 protected:
@@ -447,6 +484,27 @@ protected:
 	UINT		nAPUCycle;
 	UINT		nTotalPlays;			//number of times the play subroutine has been called (for tracking output time)
 
+	/*
+	 *	Profiler (see SetProfiling)
+	 */
+	INT64*		pProfilePC;				//cycles spent at each PC, NULL when not profiling
+	UINT*		pProfileFrames;			//cycles spent in the play routine, for each frame
+	UINT		nProfileFrameCount;
+	UINT		nProfileFrameMax;
+	UINT		nProfileCycles;			//cycles spent so far in the current frame
+	UINT		nProfileInitCycles;		//cycles spent in the init routine
+
+	/*
+	 *	Trace (see SetTrace)
+	 */
+	NSF_TRACE_ENTRY*	pTrace;			//ring, NULL when not tracing
+	UINT		nTraceMask;
+	UINT		nTraceWrite;
+	UINT		nTraceRead;
+	UINT		nTraceDropped;
+	WORD		nTraceMin;
+	WORD		nTraceMax;
+
 
 	/*
 	 *	Silence Tracker
@@ -24,9 +24,15 @@
 
 
 #include <stdio.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#define NSF_MMAP
+#endif
 #include "NSF_Core.h"
 #include "NSF_File.h"
 
+#define NSF_MMAP_THRESHOLD		0x40000		//files at least this big are mapped instead of read
+
 #define SAFE_DELETE(p) { if(p){ delete[] p; p = NULL; } }
 #define SAFE_NEW(p,t,s,r) p = new t[s]; if(!p) return r; ZeroMemory(p,sizeof(t) * s)
 
@@ -35,17 +41,28 @@ int		CNSFFile::LoadFile(LPCSTR path,BYTE needdata,BYTE ignoreversion)
 {
 	Destroy();
 
-	FILE* file = fopen(path,"rb");
-	if(!file) return -1;
+	int size;
+	BYTE* data = MapFile(path,&size);
+	if(!data) return -1;
 
-	UINT type = 0;
-	fread(&type,4,1,file);
-	int ret = -1;
+	int ret = LoadMemory(data,size,needdata,ignoreversion,1);
 
-	if(type == HEADERTYPE_NESM)		ret = LoadFile_NESM(file,needdata,ignoreversion);
-	if(type == HEADERTYPE_NSFE)		ret = LoadFile_NSFE(file,needdata);
+	UnmapFile(data,size);
+	return ret;
+}
 
-	fclose(file);
+int		CNSFFile::LoadMemory(const void* data,int size,BYTE needdata,BYTE ignoreversion,BYTE copydata)
+{
+	Destroy();
+
+	if(!data || (size < 4)) return -1;
+
+	UINT type;
+	memcpy(&type,data,4);
+	int ret = -1;
+
+	if(type == HEADERTYPE_NESM)		ret = LoadMemory_NESM((const BYTE*)data,size,needdata,ignoreversion,copydata);
+	if(type == HEADERTYPE_NSFE)		ret = LoadMemory_NSFE((const BYTE*)data,size,needdata,copydata);
 
 	// Snake's revenge puts '00' for the initial track, which (after subtracting 1) makes it 256 or -1 (bad!)
 	// This prevents that crap
@@ -64,8 +81,71 @@ int		CNSFFile::LoadFile(LPCSTR path,BYTE needdata,BYTE ignoreversion)
 	return ret;
 }
 
+BYTE*	CNSFFile::MapFile(LPCSTR path,int* size)
+{
+	FILE* file = fopen(path,"rb");
+	if(!file) return NULL;
+
+	fseek(file,0,SEEK_END);
+	long len = ftell(file);
+	fseek(file,0,SEEK_SET);
+
+	BYTE* data = NULL;
+
+	if((len < 4) || (len > 0x7FFFFFFF))
+	{
+		fclose(file);
+		return NULL;
+	}
+
+#ifdef NSF_MMAP
+	if(len >= NSF_MMAP_THRESHOLD)
+	{
+		void* map = mmap(NULL,len,PROT_READ,MAP_PRIVATE,fileno(file),0);
+		if(map != MAP_FAILED)
+			data = (BYTE*)map;
+		fclose(file);
+		*size = (int)len;
+		return data;
+	}
+#endif
+
+	//small files are read in one go
+	data = new BYTE[len];
+	if(data && (fread(data,len,1,file) != 1))
+		SAFE_DELETE(data);
+
+	fclose(file);
+	*size = (int)len;
+	return data;
+}
+
+void	CNSFFile::UnmapFile(BYTE* data,int size)
+{
+#ifdef NSF_MMAP
+	if(size >= NSF_MMAP_THRESHOLD)
+	{
+		munmap(data,size);
+		return;
+	}
+#endif
+	SAFE_DELETE(data);
+}
+
+void	CNSFFile::ReleaseData()
+{
+	if(!bDataReferenced)
+		SAFE_DELETE(pDataBuffer);
+
+	pDataBuffer = NULL;
+	nDataBufferSize = 0;
+	bDataReferenced = 0;
+}
+
 void	CNSFFile::Destroy()
 {
+	if(bDataReferenced)
+		pDataBuffer = NULL;
 	SAFE_DELETE(pDataBuffer);
 	SAFE_DELETE(pPlaylist);
 	SAFE_DELETE(pTrackTime);
@@ -84,19 +164,32 @@ void	CNSFFile::Destroy()
 	ZeroMemory(this,sizeof(CNSFFile));
 }
 
-int CNSFFile::LoadFile_NESM(FILE* file,BYTE needdata,BYTE ignoreversion)
+int CNSFFile::SetData(const BYTE* data,int len,BYTE copydata)
 {
-	int len;
+	if(copydata)
+	{
+		SAFE_NEW(pDataBuffer,BYTE,len,1);
+		memcpy(pDataBuffer,data,len);
+	}
+	else
+	{
+		pDataBuffer = (BYTE*)data;
+		bDataReferenced = 1;
+	}
 
-	fseek(file,0,SEEK_END);
-	len = ftell(file) - 0x80;
-	fseek(file,0,SEEK_SET);
+	nDataBufferSize = len;
+	return 0;
+}
+
+int CNSFFile::LoadMemory_NESM(const BYTE* data,int size,BYTE needdata,BYTE ignoreversion,BYTE copydata)
+{
+	int len = size - 0x80;
 
 	if(len < 1) return -1;
 
 	//read the info
 	NESM_HEADER					hdr;
-	fread(&hdr,0x80,1,file);
+	memcpy(&hdr,data,0x80);
 
 	//confirm the header
 	if(hdr.nHeader != HEADERTYPE_NESM)			return -1;
@@ -132,28 +225,23 @@ int CNSFFile::LoadFile_NESM(FILE* file,BYTE needdata,BYTE ignoreversion)
 	memcpy(szArtist   ,hdr.szArtist   ,32);
 	memcpy(szCopyright,hdr.szCopyright,32);
 
-	//read the NSF data
+	//the NSF data
 	if(needdata)
-	{
-		SAFE_NEW(pDataBuffer,BYTE,len,1);
-		fread(pDataBuffer,len,1,file);
-		nDataBufferSize = len;
-	}
+		return SetData(data + 0x80,len,copydata);
 
 	//if we got this far... it was a successful read
 	return 0;
 }
 
-int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
+int CNSFFile::LoadMemory_NSFE(const BYTE* data,int size,BYTE needdata,BYTE copydata)
 {
-	//restart the file
-	fseek(file,0,SEEK_SET);
-
 	//the vars we'll be using
 	UINT nChunkType;
 	int  nChunkSize;
 	int  nChunkUsed;
+	int  nPos = 0;
 	int  nDataPos = 0;
+	const BYTE*	pChunk;
 	BYTE	bInfoFound = 0;
 	BYTE	bEndFound = 0;
 	BYTE	bBankFound = 0;
@@ -163,15 +251,22 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 	info.nTrackCount = 1;		//default values
 
 	//confirm the header!
-	fread(&nChunkType,4,1,file);
+	memcpy(&nChunkType,data,4);
 	if(nChunkType != HEADERTYPE_NSFE)			return -1;
+	nPos = 4;
 
 	//begin reading chunks
 	while(!bEndFound)
 	{
-		if(feof(file))							return -1;
-		fread(&nChunkSize,4,1,file);
-		fread(&nChunkType,4,1,file);
+		if(nPos > size - 8)						return -1;
+		memcpy(&nChunkSize,data + nPos,4);
+		memcpy(&nChunkType,data + nPos + 4,4);
+		nPos += 8;
+
+		if((nChunkSize < 0) || (nChunkSize > size - nPos))	return -1;	//truncated chunk
+
+		pChunk = data + nPos;
+		nPos += nChunkSize;
 
 		switch(nChunkType)
 		{
@@ -182,8 +277,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			bInfoFound = 1;
 			nChunkUsed = min((int)sizeof(NSFE_INFOCHUNK),nChunkSize);
 
-			fread(&info,nChunkUsed,1,file);
-			fseek(file,nChunkSize - nChunkUsed,SEEK_CUR);
+			memcpy(&info,pChunk,nChunkUsed);
 
 			bIsExtended =			1;
 			nIsPal =				info.nIsPal & 3;
@@ -204,9 +298,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			if(nChunkSize < 1)					return -1;
 
 			nDataBufferSize = nChunkSize;
-			nDataPos = ftell(file);
-
-			fseek(file,nChunkSize,SEEK_CUR);
+			nDataPos = (int)(pChunk - data);
 			break;
 
 		case CHUNKTYPE_NEND:
@@ -220,8 +312,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			SAFE_NEW(pTrackTime,int,nTrackCount,1);
 			nChunkUsed = min(nChunkSize / 4,nTrackCount);
 
-			fread(pTrackTime,nChunkUsed,4,file);
-			fseek(file,nChunkSize - (nChunkUsed * 4),SEEK_CUR);
+			memcpy(pTrackTime,pChunk,nChunkUsed * 4);
 
 			for(; nChunkUsed < nTrackCount; nChunkUsed++)
 				pTrackTime[nChunkUsed] = -1;	//negative signals to use default time
@@ -235,8 +326,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			SAFE_NEW(pTrackFade,int,nTrackCount,1);
 			nChunkUsed = min(nChunkSize / 4,nTrackCount);
 
-			fread(pTrackFade,nChunkUsed,4,file);
-			fseek(file,nChunkSize - (nChunkUsed * 4),SEEK_CUR);
+			memcpy(pTrackFade,pChunk,nChunkUsed * 4);
 
 			for(; nChunkUsed < nTrackCount; nChunkUsed++)
 				pTrackFade[nChunkUsed] = -1;	//negative signals to use default time
@@ -249,8 +339,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			bBankFound = 1;
 			nChunkUsed = min(8,nChunkSize);
 
-			fread(nBankswitch,nChunkUsed,1,file);
-			fseek(file,nChunkSize - nChunkUsed,SEEK_CUR);
+			memcpy(nBankswitch,pChunk,nChunkUsed);
 			break;
 
 		case CHUNKTYPE_PLST:
@@ -260,7 +349,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			if(nPlaylistSize < 1)				break;  //no playlist?
 
 			SAFE_NEW(pPlaylist,BYTE,nPlaylistSize,1);
-			fread(pPlaylist,nChunkSize,1,file);
+			memcpy(pPlaylist,pChunk,nChunkSize);
 			break;
 
 		case CHUNKTYPE_AUTH:		{
@@ -270,7 +359,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			char*		ptr;
 			SAFE_NEW(buffer,char,nChunkSize + 4,1);
 
-			fread(buffer,nChunkSize,1,file);
+			memcpy(buffer,pChunk,nChunkSize);
 			ptr = buffer;
 
 			char**		ar[4] = {&szGameTitle,&szArtist,&szCopyright,&szRipper};
@@ -296,7 +385,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			char*		ptr;
 			SAFE_NEW(buffer,char,nChunkSize + nTrackCount,1);
 
-			fread(buffer,nChunkSize,1,file);
+			memcpy(buffer,pChunk,nChunkSize);
 			ptr = buffer;
 
 			int			i;
@@ -316,8 +405,6 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 			if((nChunkType >= 'A') && (nChunkType <= 'Z'))	//chunk is vital... don't continue
 				return -1;
 			//otherwise, just skip it
-			fseek(file,nChunkSize,SEEK_CUR);
-
 			break;
 		}		//end switch
 	}			//end while
@@ -333,11 +420,7 @@ int CNSFFile::LoadFile_NSFE(FILE* file,BYTE needdata)
 	//if both those chunks existed, this file is valid.  Load the data if it's needed
 
 	if(needdata)
-	{
-		fseek(file,nDataPos,SEEK_SET);
-		SAFE_NEW(pDataBuffer,BYTE,nDataBufferSize,1);
-		fread(pDataBuffer,nDataBufferSize,1,file);
-	}
+		return SetData(data + nDataPos,nDataBufferSize,copydata);
 	else
 		nDataBufferSize = 0;
 
@@ -83,12 +83,21 @@ public:
 														//  (like track times, game title, Author, etc)
 														//If you're loading an NSF with intention to play it, needdata
 														//  must be true
+	int				LoadMemory(const void* data,int size,BYTE needdata,BYTE ignoreversion,BYTE copydata);
+														//Same as LoadFile, from a NSF/NSFE already in memory.  If copydata
+														//  is false, pDataBuffer points inside 'data' (no copy), which
+														//  must then stay valid until ReleaseData or Destroy is called
+	void			ReleaseData();						//Frees (or forgets) pDataBuffer, once the core has loaded it
 	int				SaveFile(LPCSTR path);				//Saves the NSF to a file... including any changes you made (like to track times, etc)
 	void			Destroy();							//Cleans up memory
 
+	static BYTE*	MapFile(LPCSTR path,int* size);		//Whole file in memory, mapped when large enough.  NULL on error
+	static void		UnmapFile(BYTE* data,int size);
+
 protected:
-	int		LoadFile_NESM(FILE* file,BYTE needdata,BYTE ignoreversion);	//these functions are used internally and should not be called
-	int		LoadFile_NSFE(FILE* file,BYTE needdata);
+	int		LoadMemory_NESM(const BYTE* data,int size,BYTE needdata,BYTE ignoreversion,BYTE copydata);	//these functions are used internally and should not be called
+	int		LoadMemory_NSFE(const BYTE* data,int size,BYTE needdata,BYTE copydata);
+	int		SetData(const BYTE* data,int len,BYTE copydata);
 
 	int		SaveFile_NESM(FILE* file);
 	int		SaveFile_NSFE(FILE* file);
@@ -117,6 +126,7 @@ public:
 	//nsf data
 	BYTE*				pDataBuffer;		//the buffer containing NSF code.  If needdata was false when loading the NSF, this is NULL
 	int					nDataBufferSize;	//the size of the above buffer.  0 if needdata was false
+	bool				bDataReferenced;	//pDataBuffer points to memory owned by the caller of LoadMemory
 
 	//playlist
 	BYTE*				pPlaylist;			//the buffer containing the playlist (NULL if none exists).  Each entry is the zero based index of the song to play
@@ -1,17 +1,88 @@
 #include "layer3.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #ifdef LINUX
 #define __stdcall
 #endif
 
-#define MIN(a,b) ((a) < (b) ? (a) : (b)) 
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
 
-int __stdcall ShineMp3Encode(int wav_rate, int wav_channels, int wav_num_samples, short* wavData, int mp3_bitrate, int mp3_data_size, unsigned char* mp3_data)
+typedef struct
+{
+	shine_t s;
+
+	int channels;
+	int error;
+
+	// Shine wants exactly "samples_per_pass" frames per call, partial passes wait here.
+	short* wav_buffer;
+	int    wav_buffer_size;
+	int    wav_buffer_pos;
+
+	unsigned char* mp3_data;
+	int            mp3_size;
+	int            mp3_read;
+	int            mp3_capacity;
+} shine_encoder;
+
+static void shine_encoder_append(shine_encoder* enc, const unsigned char* data, int size)
+{
+	if (size <= 0)
+		return;
+
+	if (size > INT_MAX - (enc->mp3_size - enc->mp3_read))
+	{
+		enc->error = 1;
+		return;
+	}
+
+	if (enc->mp3_read > 0)
+	{
+		memmove(enc->mp3_data, enc->mp3_data + enc->mp3_read, enc->mp3_size - enc->mp3_read);
+		enc->mp3_size -= enc->mp3_read;
+		enc->mp3_read = 0;
+	}
+
+	if (enc->mp3_size + size > enc->mp3_capacity)
+	{
+		int new_capacity = enc->mp3_capacity ? enc->mp3_capacity : 16384;
+
+		while (new_capacity < enc->mp3_size + size)
+			new_capacity = new_capacity > INT_MAX / 2 ? INT_MAX : new_capacity * 2;
+
+		unsigned char* new_data = (unsigned char*)realloc(enc->mp3_data, new_capacity);
+		if (!new_data)
+		{
+			enc->error = 1;
+			return;
+		}
+
+		enc->mp3_data = new_data;
+		enc->mp3_capacity = new_capacity;
+	}
+
+	memcpy(enc->mp3_data + enc->mp3_size, data, size);
+	enc->mp3_size += size;
+}
+
+static void shine_encoder_encode_pass(shine_encoder* enc)
+{
+	int written = 0;
+	unsigned char* data = shine_encode_buffer_interleaved(enc->s, enc->wav_buffer, &written);
+	shine_encoder_append(enc, data, written);
+	enc->wav_buffer_pos = 0;
+}
+
+void* __stdcall ShineMp3EncoderCreate(int wav_rate, int wav_channels, int mp3_bitrate)
 {
 	if (shine_check_config(wav_rate, mp3_bitrate) < 0)
-		return -1;
+		return NULL;
+
+	shine_encoder* enc = (shine_encoder*)calloc(1, sizeof(shine_encoder));
+	if (!enc)
+		return NULL;
 
 	shine_config_t config;
 	config.wave.channels   = wav_channels;
@@ -22,60 +93,121 @@ int __stdcall ShineMp3Encode(int wav_rate, int wav_channels, int wav_num_samples
 	config.mpeg.mode = wav_channels > 1 ? JOINT_STEREO : MONO;
 	config.mpeg.bitr = mp3_bitrate;
 
-	shine_t s = shine_initialise(&config);
+	enc->s = shine_initialise(&config);
+	if (!enc->s)
+	{
+		free(enc);
+		return NULL;
+	}
 
-	int samples_per_pass = shine_samples_per_pass(s);
-	int wav_buffer_size = samples_per_pass * sizeof(short) * wav_channels;
-	int mp3_buffer_pos = 0;
+	enc->channels = wav_channels;
+	enc->wav_buffer_size = shine_samples_per_pass(enc->s) * wav_channels;
+	enc->wav_buffer = (short*)malloc(enc->wav_buffer_size * sizeof(short));
+	if (!enc->wav_buffer)
+	{
+		shine_close(enc->s);
+		free(enc);
+		return NULL;
+	}
 
-	short* wav_buffer = (short*)malloc(wav_buffer_size);
+	return enc;
+}
 
-	for (int i = 0; i < wav_num_samples; i += samples_per_pass * wav_channels)
+// Feeds interleaved PCM, "num_samples" counts individual shorts. Returns 0 on success.
+int __stdcall ShineMp3EncoderFeed(void* handle, int num_samples, const short* wav_data)
+{
+	shine_encoder* enc = (shine_encoder*)handle;
+
+	while (num_samples > 0 && !enc->error)
 	{
-		int batch_size = (wav_num_samples - i) * sizeof(short);
+		int count = MIN(num_samples, enc->wav_buffer_size - enc->wav_buffer_pos);
 
-		if (batch_size >= wav_buffer_size)
-		{
-			memcpy(wav_buffer, &wavData[i], wav_buffer_size);
-		}
-		else
-		{
-			memcpy(wav_buffer, &wavData[i], batch_size);
-			memset((unsigned char*)wav_buffer + batch_size, 0, wav_buffer_size - batch_size);
-		}
+		memcpy(enc->wav_buffer + enc->wav_buffer_pos, wav_data, count * sizeof(short));
+		enc->wav_buffer_pos += count;
+		wav_data    += count;
+		num_samples -= count;
 
-		int written = 0;
-		unsigned char* data = shine_encode_buffer_interleaved(s, wav_buffer, &written);
+		if (enc->wav_buffer_pos == enc->wav_buffer_size)
+			shine_encoder_encode_pass(enc);
+	}
 
-		if (mp3_buffer_pos + written > mp3_data_size)
-		{
-			mp3_buffer_pos = -1;
-			break;
-		}
+	return enc->error ? -1 : 0;
+}
+
+// Pads and encodes the last partial pass, then flushes the encoder. Returns 0 on success.
+int __stdcall ShineMp3EncoderFinish(void* handle)
+{
+	shine_encoder* enc = (shine_encoder*)handle;
+
+	if (enc->error)
+		return -1;
 
-		memcpy(mp3_data + mp3_buffer_pos, data, written);
-		mp3_buffer_pos += written;
+	if (enc->wav_buffer_pos > 0)
+	{
+		memset(enc->wav_buffer + enc->wav_buffer_pos, 0, (enc->wav_buffer_size - enc->wav_buffer_pos) * sizeof(short));
+		shine_encoder_encode_pass(enc);
 	}
 
-	free(wav_buffer);
+	int written = 0;
+	unsigned char* data = shine_flush(enc->s, &written);
+	shine_encoder_append(enc, data, written);
+
+	return enc->error ? -1 : 0;
+}
+
+int __stdcall ShineMp3EncoderGetPendingSize(void* handle)
+{
+	shine_encoder* enc = (shine_encoder*)handle;
+	return enc->mp3_size - enc->mp3_read;
+}
+
+// Copies at most "mp3_data_size" pending bytes into "mp3_data" and returns the number of bytes copied.
+int __stdcall ShineMp3EncoderRead(void* handle, int mp3_data_size, unsigned char* mp3_data)
+{
+	shine_encoder* enc = (shine_encoder*)handle;
+	int size = MIN(enc->mp3_size - enc->mp3_read, mp3_data_size);
+
+	memcpy(mp3_data, enc->mp3_data + enc->mp3_read, size);
+	enc->mp3_read += size;
 
-	if (mp3_buffer_pos >= 0)
+	if (enc->mp3_read == enc->mp3_size)
 	{
-		int written = 0;
-		unsigned char* data = shine_flush(s, &written);
+		enc->mp3_read = 0;
+		enc->mp3_size = 0;
+	}
 
-		if (mp3_buffer_pos + written <= mp3_data_size)
-		{
-			memcpy(mp3_data + mp3_buffer_pos, data, written);
-			mp3_buffer_pos += written;
-		}
-		else
-		{
-			mp3_buffer_pos = -1;
-		}
+	return size;
+}
+
+void __stdcall ShineMp3EncoderDestroy(void* handle)
+{
+	shine_encoder* enc = (shine_encoder*)handle;
+
+	if (!enc)
+		return;
+
+	shine_close(enc->s);
+	free(enc->wav_buffer);
+	free(enc->mp3_data);
+	free(enc);
+}
+
+int __stdcall ShineMp3Encode(int wav_rate, int wav_channels, int wav_num_samples, short* wavData, int mp3_bitrate, int mp3_data_size, unsigned char* mp3_data)
+{
+	void* enc = ShineMp3EncoderCreate(wav_rate, wav_channels, mp3_bitrate);
+	int mp3_buffer_pos = -1;
+
+	if (!enc)
+		return -1;
+
+	if (ShineMp3EncoderFeed(enc, wav_num_samples, wavData) == 0 &&
+		ShineMp3EncoderFinish(enc) == 0 &&
+		ShineMp3EncoderGetPendingSize(enc) <= mp3_data_size)
+	{
+		mp3_buffer_pos = ShineMp3EncoderRead(enc, mp3_data_size, mp3_data);
 	}
 
-	shine_close(s);
+	ShineMp3EncoderDestroy(enc);
 
 	return mp3_buffer_pos;
 }
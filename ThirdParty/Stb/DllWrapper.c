@@ -12,6 +12,14 @@
 #include <alloca.h>
 #endif
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define MAX_ATLAS_THREADS 16
+
 int __stdcall StbGetNumberOfFonts(const unsigned char* data)
 {
 	return stbtt_GetNumberOfFonts(data);
@@ -145,3 +153,159 @@ int __stdcall StbPackRects(stbrp_context* pack, const int* widths, const int* he
 
 	return result;
 }
+
+typedef struct
+{
+	int x;
+	int y;
+	int width;
+	int height;
+	int xoffset;
+	int yoffset;
+	int advance;
+	int glyph;
+} StbGlyphMetrics;
+
+typedef struct
+{
+	const stbtt_fontinfo* info;
+	const StbGlyphMetrics* metrics;
+	unsigned char* atlas;
+	int* kerning;
+	int atlas_width;
+	int num;
+	int thread_idx;
+	int num_threads;
+	float scale;
+} StbAtlasJob;
+
+// Each thread handles every "num_threads" glyph, glyphs never overlap in the atlas.
+static void StbAtlasWorker(StbAtlasJob* job)
+{
+	for (int i = job->thread_idx; i < job->num; i += job->num_threads)
+	{
+		const StbGlyphMetrics* m = &job->metrics[i];
+
+		if (m->x >= 0 && m->width > 0 && m->height > 0)
+			stbtt_MakeGlyphBitmap(job->info, &job->atlas[m->y * job->atlas_width + m->x], m->width, m->height, job->atlas_width, job->scale, job->scale, m->glyph);
+
+		if (job->kerning)
+		{
+			for (int j = 0; j < job->num; j++)
+				job->kerning[i * job->num + j] = stbtt_GetGlyphKernAdvance(job->info, m->glyph, job->metrics[j].glyph);
+		}
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI StbAtlasThreadProc(LPVOID param)
+{
+	StbAtlasWorker((StbAtlasJob*)param);
+	return 0;
+}
+#else
+static void* StbAtlasThreadProc(void* param)
+{
+	StbAtlasWorker((StbAtlasJob*)param);
+	return NULL;
+}
+#endif
+
+// Packs, rasterizes and measures all the given codepoints in one go. The atlas is a
+// single channel image of "atlas_width" x "atlas_height" and "kerning" (optional) is a
+// dense num x num table of unscaled kerning values. Returns 1 if every glyph fit.
+int __stdcall StbBuildAtlas(const stbtt_fontinfo* info, const int* codepoints, int num, float scale, int padding, int atlas_width, int atlas_height, unsigned char* atlas, StbGlyphMetrics* metrics, int* kerning, int num_threads)
+{
+	stbrp_context context;
+	stbrp_node* nodes = (stbrp_node*)malloc(sizeof(stbrp_node) * atlas_width);
+	stbrp_rect* rects = (stbrp_rect*)malloc(sizeof(stbrp_rect) * num);
+	StbAtlasJob jobs[MAX_ATLAS_THREADS];
+
+	for (int i = 0; i < num; i++)
+	{
+		StbGlyphMetrics* m = &metrics[i];
+		int x0, y0, x1, y1, lsb;
+
+		m->glyph = stbtt_FindGlyphIndex(info, codepoints[i]);
+		stbtt_GetGlyphHMetrics(info, m->glyph, &m->advance, &lsb);
+		stbtt_GetGlyphBitmapBox(info, m->glyph, scale, scale, &x0, &y0, &x1, &y1);
+
+		m->width   = x1 - x0;
+		m->height  = y1 - y0;
+		m->xoffset = x0;
+		m->yoffset = y0;
+
+		rects[i].id = i;
+		rects[i].w = m->width  > 0 ? m->width  + padding : 0;
+		rects[i].h = m->height > 0 ? m->height + padding : 0;
+	}
+
+	stbrp_init_target(&context, atlas_width, atlas_height, nodes, atlas_width);
+	int result = stbrp_pack_rects(&context, rects, num);
+
+	for (int i = 0; i < num; i++)
+	{
+		metrics[i].x = rects[i].was_packed ? rects[i].x : -1;
+		metrics[i].y = rects[i].was_packed ? rects[i].y : -1;
+	}
+
+	free(rects);
+	free(nodes);
+
+	memset(atlas, 0, atlas_width * atlas_height);
+
+	if (num_threads < 1)
+		num_threads = 1;
+	if (num_threads > MAX_ATLAS_THREADS)
+		num_threads = MAX_ATLAS_THREADS;
+	if (num_threads > num)
+		num_threads = num > 0 ? num : 1;
+
+	for (int t = 0; t < num_threads; t++)
+	{
+		jobs[t].info = info;
+		jobs[t].metrics = metrics;
+		jobs[t].atlas = atlas;
+		jobs[t].kerning = kerning;
+		jobs[t].atlas_width = atlas_width;
+		jobs[t].num = num;
+		jobs[t].thread_idx = t;
+		jobs[t].num_threads = num_threads;
+		jobs[t].scale = scale;
+	}
+
+	// Thread #0 is the calling thread.
+#ifdef _WIN32
+	HANDLE threads[MAX_ATLAS_THREADS];
+	for (int t = 1; t < num_threads; t++)
+		threads[t] = CreateThread(NULL, 0, StbAtlasThreadProc, &jobs[t], 0, NULL);
+	StbAtlasWorker(&jobs[0]);
+	for (int t = 1; t < num_threads; t++)
+	{
+		if (threads[t])
+		{
+			WaitForSingleObject(threads[t], INFINITE);
+			CloseHandle(threads[t]);
+		}
+		else
+		{
+			StbAtlasWorker(&jobs[t]);
+		}
+	}
+#else
+	pthread_t threads[MAX_ATLAS_THREADS];
+	int created[MAX_ATLAS_THREADS] = { 0 };
+	for (int t = 1; t < num_threads; t++)
+		created[t] = pthread_create(&threads[t], NULL, StbAtlasThreadProc, &jobs[t]) == 0;
+	StbAtlasWorker(&jobs[0]);
+	for (int t = 1; t < num_threads; t++)
+	{
+		if (created[t])
+			pthread_join(threads[t], NULL);
+		else
+			StbAtlasWorker(&jobs[t]);
+	}
+#endif
+
+	return result;
+}
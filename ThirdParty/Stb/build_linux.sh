@@ -1,2 +1,2 @@
-gcc -fPIC -O2 -shared -I. -DLINUX -static-libgcc -static-libstdc++ DllWrapper.c -o libStb.so
+gcc -fPIC -O2 -shared -I. -DLINUX -static-libgcc -static-libstdc++ -pthread DllWrapper.c -o libStb.so
 cp libStb.so ../../FamiStudio/
@@ -1,18 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
 #include <math.h>
 #include <vorbis/vorbisenc.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VORBIS_SSE2 1
+#endif
+
 #define READ 1024
-signed char readbuffer[READ * 4 + 44]; /* out of the data segment, not the stack */
 
 #ifdef LINUX
 #define __stdcall
 #endif
 
-int __stdcall VorbisOggEncode(int wav_rate, int wav_channels, int wav_num_samples, short* wav_data, int ogg_bitrate, int ogg_data_size, unsigned char* ogg_data)
+// Called for every ogg page (header and body separately). Return non-zero to abort the encode.
+typedef int (__stdcall *ogg_write_func)(const unsigned char* data, int size, void* user);
+
+typedef struct
 {
 	ogg_stream_state os;
 	ogg_page         og;
@@ -23,109 +31,309 @@ int __stdcall VorbisOggEncode(int wav_rate, int wav_channels, int wav_num_sample
 	vorbis_dsp_state vd;
 	vorbis_block     vb;
 
-	int eos = 0, ret;
-	int read_idx = 0;
-	int write_idx = 0;
+	int channels;
+	int eos;
+	int error;
+
+	// When no callback is provided, pages accumulate here until drained with VorbisOggEncoderRead.
+	ogg_write_func write_func;
+	void*          write_user;
+	unsigned char* out_data;
+	int            out_size;
+	int            out_read;
+	int            out_capacity;
+} vorbis_encoder;
+
+static int vorbis_encoder_append(vorbis_encoder* enc, const unsigned char* data, int size)
+{
+	if (enc->write_func)
+		return enc->write_func(data, size, enc->write_user) == 0;
+
+	// Compact what has already been drained before growing.
+	if (enc->out_read > 0)
+	{
+		memmove(enc->out_data, enc->out_data + enc->out_read, enc->out_size - enc->out_read);
+		enc->out_size -= enc->out_read;
+		enc->out_read = 0;
+	}
+
+	// Refuse to grow past INT_MAX rather than letting the size wrap around.
+	if (size < 0 || size > INT_MAX - enc->out_size)
+		return 0;
+
+	if (enc->out_size + size > enc->out_capacity)
+	{
+		int new_capacity = enc->out_capacity ? enc->out_capacity : 16384;
+		unsigned char* new_data;
+
+		while (new_capacity < enc->out_size + size)
+			new_capacity = new_capacity > INT_MAX / 2 ? INT_MAX : new_capacity * 2;
+
+		new_data = (unsigned char*)realloc(enc->out_data, new_capacity);
+		if (!new_data)
+			return 0;
+
+		enc->out_data = new_data;
+		enc->out_capacity = new_capacity;
+	}
+
+	memcpy(enc->out_data + enc->out_size, data, size);
+	enc->out_size += size;
+
+	return 1;
+}
+
+static void vorbis_encoder_write_page(vorbis_encoder* enc)
+{
+	if (!vorbis_encoder_append(enc, enc->og.header, enc->og.header_len) ||
+		!vorbis_encoder_append(enc, enc->og.body, enc->og.body_len))
+	{
+		enc->error = 1;
+	}
+}
+
+static void vorbis_encoder_flush_blocks(vorbis_encoder* enc)
+{
+	while (vorbis_analysis_blockout(&enc->vd, &enc->vb) == 1)
+	{
+		vorbis_analysis(&enc->vb, NULL);
+		vorbis_bitrate_addblock(&enc->vb);
+
+		while (vorbis_bitrate_flushpacket(&enc->vd, &enc->op))
+		{
+			ogg_stream_packetin(&enc->os, &enc->op);
+
+			while (!enc->eos && !enc->error)
+			{
+				int result = ogg_stream_pageout(&enc->os, &enc->og);
+
+				if (result == 0)
+					break;
+
+				vorbis_encoder_write_page(enc);
+
+				if (ogg_page_eos(&enc->og))
+					enc->eos = 1;
+			}
+		}
+	}
+}
+
+// Converts interleaved 16-bit PCM to planar float.
+static void deinterleave_to_float(const short* src, int num_frames, int channels, float** dst)
+{
+	const float scale = 1.0f / 32768.0f;
+	int i = 0;
+
+	if (channels == 2)
+	{
+		float* left  = dst[0];
+		float* right = dst[1];
+
+#ifdef VORBIS_SSE2
+		const __m128 vscale = _mm_set1_ps(scale);
+
+		for (; i + 4 <= num_frames; i += 4)
+		{
+			// L0 R0 L1 R1 L2 R2 L3 R3 -> sign extend pairs to 32-bit.
+			__m128i lr = _mm_loadu_si128((const __m128i*)&src[i * 2]);
+			__m128i l  = _mm_srai_epi32(_mm_slli_epi32(lr, 16), 16);
+			__m128i r  = _mm_srai_epi32(lr, 16);
+			_mm_storeu_ps(&left[i],  _mm_mul_ps(_mm_cvtepi32_ps(l), vscale));
+			_mm_storeu_ps(&right[i], _mm_mul_ps(_mm_cvtepi32_ps(r), vscale));
+		}
+#endif
+		for (; i < num_frames; i++)
+		{
+			left[i]  = src[i * 2 + 0] * scale;
+			right[i] = src[i * 2 + 1] * scale;
+		}
+	}
+	else
+	{
+		float* mono = dst[0];
+
+#ifdef VORBIS_SSE2
+		const __m128 vscale = _mm_set1_ps(scale);
+
+		for (; i + 8 <= num_frames; i += 8)
+		{
+			__m128i s  = _mm_loadu_si128((const __m128i*)&src[i]);
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+			_mm_storeu_ps(&mono[i + 0], _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+			_mm_storeu_ps(&mono[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+		}
+#endif
+		for (; i < num_frames; i++)
+		{
+			mono[i] = src[i] * scale;
+		}
+	}
+}
+
+void* __stdcall VorbisOggEncoderCreate(int wav_rate, int wav_channels, int ogg_bitrate, ogg_write_func write_func, void* write_user)
+{
+	vorbis_encoder* enc;
 
-	vorbis_info_init(&vi);
+	if (wav_channels != 1 && wav_channels != 2)
+		return NULL;
+
+	enc = (vorbis_encoder*)calloc(1, sizeof(vorbis_encoder));
+	if (!enc)
+		return NULL;
+
+	enc->channels = wav_channels;
+	enc->write_func = write_func;
+	enc->write_user = write_user;
+
+	vorbis_info_init(&enc->vi);
 
 	// This seem to the the maximum supported rate.
 	if (ogg_bitrate > 240)
 		ogg_bitrate = 240;
 
-	ret = vorbis_encode_init(&vi, wav_channels, wav_rate, -1, ogg_bitrate * 1000, -1);
-
-	if (ret) 
-		return -1;
+	if (vorbis_encode_init(&enc->vi, wav_channels, wav_rate, -1, ogg_bitrate * 1000, -1))
+	{
+		vorbis_info_clear(&enc->vi);
+		free(enc);
+		return NULL;
+	}
 
-	vorbis_comment_init(&vc);
-	vorbis_comment_add_tag(&vc, "ENCODER", "FamiStudio");
-	vorbis_analysis_init(&vd, &vi);
-	vorbis_block_init(&vd, &vb);
+	vorbis_comment_init(&enc->vc);
+	vorbis_comment_add_tag(&enc->vc, "ENCODER", "FamiStudio");
+	vorbis_analysis_init(&enc->vd, &enc->vi);
+	vorbis_block_init(&enc->vd, &enc->vb);
 
-	ogg_stream_init(&os, 123);
+	ogg_stream_init(&enc->os, 123);
 
 	{
 		ogg_packet header;
 		ogg_packet header_comm;
 		ogg_packet header_code;
 
-		vorbis_analysis_headerout(&vd, &vc, &header, &header_comm, &header_code);
-		ogg_stream_packetin(&os, &header);
-		ogg_stream_packetin(&os, &header_comm);
-		ogg_stream_packetin(&os, &header_code);
+		vorbis_analysis_headerout(&enc->vd, &enc->vc, &header, &header_comm, &header_code);
+		ogg_stream_packetin(&enc->os, &header);
+		ogg_stream_packetin(&enc->os, &header_comm);
+		ogg_stream_packetin(&enc->os, &header_code);
 
-		while (!eos) 
+		while (!enc->error)
 		{
-			int result = ogg_stream_flush(&os, &og);
-			
+			int result = ogg_stream_flush(&enc->os, &enc->og);
+
 			if (result == 0)
 				break;
 
-			memcpy(&ogg_data[write_idx], og.header, og.header_len);
-			write_idx += og.header_len;
-			memcpy(&ogg_data[write_idx], og.body, og.body_len);
-			write_idx += og.body_len;
+			vorbis_encoder_write_page(enc);
 		}
 	}
 
-	while (!eos) 
+	return enc;
+}
+
+// Feeds interleaved PCM, "num_samples" counts individual shorts, like VorbisOggEncode. Returns 0 on success.
+int __stdcall VorbisOggEncoderFeed(void* handle, int num_samples, const short* wav_data)
+{
+	vorbis_encoder* enc = (vorbis_encoder*)handle;
+	int num_frames = num_samples / enc->channels;
+
+	if (enc->error || enc->eos)
+		return -1;
+
+	while (num_frames > 0 && !enc->error)
 	{
-		long i = 0;
-		float **buffer = vorbis_analysis_buffer(&vd, READ);
+		int count = num_frames < READ ? num_frames : READ;
+		float** buffer = vorbis_analysis_buffer(&enc->vd, count);
 
-		if (wav_channels == 2)
-		{
-			for (i = 0; i < READ && read_idx < wav_num_samples; i++, read_idx += 2)
-			{
-				buffer[0][i] = wav_data[read_idx + 0] / 32768.f;
-				buffer[1][i] = wav_data[read_idx + 1] / 32768.f;
-			}
-		}
-		else
-		{
-			for (i = 0; i < READ && read_idx < wav_num_samples; i++, read_idx++)
-			{
-				buffer[0][i] = wav_data[read_idx] / 32768.f;
-			}
-		}
+		deinterleave_to_float(wav_data, count, enc->channels, buffer);
+		vorbis_analysis_wrote(&enc->vd, count);
+		vorbis_encoder_flush_blocks(enc);
 
-		vorbis_analysis_wrote(&vd, i);
+		wav_data   += count * enc->channels;
+		num_frames -= count;
+	}
 
-		while (vorbis_analysis_blockout(&vd, &vb) == 1)
-		{
-			vorbis_analysis(&vb, NULL);
-			vorbis_bitrate_addblock(&vb);
+	return enc->error ? -1 : 0;
+}
 
-			while (vorbis_bitrate_flushpacket(&vd, &op)) 
-			{
-				ogg_stream_packetin(&os, &op);
-
-				while (!eos) 
-				{
-					int result = ogg_stream_pageout(&os, &og);
-					
-					if (result == 0)
-						break;
-
-					memcpy(&ogg_data[write_idx], og.header, og.header_len);
-					write_idx += og.header_len;
-					memcpy(&ogg_data[write_idx], og.body, og.body_len);
-					write_idx += og.body_len;
-
-					if (ogg_page_eos(&og))
-						eos = 1;
-				}
-			}
-		}
+// Signals the end of the stream and flushes the last pages. Returns 0 on success.
+int __stdcall VorbisOggEncoderFinish(void* handle)
+{
+	vorbis_encoder* enc = (vorbis_encoder*)handle;
+
+	if (enc->error)
+		return -1;
+
+	if (!enc->eos)
+	{
+		vorbis_analysis_wrote(&enc->vd, 0);
+		vorbis_encoder_flush_blocks(enc);
 	}
 
-	ogg_stream_clear(&os);
-	vorbis_block_clear(&vb);
-	vorbis_dsp_clear(&vd);
-	vorbis_comment_clear(&vc);
-	vorbis_info_clear(&vi);
+	return enc->error ? -1 : 0;
+}
 
-	return write_idx;
+// Number of encoded bytes waiting to be drained (always 0 when using a write callback).
+int __stdcall VorbisOggEncoderGetPendingSize(void* handle)
+{
+	vorbis_encoder* enc = (vorbis_encoder*)handle;
+	return enc->out_size - enc->out_read;
+}
+
+// Copies at most "ogg_data_size" pending bytes into "ogg_data" and returns the number of bytes copied.
+int __stdcall VorbisOggEncoderRead(void* handle, int ogg_data_size, unsigned char* ogg_data)
+{
+	vorbis_encoder* enc = (vorbis_encoder*)handle;
+	int size = enc->out_size - enc->out_read;
+
+	if (size > ogg_data_size)
+		size = ogg_data_size;
+
+	memcpy(ogg_data, enc->out_data + enc->out_read, size);
+	enc->out_read += size;
+
+	if (enc->out_read == enc->out_size)
+	{
+		enc->out_read = 0;
+		enc->out_size = 0;
+	}
+
+	return size;
 }
 
+void __stdcall VorbisOggEncoderDestroy(void* handle)
+{
+	vorbis_encoder* enc = (vorbis_encoder*)handle;
+
+	if (!enc)
+		return;
+
+	ogg_stream_clear(&enc->os);
+	vorbis_block_clear(&enc->vb);
+	vorbis_dsp_clear(&enc->vd);
+	vorbis_comment_clear(&enc->vc);
+	vorbis_info_clear(&enc->vi);
+
+	free(enc->out_data);
+	free(enc);
+}
+
+int __stdcall VorbisOggEncode(int wav_rate, int wav_channels, int wav_num_samples, short* wav_data, int ogg_bitrate, int ogg_data_size, unsigned char* ogg_data)
+{
+	int write_idx = -1;
+	void* enc = VorbisOggEncoderCreate(wav_rate, wav_channels, ogg_bitrate, NULL, NULL);
+
+	if (!enc)
+		return -1;
+
+	if (VorbisOggEncoderFeed(enc, wav_num_samples, wav_data) == 0 &&
+		VorbisOggEncoderFinish(enc) == 0 &&
+		VorbisOggEncoderGetPendingSize(enc) <= ogg_data_size)
+	{
+		write_idx = VorbisOggEncoderRead(enc, ogg_data_size, ogg_data);
+	}
+
+	VorbisOggEncoderDestroy(enc);
+
+	return write_idx;
+}